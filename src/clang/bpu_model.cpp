@@ -0,0 +1,446 @@
+/***************************************************************************
+ * @COPYRIGHT NOTICE
+ * @Copyright 2023 Horizon Robotics, Inc.
+ * @All rights reserved.
+ ***************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "sp_bpu.h"
+
+#include "bpu_wrapper.h"
+#include "dnn/hb_dnn.h"
+
+#define ALIGN_16(v) ((v + (16 - 1)) / 16 * 16)
+
+#define BPU_POOL_DEFAULT_SIZE 4 // 加载模型时预分配的 tensor 组数
+#define BPU_POOL_MAX_SIZE 64    // 池的上限，到达后申请者等待归还；要能放下一批 ROI 的结果
+
+typedef struct
+{
+    bpu_tensor_set_t set;
+    std::vector<hbDNNTensor> inputs;
+    std::vector<hbDNNTensor> outputs;
+    bool in_use;
+} bpu_pool_entry_t;
+
+// 每个模型一份：缓存的 tensor 属性，以及按这些属性预分配好的 tensor 池
+typedef struct
+{
+    std::string name;
+    int32_t shared; // 属于模型注册表，不能单独释放
+    int32_t resizer; // 输入来自 resizer，可以用 hbDNNRoiInfer 在 BPU 上裁剪缩放
+    std::vector<hbDNNTensorProperties> input_props;
+    std::vector<hbDNNTensorProperties> output_props;
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::vector<std::unique_ptr<bpu_pool_entry_t>> entries;
+    bpu_pool_stats_t stats;
+} bpu_model_t;
+
+// 注册表：一个打包 bin 对应一个 packed handle，其中每个模型一个 bpu_module
+typedef struct
+{
+    hbPackedDNNHandle_t packed_dnn_handle;
+    std::vector<std::string> names;
+    std::vector<bpu_module *> modules;
+} bpu_models_t;
+
+static int32_t bpu_alloc_tensor(hbDNNTensor *tensor, const hbDNNTensorProperties &properties, int64_t *bytes)
+{
+    int32_t height = properties.validShape.dimensionSize[2];
+    int32_t width = properties.validShape.dimensionSize[3];
+    int32_t size = 4;
+    int32_t ret = 0;
+
+    memset(tensor, 0, sizeof(hbDNNTensor));
+    tensor->properties = properties;
+
+    if (properties.tensorType == HB_DNN_IMG_TYPE_NV12)
+    {
+        size = height * ALIGN_16(width) * 3 / 2;
+    }
+    else if (properties.tensorType == HB_DNN_IMG_TYPE_NV12_SEPARATE)
+    {
+        // Y 和 UV 分开存放
+        size = height * ALIGN_16(width);
+        ret = hbSysAllocCachedMem(&tensor->sysMem[1], size / 2);
+        if (ret)
+            return ret;
+        *bytes += size / 2;
+    }
+    else
+    {
+        // 与 x3_bpu_init_tensors 一致，按对齐后的形状、每个元素 4 字节分配
+        for (int32_t j = 0; j < properties.alignedShape.numDimensions; j++)
+            size *= properties.alignedShape.dimensionSize[j];
+    }
+
+    ret = hbSysAllocCachedMem(&tensor->sysMem[0], size);
+    if (ret)
+        return ret;
+    *bytes += size;
+    return 0;
+}
+
+static void bpu_free_tensor(hbDNNTensor *tensor)
+{
+    for (int32_t i = 0; i < 2; i++)
+    {
+        if (tensor->sysMem[i].virAddr)
+            hbSysFreeMem(&tensor->sysMem[i]);
+        tensor->sysMem[i].virAddr = NULL;
+    }
+}
+
+static void bpu_pool_free_entry(bpu_pool_entry_t *entry)
+{
+    for (auto &tensor : entry->inputs)
+        bpu_free_tensor(&tensor);
+    for (auto &tensor : entry->outputs)
+        bpu_free_tensor(&tensor);
+}
+
+// 调用时持有 model->mtx
+static bpu_pool_entry_t *bpu_pool_alloc_entry(bpu_model_t *model)
+{
+    std::unique_ptr<bpu_pool_entry_t> entry(new bpu_pool_entry_t());
+    int64_t bytes = 0;
+    int32_t ret = 0;
+    size_t i = 0;
+
+    entry->in_use = false;
+    entry->inputs.resize(model->input_props.size());
+    entry->outputs.resize(model->output_props.size());
+    for (i = 0; i < model->input_props.size() && ret == 0; i++)
+        ret = bpu_alloc_tensor(&entry->inputs[i], model->input_props[i], &bytes);
+    for (i = 0; i < model->output_props.size() && ret == 0; i++)
+        ret = bpu_alloc_tensor(&entry->outputs[i], model->output_props[i], &bytes);
+    if (ret)
+    {
+        printf("[BPU ERR] %s:hbSysAllocCachedMem failed!Error code:%d\n", __func__, ret);
+        bpu_pool_free_entry(entry.get());
+        return NULL;
+    }
+
+    entry->set.input = entry->inputs.data();
+    entry->set.input_count = entry->inputs.size();
+    entry->set.output = entry->outputs.data();
+    entry->set.output_count = entry->outputs.size();
+
+    model->stats.capacity++;
+    model->stats.alloc_count++;
+    model->stats.bytes += bytes;
+    model->entries.push_back(std::move(entry));
+    return model->entries.back().get();
+}
+
+int32_t x3_bpu_model_setup(bpu_module *bpu_handle, const char *model_name, int32_t shared)
+{
+    bpu_model_t *model = NULL;
+    int32_t input_count = 0, output_count = 0;
+    int32_t input_source = 0;
+    int32_t ret = 0;
+
+    ret = hbDNNGetInputCount(&input_count, bpu_handle->m_dnn_handle);
+    if (ret == 0)
+        ret = hbDNNGetOutputCount(&output_count, bpu_handle->m_dnn_handle);
+    if (ret)
+    {
+        printf("[BPU ERR] %s:get tensor count failed!Error code:%d\n", __func__, ret);
+        return ret;
+    }
+
+    model = new bpu_model_t();
+    model->name = model_name ? model_name : "";
+    model->shared = shared;
+    memset(&model->stats, 0, sizeof(bpu_pool_stats_t));
+    model->input_props.resize(input_count);
+    model->output_props.resize(output_count);
+    for (int32_t i = 0; i < input_count && ret == 0; i++)
+        ret = hbDNNGetInputTensorProperties(&model->input_props[i], bpu_handle->m_dnn_handle, i);
+    for (int32_t i = 0; i < output_count && ret == 0; i++)
+        ret = hbDNNGetOutputTensorProperties(&model->output_props[i], bpu_handle->m_dnn_handle, i);
+    if (ret)
+    {
+        printf("[BPU ERR] %s:get tensor properties failed!Error code:%d\n", __func__, ret);
+        delete model;
+        return ret;
+    }
+
+    model->resizer = 0;
+    if (input_count == 1 &&
+        hbDNNGetInputSource(&input_source, bpu_handle->m_dnn_handle, 0) == 0)
+        model->resizer = (input_source == HB_DNN_INPUT_FROM_RESIZER);
+
+    bpu_handle->m_model = model;
+    x3_bpu_model_reserve(bpu_handle, BPU_POOL_DEFAULT_SIZE);
+    return 0;
+}
+
+int32_t x3_bpu_model_reserve(bpu_module *bpu_handle, int32_t count)
+{
+    bpu_model_t *model = static_cast<bpu_model_t *>(bpu_handle->m_model);
+
+    if (model == NULL)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(model->mtx);
+    count = std::min(count, BPU_POOL_MAX_SIZE);
+    while ((int32_t)model->entries.size() < count)
+    {
+        if (bpu_pool_alloc_entry(model) == NULL)
+            return -1;
+    }
+    // 等待的申请者可以用新分配的 tensor
+    model->cond.notify_all();
+    return 0;
+}
+
+int32_t x3_bpu_model_teardown(bpu_module *bpu_handle)
+{
+    bpu_model_t *model = static_cast<bpu_model_t *>(bpu_handle->m_model);
+
+    if (model == NULL)
+        return 0;
+
+    // 还有 tensor 没归还时不能释放，否则持有者拿到的是野指针
+    if (x3_bpu_model_in_use(bpu_handle))
+    {
+        printf("[BPU ERR] %s:model %s tensors still in use\n", __func__, model->name.c_str());
+        return -1;
+    }
+    for (auto &entry : model->entries)
+        bpu_pool_free_entry(entry.get());
+    delete model;
+    bpu_handle->m_model = NULL;
+    return 0;
+}
+
+int32_t x3_bpu_model_in_use(bpu_module *bpu_handle)
+{
+    bpu_model_t *model = static_cast<bpu_model_t *>(bpu_handle->m_model);
+
+    if (model == NULL)
+        return 0;
+    std::lock_guard<std::mutex> lock(model->mtx);
+    return model->stats.in_use;
+}
+
+int32_t x3_bpu_model_is_shared(bpu_module *bpu_handle)
+{
+    bpu_model_t *model = static_cast<bpu_model_t *>(bpu_handle->m_model);
+    return model ? model->shared : 0;
+}
+
+int32_t x3_bpu_model_is_resizer(bpu_module *bpu_handle)
+{
+    bpu_model_t *model = static_cast<bpu_model_t *>(bpu_handle->m_model);
+    return model ? model->resizer : 0;
+}
+
+bpu_tensor_set_t *x3_bpu_acquire_tensors(bpu_module *bpu_handle)
+{
+    bpu_model_t *model = static_cast<bpu_model_t *>(bpu_handle->m_model);
+    bpu_pool_entry_t *entry = NULL;
+    bool waited = false;
+
+    if (model == NULL)
+        return NULL;
+
+    std::unique_lock<std::mutex> lock(model->mtx);
+    model->stats.acquire_count++;
+    while (1)
+    {
+        for (auto &e : model->entries)
+        {
+            if (!e->in_use)
+            {
+                entry = e.get();
+                model->stats.reuse_count++;
+                break;
+            }
+        }
+        if (entry == NULL && (int32_t)model->entries.size() < BPU_POOL_MAX_SIZE)
+            entry = bpu_pool_alloc_entry(model);
+        if (entry)
+            break;
+        if (!waited)
+        {
+            model->stats.wait_count++;
+            waited = true;
+        }
+        model->cond.wait(lock);
+    }
+
+    entry->in_use = true;
+    model->stats.in_use++;
+    if (model->stats.in_use > model->stats.peak_in_use)
+        model->stats.peak_in_use = model->stats.in_use;
+    return &entry->set;
+}
+
+int32_t x3_bpu_release_tensors(bpu_module *bpu_handle, bpu_tensor_set_t *tensors)
+{
+    bpu_model_t *model = static_cast<bpu_model_t *>(bpu_handle->m_model);
+
+    if (model == NULL || tensors == NULL)
+        return -1;
+
+    {
+        std::lock_guard<std::mutex> lock(model->mtx);
+        for (auto &e : model->entries)
+        {
+            if (&e->set == tensors && e->in_use)
+            {
+                e->in_use = false;
+                model->stats.in_use--;
+                model->cond.notify_one();
+                return 0;
+            }
+        }
+    }
+    printf("[BPU ERR] %s:tensors %p not from model pool\n", __func__, tensors);
+    return -1;
+}
+
+int32_t x3_bpu_predict_tensors(bpu_module *bpu_handle, bpu_tensor_set_t *tensors)
+{
+    hbDNNTaskHandle_t task_handle = nullptr;
+    hbDNNInferCtrlParam infer_ctrl_param;
+    int32_t ret = 0;
+
+    for (int32_t i = 0; i < tensors->input_count; i++)
+    {
+        for (int32_t j = 0; j < 2; j++)
+        {
+            if (tensors->input[i].sysMem[j].virAddr)
+                hbSysFlushMem(&tensors->input[i].sysMem[j], HB_SYS_MEM_CACHE_CLEAN);
+        }
+    }
+
+    HB_DNN_INITIALIZE_INFER_CTRL_PARAM(&infer_ctrl_param);
+    ret = hbDNNInfer(&task_handle, &tensors->output, tensors->input,
+                     bpu_handle->m_dnn_handle, &infer_ctrl_param);
+    if (ret)
+    {
+        printf("[BPU ERR] %s:hbDNNInfer failed!Error code:%d\n", __func__, ret);
+        return ret;
+    }
+    ret = hbDNNWaitTaskDone(task_handle, 0);
+    for (int32_t i = 0; i < tensors->output_count; i++)
+        hbSysFlushMem(&tensors->output[i].sysMem[0], HB_SYS_MEM_CACHE_INVALIDATE);
+    hbDNNReleaseTask(task_handle);
+    return ret;
+}
+
+int32_t x3_bpu_get_pool_stats(bpu_module *bpu_handle, bpu_pool_stats_t *stats)
+{
+    bpu_model_t *model = static_cast<bpu_model_t *>(bpu_handle->m_model);
+
+    if (model == NULL || stats == NULL)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(model->mtx);
+    *stats = model->stats;
+    return 0;
+}
+
+void *x3_bpu_load_models(const char *model_file_name)
+{
+    bpu_models_t *models = NULL;
+    hbPackedDNNHandle_t packed_dnn_handle = nullptr;
+    const char **model_name_list = NULL;
+    int32_t model_count = 0;
+    int32_t ret = 0;
+
+    ret = hbDNNInitializeFromFiles(&packed_dnn_handle, &model_file_name, 1);
+    if (ret)
+    {
+        printf("[BPU ERR] %s:hbDNNInitializeFromFiles %s failed!Error code:%d\n", __func__, model_file_name, ret);
+        return NULL;
+    }
+    ret = hbDNNGetModelNameList(&model_name_list, &model_count, packed_dnn_handle);
+    if (ret || model_count <= 0)
+    {
+        printf("[BPU ERR] %s:hbDNNGetModelNameList failed!Error code:%d\n", __func__, ret);
+        hbDNNRelease(packed_dnn_handle);
+        return NULL;
+    }
+
+    models = new bpu_models_t();
+    models->packed_dnn_handle = packed_dnn_handle;
+    for (int32_t i = 0; i < model_count; i++)
+    {
+        bpu_module *module = x3_bpu_module_create(packed_dnn_handle, model_name_list[i]);
+        if (module == NULL || x3_bpu_model_setup(module, model_name_list[i], 1))
+        {
+            if (module)
+                x3_bpu_module_destroy(module);
+            x3_bpu_release_models(models);
+            return NULL;
+        }
+        models->names.push_back(model_name_list[i]);
+        models->modules.push_back(module);
+        printf("[BPU MSG] load model %s\n", model_name_list[i]);
+    }
+
+    return models;
+}
+
+int32_t x3_bpu_release_models(void *handle)
+{
+    bpu_models_t *models = static_cast<bpu_models_t *>(handle);
+
+    // 先收掉所有异步任务，再确认没有模型的 tensor 还在外面，避免只释放了一部分模型
+    for (auto module : models->modules)
+    {
+        x3_bpu_async_deinit(module);
+        if (x3_bpu_model_in_use(module))
+        {
+            printf("[BPU ERR] %s:model tensors still in use\n", __func__);
+            return -1;
+        }
+    }
+    for (auto module : models->modules)
+        x3_bpu_module_destroy(module);
+    hbDNNRelease(models->packed_dnn_handle);
+    delete models;
+    return 0;
+}
+
+int32_t x3_bpu_get_model_count(void *handle)
+{
+    return static_cast<bpu_models_t *>(handle)->modules.size();
+}
+
+const char *x3_bpu_get_model_name(void *handle, int32_t index)
+{
+    bpu_models_t *models = static_cast<bpu_models_t *>(handle);
+
+    if (index < 0 || index >= (int32_t)models->names.size())
+        return NULL;
+    return models->names[index].c_str();
+}
+
+bpu_module *x3_bpu_get_model(void *handle, const char *model_name)
+{
+    bpu_models_t *models = static_cast<bpu_models_t *>(handle);
+
+    if (models->modules.empty())
+        return NULL;
+    if (model_name == NULL)
+        return models->modules[0];
+    for (size_t i = 0; i < models->names.size(); i++)
+    {
+        if (models->names[i] == model_name)
+            return models->modules[i];
+    }
+    return NULL;
+}
@@ -0,0 +1,308 @@
+/***************************************************************************
+ * @COPYRIGHT NOTICE
+ * @Copyright 2023 Horizon Robotics, Inc.
+ * @All rights reserved.
+ ***************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "sp_bpu.h"
+#include "sp_vio.h"
+
+#include "bpu_wrapper.h"
+#include "dnn/hb_dnn.h"
+
+// 一次裁剪缩放用到的临时内存，同一批 ROI 之间复用
+typedef struct
+{
+    std::vector<int32_t> x0;  // 每个输出列对应的左侧源像素
+    std::vector<int32_t> x1;  // 右侧源像素
+    std::vector<int32_t> wx;  // 右侧像素的权重，Q8
+    std::vector<uint8_t> row; // 垂直方向插值后的一行
+} bpu_resize_buf_t;
+
+// 两行按 Q7 权重混合：dst = (a * (128 - w) + b * w + 64) >> 7
+static void bpu_blend_rows(const uint8_t *a, const uint8_t *b, int32_t w, uint8_t *dst, int32_t len)
+{
+    int32_t i = 0;
+
+    if (w == 0)
+    {
+        memcpy(dst, a, len);
+        return;
+    }
+#if defined(__ARM_NEON)
+    uint8x8_t wa = vdup_n_u8(128 - w);
+    uint8x8_t wb = vdup_n_u8(w);
+    for (; i + 16 <= len; i += 16)
+    {
+        uint8x16_t va = vld1q_u8(a + i);
+        uint8x16_t vb = vld1q_u8(b + i);
+        uint16x8_t lo = vmull_u8(vget_low_u8(va), wa);
+        uint16x8_t hi = vmull_u8(vget_high_u8(va), wa);
+        lo = vmlal_u8(lo, vget_low_u8(vb), wb);
+        hi = vmlal_u8(hi, vget_high_u8(vb), wb);
+        vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, 7), vrshrn_n_u16(hi, 7)));
+    }
+#endif
+    for (; i < len; i++)
+        dst[i] = (a[i] * (128 - w) + b[i] * w + 64) >> 7;
+}
+
+// 双线性缩放一个平面的 [sx, sx + sw) x [sy, sy + sh) 区域到 dw x dh
+// channels 为 2 时是交织的 UV 平面，坐标以 UV 对为单位
+static void bpu_resize_plane(const uint8_t *src, int32_t src_stride, int32_t sx, int32_t sy,
+                             int32_t sw, int32_t sh, uint8_t *dst, int32_t dst_stride,
+                             int32_t dw, int32_t dh, int32_t channels, bpu_resize_buf_t *buf)
+{
+    const uint8_t *base = src + (size_t)sy * src_stride + sx * channels;
+    int32_t x = 0, y = 0, c = 0, fy = 0, y0 = 0, y1 = 0;
+    int32_t fx = 0;
+
+    buf->x0.resize(dw);
+    buf->x1.resize(dw);
+    buf->wx.resize(dw);
+    buf->row.resize(sw * channels);
+
+    // 像素中心对齐：src = (dst + 0.5) * sw / dw - 0.5
+    for (x = 0; x < dw; x++)
+    {
+        fx = (int32_t)((((int64_t)(2 * x + 1) * sw * 256) / (2 * dw)) - 128);
+        fx = std::max(fx, 0);
+        buf->x0[x] = std::min(fx >> 8, sw - 1);
+        buf->x1[x] = std::min(buf->x0[x] + 1, sw - 1);
+        buf->wx[x] = fx & 0xff;
+    }
+
+    for (y = 0; y < dh; y++)
+    {
+        fy = (int32_t)((((int64_t)(2 * y + 1) * sh * 128) / (2 * dh)) - 64);
+        fy = std::max(fy, 0);
+        y0 = std::min(fy >> 7, sh - 1);
+        y1 = std::min(y0 + 1, sh - 1);
+        bpu_blend_rows(base + (size_t)y0 * src_stride, base + (size_t)y1 * src_stride,
+                       (y0 == y1) ? 0 : (fy & 0x7f), buf->row.data(), sw * channels);
+
+        uint8_t *out = dst + (size_t)y * dst_stride;
+        const uint8_t *row = buf->row.data();
+        for (x = 0; x < dw; x++)
+        {
+            const uint8_t *p0 = row + buf->x0[x] * channels;
+            const uint8_t *p1 = row + buf->x1[x] * channels;
+            int32_t w = buf->wx[x];
+            for (c = 0; c < channels; c++)
+                *out++ = (p0[c] * (256 - w) + p1[c] * w + 128) >> 8;
+        }
+    }
+}
+
+static void bpu_roi_frame_planes(const sp_frame_lease_t *frame, int32_t *stride,
+                                 uint8_t **y, uint8_t **uv, uint64_t *y_paddr, uint64_t *uv_paddr)
+{
+    *stride = (frame->stride > 0) ? frame->stride : frame->width;
+    *y = frame->vaddr[0];
+    *y_paddr = frame->paddr[0];
+    if (frame->plane_count > 1)
+    {
+        *uv = frame->vaddr[1];
+        *uv_paddr = frame->paddr[1];
+    }
+    else
+    {
+        *uv = frame->vaddr[0] + (size_t)(*stride) * frame->height;
+        *uv_paddr = frame->paddr[0] ? frame->paddr[0] + (uint64_t)(*stride) * frame->height : 0;
+    }
+}
+
+// 整批交给 BPU 的 resizer 裁剪缩放，每个 ROI 的输入都是同一张源图
+static int32_t bpu_roi_infer_resizer(bpu_module *bpu_handle, sp_frame_lease_t *frame,
+                                     std::vector<hbDNNRoi> &rois, bpu_tensor_set_t **results)
+{
+    int32_t roi_count = rois.size();
+    int32_t stride = 0, ret = 0;
+    uint8_t *y = NULL, *uv = NULL;
+    uint64_t y_paddr = 0, uv_paddr = 0;
+    hbDNNTensor src;
+    std::vector<hbDNNTensor> inputs;
+    std::vector<hbDNNTensor> outputs;
+    hbDNNTensor *output = NULL;
+    hbDNNTaskHandle_t task_handle = nullptr;
+    hbDNNInferCtrlParam infer_ctrl_param;
+
+    bpu_roi_frame_planes(frame, &stride, &y, &uv, &y_paddr, &uv_paddr);
+    if (y_paddr == 0 || uv_paddr == 0)
+        return -1;
+
+    memset(&src, 0, sizeof(hbDNNTensor));
+    src.properties = bpu_handle->input_tensor.properties;
+    src.properties.tensorType = HB_DNN_IMG_TYPE_NV12_SEPARATE;
+    src.properties.validShape.numDimensions = 4;
+    src.properties.validShape.dimensionSize[0] = 1;
+    src.properties.validShape.dimensionSize[1] = 3;
+    src.properties.validShape.dimensionSize[2] = frame->height;
+    src.properties.validShape.dimensionSize[3] = frame->width;
+    src.properties.alignedShape = src.properties.validShape;
+    src.properties.alignedShape.dimensionSize[3] = stride;
+    src.sysMem[0].phyAddr = y_paddr;
+    src.sysMem[0].virAddr = y;
+    src.sysMem[0].memSize = stride * frame->height;
+    src.sysMem[1].phyAddr = uv_paddr;
+    src.sysMem[1].virAddr = uv;
+    src.sysMem[1].memSize = stride * frame->height / 2;
+
+    // hbDNNRoiInfer 的输入是 roi_count 份源图，输出按 ROI 顺序连续排放
+    inputs.assign(roi_count, src);
+    for (int32_t i = 0; i < roi_count; i++)
+        outputs.insert(outputs.end(), results[i]->output, results[i]->output + results[i]->output_count);
+    output = outputs.data();
+
+    HB_DNN_INITIALIZE_INFER_CTRL_PARAM(&infer_ctrl_param);
+    ret = hbDNNRoiInfer(&task_handle, &output, inputs.data(), rois.data(), roi_count,
+                        bpu_handle->m_dnn_handle, &infer_ctrl_param);
+    if (ret)
+        return ret;
+    ret = hbDNNWaitTaskDone(task_handle, 0);
+    hbDNNReleaseTask(task_handle);
+    if (ret)
+        return ret;
+
+    for (int32_t i = 0; i < roi_count; i++)
+    {
+        for (int32_t j = 0; j < results[i]->output_count; j++)
+            hbSysFlushMem(&(results[i]->output[j].sysMem[0]), HB_SYS_MEM_CACHE_INVALIDATE);
+    }
+    return 0;
+}
+
+// CPU 裁剪缩放：第 i 个 ROI 提交给 BPU 后马上处理第 i + 1 个，缩放和推理重叠执行
+static int32_t bpu_roi_infer_cpu(bpu_module *bpu_handle, sp_frame_lease_t *frame,
+                                 std::vector<hbDNNRoi> &rois, bpu_tensor_set_t **results)
+{
+    const hbDNNTensorProperties &model = bpu_handle->input_tensor.properties;
+    int32_t dst_h = model.validShape.dimensionSize[2];
+    int32_t dst_w = model.validShape.dimensionSize[3];
+    int32_t dst_stride = dst_w;
+    int32_t roi_count = rois.size();
+    int32_t stride = 0, ret = 0, submitted = 0;
+    uint8_t *y = NULL, *uv = NULL;
+    uint64_t y_paddr = 0, uv_paddr = 0;
+    std::vector<hbDNNTaskHandle_t> tasks(roi_count, nullptr);
+    hbDNNInferCtrlParam infer_ctrl_param;
+    bpu_resize_buf_t buf;
+
+    if (model.tensorType != HB_DNN_IMG_TYPE_NV12 &&
+        model.tensorType != HB_DNN_IMG_TYPE_NV12_SEPARATE)
+    {
+        printf("[BPU ERR] %s:model input type %d is not nv12\n", __func__, model.tensorType);
+        return -1;
+    }
+    if (model.tensorType == HB_DNN_IMG_TYPE_NV12_SEPARATE && model.alignedShape.dimensionSize[3] > 0)
+        dst_stride = model.alignedShape.dimensionSize[3];
+
+    bpu_roi_frame_planes(frame, &stride, &y, &uv, &y_paddr, &uv_paddr);
+    HB_DNN_INITIALIZE_INFER_CTRL_PARAM(&infer_ctrl_param);
+
+    for (int32_t i = 0; i < roi_count; i++)
+    {
+        const hbDNNRoi &roi = rois[i];
+        hbDNNTensor *input = results[i]->input;
+        hbDNNTensor *output = results[i]->output;
+        uint8_t *dst_y = (uint8_t *)input->sysMem[0].virAddr;
+        uint8_t *dst_uv = (model.tensorType == HB_DNN_IMG_TYPE_NV12) ?
+            dst_y + (size_t)dst_stride * dst_h : (uint8_t *)input->sysMem[1].virAddr;
+        int32_t sw = roi.right - roi.left + 1;
+        int32_t sh = roi.bottom - roi.top + 1;
+
+        bpu_resize_plane(y, stride, roi.left, roi.top, sw, sh,
+                         dst_y, dst_stride, dst_w, dst_h, 1, &buf);
+        bpu_resize_plane(uv, stride, roi.left / 2, roi.top / 2, sw / 2, sh / 2,
+                         dst_uv, dst_stride, dst_w / 2, dst_h / 2, 2, &buf);
+        hbSysFlushMem(&input->sysMem[0], HB_SYS_MEM_CACHE_CLEAN);
+        if (input->sysMem[1].virAddr)
+            hbSysFlushMem(&input->sysMem[1], HB_SYS_MEM_CACHE_CLEAN);
+
+        ret = hbDNNInfer(&tasks[i], &output, input, bpu_handle->m_dnn_handle, &infer_ctrl_param);
+        if (ret)
+        {
+            printf("[BPU ERR] %s:hbDNNInfer roi %d failed!Error code:%d\n", __func__, i, ret);
+            break;
+        }
+        submitted++;
+    }
+
+    for (int32_t i = 0; i < submitted; i++)
+    {
+        int32_t wait_ret = hbDNNWaitTaskDone(tasks[i], 0);
+        if (wait_ret && ret == 0)
+            ret = wait_ret;
+        for (int32_t j = 0; j < results[i]->output_count; j++)
+            hbSysFlushMem(&(results[i]->output[j].sysMem[0]), HB_SYS_MEM_CACHE_INVALIDATE);
+        hbDNNReleaseTask(tasks[i]);
+    }
+    return ret;
+}
+
+int32_t x3_bpu_predict_rois(bpu_module *bpu_handle, sp_frame_lease_t *frame, const hbDNNRoi *rois,
+                            int32_t roi_count, bpu_tensor_set_t **results)
+{
+    std::vector<hbDNNRoi> clipped;
+    int32_t ret = 0, acquired = 0;
+
+    if (roi_count <= 0 || roi_count > SP_BPU_ROI_MAX_NUM || frame->vaddr[0] == NULL ||
+        frame->width < 2 || frame->height < 2)
+    {
+        printf("[BPU ERR] %s:invalid roi_count %d or frame\n", __func__, roi_count);
+        return -1;
+    }
+
+    // 裁剪到图像范围内，起点取偶数、宽高取偶数，满足 NV12 的 UV 采样和 resizer 的对齐要求
+    clipped.resize(roi_count);
+    for (int32_t i = 0; i < roi_count; i++)
+    {
+        hbDNNRoi &roi = clipped[i];
+        roi.left = std::min(std::max(rois[i].left, 0), frame->width - 2) & ~1;
+        roi.top = std::min(std::max(rois[i].top, 0), frame->height - 2) & ~1;
+        roi.right = std::min(std::max(rois[i].right, roi.left + 1), frame->width - 1);
+        roi.bottom = std::min(std::max(rois[i].bottom, roi.top + 1), frame->height - 1);
+        if ((roi.right - roi.left + 1) & 1)
+            roi.right--;
+        if ((roi.bottom - roi.top + 1) & 1)
+            roi.bottom--;
+    }
+
+    memset(results, 0, sizeof(bpu_tensor_set_t *) * roi_count);
+    for (acquired = 0; acquired < roi_count; acquired++)
+    {
+        results[acquired] = x3_bpu_acquire_tensors(bpu_handle);
+        if (results[acquired] == NULL)
+        {
+            ret = -1;
+            break;
+        }
+    }
+
+    if (ret == 0 && x3_bpu_model_is_resizer(bpu_handle))
+    {
+        ret = bpu_roi_infer_resizer(bpu_handle, frame, clipped, results);
+        if (ret == 0)
+            return 0;
+        printf("[BPU MSG] %s:roi infer on resizer failed(%d), crop on cpu\n", __func__, ret);
+        ret = 0;
+    }
+    if (ret == 0)
+        ret = bpu_roi_infer_cpu(bpu_handle, frame, clipped, results);
+
+    if (ret)
+    {
+        for (int32_t i = 0; i < acquired; i++)
+        {
+            x3_bpu_release_tensors(bpu_handle, results[i]);
+            results[i] = NULL;
+        }
+    }
+    return ret;
+}
@@ -11,7 +11,14 @@
 #include <time.h>
 #include <stdbool.h>
 #include <future>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "sp_bpu.h"
+#include "sp_vio.h"
 
 #include "bpu_wrapper.h"
 #include "dnn/hb_dnn.h"
@@ -19,6 +26,45 @@ static void print_model_info(hbPackedDNNHandle_t packed_dnn_handle);
 
 #define ALIGN_16(v) ((v + (16 - 1)) / 16 * 16)
 
+#define BPU_ASYNC_DEFAULT_DEPTH 3
+#define BPU_ASYNC_MAX_DEPTH 8
+
+enum
+{
+    BPU_TASK_FREE = 0,
+    BPU_TASK_RUNNING, // 已提交，还没有被完成线程取走结果
+    BPU_TASK_DONE,    // 输出已经可读，等待调用者释放
+};
+
+typedef struct
+{
+    int64_t id;
+    int32_t state;
+    int32_t status;
+    hbDNNTaskHandle_t task_handle;
+    bpu_tensor_set_t *tensors; // 提交时从模型的 tensor 池中取，任务释放时归还
+    sp_bpu_callback cb;
+    void *userdata;
+    sp_frame_lease_t frame;   // 零拷贝输入时引用的 VIO 帧
+    hbDNNTensor frame_input;
+} bpu_async_task_t;
+
+// 在途任务环：调用者线程拷贝输入并提交，完成线程按提交顺序等待 BPU 结果
+typedef struct
+{
+    bpu_module *module;
+    std::vector<bpu_async_task_t> tasks;
+    std::deque<int64_t> running; // 按提交顺序排列的在途任务
+    int64_t next_id;
+    bool stop;
+    std::mutex mtx;
+    std::condition_variable done_cond;   // 有任务完成或者被释放
+    std::condition_variable submit_cond; // 有任务提交
+    std::thread done_thread;
+} bpu_async_ctx_t;
+
+static std::mutex bpu_async_init_mtx;
+
 void HB_CHECK_SUCCESS(int32_t value, char *errmsg)
 {
     /*value can be call of function*/
@@ -32,8 +78,7 @@ void HB_CHECK_SUCCESS(int32_t value, char *errmsg)
 bpu_module *x3_bpu_predict_init(const char *model_file_name)
 {
 
-    bpu_module *bpu_handle = (bpu_module *)malloc(sizeof(bpu_module));
-    memset(bpu_handle, 0, sizeof(bpu_module));
+    bpu_module *bpu_handle = NULL;
     //第一步加载模型
     hbPackedDNNHandle_t packed_dnn_handle;
     HB_CHECK_SUCCESS(hbDNNInitializeFromFiles(&packed_dnn_handle, static_cast<const char **>(&model_file_name), 1), "hbDNNInitializeFromFiles fail");
@@ -43,10 +88,37 @@ bpu_module *x3_bpu_predict_init(const char *model_file_name)
     int32_t model_count = 0;
     HB_CHECK_SUCCESS(hbDNNGetModelNameList(&model_name_list, &model_count, packed_dnn_handle), "hbDNNGetModelNameList fail");
 
-    // 第三步获取dnn_handle
+    // 第三步获取dnn_handle，分配输入 tensor 并建立 tensor 池
+    bpu_handle = x3_bpu_module_create(packed_dnn_handle, model_name_list[0]);
+    if (bpu_handle == NULL)
+    {
+        hbDNNRelease(packed_dnn_handle);
+        return NULL;
+    }
+    if (x3_bpu_model_setup(bpu_handle, model_name_list[0], 0))
+    {
+        x3_bpu_module_destroy(bpu_handle);
+        hbDNNRelease(packed_dnn_handle);
+        return NULL;
+    }
+
+    print_model_info(bpu_handle->m_packed_dnn_handle);
+
+    return bpu_handle;
+}
+
+bpu_module *x3_bpu_module_create(hbPackedDNNHandle_t packed_dnn_handle, const char *model_name)
+{
     hbDNNHandle_t dnn_handle;
-    HB_CHECK_SUCCESS(hbDNNGetModelHandle(&dnn_handle, packed_dnn_handle, model_name_list[0]), "hbDNNGetModelHandle fail");
+    int32_t ret = hbDNNGetModelHandle(&dnn_handle, packed_dnn_handle, model_name);
+    if (ret)
+    {
+        printf("[BPU ERR] %s:hbDNNGetModelHandle %s failed!Error code:%d\n", __func__, model_name, ret);
+        return NULL;
+    }
 
+    bpu_module *bpu_handle = (bpu_module *)malloc(sizeof(bpu_module));
+    memset(bpu_handle, 0, sizeof(bpu_module));
     bpu_handle->m_packed_dnn_handle = packed_dnn_handle;
     bpu_handle->m_dnn_handle = dnn_handle;
 
@@ -56,11 +128,20 @@ bpu_module *x3_bpu_predict_init(const char *model_file_name)
     bpu_handle->input_tensor.properties = input_properties;
     hbSysAllocCachedMem(bpu_handle->input_tensor.sysMem, input_properties.validShape.dimensionSize[2] * ALIGN_16(input_properties.validShape.dimensionSize[3]) * 3 / 2);
 
-    print_model_info(bpu_handle->m_packed_dnn_handle);
-
     return bpu_handle;
 }
 
+// 不释放 packed handle，由创建者负责
+int32_t x3_bpu_module_destroy(bpu_module *handle)
+{
+    x3_bpu_async_deinit(handle);
+    if (x3_bpu_model_teardown(handle))
+        return -1;
+    hbSysFreeMem(&(handle->input_tensor.sysMem[0]));
+    free(handle);
+    return 0;
+}
+
 int32_t x3_bpu_init_tensors(bpu_module *bpu_handle, hbDNNTensor *output_tensors)
 {
     int32_t ret = -1;
@@ -139,9 +220,451 @@ int32_t x3_bpu_start_predict(bpu_module *bpu_handle, char *frame_buffer)
 
 int32_t x3_bpu_predict_unint(bpu_module *handle)
 {
-    hbSysFreeMem(&(handle->input_tensor.sysMem[0]));
-    hbDNNRelease(handle->m_packed_dnn_handle);
-    free(handle);
+    hbPackedDNNHandle_t packed_dnn_handle = handle->m_packed_dnn_handle;
+
+    if (x3_bpu_model_is_shared(handle))
+    {
+        printf("[BPU ERR] %s:model belongs to a registry, use sp_bpu_release_models\n", __func__);
+        return -1;
+    }
+    if (x3_bpu_module_destroy(handle))
+        return -1;
+    hbDNNRelease(packed_dnn_handle);
+    return 0;
+}
+
+static bpu_async_task_t *bpu_async_find(bpu_async_ctx_t *ctx, int64_t task_id)
+{
+    for (auto &task : ctx->tasks)
+    {
+        if (task.state != BPU_TASK_FREE && task.id == task_id)
+            return &task;
+    }
+    return NULL;
+}
+
+// 调用时持有 ctx->mtx
+static void bpu_async_free_task(bpu_async_ctx_t *ctx, bpu_async_task_t *task)
+{
+    if (task->tensors)
+        x3_bpu_release_tensors(ctx->module, task->tensors);
+    task->tensors = NULL;
+    task->state = BPU_TASK_FREE;
+}
+
+// 完成线程：BPU 按提交顺序执行，所以只需要等队头的任务
+static void bpu_async_done_loop(bpu_async_ctx_t *ctx)
+{
+    bpu_async_task_t *task = NULL;
+    sp_bpu_callback cb = NULL;
+    int64_t task_id = 0;
+    int32_t ret = 0;
+
+    while (1)
+    {
+        {
+            std::unique_lock<std::mutex> lock(ctx->mtx);
+            ctx->submit_cond.wait(lock, [ctx] { return ctx->stop || !ctx->running.empty(); });
+            // 退出前把在途任务全部等完，避免释放 tensor 时 BPU 还在写
+            if (ctx->running.empty())
+                break;
+            task_id = ctx->running.front();
+            task = bpu_async_find(ctx, task_id);
+        }
+
+        if (task->task_handle)
+        {
+            ret = hbDNNWaitTaskDone(task->task_handle, 0);
+            if (ret)
+            {
+                printf("[BPU ERR] %s:hbDNNWaitTaskDone failed!Error code:%d\n", __func__, ret);
+                task->status = ret;
+            }
+            for (int32_t i = 0; i < task->tensors->output_count; i++)
+                hbSysFlushMem(&(task->tensors->output[i].sysMem[0]), HB_SYS_MEM_CACHE_INVALIDATE);
+            hbDNNReleaseTask(task->task_handle);
+            task->task_handle = nullptr;
+        }
+        if (task->frame.lease)
+            sp_vio_release_frame(&task->frame);
+
+        {
+            std::lock_guard<std::mutex> lock(ctx->mtx);
+            ctx->running.pop_front();
+            task->state = BPU_TASK_DONE;
+            cb = task->cb;
+        }
+
+        if (cb)
+        {
+            cb(task_id, task->status, task->tensors->output, task->tensors->output_count, task->userdata);
+            std::lock_guard<std::mutex> lock(ctx->mtx);
+            bpu_async_free_task(ctx, task);
+        }
+        ctx->done_cond.notify_all();
+    }
+}
+
+int32_t x3_bpu_async_init(bpu_module *bpu_handle, int32_t depth)
+{
+    std::lock_guard<std::mutex> init_lock(bpu_async_init_mtx);
+    bpu_async_ctx_t *ctx = NULL;
+
+    if (bpu_handle->m_async)
+        return 0;
+    if (bpu_handle->m_model == NULL)
+        return -1;
+
+    if (depth <= 0)
+        depth = BPU_ASYNC_DEFAULT_DEPTH;
+    if (depth > BPU_ASYNC_MAX_DEPTH)
+        depth = BPU_ASYNC_MAX_DEPTH;
+
+    // 在途任务和一批 ROI 同时用满时也不用在推理路径上分配 tensor
+    if (x3_bpu_model_reserve(bpu_handle, depth + SP_BPU_ROI_MAX_NUM))
+        printf("[BPU MSG] %s:preallocate tensor pool failed, allocate on demand\n", __func__);
+
+    ctx = new bpu_async_ctx_t();
+    ctx->module = bpu_handle;
+    ctx->next_id = 0;
+    ctx->stop = false;
+    ctx->tasks.resize(depth);
+    for (auto &task : ctx->tasks)
+    {
+        task.id = -1;
+        task.state = BPU_TASK_FREE;
+        task.status = 0;
+        task.task_handle = nullptr;
+        task.tensors = NULL;
+        task.cb = NULL;
+        task.userdata = NULL;
+        memset(&task.frame, 0, sizeof(sp_frame_lease_t));
+    }
+
+    ctx->done_thread = std::thread(bpu_async_done_loop, ctx);
+    bpu_handle->m_async = ctx;
+    return 0;
+}
+
+int32_t x3_bpu_async_deinit(bpu_module *bpu_handle)
+{
+    std::lock_guard<std::mutex> init_lock(bpu_async_init_mtx);
+    bpu_async_ctx_t *ctx = static_cast<bpu_async_ctx_t *>(bpu_handle->m_async);
+
+    if (ctx == NULL)
+        return 0;
+
+    {
+        std::lock_guard<std::mutex> lock(ctx->mtx);
+        ctx->stop = true;
+    }
+    ctx->submit_cond.notify_all();
+    ctx->done_cond.notify_all();
+    if (ctx->done_thread.joinable())
+        ctx->done_thread.join();
+
+    // 调用者没有释放的任务在这里归还 tensor
+    for (auto &task : ctx->tasks)
+    {
+        if (task.state != BPU_TASK_FREE)
+            bpu_async_free_task(ctx, &task);
+    }
+    delete ctx;
+    bpu_handle->m_async = NULL;
+    return 0;
+}
+
+// 取一个空闲任务，没有时等待；返回 NULL 表示任务环正在销毁
+static bpu_async_task_t *bpu_async_acquire(bpu_module *bpu_handle, sp_bpu_callback cb, void *userdata)
+{
+    bpu_async_ctx_t *ctx = static_cast<bpu_async_ctx_t *>(bpu_handle->m_async);
+    bpu_async_task_t *task = NULL;
+    bpu_tensor_set_t *tensors = NULL;
+
+    if (ctx == NULL)
+    {
+        if (x3_bpu_async_init(bpu_handle, BPU_ASYNC_DEFAULT_DEPTH))
+            return NULL;
+        ctx = static_cast<bpu_async_ctx_t *>(bpu_handle->m_async);
+    }
+
+    // 池满时要等完成线程归还 tensor，而归还要拿 ctx->mtx，所以必须在加锁之前取
+    tensors = x3_bpu_acquire_tensors(bpu_handle);
+    if (tensors == NULL)
+        return NULL;
+
+    std::unique_lock<std::mutex> lock(ctx->mtx);
+    ctx->done_cond.wait(lock, [ctx, &task] {
+        for (auto &t : ctx->tasks)
+        {
+            if (t.state == BPU_TASK_FREE)
+            {
+                task = &t;
+                return true;
+            }
+        }
+        return ctx->stop;
+    });
+    if (ctx->stop)
+    {
+        lock.unlock();
+        x3_bpu_release_tensors(bpu_handle, tensors);
+        return NULL;
+    }
+    task->tensors = tensors;
+    task->id = ctx->next_id++;
+    task->state = BPU_TASK_RUNNING;
+    task->status = 0;
+    task->cb = cb;
+    task->userdata = userdata;
+    task->frame.lease = NULL;
+    return task;
+}
+
+static int64_t bpu_async_launch(bpu_module *bpu_handle, bpu_async_task_t *task, const hbDNNTensor *input)
+{
+    bpu_async_ctx_t *ctx = static_cast<bpu_async_ctx_t *>(bpu_handle->m_async);
+    hbDNNTensor *output = task->tensors->output;
+    hbDNNInferCtrlParam infer_ctrl_param;
+    int64_t task_id = task->id;
+    int32_t ret = 0;
+
+    HB_DNN_INITIALIZE_INFER_CTRL_PARAM(&infer_ctrl_param);
+    ret = hbDNNInfer(&task->task_handle, &output, input,
+                     bpu_handle->m_dnn_handle, &infer_ctrl_param);
+    if (ret)
+    {
+        // 提交失败也走完成线程，保证回调和 wait 的行为一致
+        printf("[BPU ERR] %s:hbDNNInfer failed!Error code:%d\n", __func__, ret);
+        task->task_handle = nullptr;
+        task->status = ret;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ctx->mtx);
+        ctx->running.push_back(task_id);
+    }
+    ctx->submit_cond.notify_one();
+
+    return task_id;
+}
+
+int64_t x3_bpu_submit(bpu_module *bpu_handle, char *frame_buffer, sp_bpu_callback cb, void *userdata)
+{
+    bpu_async_task_t *task = NULL;
+    hbDNNTensor *input = NULL;
+    int32_t height = bpu_handle->input_tensor.properties.validShape.dimensionSize[2];
+    int32_t width = bpu_handle->input_tensor.properties.validShape.dimensionSize[3];
+
+    task = bpu_async_acquire(bpu_handle, cb, userdata);
+    if (task == NULL)
+        return -1;
+    input = task->tensors->input;
+
+    // NV12_SEPARATE 的池 tensor 里 Y 和 UV 是两块内存，分别拷贝
+    if (input->properties.tensorType == HB_DNN_IMG_TYPE_NV12_SEPARATE)
+    {
+        memcpy(input->sysMem[0].virAddr, frame_buffer, height * width);
+        memcpy(input->sysMem[1].virAddr, frame_buffer + height * width, height * width / 2);
+        hbSysFlushMem(&input->sysMem[1], HB_SYS_MEM_CACHE_CLEAN);
+    }
+    else
+    {
+        memcpy(input->sysMem[0].virAddr, frame_buffer, height * width * 3 / 2);
+    }
+    hbSysFlushMem(&input->sysMem[0], HB_SYS_MEM_CACHE_CLEAN);
+
+    return bpu_async_launch(bpu_handle, task, task->tensors->input);
+}
+
+// 用 VIO 借出的帧直接构造输入 tensor，不拷贝也不刷 cache（图像由硬件写入，CPU cache 里没有脏数据）
+// Y/UV 连续且没有行填充时按模型原来的 NV12 类型输入，否则用 NV12_SEPARATE 并把 stride 放到 alignedShape
+static int32_t bpu_frame_to_tensor(bpu_module *bpu_handle, const sp_frame_lease_t *frame, hbDNNTensor *input)
+{
+    const hbDNNTensorProperties &model = bpu_handle->input_tensor.properties;
+    int32_t height = model.validShape.dimensionSize[2];
+    int32_t width = model.validShape.dimensionSize[3];
+    int32_t stride = (frame->stride > 0) ? frame->stride : frame->width;
+    uint32_t y_size = stride * height;
+    uint64_t uv_paddr = 0;
+    uint8_t *uv_vaddr = NULL;
+
+    if (model.tensorType != HB_DNN_IMG_TYPE_NV12 &&
+        model.tensorType != HB_DNN_IMG_TYPE_NV12_SEPARATE)
+    {
+        printf("[BPU ERR] %s:model input type %d is not nv12\n", __func__, model.tensorType);
+        return -1;
+    }
+    if (frame->width != width || frame->height != height || frame->vaddr[0] == NULL)
+    {
+        printf("[BPU ERR] %s:frame %dx%d does not match model input %dx%d\n",
+               __func__, frame->width, frame->height, width, height);
+        return -1;
+    }
+
+    if (frame->plane_count > 1)
+    {
+        uv_paddr = frame->paddr[1];
+        uv_vaddr = frame->vaddr[1];
+    }
+    else
+    {
+        uv_paddr = frame->paddr[0] + y_size;
+        uv_vaddr = frame->vaddr[0] + y_size;
+    }
+
+    memset(input, 0, sizeof(hbDNNTensor));
+    input->properties = model;
+    if (stride == width && uv_paddr == frame->paddr[0] + y_size &&
+        model.tensorType == HB_DNN_IMG_TYPE_NV12)
+    {
+        input->sysMem[0].phyAddr = frame->paddr[0];
+        input->sysMem[0].virAddr = frame->vaddr[0];
+        input->sysMem[0].memSize = y_size * 3 / 2;
+        return 0;
+    }
+
+    input->properties.tensorType = HB_DNN_IMG_TYPE_NV12_SEPARATE;
+    input->properties.alignedShape = model.validShape;
+    input->properties.alignedShape.dimensionSize[3] = stride;
+    input->sysMem[0].phyAddr = frame->paddr[0];
+    input->sysMem[0].virAddr = frame->vaddr[0];
+    input->sysMem[0].memSize = y_size;
+    input->sysMem[1].phyAddr = uv_paddr;
+    input->sysMem[1].virAddr = uv_vaddr;
+    input->sysMem[1].memSize = y_size / 2;
+    return 0;
+}
+
+int32_t x3_bpu_start_predict_frame(bpu_module *bpu_handle, sp_frame_lease_t *frame)
+{
+    hbDNNTensor input;
+    hbDNNTaskHandle_t task_handle = nullptr;
+    hbDNNInferCtrlParam infer_ctrl_param;
+    int32_t output_count = 0;
+    int32_t ret = 0;
+
+    if (bpu_frame_to_tensor(bpu_handle, frame, &input))
+        return -1;
+
+    HB_DNN_INITIALIZE_INFER_CTRL_PARAM(&infer_ctrl_param);
+    ret = hbDNNInfer(&task_handle, &(bpu_handle->output_tensor), &input,
+                     bpu_handle->m_dnn_handle, &infer_ctrl_param);
+    if (ret)
+    {
+        printf("[BPU ERR] %s:hbDNNInfer failed!Error code:%d\n", __func__, ret);
+        return ret;
+    }
+    ret = hbDNNWaitTaskDone(task_handle, 0);
+    hbDNNGetOutputCount(&output_count, bpu_handle->m_dnn_handle);
+    for (int32_t i = 0; i < output_count; i++)
+        hbSysFlushMem(&(bpu_handle->output_tensor[i].sysMem[0]), HB_SYS_MEM_CACHE_INVALIDATE);
+    hbDNNReleaseTask(task_handle);
+    return ret;
+}
+
+int64_t x3_bpu_submit_frame(bpu_module *bpu_handle, sp_frame_lease_t *frame, sp_bpu_callback cb, void *userdata)
+{
+    bpu_async_task_t *task = NULL;
+    hbDNNTensor input;
+
+    if (bpu_frame_to_tensor(bpu_handle, frame, &input))
+        return -1;
+
+    task = bpu_async_acquire(bpu_handle, cb, userdata);
+    if (task == NULL)
+        return -1;
+
+    // 任务自己持有一份帧引用，推理完成后由完成线程归还，调用者可以立即释放自己的那份
+    task->frame = *frame;
+    if (task->frame.lease)
+        sp_vio_retain_frame(&task->frame);
+    task->frame_input = input;
+
+    return bpu_async_launch(bpu_handle, task, &task->frame_input);
+}
+
+int32_t x3_bpu_poll(bpu_module *bpu_handle, int64_t task_id)
+{
+    bpu_async_ctx_t *ctx = static_cast<bpu_async_ctx_t *>(bpu_handle->m_async);
+    bpu_async_task_t *task = NULL;
+
+    if (ctx == NULL || task_id < 0)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(ctx->mtx);
+    if (task_id >= ctx->next_id)
+        return -1;
+    task = bpu_async_find(ctx, task_id);
+    // 找不到说明已经完成并被释放（带回调的任务在回调返回后自动释放）
+    return (task == NULL || task->state == BPU_TASK_DONE) ? 1 : 0;
+}
+
+int32_t x3_bpu_wait(bpu_module *bpu_handle, int64_t task_id, int32_t timeout_ms)
+{
+    bpu_async_ctx_t *ctx = static_cast<bpu_async_ctx_t *>(bpu_handle->m_async);
+    bpu_async_task_t *task = NULL;
+    bool done = false;
+
+    if (ctx == NULL || task_id < 0)
+        return -1;
+
+    std::unique_lock<std::mutex> lock(ctx->mtx);
+    if (task_id >= ctx->next_id)
+        return -1;
+
+    auto finished = [ctx, task_id, &task] {
+        task = bpu_async_find(ctx, task_id);
+        return task == NULL || task->state == BPU_TASK_DONE;
+    };
+    if (timeout_ms < 0)
+    {
+        ctx->done_cond.wait(lock, finished);
+        done = true;
+    }
+    else
+    {
+        done = ctx->done_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), finished);
+    }
+    if (!done)
+        return -1;
+
+    return task ? task->status : 0;
+}
+
+hbDNNTensor *x3_bpu_get_output(bpu_module *bpu_handle, int64_t task_id, int32_t *output_count)
+{
+    bpu_async_ctx_t *ctx = static_cast<bpu_async_ctx_t *>(bpu_handle->m_async);
+    bpu_async_task_t *task = NULL;
+
+    if (ctx == NULL)
+        return NULL;
+
+    std::lock_guard<std::mutex> lock(ctx->mtx);
+    task = bpu_async_find(ctx, task_id);
+    if (task == NULL || task->state != BPU_TASK_DONE)
+        return NULL;
+    if (output_count)
+        *output_count = task->tensors->output_count;
+    return task->tensors->output;
+}
+
+int32_t x3_bpu_release(bpu_module *bpu_handle, int64_t task_id)
+{
+    bpu_async_ctx_t *ctx = static_cast<bpu_async_ctx_t *>(bpu_handle->m_async);
+    bpu_async_task_t *task = NULL;
+
+    if (ctx == NULL)
+        return -1;
+
+    {
+        std::lock_guard<std::mutex> lock(ctx->mtx);
+        task = bpu_async_find(ctx, task_id);
+        if (task == NULL || task->state != BPU_TASK_DONE || task->cb != NULL)
+            return -1;
+        bpu_async_free_task(ctx, task);
+    }
+    ctx->done_cond.notify_all();
     return 0;
 }
 
@@ -9,6 +9,7 @@
 #define BPU_WRAPPERH_
 
 #include "sp_bpu.h"
+#include "sp_vio.h"
 #include "dnn/hb_dnn.h"
 
 #ifdef __cplusplus
@@ -22,6 +23,39 @@ int32_t x3_bpu_init_tensors(bpu_module *bpu_handle, hbDNNTensor *output_tensors)
 int32_t x3_bpu_deinit_tensor(hbDNNTensor *tensor, int32_t len);
 int32_t x3_bpu_start_predict(bpu_module *bpu_handle, char *frame_buffer);
 int32_t x3_bpu_predict_unint(bpu_module *handle);
+int32_t x3_bpu_start_predict_frame(bpu_module *bpu_handle, sp_frame_lease_t *frame);
+
+bpu_module *x3_bpu_module_create(hbPackedDNNHandle_t packed_dnn_handle, const char *model_name);
+int32_t x3_bpu_module_destroy(bpu_module *handle);
+
+int32_t x3_bpu_model_setup(bpu_module *bpu_handle, const char *model_name, int32_t shared);
+int32_t x3_bpu_model_teardown(bpu_module *bpu_handle);
+// 把 tensor 池预分配到 count 组（不超过池的上限）
+int32_t x3_bpu_model_reserve(bpu_module *bpu_handle, int32_t count);
+int32_t x3_bpu_model_in_use(bpu_module *bpu_handle);
+int32_t x3_bpu_model_is_shared(bpu_module *bpu_handle);
+int32_t x3_bpu_model_is_resizer(bpu_module *bpu_handle);
+bpu_tensor_set_t *x3_bpu_acquire_tensors(bpu_module *bpu_handle);
+int32_t x3_bpu_release_tensors(bpu_module *bpu_handle, bpu_tensor_set_t *tensors);
+int32_t x3_bpu_predict_tensors(bpu_module *bpu_handle, bpu_tensor_set_t *tensors);
+int32_t x3_bpu_get_pool_stats(bpu_module *bpu_handle, bpu_pool_stats_t *stats);
+
+void *x3_bpu_load_models(const char *model_file_name);
+int32_t x3_bpu_release_models(void *handle);
+int32_t x3_bpu_get_model_count(void *handle);
+const char *x3_bpu_get_model_name(void *handle, int32_t index);
+bpu_module *x3_bpu_get_model(void *handle, const char *model_name);
+
+int32_t x3_bpu_async_init(bpu_module *bpu_handle, int32_t depth);
+int32_t x3_bpu_async_deinit(bpu_module *bpu_handle);
+int64_t x3_bpu_submit(bpu_module *bpu_handle, char *frame_buffer, sp_bpu_callback cb, void *userdata);
+int64_t x3_bpu_submit_frame(bpu_module *bpu_handle, sp_frame_lease_t *frame, sp_bpu_callback cb, void *userdata);
+int32_t x3_bpu_predict_rois(bpu_module *bpu_handle, sp_frame_lease_t *frame, const hbDNNRoi *rois,
+                            int32_t roi_count, bpu_tensor_set_t **results);
+int32_t x3_bpu_poll(bpu_module *bpu_handle, int64_t task_id);
+int32_t x3_bpu_wait(bpu_module *bpu_handle, int64_t task_id, int32_t timeout_ms);
+hbDNNTensor *x3_bpu_get_output(bpu_module *bpu_handle, int64_t task_id, int32_t *output_count);
+int32_t x3_bpu_release(bpu_module *bpu_handle, int64_t task_id);
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,15 @@ int32_t sp_bpu_start_predict(bpu_module *bpu_handle, char *addr)
     return -1;
 }
 
+int32_t sp_bpu_start_predict_frame(bpu_module *bpu_handle, sp_frame_lease_t *frame)
+{
+    if (bpu_handle && frame)
+    {
+        return x3_bpu_start_predict_frame(bpu_handle, frame);
+    }
+    return -1;
+}
+
 int32_t sp_release_bpu_module(bpu_module *bpu_handle)
 {
     if (bpu_handle)
@@ -43,4 +52,158 @@ int32_t sp_deinit_bpu_tensor(hbDNNTensor *tensor, int32_t len)
         return x3_bpu_deinit_tensor(tensor, len);
     }
     return -1;
-}
\ No newline at end of file
+}
+
+void *sp_bpu_load_models(const char *model_file_name)
+{
+    if (model_file_name)
+    {
+        return x3_bpu_load_models(model_file_name);
+    }
+    return nullptr;
+}
+
+int32_t sp_bpu_release_models(void *models)
+{
+    if (models)
+    {
+        return x3_bpu_release_models(models);
+    }
+    return -1;
+}
+
+int32_t sp_bpu_get_model_count(void *models)
+{
+    if (models)
+    {
+        return x3_bpu_get_model_count(models);
+    }
+    return -1;
+}
+
+const char *sp_bpu_get_model_name(void *models, int32_t index)
+{
+    if (models)
+    {
+        return x3_bpu_get_model_name(models, index);
+    }
+    return nullptr;
+}
+
+bpu_module *sp_bpu_get_model(void *models, const char *model_name)
+{
+    if (models)
+    {
+        return x3_bpu_get_model(models, model_name);
+    }
+    return nullptr;
+}
+
+bpu_tensor_set_t *sp_bpu_acquire_tensors(bpu_module *bpu_handle)
+{
+    if (bpu_handle)
+    {
+        return x3_bpu_acquire_tensors(bpu_handle);
+    }
+    return nullptr;
+}
+
+int32_t sp_bpu_release_tensors(bpu_module *bpu_handle, bpu_tensor_set_t *tensors)
+{
+    if (bpu_handle && tensors)
+    {
+        return x3_bpu_release_tensors(bpu_handle, tensors);
+    }
+    return -1;
+}
+
+int32_t sp_bpu_predict_tensors(bpu_module *bpu_handle, bpu_tensor_set_t *tensors)
+{
+    if (bpu_handle && tensors)
+    {
+        return x3_bpu_predict_tensors(bpu_handle, tensors);
+    }
+    return -1;
+}
+
+int32_t sp_bpu_get_pool_stats(bpu_module *bpu_handle, bpu_pool_stats_t *stats)
+{
+    if (bpu_handle && stats)
+    {
+        return x3_bpu_get_pool_stats(bpu_handle, stats);
+    }
+    return -1;
+}
+
+int32_t sp_bpu_predict_rois(bpu_module *bpu_handle, sp_frame_lease_t *frame, const hbDNNRoi *rois,
+                            int32_t roi_count, bpu_tensor_set_t **results)
+{
+    if (bpu_handle && frame && rois && results)
+    {
+        return x3_bpu_predict_rois(bpu_handle, frame, rois, roi_count, results);
+    }
+    return -1;
+}
+
+int32_t sp_bpu_async_init(bpu_module *bpu_handle, int32_t depth)
+{
+    if (bpu_handle)
+    {
+        return x3_bpu_async_init(bpu_handle, depth);
+    }
+    return -1;
+}
+
+int64_t sp_bpu_submit(bpu_module *bpu_handle, char *addr, sp_bpu_callback cb, void *userdata)
+{
+    if (bpu_handle && addr)
+    {
+        return x3_bpu_submit(bpu_handle, addr, cb, userdata);
+    }
+    return -1;
+}
+
+int64_t sp_bpu_submit_frame(bpu_module *bpu_handle, sp_frame_lease_t *frame, sp_bpu_callback cb, void *userdata)
+{
+    if (bpu_handle && frame)
+    {
+        return x3_bpu_submit_frame(bpu_handle, frame, cb, userdata);
+    }
+    return -1;
+}
+
+int32_t sp_bpu_poll(bpu_module *bpu_handle, int64_t task_id)
+{
+    if (bpu_handle)
+    {
+        return x3_bpu_poll(bpu_handle, task_id);
+    }
+    return -1;
+}
+
+int32_t sp_bpu_wait(bpu_module *bpu_handle, int64_t task_id, int32_t timeout_ms)
+{
+    if (bpu_handle)
+    {
+        return x3_bpu_wait(bpu_handle, task_id, timeout_ms);
+    }
+    return -1;
+}
+
+hbDNNTensor *sp_bpu_get_output(bpu_module *bpu_handle, int64_t task_id, int32_t *output_count)
+{
+    if (bpu_handle)
+    {
+        return x3_bpu_get_output(bpu_handle, task_id, output_count);
+    }
+    return nullptr;
+}
+
+int32_t sp_bpu_release(bpu_module *bpu_handle, int64_t task_id)
+{
+    if (bpu_handle)
+    {
+        return x3_bpu_release(bpu_handle, task_id);
+    }
+    return -1;
+}
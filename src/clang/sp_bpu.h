@@ -2,6 +2,7 @@
 #define SP_BPU
 #include <stdint.h>
 #include "dnn/hb_dnn.h"
+#include "sp_vio.h"
 #define SP_PREDICT_TYPE_YOLOV5 1
 #define SP_PREDICT_TYPE_MOBILENET 2
 #define SP_PREDICT_TYPE_FCOS 3
@@ -36,16 +37,93 @@ extern "C"
     hbDNNHandle_t m_dnn_handle;
     hbDNNTensor input_tensor;
     hbDNNTensor *output_tensor;
+    void *m_async; // 异步推理的任务环，第一次 sp_bpu_submit 或者 sp_bpu_async_init 时创建
+    void *m_model; // 缓存的 tensor 属性和预分配的 tensor 池
   } bpu_module;
 
+  // 一组可以直接用于一次推理的输入输出 tensor，属性已经按模型填好，内存来自模型的 tensor 池
+  typedef struct
+  {
+    hbDNNTensor *input;
+    int32_t input_count;
+    hbDNNTensor *output;
+    int32_t output_count;
+  } bpu_tensor_set_t;
+
+  // tensor 池的复用统计
+  typedef struct
+  {
+    int32_t capacity;      // 已经分配的 tensor 组数
+    int32_t in_use;        // 正在使用的 tensor 组数
+    int32_t peak_in_use;   // 同时使用的最大组数
+    int64_t acquire_count; // 申请次数
+    int64_t reuse_count;   // 直接复用已有 tensor 组的次数
+    int64_t alloc_count;   // 新分配 tensor 组的次数，包括加载模型时的预分配
+    int64_t wait_count;    // 池满后等待归还的次数
+    int64_t bytes;         // 池中 tensor 占用的内存字节数
+  } bpu_pool_stats_t;
+
+  // 异步推理完成回调，在推理完成线程中调用；status 为 0 表示成功，output 只在回调内有效
+  // 回调里不能调用同一个模型的 sp_bpu_submit/sp_bpu_submit_frame/sp_bpu_wait：
+  // 空闲任务和任务完成都要由这个线程推进，在回调里等待会死锁。需要提交下一帧时交给其他线程
+  typedef void (*sp_bpu_callback)(int64_t task_id, int32_t status, hbDNNTensor *output,
+                                  int32_t output_count, void *userdata);
+
   bpu_module *sp_init_bpu_module(const char *model_file_name);
 
   int32_t sp_bpu_start_predict(bpu_module *bpu_handle, char *addr);
 
+  // 直接用 sp_vio_acquire_frame 借出的帧推理，帧的宽高必须与模型输入一致，不做内存拷贝
+  int32_t sp_bpu_start_predict_frame(bpu_module *bpu_handle, sp_frame_lease_t *frame);
+
+  // 还有 sp_bpu_acquire_tensors 借出的 tensor 没归还时返回 -1，不释放任何资源
   int32_t sp_release_bpu_module(bpu_module *bpu_handle);
   int32_t sp_init_bpu_tensors(bpu_module *bpu_handle, hbDNNTensor *output_tensors);
   int32_t sp_deinit_bpu_tensor(hbDNNTensor *tensor, int32_t len);
 
+  // 模型注册表：加载打包 bin 中的全部模型，每个模型是一个 bpu_module，由注册表持有，
+  // 不能用 sp_release_bpu_module 释放；任何模型还有借出的 tensor 时 sp_bpu_release_models 返回 -1
+  void *sp_bpu_load_models(const char *model_file_name);
+  int32_t sp_bpu_release_models(void *models);
+  int32_t sp_bpu_get_model_count(void *models);
+  const char *sp_bpu_get_model_name(void *models, int32_t index);
+  // model_name 为 NULL 时返回第一个模型
+  bpu_module *sp_bpu_get_model(void *models, const char *model_name);
+
+  // 从模型的 tensor 池中取一组 tensor，池满时等待其他推理归还
+  bpu_tensor_set_t *sp_bpu_acquire_tensors(bpu_module *bpu_handle);
+  int32_t sp_bpu_release_tensors(bpu_module *bpu_handle, bpu_tensor_set_t *tensors);
+  // 用调用者填好输入的 tensor 组做一次同步推理，输出写到 tensors->output
+  int32_t sp_bpu_predict_tensors(bpu_module *bpu_handle, bpu_tensor_set_t *tensors);
+  int32_t sp_bpu_get_pool_stats(bpu_module *bpu_handle, bpu_pool_stats_t *stats);
+
+#define SP_BPU_ROI_MAX_NUM 32
+  // 对一帧 NV12 图像上的 roi_count 个框做批量推理，每个框裁剪并缩放到模型输入大小
+  // 模型输入来自 resizer 且帧有物理地址时整批交给 hbDNNRoiInfer，否则在 CPU 上裁剪缩放，
+  // 与 BPU 推理流水执行；frame 可以是 sp_vio_acquire_frame 借出的帧，也可以由调用者填写
+  // （paddr 为 0 时只走 CPU 路径）。rois 坐标包含右下边界
+  // results[i] 是第 i 个框的输出，来自模型的 tensor 池，用完后调用 sp_bpu_release_tensors 归还
+  int32_t sp_bpu_predict_rois(bpu_module *bpu_handle, sp_frame_lease_t *frame, const hbDNNRoi *rois,
+                              int32_t roi_count, bpu_tensor_set_t **results);
+
+  // 异步推理：每个在途任务有自己的输入输出 tensor，前处理、推理和后处理可以流水起来
+  // depth 为同时在途的任务数，不调用时第一次 submit 按默认深度创建；
+  // 模型的 tensor 池预分配到 depth + SP_BPU_ROI_MAX_NUM 组，异步推理和批量 ROI 同时进行时不再分配
+  int32_t sp_bpu_async_init(bpu_module *bpu_handle, int32_t depth);
+  // 拷贝一帧 NV12 到空闲任务的输入并提交，没有空闲任务时阻塞等待
+  // 返回任务 id（>= 0），cb 不为 NULL 时任务完成后调用 cb 并自动释放任务
+  int64_t sp_bpu_submit(bpu_module *bpu_handle, char *addr, sp_bpu_callback cb, void *userdata);
+  // 零拷贝的异步提交，任务自己持有帧引用直到推理完成，调用者提交后即可 sp_vio_release_frame
+  int64_t sp_bpu_submit_frame(bpu_module *bpu_handle, sp_frame_lease_t *frame, sp_bpu_callback cb, void *userdata);
+  // 1: 已完成，0: 还在推理，-1: id 无效
+  int32_t sp_bpu_poll(bpu_module *bpu_handle, int64_t task_id);
+  // 等待任务完成，timeout_ms < 0 一直等；0: 成功，-1: 超时或者 id 无效，其他为推理错误码
+  int32_t sp_bpu_wait(bpu_module *bpu_handle, int64_t task_id, int32_t timeout_ms);
+  // 已完成任务的输出 tensor，sp_bpu_release 之前有效
+  hbDNNTensor *sp_bpu_get_output(bpu_module *bpu_handle, int64_t task_id, int32_t *output_count);
+  // 没有回调的任务用完输出后必须释放
+  int32_t sp_bpu_release(bpu_module *bpu_handle, int64_t task_id);
+
 #ifdef __cplusplus
 }
 #endif
@@ -127,6 +127,36 @@ int32_t sp_decoder_set_image(void *decoder_object, char *image_buffer, int32_t c
     return 0;
 }
 
+int32_t sp_decoder_set_image_phys(void *decoder_object, uint64_t paddr, char *vaddr, int32_t chn, int32_t src_idx, int32_t size, int32_t eos)
+{
+    if (decoder_object != NULL)
+    {
+        auto decoder_obj = static_cast<VPPDecode *>(decoder_object);
+        return decoder_obj->send_frame(chn, paddr, static_cast<void *>(vaddr), src_idx, size, eos);
+    }
+    return -1;
+}
+
+int32_t sp_decoder_reclaim_image(void *decoder_object)
+{
+    if (decoder_object != NULL)
+    {
+        auto decoder_obj = static_cast<VPPDecode *>(decoder_object);
+        return decoder_obj->reclaim_frame();
+    }
+    return -1;
+}
+
+int32_t sp_decoder_set_pace(void *decoder_object, int32_t mode)
+{
+    if (decoder_object != NULL)
+    {
+        auto decoder_obj = static_cast<VPPDecode *>(decoder_object);
+        return decoder_obj->set_pace_mode(mode);
+    }
+    return -1;
+}
+
 int32_t sp_stop_decode(void *decoder_object)
 {
     if (decoder_object != NULL)
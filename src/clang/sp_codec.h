@@ -10,6 +10,8 @@
 #define SP_ENCODER_H264  1
 #define SP_ENCODER_H265  2
 #define SP_ENCODER_MJPEG 3
+#define SP_DECODER_PACE_FREE 0 /* 按硬件速度解码 */
+#define SP_DECODER_PACE_PTS  1 /* 按码流时间戳实时解码 */
 #ifdef __cplusplus
 extern "C"
 {
@@ -29,7 +31,13 @@ extern "C"
        int32_t sp_start_decode(void *obj, const char *stream_file, int32_t video_chn, int32_t type, int32_t width, int32_t height);
        int32_t sp_decoder_get_image(void *obj, char *image_buffer);
        int32_t sp_decoder_set_image(void *obj, char *image_buffer, int32_t chn, int32_t size, int32_t eos);
+       // 送入调用者持有的物理连续码流 buffer，不做拷贝；src_idx 是调用者给 buffer 的编号（0 ~ 31），
+       // sp_decoder_reclaim_image 交还这个编号之前不能改写该 buffer
+       int32_t sp_decoder_set_image_phys(void *obj, uint64_t paddr, char *vaddr, int32_t chn, int32_t src_idx, int32_t size, int32_t eos);
+       // 返回一个解码器已经读完的 src_idx，没有时返回 -1，不阻塞
+       int32_t sp_decoder_reclaim_image(void *obj);
        int32_t sp_stop_decode(void *obj);
+       int32_t sp_decoder_set_pace(void *obj, int32_t mode);
 
 #ifdef __cplusplus
 }
@@ -50,6 +50,13 @@ int32_t sp_display_draw_rect(void *obj, int32_t x0, int32_t y0, int32_t x1, int3
     return -1;
 }
 
+int32_t sp_display_draw_rects(void *obj, const sp_display_rect_t *rects, int32_t num, int32_t chn, int32_t flush)
+{
+    if (obj != NULL)
+        return static_cast<VPPDisplay *>(obj)->set_graph_rects((const x3_disp_rect_t *)rects, num, chn, flush);
+    return -1;
+}
+
 int32_t sp_display_draw_string(void *obj, int32_t x, int32_t y, char *str, int32_t chn, int32_t flush, int32_t color, int32_t line_width)
 {
     if (obj != NULL)
@@ -57,6 +64,13 @@ int32_t sp_display_draw_string(void *obj, int32_t x, int32_t y, char *str, int32
     return -1;
 }
 
+int32_t sp_display_present_graph(void *obj, int32_t chn)
+{
+    if (obj != NULL)
+        return static_cast<VPPDisplay *>(obj)->present_graph(chn);
+    return -1;
+}
+
 static int32_t exec_cmd_ex(const char *cmd, char* res, int32_t max)
 {
     if(cmd == NULL || res == NULL || max <= 0)
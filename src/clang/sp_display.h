@@ -1,6 +1,19 @@
 #ifndef SP_DISPLAY_H_
 #define SP_DISPLAY_H_
 
+#include <stdint.h>
+
+// 批量画框的一项，line_width <= 0 时画实心矩形
+typedef struct
+{
+    int32_t x0;
+    int32_t y0;
+    int32_t x1;
+    int32_t y1;
+    uint32_t color;
+    int32_t line_width;
+} sp_display_rect_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -12,7 +25,10 @@ extern "C"
     int32_t sp_stop_display(void *obj);
     int32_t sp_display_set_image(void *obj, char *addr, int32_t size, int32_t chn);
     int32_t sp_display_draw_rect(void *obj, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t chn, int32_t flush, int32_t color, int32_t line_width);
+    int32_t sp_display_draw_rects(void *obj, const sp_display_rect_t *rects, int32_t num, int32_t chn, int32_t flush);
     int32_t sp_display_draw_string(void *obj, int32_t x, int32_t y, char *str, int32_t chn, int32_t flush, int32_t color, int32_t line_width);
+    // 一帧画完后送显一次；调用过之后，该通道的 draw_* 不再各自送显
+    int32_t sp_display_present_graph(void *obj, int32_t chn);
     void sp_get_display_resolution(int32_t *width, int32_t *height);
 
 #ifdef __cplusplus
@@ -93,81 +93,90 @@ int32_t sp_vio_close(void *obj)
     return -1;
 }
 
-int32_t sp_vio_get_frame(void *obj, char *frame_buffer, int32_t width, int32_t height, const int32_t timeout)
+int32_t sp_vio_acquire_frame(void *obj, int32_t module, sp_frame_lease_t *frame, int32_t width, int32_t height, const int32_t timeout)
 {
-    if (obj != NULL && frame_buffer != NULL)
+    if (obj != NULL && frame != NULL)
     {
         auto sp = static_cast<VPPCamera *>(obj);
-        auto module_enum = static_cast<DevModule>(SP_DEV_IPU);
-        ImageFrame *temp_ptr = new ImageFrame;
-        if (!sp->GetImageFrame(temp_ptr, module_enum, width, height, timeout))
-        {
-            memcpy(frame_buffer, temp_ptr->data[0], temp_ptr->data_size[0]);
-            if (temp_ptr->plane_count > 1)
-                memcpy(frame_buffer + temp_ptr->data_size[0], temp_ptr->data[1], temp_ptr->data_size[1]);
-            sp->ReturnImageFrame(temp_ptr, module_enum, width, height); // delete temp_ptr->frame_info
-        }
-        else
-        {
-            delete temp_ptr;
+        auto module_enum = static_cast<DevModule>(module);
+        ImageFrameLease *lease = sp->AcquireImageFrame(module_enum, width, height, timeout);
+        if (lease == NULL)
             return -1;
+
+        ImageFrame *image = &lease->m_frame;
+        frame->width = image->width;
+        frame->height = image->height;
+        frame->stride = image->stride;
+        frame->plane_count = image->plane_count;
+        for (int32_t i = 0; i < 2; i++)
+        {
+            frame->vaddr[i] = (i < image->plane_count) ? image->data[i] : NULL;
+            frame->paddr[i] = (i < image->plane_count) ? image->pdata[i] : 0;
+            frame->plane_size[i] = (i < image->plane_count) ? image->data_size[i] : 0;
         }
-        delete temp_ptr;
+        frame->frame_id = image->image_id;
+        frame->timestamp = image->image_timestamp;
+        frame->lost_frames = image->lost_image_num;
+        frame->lease = lease;
         return 0;
     }
     return -1;
 }
 
-int32_t sp_vio_get_raw(void *obj, char *frame_buffer, int32_t width, int32_t height, const int32_t timeout)
+int32_t sp_vio_retain_frame(sp_frame_lease_t *frame)
 {
-    if (obj != NULL && frame_buffer != NULL)
+    if (frame != NULL && frame->lease != NULL)
     {
-        auto sp = static_cast<VPPCamera *>(obj);
-        auto module_enum = static_cast<DevModule>(Dev_SIF);
-        ImageFrame *temp_ptr = new ImageFrame;
-        if (!sp->GetImageFrame(temp_ptr, module_enum, width, height, timeout))
-        {
-            memcpy(frame_buffer, temp_ptr->data[0], temp_ptr->data_size[0]);
-            if (temp_ptr->plane_count > 1)
-                memcpy(frame_buffer + temp_ptr->data_size[0], temp_ptr->data[1], temp_ptr->data_size[1]);
-            sp->ReturnImageFrame(temp_ptr, module_enum, width, height); // delete temp_ptr->frame_info
-        }
-        else
-        {
-            delete temp_ptr;
-            return -1;
-        }
-        delete temp_ptr;
+        auto lease = static_cast<ImageFrameLease *>(frame->lease);
+        lease->m_owner->RetainImageFrame(lease);
         return 0;
     }
     return -1;
 }
 
-int32_t sp_vio_get_yuv(void *obj, char *frame_buffer, int32_t width, int32_t height, const int32_t timeout)
+int32_t sp_vio_release_frame(sp_frame_lease_t *frame)
+{
+    if (frame != NULL && frame->lease != NULL)
+    {
+        auto lease = static_cast<ImageFrameLease *>(frame->lease);
+        lease->m_owner->ReleaseImageFrame(lease);
+        frame->lease = NULL;
+        return 0;
+    }
+    return -1;
+}
+
+// 拷贝接口基于租约实现：借出硬件 buffer，拷贝到调用者内存后立即归还
+static int32_t sp_vio_copy_frame(void *obj, int32_t module, char *frame_buffer, int32_t width, int32_t height, const int32_t timeout)
 {
     if (obj != NULL && frame_buffer != NULL)
     {
-        auto sp = static_cast<VPPCamera *>(obj);
-        auto module_enum = static_cast<DevModule>(Dev_ISP);
-        ImageFrame *temp_ptr = new ImageFrame;
-        if (!sp->GetImageFrame(temp_ptr, module_enum, width, height, timeout))
-        {
-            memcpy(frame_buffer, temp_ptr->data[0], temp_ptr->data_size[0]);
-            if (temp_ptr->plane_count > 1)
-                memcpy(frame_buffer + temp_ptr->data_size[0], temp_ptr->data[1], temp_ptr->data_size[1]);
-            sp->ReturnImageFrame(temp_ptr, module_enum, width, height); // delete temp_ptr->frame_info
-        }
-        else
-        {
-            delete temp_ptr;
+        sp_frame_lease_t frame;
+        if (sp_vio_acquire_frame(obj, module, &frame, width, height, timeout))
             return -1;
-        }
-        delete temp_ptr;
-        return 0;
+        memcpy(frame_buffer, frame.vaddr[0], frame.plane_size[0]);
+        if (frame.plane_count > 1)
+            memcpy(frame_buffer + frame.plane_size[0], frame.vaddr[1], frame.plane_size[1]);
+        return sp_vio_release_frame(&frame);
     }
     return -1;
 }
 
+int32_t sp_vio_get_frame(void *obj, char *frame_buffer, int32_t width, int32_t height, const int32_t timeout)
+{
+    return sp_vio_copy_frame(obj, SP_DEV_IPU, frame_buffer, width, height, timeout);
+}
+
+int32_t sp_vio_get_raw(void *obj, char *frame_buffer, int32_t width, int32_t height, const int32_t timeout)
+{
+    return sp_vio_copy_frame(obj, SP_DEV_SIF, frame_buffer, width, height, timeout);
+}
+
+int32_t sp_vio_get_yuv(void *obj, char *frame_buffer, int32_t width, int32_t height, const int32_t timeout)
+{
+    return sp_vio_copy_frame(obj, SP_DEV_ISP, frame_buffer, width, height, timeout);
+}
+
 int32_t sp_vio_set_frame(void *obj, void *frame_buffer, int32_t size)
 {
     if (obj != NULL && frame_buffer != NULL)
@@ -24,6 +24,22 @@ typedef struct
         int32_t fps;
 } sp_sensors_parameters;
 
+// 以租约方式借出的一帧图像，地址直接指向 VIO 的硬件 buffer，使用完必须调用 sp_vio_release_frame
+typedef struct
+{
+        int32_t width;
+        int32_t height;
+        int32_t stride;
+        int32_t plane_count;
+        uint8_t *vaddr[2];
+        uint64_t paddr[2];
+        uint32_t plane_size[2];
+        int64_t frame_id;
+        int64_t timestamp;
+        int64_t lost_frames;
+        void *lease;
+} sp_frame_lease_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -41,6 +57,9 @@ extern "C"
         int32_t sp_vio_set_frame(void *obj, void *frame_buffer, int32_t size);
         int32_t sp_vio_get_raw(void *obj, char *frame_buffer, int32_t width, int32_t height, const int32_t timeout);
         int32_t sp_vio_get_yuv(void *obj, char *frame_buffer, int32_t width, int32_t height, const int32_t timeout);
+        int32_t sp_vio_acquire_frame(void *obj, int32_t module, sp_frame_lease_t *frame, int32_t width, int32_t height, const int32_t timeout);
+        int32_t sp_vio_retain_frame(sp_frame_lease_t *frame);
+        int32_t sp_vio_release_frame(sp_frame_lease_t *frame);
 
 
 #ifdef __cplusplus
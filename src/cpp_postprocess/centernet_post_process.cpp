@@ -15,11 +15,12 @@
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
-#include <queue>
+#include <new>
 #include <arm_neon.h>
 
 
 #include "centernet_post_process.h"
+#include "post_process_parallel.h"
 
 #define BSWAP_32(x) static_cast<int32_t>(__builtin_bswap32(x))
 
@@ -93,25 +94,20 @@ static float fastExp(float x) {
   return v.f;
 }
 
+// top-k 的输出顺序：分数从低到高，分数相同时下标大的在前，
+// 排序结果不依赖候选点收集的先后顺序，多线程收集时结果也不变
+static inline bool node_less(const DataNode &ldt, const DataNode &rdt) {
+  return ldt.value < rdt.value || (ldt.value == rdt.value && ldt.indx > rdt.indx);
+}
+
 // order topK data in node
+// 原地部分选择出分数最高的 topk 个放到 node 的前面，再按 node_less 排序，不分配内存
 static void top_k_helper(DataNode *node, int topk, int len) {
-  std::priority_queue<int, std::vector<DataNode>, std::greater<DataNode>> heap;
-  int i = 0;
-  while (i < len) {
-    if (i < topk) {
-      heap.push(node[i]);
-    } else {
-      if (heap.top().value < node[i].value) {
-        heap.pop();
-        heap.push(node[i]);
-      }
-    }
-    i++;
-  }
-  for (int j = 0; j < topk; j++) {
-    node[j] = heap.top();
-    heap.pop();
+  if (topk < len) {
+    std::nth_element(node, node + topk, node + len,
+                     [](const DataNode &ldt, const DataNode &rdt) { return node_less(rdt, ldt); });
   }
+  std::sort(node, node + topk, node_less);
 }
 
 #define BSWAP_32(x) static_cast<int32_t>(__builtin_bswap32(x))
@@ -125,33 +121,46 @@ float quanti_scale_function(DType data, float scale) {
   return static_cast<float>(data) * scale;
 }
 
-int filter_func(hbDNNTensor *tensor,
-                std::vector<DataNode> &node,
-                float &t_value,
-                float *scale) {
-  int h_index{2}, w_index{3}, c_index{1};
-  int *shape = tensor->properties.validShape.dimensionSize;
-  int input_c = shape[c_index];
-  int input_h = shape[h_index];
-  int input_w = shape[w_index];
+// 把 mask 里为真的 lane 对应的点追加到 node 里，index 是 lane 0 的下标
+static inline void push_nodes(uint32x4_t mask, float32x4_t value, int index, std::vector<DataNode> &node) {
+  uint32_t lanes[4];
+  float values[4];
+  vst1q_u32(lanes, mask);
+  vst1q_f32(values, value);
+  for (int k = 0; k < 4; k++) {
+    if (lanes[k] != 0) {
+      node.push_back({values[k], index + k});
+    }
+  }
+}
 
-  int num_elements = input_c * input_h * input_w;
-  int16_t *raw_heat_map_data =
-      reinterpret_cast<int16_t *>(tensor->sysMem[0].virAddr);
-
-  // per-tensor way
-  float threshold = t_value / scale[0];
-  DataNode tmp_node;
-  for (int i = 0; i < num_elements; ++i) {
-    // compare with int16 data
-    if (raw_heat_map_data[i] > static_cast<int16_t>(threshold)) {
-      // dequantize
-      tmp_node.value = quanti_scale_function(raw_heat_map_data[i], scale[0]);
-      tmp_node.indx = i;
-      node.emplace_back(tmp_node);
+/**
+ * 热力图 [begin, end) 范围内大于阈值的点反量化之后放到 node 里
+ * 8 个 int16 一组比较，比较结果压成 64 位掩码，只对命中的点逐个写出
+ * @param[in] threshold: int16 上的阈值，即 score_threshold / scale 截断到 int16
+ */
+static void filter_func(const int16_t *raw_heat_map_data,
+                        int begin,
+                        int end,
+                        int16_t threshold,
+                        float scale,
+                        std::vector<DataNode> &node) {
+  int i = begin;
+  int16x8_t vthreshold = vdupq_n_s16(threshold);
+  for (; i + 8 <= end; i += 8) {
+    uint16x8_t mask = vcgtq_s16(vld1q_s16(raw_heat_map_data + i), vthreshold);
+    uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(mask)), 0);
+    while (bits != 0) {
+      int k = __builtin_ctzll(bits) >> 3;
+      bits &= ~(0xFFull << (k * 8));
+      node.push_back({quanti_scale_function(raw_heat_map_data[i + k], scale), i + k});
+    }
+  }
+  for (; i < end; i++) {
+    if (raw_heat_map_data[i] > threshold) {
+      node.push_back({quanti_scale_function(raw_heat_map_data[i], scale), i});
     }
   }
-  return 0;
 }
 
 static float DequantiScale(int32_t data, bool big_endian, float &scale_value) {
@@ -238,10 +247,48 @@ typedef struct Detection {
   ~Detection() {}
 } Detection;
 
-std::vector<Detection> centernet_dets;
+#define CENTERNET_DEFAULT_MAX_DETS 1024
+#define CENTERNET_PARALLEL_ELEMENTS (128 * 128 * 8) /* 热力图小于这个大小时单线程处理 */
+
+// 一路后处理的上下文，热力图候选点和检测框的缓存预先分配好，逐帧复用
+struct CenternetPostProcessCtx {
+  std::vector<Detection> dets;
+  std::vector<DataNode> node;
+  PostProcessJson json;
+  int threads = 0; /* 收集候选点使用的线程数，<= 0 时按 CPU 核数 */
+  std::vector<DataNode> worker_node[POST_PROCESS_MAX_THREADS]; /* worker 0 直接写 node */
+  PostProcessWorkers workers;  /* 收集候选点用的常驻线程 */
+
+  explicit CenternetPostProcessCtx(int max_dets) {
+    dets.reserve(max_dets);
+    node.reserve(max_dets);
+  }
+};
+
+// 兼容原来的全局接口
+static CenternetPostProcessCtx centernet_default_ctx(CENTERNET_DEFAULT_MAX_DETS);
 
 
-void Centernet_resnet101_doProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTensor *reg_tensor, CenternetPostProcessInfo_t *post_info, int layer){
+/**
+ * 按通道把热力图拆给多个线程收集候选点，func(c, node) 处理第 c 个通道，
+ * 各线程的候选点按线程编号顺序合并到 ctx->node
+ */
+template <typename Func>
+static void centernet_collect(CenternetPostProcessCtx *ctx, int channels, int area, Func func) {
+  int thread_num = channels * area >= CENTERNET_PARALLEL_ELEMENTS ? PostProcessThreadNum(ctx->threads, channels) : 1;
+  ctx->workers.RunRows(thread_num, channels, [&](int worker, int c_begin, int c_end) {
+    std::vector<DataNode> &node = worker == 0 ? ctx->node : ctx->worker_node[worker];
+    for (int c = c_begin; c < c_end; c++) {
+      func(c, node);
+    }
+  });
+  for (int i = 1; i < thread_num; i++) {
+    ctx->node.insert(ctx->node.end(), ctx->worker_node[i].begin(), ctx->worker_node[i].end());
+    ctx->worker_node[i].clear();
+  }
+}
+
+void Centernet_resnet101_CtxDoProcess(CenternetPostProcessCtx_t *ctx, hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTensor *reg_tensor, CenternetPostProcessInfo_t *post_info, int layer){
 
   int h_index{2}, w_index{3}, c_index{1};
   int *shape = nms_tensor->properties.validShape.dimensionSize;
@@ -267,12 +314,18 @@ void Centernet_resnet101_doProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tens
   // Determine whether the model contains a dequnatize node by the first tensor
   auto quanti_type = nms_tensor->properties.quantiType;
 
-  std::vector<DataNode> node;
+  std::vector<DataNode> &node = ctx->node;
+  node.clear();
 
   if (quanti_type == hbDNNQuantiType::SCALE) {
     auto &scales0 = nms_tensor->properties.scale.scaleData;
-    // filter score with dequantize
-    filter_func(nms_tensor, node, post_info->score_threshold, scales0);
+    // filter score with dequantize, per-tensor way
+    auto *raw_heat_map_data = reinterpret_cast<int16_t *>(nms_tensor->sysMem[0].virAddr);
+    int16_t threshold = static_cast<int16_t>(post_info->score_threshold / scales0[0]);
+    float scale = scales0[0];
+    centernet_collect(ctx, shape[c_index], area, [&](int c, std::vector<DataNode> &node) {
+      filter_func(raw_heat_map_data, c * area, (c + 1) * area, threshold, scale, node);
+    });
   } else {
     printf("centernet unsupport shift dequantzie now!\n");
     return;
@@ -282,10 +335,6 @@ void Centernet_resnet101_doProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tens
   int topk = node.size() > post_info->nms_top_k ? post_info->nms_top_k : node.size();
   if (topk != 0) top_k_helper(node.data(), topk, node.size());
 
-  std::vector<float> reg_x(topk);
-  std::vector<float> reg_y(topk);
-  std::vector<Detection> tmp_box(topk);
-
   if (wh_tensor->properties.quantiType == hbDNNQuantiType::SCALE) {
     int32_t *wh = reinterpret_cast<int32_t *>(wh_tensor->sysMem[0].virAddr);
     int32_t *reg = reinterpret_cast<int32_t *>(reg_tensor->sysMem[0].virAddr);
@@ -295,6 +344,7 @@ void Centernet_resnet101_doProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tens
       if (topk_score <= post_info->score_threshold) {
         continue;
       }
+      Detection det;
 
       // bbox decode with dequantize
       int topk_clses = node[i].indx / area;
@@ -311,24 +361,23 @@ void Centernet_resnet101_doProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tens
       float wh_0 = quanti_scale_function(wh[topk_inds], *wh_scale);
       float wh_1 = quanti_scale_function(wh[area + topk_inds], *(wh_scale + 1));
 
-      tmp_box[i].bbox.xmin = topk_xs - wh_0 / 2;
-      tmp_box[i].bbox.xmax = topk_xs + wh_0 / 2;
-      tmp_box[i].bbox.ymin = topk_ys - wh_1 / 2;
-      tmp_box[i].bbox.ymax = topk_ys + wh_1 / 2;
+      det.bbox.xmin = topk_xs - wh_0 / 2;
+      det.bbox.xmax = topk_xs + wh_0 / 2;
+      det.bbox.ymin = topk_ys - wh_1 / 2;
+      det.bbox.ymax = topk_ys + wh_1 / 2;
 
-      tmp_box[i].score = topk_score;
-      tmp_box[i].id = topk_clses;
-      tmp_box[i].class_name = default_ptq_centernet_config.class_names[topk_clses].c_str();
-      centernet_dets.push_back(tmp_box[i]);
+      det.score = topk_score;
+      det.id = topk_clses;
+      det.class_name = default_ptq_centernet_config.class_names[topk_clses].c_str();
+      ctx->dets.push_back(det);
     }
   } else {
     printf("centernet unsupport now!\n");
     return;
   }
 
-  auto &detections = centernet_dets;
-  int det_num = centernet_dets.size();
-  printf("det.size(): %d", det_num);
+  auto &detections = ctx->dets;
+  int det_num = detections.size();
   for (int i = 0; i < det_num; i++) {
     detections[i].bbox.xmin = detections[i].bbox.xmin * scale_x - offset_x;
     detections[i].bbox.xmax = detections[i].bbox.xmax * scale_x - offset_x;
@@ -341,402 +390,114 @@ void Centernet_resnet101_doProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tens
 }
 
 
-int NMSMaxPool2dDequanti(hbDNNTensor *tensor,
-                         std::vector<DataNode> &node,
-                         float &t_value,
-                         float *scale) {
-  int h_index{2}, w_index{3}, c_index{1};
-  int *shape = tensor->properties.validShape.dimensionSize;
-  int input_c = shape[c_index];
-  int input_h = shape[h_index];
-  int input_w = shape[w_index];
-
-  auto *raw_heat_map_data =
-      reinterpret_cast<int32_t *>(tensor->sysMem[0].virAddr);
-
-  std::vector<int> edge1 = {-1, +1, +input_w - 1, +input_w, +input_w + 1};
-
-  std::vector<int> edge2 = {
-      -1,
-      +1,
-      -input_w - 1,
-      -input_w,
-      -input_w + 1,
-  };
-
-  std::vector<int> edge3 = {
-      +1,
-      +input_w,
-      +input_w + 1,
-      -input_w,
-      -input_w + 1,
-  };
-
-  std::vector<int> edge4 = {
-      -1,
-      +input_w - 1,
-      +input_w,
-      -input_w - 1,
-      -input_w,
-  };
-
-  int pos[8] = {+1,
-                -1,
-                +input_w - 1,
-                +input_w,
-                +input_w + 1,
-                -input_w - 1,
-                -input_w,
-                -input_w + 1};
-
-  bool big_endian = false;
-
-  for (int c = 0; c < input_c; c++) {
-    int channel_offset = c * input_h * input_w;
-    int32_t *iptr = raw_heat_map_data + channel_offset;
-    float scale_value = scale[c];
-    // VLOG(EXAMPLE_REPORT) << "c: " << c << "; scale1:" << scale[c];
-    DataNode tmp_node;
-
-    std::vector<int32_t> point1(4, 0.f);
-    point1[0] = iptr[0];
-    point1[1] = iptr[1];
-    point1[2] = iptr[input_w + 0];
-    point1[3] = iptr[input_w + 1];
-    int i = 0;
-    for (; i < 4; ++i) {
-      if (point1[0] < point1[i]) break;
-    }
-    if (i == 4) {
-      tmp_node.value = DequantiScale(point1[0], big_endian, scale_value);
-      if (tmp_node.value > t_value) {
-        tmp_node.indx = channel_offset;
-        node.emplace_back(tmp_node);
-      }
-    }
-
-    std::vector<int32_t> point2(4, 0.f);
-    point2[0] = iptr[input_w - 2];
-    point2[1] = iptr[input_w - 1];  //
-    point2[2] = iptr[input_w + input_w - 2];
-    point2[3] = iptr[input_w + input_w - 1];
-    i = 0;
-    for (; i < 4; ++i) {
-      if (point2[1] < point2[i]) break;
-    }
-    if (i == 4) {
-      tmp_node.value = DequantiScale(point2[1], big_endian, scale_value);  //
-      if (tmp_node.value > t_value) {
-        tmp_node.indx = channel_offset + input_w - 1;
-        node.emplace_back(tmp_node);
-      }
-    }
-
-    std::vector<int32_t> point3(4, 0.f);
-    point3[0] = iptr[(input_h - 2) * input_w + 0];
-    point3[1] = iptr[(input_h - 2) * input_w + 1];
-    point3[2] = iptr[(input_h - 1) * input_w + 0];  //
-    point3[3] = iptr[(input_h - 1) * input_w + 1];
-    i = 0;
-    for (; i < 4; ++i) {
-      if (point3[2] < point3[i]) break;
-    }
-    if (i == 4) {
-      tmp_node.value = DequantiScale(point3[2], big_endian, scale_value);
-      if (tmp_node.value > t_value) {
-        tmp_node.indx = channel_offset + (input_h - 1) * input_w;
-        node.emplace_back(tmp_node);
-      }
-    }
-
-    std::vector<int32_t> point4(4, 0.f);
-    point4[0] = iptr[(input_h - 2) * input_w + (input_w - 2)];
-    point4[1] = iptr[(input_h - 2) * input_w + (input_w - 1)];
-    point4[2] = iptr[(input_h - 1) * input_w + (input_w - 2)];
-    point4[3] = iptr[(input_h - 1) * input_w + (input_w - 1)];  //
-    i = 0;
-    for (; i < 4; ++i) {
-      if (point4[3] < point4[i]) break;
-    }
-    if (i == 4) {
-      tmp_node.value = DequantiScale(point4[3], big_endian, scale_value);
-      if (tmp_node.value > t_value) {
-        tmp_node.indx = channel_offset + (input_h - 1) * input_w + input_w - 1;
-        node.emplace_back(tmp_node);
-      }
-    }
-
-    // top + bottom
-    for (int w = 1; w < input_w - 1; ++w) {
-      i = 0;
-      int32_t cur_value = iptr[w];
-      for (; i < 5; ++i) {
-        if (cur_value < iptr[w + edge1[i]]) break;
-      }
-      if (i == 5) {
-        tmp_node.value = DequantiScale(cur_value, big_endian, scale_value);
-        if (tmp_node.value > t_value) {
-          tmp_node.indx = channel_offset + w;
-          node.emplace_back(tmp_node);
-        }
-      }
-
-      i = 0;
-      int cur_pos = (input_h - 1) * input_w + w;
-      cur_value = iptr[cur_pos];
-      for (; i < 5; ++i) {
-        if (cur_value < iptr[cur_pos + edge2[i]]) break;
-      }
-      if (i == 5) {
-        tmp_node.value = DequantiScale(cur_value, big_endian, scale_value);
-        if (tmp_node.value > t_value) {
-          tmp_node.indx = channel_offset + cur_pos;
-          node.emplace_back(tmp_node);
-        }
+// (h, w) 不小于 3x3 邻域（超出边界的部分不算）里的所有点，即 max pool 之后值不变
+template <typename DType>
+static inline bool heatmap_peak(const DType *iptr, int h, int w, int input_h, int input_w) {
+  DType cur_value = iptr[h * input_w + w];
+  for (int y = std::max(h - 1, 0); y <= std::min(h + 1, input_h - 1); y++) {
+    for (int x = std::max(w - 1, 0); x <= std::min(w + 1, input_w - 1); x++) {
+      if (cur_value < iptr[y * input_w + x]) {
+        return false;
       }
     }
+  }
+  return true;
+}
 
-    // left + right
-    for (int h = 1; h < input_h - 1; ++h) {
-      i = 0;
-      int cur_pos = h * input_w;
-      int32_t cur_value = iptr[cur_pos];
-      for (; i < 5; ++i) {
-        if (cur_value < iptr[cur_pos + edge3[i]]) break;
-      }
-      if (i == 5) {
-        tmp_node.value = DequantiScale(cur_value, big_endian, scale_value);
-        if (tmp_node.value > t_value) {
-          tmp_node.indx = channel_offset + cur_pos;
-          node.emplace_back(tmp_node);
-        }
-      }
-
-      i = 0;
-      cur_pos = h * input_w + input_w - 1;
-      cur_value = iptr[cur_pos];
-      for (; i < 5; ++i) {
-        if (cur_value < iptr[cur_pos + edge3[i]]) break;
+/**
+ * 一个通道里 3x3 max pool 之后值不变、并且反量化之后大于阈值的点放到 node 里
+ * 4 个点一组先比较阈值，组里有点超过阈值时再用错位加载求 3x3 邻域的最大值；
+ * 第一行和最后一行把越界的那一行换成本行，结果和只取边界内的邻域一样。
+ * 左右两列和凑不够 4 个的点逐个判断
+ */
+static void NMSMaxPool2dDequanti(const int32_t *iptr,
+                                 int input_h,
+                                 int input_w,
+                                 float scale_value,
+                                 float t_value,
+                                 int channel_offset,
+                                 std::vector<DataNode> &node) {
+  bool big_endian = false;
+  float32x4_t vscale = vdupq_n_f32(scale_value);
+  float32x4_t vthreshold = vdupq_n_f32(t_value);
+  for (int h = 0; h < input_h; h++) {
+    const int32_t *row = iptr + h * input_w;
+    const int32_t *up = h > 0 ? row - input_w : row;
+    const int32_t *down = h < input_h - 1 ? row + input_w : row;
+    int offset = channel_offset + h * input_w;
+
+    auto scalar_peak = [&](int w) {
+      float value = DequantiScale(row[w], big_endian, scale_value);
+      if (value > t_value && heatmap_peak(iptr, h, w, input_h, input_w)) {
+        node.push_back({value, offset + w});
       }
-      if (i == 5) {
-        tmp_node.value = DequantiScale(cur_value, big_endian, scale_value);
-        if (tmp_node.value > t_value) {
-          tmp_node.indx = channel_offset + cur_pos;
-          node.emplace_back(tmp_node);
-        }
+    };
+
+    scalar_peak(0);
+    int w = 1;
+    for (; w + 4 < input_w; w += 4) {
+      int32x4_t cur = vld1q_s32(row + w);
+      float32x4_t value = vmulq_f32(vcvtq_f32_s32(cur), vscale);
+      uint32x4_t mask = vcgtq_f32(value, vthreshold);
+      if (vmaxvq_u32(mask) == 0) {
+        continue;
       }
+      int32x4_t max_value = vmaxq_s32(vld1q_s32(row + w - 1), vld1q_s32(row + w + 1));
+      max_value = vmaxq_s32(max_value, vmaxq_s32(vld1q_s32(up + w - 1), vld1q_s32(up + w)));
+      max_value = vmaxq_s32(max_value, vmaxq_s32(vld1q_s32(up + w + 1), vld1q_s32(down + w - 1)));
+      max_value = vmaxq_s32(max_value, vmaxq_s32(vld1q_s32(down + w), vld1q_s32(down + w + 1)));
+      mask = vandq_u32(mask, vcgeq_s32(cur, max_value));
+      push_nodes(mask, value, offset + w, node);
     }
-
-    // center
-    for (int h = 1; h < input_h - 1; h++) {
-      int offset = h * input_w;
-      for (int w = 1; w < input_w - 1; w++) {
-        int cur_pos = offset + w;
-        int32_t cur_value = iptr[cur_pos];
-        i = 0;
-        for (; i < 8; ++i) {
-          if (cur_value < iptr[cur_pos + pos[i]]) break;
-        }
-        if (i == 8) {
-          tmp_node.value = DequantiScale(cur_value, big_endian, scale_value);
-          if (tmp_node.value > t_value) {
-            tmp_node.indx = channel_offset + cur_pos;
-            node.emplace_back(tmp_node);
-          }
-        }
-      }
+    for (; w < input_w; w++) {
+      scalar_peak(w);
     }
   }
-  return 0;
 }
 
-int NMSMaxPool2d(hbDNNTensor *tensor,
-                 std::vector<DataNode> &node,
-                 float &t_value) {
-  int h_index{2}, w_index{3}, c_index{1};
-  int *shape = tensor->properties.validShape.dimensionSize;
-  int input_c = shape[c_index];
-  int input_h = shape[h_index];
-  int input_w = shape[w_index];
-
-  float *raw_heat_map_data =
-      reinterpret_cast<float *>(tensor->sysMem[0].virAddr);
-
-  std::vector<int> edge1 = {-1, +1, +input_w - 1, +input_w, +input_w + 1};
-
-  std::vector<int> edge2 = {
-      -1,
-      +1,
-      -input_w - 1,
-      -input_w,
-      -input_w + 1,
-  };
-
-  std::vector<int> edge3 = {
-      +1,
-      +input_w,
-      +input_w + 1,
-      -input_w,
-      -input_w + 1,
-  };
-
-  std::vector<int> edge4 = {
-      -1,
-      +input_w - 1,
-      +input_w,
-      -input_w - 1,
-      -input_w,
-  };
-
-  int pos[8] = {+1,
-                -1,
-                +input_w - 1,
-                +input_w,
-                +input_w + 1,
-                -input_w - 1,
-                -input_w,
-                -input_w + 1};
-
-  for (int c = 0; c < input_c; c++) {
-    int channel_offset = c * input_h * input_w;
-    float *iptr = raw_heat_map_data + channel_offset;
-    DataNode tmp_node;
-
-    std::vector<float> point1(4, 0.f);
-    point1[0] = iptr[0];  //
-    point1[1] = iptr[1];
-    point1[2] = iptr[input_w + 0];
-    point1[3] = iptr[input_w + 1];
-    int i = 0;
-    for (; i < 4; ++i) {
-      if (point1[0] < point1[i]) break;
-    }
-    if (i == 4 && point1[0] > t_value) {
-      tmp_node.indx = channel_offset;
-      tmp_node.value = point1[0];
-      node.emplace_back(tmp_node);
-    }
-
-    std::vector<float> point2(4, 0.f);
-    point2[0] = iptr[input_w - 2];
-    point2[1] = iptr[input_w - 1];  //
-    point2[2] = iptr[input_w + input_w - 2];
-    point2[3] = iptr[input_w + input_w - 1];
-    i = 0;
-    for (; i < 4; ++i) {
-      if (point2[1] < point2[i]) break;
-    }
-    if (i == 4 && point2[1] > t_value) {
-      tmp_node.indx = channel_offset + input_w - 1;
-      tmp_node.value = point2[1];  //
-      node.emplace_back(tmp_node);
-    }
-
-    std::vector<float> point3(4, 0.f);
-    point3[0] = iptr[(input_h - 2) * input_w + 0];
-    point3[1] = iptr[(input_h - 2) * input_w + 1];
-    point3[2] = iptr[(input_h - 1) * input_w + 0];  //
-    point3[3] = iptr[(input_h - 1) * input_w + 1];
-    i = 0;
-    for (; i < 4; ++i) {
-      if (point3[2] < point3[i]) break;
-    }
-    if (i == 4 && point3[2] > t_value) {
-      tmp_node.indx = channel_offset + (input_h - 1) * input_w;
-      tmp_node.value = point3[2];
-      node.emplace_back(tmp_node);
-    }
-
-    std::vector<float> point4(4, 0.f);
-    point4[0] = iptr[(input_h - 2) * input_w + (input_w - 2)];
-    point4[1] = iptr[(input_h - 2) * input_w + (input_w - 1)];
-    point4[2] = iptr[(input_h - 1) * input_w + (input_w - 2)];
-    point4[3] = iptr[(input_h - 1) * input_w + (input_w - 1)];  //
-    i = 0;
-    for (; i < 4; ++i) {
-      if (point4[3] < point4[i]) break;
-    }
-    if (i == 4 && point4[3] > t_value) {
-      tmp_node.indx = channel_offset + (input_h - 1) * input_w + input_w - 1;
-      tmp_node.value = point4[3];
-      node.emplace_back(tmp_node);
-    }
-
-    // top + bottom
-    for (int w = 1; w < input_w - 1; ++w) {
-      i = 0;
-      float cur_value = iptr[w];
-      for (; i < 5; ++i) {
-        if (cur_value < iptr[w + edge1[i]]) break;
-      }
-      if (i == 5 && cur_value > t_value) {
-        tmp_node.indx = channel_offset + w;
-        tmp_node.value = cur_value;
-        node.emplace_back(tmp_node);
-      }
-
-      i = 0;
-      int cur_pos = (input_h - 1) * input_w + w;
-      cur_value = iptr[cur_pos];
-      for (; i < 5; ++i) {
-        if (cur_value < iptr[cur_pos + edge2[i]]) break;
-      }
-      if (i == 5 && cur_value > t_value) {
-        tmp_node.indx = channel_offset + cur_pos;
-        tmp_node.value = cur_value;
-        node.emplace_back(tmp_node);
+// 同 NMSMaxPool2dDequanti，输入是 float 热力图
+static void NMSMaxPool2d(const float *iptr,
+                         int input_h,
+                         int input_w,
+                         float t_value,
+                         int channel_offset,
+                         std::vector<DataNode> &node) {
+  float32x4_t vthreshold = vdupq_n_f32(t_value);
+  for (int h = 0; h < input_h; h++) {
+    const float *row = iptr + h * input_w;
+    const float *up = h > 0 ? row - input_w : row;
+    const float *down = h < input_h - 1 ? row + input_w : row;
+    int offset = channel_offset + h * input_w;
+
+    auto scalar_peak = [&](int w) {
+      float value = row[w];
+      if (value > t_value && heatmap_peak(iptr, h, w, input_h, input_w)) {
+        node.push_back({value, offset + w});
       }
-    }
-
-    // left + right
-    for (int h = 1; h < input_h - 1; ++h) {
-      i = 0;
-      int cur_pos = h * input_w;
-      float cur_value = iptr[cur_pos];
-      for (; i < 5; ++i) {
-        if (cur_value < iptr[cur_pos + edge3[i]]) break;
-      }
-      if (i == 5 && cur_value > t_value) {
-        tmp_node.indx = channel_offset + cur_pos;
-        tmp_node.value = cur_value;
-        node.emplace_back(tmp_node);
-      }
-
-      i = 0;
-      cur_pos = h * input_w + input_w - 1;
-      cur_value = iptr[cur_pos];
-      for (; i < 5; ++i) {
-        if (iptr[cur_pos] < iptr[cur_pos + edge4[i]]) break;
-      }
-      if (i == 5 && cur_value > t_value) {
-        tmp_node.indx = channel_offset + cur_pos;
-        tmp_node.value = cur_value;
-        node.emplace_back(tmp_node);
+    };
+
+    scalar_peak(0);
+    int w = 1;
+    for (; w + 4 < input_w; w += 4) {
+      float32x4_t cur = vld1q_f32(row + w);
+      uint32x4_t mask = vcgtq_f32(cur, vthreshold);
+      if (vmaxvq_u32(mask) == 0) {
+        continue;
       }
+      float32x4_t max_value = vmaxq_f32(vld1q_f32(row + w - 1), vld1q_f32(row + w + 1));
+      max_value = vmaxq_f32(max_value, vmaxq_f32(vld1q_f32(up + w - 1), vld1q_f32(up + w)));
+      max_value = vmaxq_f32(max_value, vmaxq_f32(vld1q_f32(up + w + 1), vld1q_f32(down + w - 1)));
+      max_value = vmaxq_f32(max_value, vmaxq_f32(vld1q_f32(down + w), vld1q_f32(down + w + 1)));
+      mask = vandq_u32(mask, vcgeq_f32(cur, max_value));
+      push_nodes(mask, cur, offset + w, node);
     }
-
-    // center
-    for (int h = 1; h < input_h - 1; h++) {
-      int offset = h * input_w;
-      for (int w = 1; w < input_w - 1; w++) {
-        int cur_pos = offset + w;
-        float cur_value = iptr[cur_pos];
-        i = 0;
-        for (; i < 8; ++i) {
-          if (cur_value < iptr[cur_pos + pos[i]]) break;
-        }
-        if (i == 8 && cur_value > t_value) {
-          tmp_node.indx = channel_offset + cur_pos;
-          tmp_node.value = cur_value;
-          node.emplace_back(tmp_node);
-        }
-      }
+    for (; w < input_w; w++) {
+      scalar_peak(w);
     }
   }
-  return 0;
 }
 
-void CenternetdoProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTensor *reg_tensor, CenternetPostProcessInfo_t *post_info, int layer) {
+void CenternetCtxDoProcess(CenternetPostProcessCtx_t *ctx, hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTensor *reg_tensor, CenternetPostProcessInfo_t *post_info, int layer) {
 
   int h_index{2}, w_index{3}, c_index{1};
   int *shape = nms_tensor->properties.validShape.dimensionSize;
@@ -762,14 +523,25 @@ void CenternetdoProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTe
   // Determine whether the model contains a dequnatize node by the first tensor
   auto quanti_type = nms_tensor->properties.quantiType;
 
-  std::vector<DataNode> node;
+  std::vector<DataNode> &node = ctx->node;
+  node.clear();
   float t_value =
       log(post_info->score_threshold / (1.f - post_info->score_threshold));  // ln (2.f/3.f)
+  int input_h = shape[h_index];
+  int input_w = shape[w_index];
+  int channel_area = input_h * input_w;
   if (quanti_type == hbDNNQuantiType::NONE) {
-    NMSMaxPool2d(nms_tensor, node, t_value);
+    auto *raw_heat_map_data = reinterpret_cast<float *>(nms_tensor->sysMem[0].virAddr);
+    centernet_collect(ctx, shape[c_index], channel_area, [&](int c, std::vector<DataNode> &node) {
+      NMSMaxPool2d(raw_heat_map_data + c * channel_area, input_h, input_w, t_value, c * channel_area, node);
+    });
   } else if (quanti_type == hbDNNQuantiType::SCALE) {
     auto &scales0 = nms_tensor->properties.scale.scaleData;
-    NMSMaxPool2dDequanti(nms_tensor, node, t_value, scales0);
+    auto *raw_heat_map_data = reinterpret_cast<int32_t *>(nms_tensor->sysMem[0].virAddr);
+    centernet_collect(ctx, shape[c_index], channel_area, [&](int c, std::vector<DataNode> &node) {
+      NMSMaxPool2dDequanti(raw_heat_map_data + c * channel_area, input_h, input_w, scales0[c], t_value,
+                           c * channel_area, node);
+    });
   } else {
     printf("centernet unsupport shift dequantzie now!\n");
     return;
@@ -778,10 +550,6 @@ void CenternetdoProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTe
   int topk = node.size() > post_info->nms_top_k ? post_info->nms_top_k : node.size();
   if (topk != 0) top_k_helper(node.data(), topk, node.size());
 
-  std::vector<float> reg_x(topk);
-  std::vector<float> reg_y(topk);
-  std::vector<Detection> tmp_box(topk);
-
   if (quanti_type == hbDNNQuantiType::NONE) {
     float *wh = reinterpret_cast<float *>(wh_tensor->sysMem[0].virAddr);
     float *reg = reinterpret_cast<float *>(reg_tensor->sysMem[0].virAddr);
@@ -792,6 +560,7 @@ void CenternetdoProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTe
       if (topk_score <= post_info->score_threshold) {
         continue;
       }
+      Detection det;
 
       int topk_clses = node[i].indx / area;
       int topk_inds = node[i].indx % area;
@@ -801,15 +570,15 @@ void CenternetdoProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTe
       topk_xs += reg[topk_inds];
       topk_ys += reg[area + topk_inds];
 
-      tmp_box[i].bbox.xmin = topk_xs - wh[topk_inds] / 2;
-      tmp_box[i].bbox.xmax = topk_xs + wh[topk_inds] / 2;
-      tmp_box[i].bbox.ymin = topk_ys - wh[area + topk_inds] / 2;
-      tmp_box[i].bbox.ymax = topk_ys + wh[area + topk_inds] / 2;
+      det.bbox.xmin = topk_xs - wh[topk_inds] / 2;
+      det.bbox.xmax = topk_xs + wh[topk_inds] / 2;
+      det.bbox.ymin = topk_ys - wh[area + topk_inds] / 2;
+      det.bbox.ymax = topk_ys + wh[area + topk_inds] / 2;
 
-      tmp_box[i].score = topk_score;
-      tmp_box[i].id = topk_clses;
-      tmp_box[i].class_name = default_ptq_centernet_config.class_names[topk_clses].c_str();
-      centernet_dets.push_back(tmp_box[i]);
+      det.score = topk_score;
+      det.id = topk_clses;
+      det.class_name = default_ptq_centernet_config.class_names[topk_clses].c_str();
+      ctx->dets.push_back(det);
     }
 
   } else if (quanti_type == hbDNNQuantiType::SCALE) {
@@ -823,6 +592,7 @@ void CenternetdoProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTe
       if (topk_score <= post_info->score_threshold) {
         continue;
       }
+      Detection det;
 
       int topk_clses = node[i].indx / area;
       int topk_inds = node[i].indx % area;
@@ -840,24 +610,23 @@ void CenternetdoProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTe
       float wh_1 =
           DequantiScale(wh[area + topk_inds], big_endian, *(scales1 + 1));
 
-      tmp_box[i].bbox.xmin = topk_xs - wh_0 / 2;
-      tmp_box[i].bbox.xmax = topk_xs + wh_0 / 2;
-      tmp_box[i].bbox.ymin = topk_ys - wh_1 / 2;
-      tmp_box[i].bbox.ymax = topk_ys + wh_1 / 2;
+      det.bbox.xmin = topk_xs - wh_0 / 2;
+      det.bbox.xmax = topk_xs + wh_0 / 2;
+      det.bbox.ymin = topk_ys - wh_1 / 2;
+      det.bbox.ymax = topk_ys + wh_1 / 2;
 
-      tmp_box[i].score = topk_score;
-      tmp_box[i].id = topk_clses;
-      tmp_box[i].class_name = default_ptq_centernet_config.class_names[topk_clses].c_str();
-      centernet_dets.push_back(tmp_box[i]);
+      det.score = topk_score;
+      det.id = topk_clses;
+      det.class_name = default_ptq_centernet_config.class_names[topk_clses].c_str();
+      ctx->dets.push_back(det);
     }
   } else {
     printf("centernet unsupport shift dequantzie now!\n");
     return;
   }
 
-  auto &detections = centernet_dets;
-  int det_num = centernet_dets.size();
-  printf("det.size(): %d\n", det_num);
+  auto &detections = ctx->dets;
+  int det_num = detections.size();
   for (int i = 0; i < det_num; i++) {
     detections[i].bbox.xmin = detections[i].bbox.xmin * scale_x - offset_x;
     detections[i].bbox.xmax = detections[i].bbox.xmax * scale_x - offset_x;
@@ -869,32 +638,64 @@ void CenternetdoProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTe
 
 }
 
-char* CenternetPostProcess(CenternetPostProcessInfo_t *post_info) {
-
-  int i = 0;
-  char *str_dets;
+char* CenternetCtxPostProcess(CenternetPostProcessCtx_t *ctx, CenternetPostProcessInfo_t *post_info) {
 
-  std::stringstream out_string;
-  std::vector<Detection> centernet_det_restuls;
+  std::vector<Detection> &centernet_det_restuls = ctx->dets;
 
-  centernet_det_restuls = centernet_dets;
   // 算法结果转换成json格式
-  int centernet_det_restuls_size = centernet_det_restuls.size();
-  out_string << "\"centernet_result\": [";
-  for (i = 0; i < centernet_det_restuls_size; i++) {
-  	auto det_ret = centernet_det_restuls[i];
-  	out_string << det_ret;
-  	if (i < centernet_det_restuls_size - 1)
-		out_string << ",";
+  PostProcessJson &json = ctx->json;
+  json.Reset();
+  json.Raw("\"centernet_result\": [");
+  for (size_t i = 0; i < centernet_det_restuls.size(); i++) {
+    const Detection &det = centernet_det_restuls[i];
+    if (i > 0) {
+      json.Raw(",");
+    }
+    json.Detection(det.bbox.xmin, det.bbox.ymin, det.bbox.xmax, det.bbox.ymax,
+                   det.score, det.id, default_ptq_centernet_config.class_names[det.id].c_str());
   }
-  out_string << "]" << std::endl;
+  json.Raw("]");
 
-  str_dets = (char *)malloc(out_string.str().length() + 1);
-  str_dets[out_string.str().length()] = '\0';
-  snprintf(str_dets, out_string.str().length(), "%s", out_string.str().c_str());
-  // printf("str_dets: %s\n", str_dets);
-  centernet_dets.clear();
   centernet_det_restuls.clear();
-  return str_dets;
+  return json.Dup();
+}
+
+int CenternetCtxGetBoxes(CenternetPostProcessCtx_t *ctx, CenternetPostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes) {
+
+  int count = PostProcessPackBoxes(ctx->dets, boxes, max_boxes);
+
+  ctx->dets.clear();
+  return count;
+}
+
+CenternetPostProcessCtx_t *CenternetPostProcessCreate(int max_dets) {
+  if (max_dets <= 0) {
+    max_dets = CENTERNET_DEFAULT_MAX_DETS;
+  }
+  return new (std::nothrow) CenternetPostProcessCtx(max_dets);
+}
+
+void CenternetPostProcessDestroy(CenternetPostProcessCtx_t *ctx) {
+  delete ctx;
+}
+
+void CenternetPostProcessSetThreads(CenternetPostProcessCtx_t *ctx, int threads) {
+  ctx->threads = threads;
+}
+
+void CenternetdoProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTensor *reg_tensor, CenternetPostProcessInfo_t *post_info, int layer) {
+  CenternetCtxDoProcess(&centernet_default_ctx, nms_tensor, wh_tensor, reg_tensor, post_info, layer);
+}
+
+void Centernet_resnet101_doProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTensor *reg_tensor, CenternetPostProcessInfo_t *post_info, int layer) {
+  Centernet_resnet101_CtxDoProcess(&centernet_default_ctx, nms_tensor, wh_tensor, reg_tensor, post_info, layer);
+}
+
+char* CenternetPostProcess(CenternetPostProcessInfo_t *post_info) {
+  return CenternetCtxPostProcess(&centernet_default_ctx, post_info);
+}
+
+int CenternetPostProcessBoxes(CenternetPostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes) {
+  return CenternetCtxGetBoxes(&centernet_default_ctx, post_info, boxes, max_boxes);
 }
 
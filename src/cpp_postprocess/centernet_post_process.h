@@ -10,6 +10,7 @@
 #define _POST_PROCESS_CENTERNET_POST_PROCESS_H_
 
 #include "dnn/hb_dnn.h"
+#include "post_process_output.h"
 
 #ifdef __cplusplus
   extern "C"{
@@ -39,6 +40,40 @@ void CenternetdoProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTe
 
 void Centernet_resnet101_doProcess(hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTensor *reg_tensor, CenternetPostProcessInfo_t *post_info, int layer);
 
+// 后处理上下文：每个上下文独立保存一路模型输出的检测结果，内部缓存逐帧复用。
+// 同一个上下文同一时间只能在一个线程里使用，不同上下文可以并行处理。
+// 上面不带上下文的接口共用一个内部的默认上下文。
+typedef struct CenternetPostProcessCtx CenternetPostProcessCtx_t;
+
+/**
+ * 创建后处理上下文
+ * @param[in] max_dets: 预分配的检测框数量，<= 0 时使用默认值
+ * @return 上下文句柄，失败返回 NULL
+ */
+CenternetPostProcessCtx_t *CenternetPostProcessCreate(int max_dets);
+
+void CenternetPostProcessDestroy(CenternetPostProcessCtx_t *ctx);
+
+void CenternetCtxDoProcess(CenternetPostProcessCtx_t *ctx, hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTensor *reg_tensor, CenternetPostProcessInfo_t *post_info, int layer);
+
+void Centernet_resnet101_CtxDoProcess(CenternetPostProcessCtx_t *ctx, hbDNNTensor *nms_tensor, hbDNNTensor *wh_tensor, hbDNNTensor *reg_tensor, CenternetPostProcessInfo_t *post_info, int layer);
+
+char* CenternetCtxPostProcess(CenternetPostProcessCtx_t *ctx, CenternetPostProcessInfo_t *post_info);
+
+/**
+ * 把结果写到调用者提供的数组里，不生成 json 字符串
+ * @param[out] boxes: 结果数组，按 top-k 的顺序排列
+ * @param[in] max_boxes: 数组长度，超出的结果被丢弃
+ * @return 写入的结果个数
+ */
+int CenternetCtxGetBoxes(CenternetPostProcessCtx_t *ctx, CenternetPostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes);
+
+// 使用默认上下文，和 CenternetdoProcess/Centernet_resnet101_doProcess 配合使用
+int CenternetPostProcessBoxes(CenternetPostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes);
+
+// 设置收集热力图候选点使用的线程数，按通道拆分，<= 0 时按 CPU 核数；热力图较小时始终单线程
+void CenternetPostProcessSetThreads(CenternetPostProcessCtx_t *ctx, int threads);
+
 
 #ifdef __cplusplus
 }
@@ -17,8 +17,11 @@
 #include <algorithm>
 #include <arm_neon.h>
 #include <queue>
+#include <new>
 
 #include "fcos_post_process.h"
+#include "post_process_math.h"
+#include "post_process_parallel.h"
 
 static inline uint32x4x4_t CalculateIndex(uint32_t idx,
                                           float32x4_t a,
@@ -138,11 +141,6 @@ PTQFcosConfig fcos_config_ = {
      "hair drier",    "toothbrush"},
     ""};
 
-struct ScoreId {
-  float score;
-  int id;
-};
-
 /**
  * Finds the smallest element in the range [first, last).
  * @tparam[in] ForwardIterator
@@ -223,7 +221,60 @@ typedef struct Detection {
   ~Detection() {}
 } Detection;
 
-std::vector<Detection> fcos_dets;
+#define FCOS_DEFAULT_MAX_DETS 1024
+#define FCOS_PARALLEL_CELLS (64 * 64) /* 所有层的网格数加起来少于这个值时单线程解码 */
+
+// 一层输出解码用到的参数，解码之前准备好，解码时各个线程只读
+struct FcosLevel {
+  bool nchw;
+  bool quanti;                /* int32 定点输出，按 scale 反量化；否则是 float 输出 */
+  const void *cls_data;
+  const void *bbox_data;
+  const void *ce_data;
+  const float *cls_scale;
+  const float *bbox_scale;
+  const float *ce_scale;
+  int height;                 /* 解码的行数 */
+  int width;                  /* 每行解码的网格数 */
+  int row_step;               /* 相邻两行的网格下标差，即对齐之后的宽 */
+  int channels;               /* 类别数 */
+  int plane;                  /* NCHW 相邻两个通道的距离 */
+  int ce_step;                /* NHWC 相邻两个网格 ce 的距离 */
+  int bbox_step;              /* NHWC 相邻两个网格 bbox 的距离 */
+  int stride;
+  float w_scale;
+  float h_scale;
+  float score_thresh;         /* sigmoid(cls) * sigmoid(ce) 的阈值，即 score_threshold 的平方 */
+  float pre_thresh;           /* cls 和 ce 在 sigmoid 之前的阈值 */
+  int32_t ce_qthr;            /* ce 的定点阈值 */
+  const int32_t *cls_qthr;    /* 每个类别的定点阈值 */
+};
+
+// 一路后处理的上下文，检测框、NMS 和各层解码参数的缓存都预先分配好，逐帧复用
+struct FcosPostProcessCtx {
+  std::vector<Detection> dets;
+  std::vector<Detection> results;
+  PostProcessNms nms;
+  PostProcessNmsConfig_t nms_config;
+  PostProcessJson json;
+  int threads = 0; /* 解码使用的线程数，<= 0 时按 CPU 核数 */
+  std::vector<Detection> worker_dets[POST_PROCESS_MAX_THREADS]; /* worker 0 直接写 dets */
+  PostProcessWorkers workers;  /* 解码用的常驻线程 */
+  std::vector<FcosLevel> levels;
+  std::vector<std::vector<int32_t>> cls_qthr; /* 每层每个类别的定点阈值 */
+
+  explicit FcosPostProcessCtx(int max_dets) {
+    dets.reserve(max_dets);
+    results.reserve(max_dets);
+    nms.Reserve(max_dets);
+    nms_config = PostProcessNmsDefaultConfig();
+    levels.resize(fcos_config_.strides.size());
+    cls_qthr.resize(fcos_config_.strides.size());
+  }
+};
+
+// 兼容原来的全局接口
+static FcosPostProcessCtx fcos_default_ctx(FCOS_DEFAULT_MAX_DETS);
 
 static int get_tensor_hwc_index(hbDNNTensor *tensor,
                          int *h_index,
@@ -243,455 +294,475 @@ static int get_tensor_hwc_index(hbDNNTensor *tensor,
   return 0;
 }
 
-static void fcos_nms(std::vector<Detection> &input,
+static void fcos_nms(FcosPostProcessCtx *ctx,
                float iou_threshold,
                int top_k,
-               std::vector<Detection> &result,
                bool suppress) {
-  // sort order by score desc
-  std::stable_sort(input.begin(), input.end(), std::greater<Detection>());
-
-  std::vector<bool> skip(input.size(), false);
-
-  // pre-calculate boxes area
-  std::vector<float> areas;
-  areas.reserve(input.size());
-  for (size_t i = 0; i < input.size(); i++) {
-    float width = input[i].bbox.xmax - input[i].bbox.xmin;
-    float height = input[i].bbox.ymax - input[i].bbox.ymin;
-    areas.push_back(width * height);
+  PostProcessNmsParam param;
+  param.iou_threshold = iou_threshold;
+  param.top_k = top_k;
+  param.max_input = 0;
+  param.class_agnostic = suppress;
+  param.config = ctx->nms_config;
+  PostProcessNmsDetections(ctx->nms, param, ctx->dets, ctx->results);
+}
+
+/**
+ * 准备一层输出的解码参数
+ * @param[in] index: 写到 ctx->levels[index]
+ * @param[in] layer: 输出层，决定 stride
+ * @return 0 if success
+ */
+static int fcos_prepare_level(FcosPostProcessCtx *ctx, int index, hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors,
+                              hbDNNTensor *ce_tensors, FcosPostProcessInfo_t *post_info, int layer) {
+  auto quanti_type = cls_tensors->properties.quantiType;
+  if (quanti_type != hbDNNQuantiType::SCALE && quanti_type != hbDNNQuantiType::NONE) {
+    printf("error quanti_type: %d\n", quanti_type);
+    return -1;
+  }
+  auto layout = cls_tensors->properties.tensorLayout;
+  if (layout != HB_DNN_LAYOUT_NHWC && layout != HB_DNN_LAYOUT_NCHW) {
+    printf("tensor layout error.\n");
+    return -1;
   }
 
-  int count = 0;
-  for (size_t i = 0; count < top_k && i < skip.size(); i++) {
-    if (skip[i]) {
-      continue;
-    }
-    skip[i] = true;
-    ++count;
+  FcosLevel &level = ctx->levels[index];
+  level.nchw = layout == HB_DNN_LAYOUT_NCHW;
+  level.quanti = quanti_type == hbDNNQuantiType::SCALE;
+  level.cls_data = cls_tensors->sysMem[0].virAddr;
+  level.bbox_data = bbox_tensors->sysMem[0].virAddr;
+  level.ce_data = ce_tensors->sysMem[0].virAddr;
+  level.cls_scale = cls_tensors->properties.scale.scaleData;
+  level.bbox_scale = bbox_tensors->properties.scale.scaleData;
+  level.ce_scale = ce_tensors->properties.scale.scaleData;
 
-    for (size_t j = i + 1; j < skip.size(); ++j) {
-      if (skip[j]) {
-        continue;
-      }
-      if (suppress == false) {
-        if (input[i].id != input[j].id) {
-          continue;
-        }
-      }
-
-      // intersection area
-      float xx1 = std::max(input[i].bbox.xmin, input[j].bbox.xmin);
-      float yy1 = std::max(input[i].bbox.ymin, input[j].bbox.ymin);
-      float xx2 = std::min(input[i].bbox.xmax, input[j].bbox.xmax);
-      float yy2 = std::min(input[i].bbox.ymax, input[j].bbox.ymax);
-
-      if (xx2 > xx1 && yy2 > yy1) {
-        float area_intersection = (xx2 - xx1) * (yy2 - yy1);
-        float iou_ratio =
-            area_intersection / (areas[j] + areas[i] - area_intersection);
-        if (iou_ratio > iou_threshold) {
-          skip[j] = true;
-        }
-      }
-    }
-    result.push_back(input[i]);
+  // 同一个尺度下，tensor[i],tensor[i+5],tensor[i+10]出来的hw都一致，64*64/32*32/...
+  int *shape = cls_tensors->properties.alignedShape.dimensionSize;
+  if (level.nchw) {
+    level.channels = shape[1];
+    level.height = shape[2];
+    level.row_step = shape[3];
+    // 定点输出只解码有效宽度之内的网格
+    level.width = level.quanti ? cls_tensors->properties.validShape.dimensionSize[3] : shape[3];
+    level.plane = shape[2] * shape[3];
+  } else {
+    level.height = shape[1];
+    level.row_step = shape[2];
+    level.channels = shape[3];
+    level.width = shape[2];
+    // 定点输出的 ce 和 bbox 都按 4 个通道对齐
+    level.ce_step = level.quanti ? 4 : 1;
+    level.bbox_step = 4;
   }
-}
 
-static void GetBboxAndScoresNHWC(
-    hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors,
-    FcosPostProcessInfo_t *post_info, int layer) {
   int ori_h = post_info->ori_height;
   int ori_w = post_info->ori_width;
   int input_h = post_info->height;
   int input_w = post_info->width;
-  float w_scale;
-  float h_scale;
   // preprocess action is pad and resize
   if (post_info->is_pad_resize) {
     float scale = ori_h > ori_w ? ori_h : ori_w;
-    w_scale = scale / input_w;
-    h_scale = scale / input_h;
+    level.w_scale = scale / input_w;
+    level.h_scale = scale / input_h;
   } else {
-    w_scale = static_cast<float>(ori_w) / input_w;
-    h_scale = static_cast<float>(ori_h) / input_h;
+    level.w_scale = static_cast<float>(ori_w) / input_w;
+    level.h_scale = static_cast<float>(ori_h) / input_h;
   }
+  level.stride = fcos_config_.strides[layer];
 
-  auto *cls_data = reinterpret_cast<float *>(cls_tensors->sysMem[0].virAddr);
-  auto *bbox_data =
-      reinterpret_cast<float *>(bbox_tensors->sysMem[0].virAddr);
-  auto *ce_data =
-      reinterpret_cast<float *>(ce_tensors->sysMem[0].virAddr);
-
-  // 同一个尺度下，tensor[i],tensor[i+5],tensor[i+10]出来的hw都一致，64*64/32*32/...
-  int *shape = cls_tensors->properties.alignedShape.dimensionSize;
-  int tensor_h = shape[1];
-  int tensor_w = shape[2];
-  int tensor_c = shape[3];
-  // printf("tensor_h:%d, tensor_w:%d, tensor_c:%d, \n", tensor_h, tensor_w, tensor_c);
-
-  for (int h = 0; h < tensor_h; h++) {
-    int offset = h * tensor_w;
-    for (int w = 0; w < tensor_w; w++) {
-      // get score
-      int ce_offset = offset + w;
-      ce_data[ce_offset] = 1.0 / (1.0 + exp(-ce_data[ce_offset]));
-
-      int cls_offset = ce_offset * tensor_c;
-      ScoreId tmp_score = {cls_data[cls_offset], 0};
-      for (int cls_c = 1; cls_c < tensor_c; cls_c++) {
-        int cls_index = cls_offset + cls_c;
-        if (cls_data[cls_index] > tmp_score.score) {
-          tmp_score.id = cls_c;
-          tmp_score.score = cls_data[cls_index];
-        }
-      }
-      tmp_score.score = 1.0 / (1.0 + exp(-tmp_score.score));
-      tmp_score.score = std::sqrt(tmp_score.score * ce_data[ce_offset]);
-      if (tmp_score.score <= post_info->score_threshold) continue;
-
-      // get detection box
-      Detection detection;
-      int index = 4 * (h * tensor_w + w);
-      auto &strides = fcos_config_.strides;
-
-      detection.bbox.xmin =
-          ((w + 0.5) * strides[layer] - bbox_data[index]) * w_scale;
-      detection.bbox.ymin =
-          ((h + 0.5) * strides[layer] - bbox_data[index + 1]) * h_scale;
-      detection.bbox.xmax =
-          ((w + 0.5) * strides[layer] + bbox_data[index + 2]) * w_scale;
-      detection.bbox.ymax =
-          ((h + 0.5) * strides[layer] + bbox_data[index + 3]) * h_scale;
-
-      detection.score = tmp_score.score;
-      detection.id = tmp_score.id;
-      detection.class_name = fcos_config_.class_names[detection.id].c_str();
-      fcos_dets.push_back(detection);
+  /* sqrt(sigmoid(cls) * sigmoid(ce)) <= score_threshold_  equals to
+   ** sigmoid(cls) * sigmoid(ce) <= score_threshold_^2
+   ** sigmoid(cls) 和 sigmoid(ce) 都不超过乘积，所以 cls、ce 任何一个
+   ** 在 sigmoid 之前不到 -ln(1 / score_threshold_^2 - 1) 的网格都可以直接跳过
+   */
+  float score_threshold = post_info->score_threshold;
+  level.score_thresh = score_threshold > 0 ? score_threshold * score_threshold : -1.0f;
+  level.pre_thresh = PostProcessLogitThreshold(level.score_thresh);
+
+  // 定点输出的预筛阈值换算到每个通道的定点数上，预筛不用反量化
+  if (level.quanti) {
+    std::vector<int32_t> &cls_qthr = ctx->cls_qthr[index];
+    cls_qthr.resize(level.channels);
+    for (int c = 0; c < level.channels; c++) {
+      cls_qthr[c] = PostProcessQuantiThreshold(level.pre_thresh, level.cls_scale[c]);
     }
+    level.cls_qthr = cls_qthr.data();
+    level.ce_qthr = PostProcessQuantiThreshold(level.pre_thresh, level.ce_scale[0]);
   }
+  return 0;
 }
 
-static void GetBboxAndScoresNCHW(
-    hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors,
-    FcosPostProcessInfo_t *post_info, int layer) {
-  int ori_h = post_info->ori_height;
-  int ori_w = post_info->ori_width;
-  int input_h = post_info->height;
-  int input_w = post_info->width;
-  float w_scale;
-  float h_scale;
-  // preprocess action is pad and resize
-  if (post_info->is_pad_resize) {
-    float scale = ori_h > ori_w ? ori_h : ori_w;
-    w_scale = scale / input_w;
-    h_scale = scale / input_h;
+static void fcos_add_detection(const FcosLevel &level, int h, int w, float score, int id,
+                               std::vector<Detection> &dets) {
+  int cell = h * level.row_step + w;
+  float box[4];
+  for (int k = 0; k < 4; k++) {
+    int index = level.nchw ? k * level.plane + cell : cell * level.bbox_step + k;
+    if (level.quanti) {
+      box[k] = reinterpret_cast<const int32_t *>(level.bbox_data)[index] * level.bbox_scale[k];
+    } else {
+      box[k] = reinterpret_cast<const float *>(level.bbox_data)[index];
+    }
+  }
+
+  Detection detection;
+  if (level.quanti && level.nchw) {
+    // 定点 NCHW 输出的距离以 stride 为单位
+    float xmin = std::max(0.f, box[0]);
+    float ymin = std::max(0.f, box[1]);
+    float xmax = std::max(0.f, box[2]);
+    float ymax = std::max(0.f, box[3]);
+    detection.bbox.xmin = (w + 0.5 - xmin) * level.stride * level.w_scale;
+    detection.bbox.ymin = (h + 0.5 - ymin) * level.stride * level.h_scale;
+    detection.bbox.xmax = (w + 0.5 + xmax) * level.stride * level.w_scale;
+    detection.bbox.ymax = (h + 0.5 + ymax) * level.stride * level.h_scale;
   } else {
-    w_scale = static_cast<float>(ori_w) / input_w;
-    h_scale = static_cast<float>(ori_h) / input_h;
+    detection.bbox.xmin = ((w + 0.5) * level.stride - box[0]) * level.w_scale;
+    detection.bbox.ymin = ((h + 0.5) * level.stride - box[1]) * level.h_scale;
+    detection.bbox.xmax = ((w + 0.5) * level.stride + box[2]) * level.w_scale;
+    detection.bbox.ymax = ((h + 0.5) * level.stride + box[3]) * level.h_scale;
   }
 
-  auto *cls_data = reinterpret_cast<float *>(cls_tensors->sysMem[0].virAddr);
-  auto *bbox_data =
-      reinterpret_cast<float *>(bbox_tensors->sysMem[0].virAddr);
-  auto *ce_data =
-      reinterpret_cast<float *>(ce_tensors->sysMem[0].virAddr);
+  detection.score = std::sqrt(score);
+  detection.id = id;
+  detection.class_name = fcos_config_.class_names[detection.id].c_str();
+  dets.push_back(detection);
+}
 
-  // 同一个尺度下，tensor[i],tensor[i+5],tensor[i+10]出来的hw都一致，64*64/32*32/...
-  int *shape = cls_tensors->properties.alignedShape.dimensionSize;
-  int tensor_c = shape[1];
-  int tensor_h = shape[2];
-  int tensor_w = shape[3];
-  int aligned_hw = tensor_h * tensor_w;
-
-  for (int h = 0; h < tensor_h; h++) {
-    int offset = h * tensor_w;
-    for (int w = 0; w < tensor_w; w++) {
-      // get score
-      int ce_offset = offset + w;
-      ce_data[ce_offset] = 1.0 / (1.0 + exp(-ce_data[ce_offset]));
-
-      ScoreId tmp_score = {cls_data[offset + w], 0};
-      for (int cls_c = 1; cls_c < tensor_c; cls_c++) {
-        int cls_index = cls_c * aligned_hw + offset + w;
-        if (cls_data[cls_index] > tmp_score.score) {
-          tmp_score.id = cls_c;
-          tmp_score.score = cls_data[cls_index];
+/**
+ * 一行里连续 4 个网格的打分和过滤
+ * sigmoid(cls) * sigmoid(ce) = 1 / ((1 + exp(-cls)) * (1 + exp(-ce)))，两个 sigmoid 合成一次除法
+ * @param[in] lanes: 有效的网格数，其余 lane 的 cls 必须是 -inf
+ */
+static void fcos_score_cells(const FcosLevel &level, int h, int w, int lanes, float32x4_t cls, float32x4_t ce,
+                             const int32_t *ids, std::vector<Detection> &dets) {
+  float32x4_t pre_thresh = vdupq_n_f32(level.pre_thresh);
+  uint32x4_t mask = vandq_u32(vcgtq_f32(cls, pre_thresh), vcgtq_f32(ce, pre_thresh));
+  if (vmaxvq_u32(mask) == 0) {
+    return;
+  }
+
+  float32x4_t one = vdupq_n_f32(1.0f);
+  float32x4_t denom = vmulq_f32(vaddq_f32(one, PostProcessExp4(vnegq_f32(cls))),
+                                vaddq_f32(one, PostProcessExp4(vnegq_f32(ce))));
+  float32x4_t score = vdivq_f32(one, denom);
+  mask = vandq_u32(mask, vcgtq_f32(score, vdupq_n_f32(level.score_thresh)));
+  if (vmaxvq_u32(mask) == 0) {
+    return;
+  }
+
+  uint32_t keep[4];
+  float scores[4];
+  vst1q_u32(keep, mask);
+  vst1q_f32(scores, score);
+  for (int k = 0; k < lanes; k++) {
+    if (keep[k] != 0) {
+      fcos_add_detection(level, h, w + k, scores[k], ids[k], dets);
+    }
+  }
+}
+
+// 有没有类别的定点数不小于这个类别的定点阈值
+static inline bool fcos_any_above(const int32_t *data, const int32_t *qthr, int num) {
+  int i = 0;
+  for (; i + 4 <= num; i += 4) {
+    if (vmaxvq_u32(vcgeq_s32(vld1q_s32(data + i), vld1q_s32(qthr + i))) != 0) {
+      return true;
+    }
+  }
+  for (; i < num; i++) {
+    if (data[i] >= qthr[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// NHWC：每个网格的类别连续存放，先看 ce，过了预筛的网格再求类别最大值
+static void fcos_decode_nhwc(const FcosLevel &level, int row_begin, int row_end, std::vector<Detection> &dets) {
+  const float neg_inf = -std::numeric_limits<float>::infinity();
+  for (int h = row_begin; h < row_end; h++) {
+    for (int w = 0; w < level.width; w += 4) {
+      int lanes = std::min(4, level.width - w);
+      float cls[4] = {neg_inf, neg_inf, neg_inf, neg_inf};
+      float ce[4] = {neg_inf, neg_inf, neg_inf, neg_inf};
+      int32_t ids[4] = {0, 0, 0, 0};
+      bool any = false;
+      for (int k = 0; k < lanes; k++) {
+        int cell = h * level.row_step + w + k;
+        if (level.quanti) {
+          int32_t ce_q = reinterpret_cast<const int32_t *>(level.ce_data)[cell * level.ce_step];
+          const int32_t *cls_q = reinterpret_cast<const int32_t *>(level.cls_data) + cell * level.channels;
+          if (ce_q < level.ce_qthr || !fcos_any_above(cls_q, level.cls_qthr, level.channels)) {
+            continue;
+          }
+          ce[k] = ce_q * level.ce_scale[0];
+          ids[k] = PostProcessArgmaxScale(cls_q, level.cls_scale, level.channels, &cls[k]);
+        } else {
+          float ce_value = reinterpret_cast<const float *>(level.ce_data)[cell * level.ce_step];
+          if (!(ce_value > level.pre_thresh)) {
+            continue;
+          }
+          ce[k] = ce_value;
+          const float *cls_value = reinterpret_cast<const float *>(level.cls_data) + cell * level.channels;
+          ids[k] = PostProcessArgmax(cls_value, level.channels, &cls[k]);
         }
+        any = true;
+      }
+      if (any) {
+        fcos_score_cells(level, h, w, lanes, vld1q_f32(cls), vld1q_f32(ce), ids, dets);
       }
-      tmp_score.score = 1.0 / (1.0 + exp(-tmp_score.score));
-      tmp_score.score = std::sqrt(tmp_score.score * ce_data[ce_offset]);
-      if (tmp_score.score <= post_info->score_threshold) continue;
-
-      // get detection box
-      auto &strides = fcos_config_.strides;
-      Detection detection;
-      detection.bbox.xmin =
-          ((w + 0.5) * strides[layer] - bbox_data[offset + w]) * w_scale;
-      detection.bbox.ymin =
-          ((h + 0.5) * strides[layer] - bbox_data[1 * aligned_hw + offset + w]) *
-          h_scale;
-      detection.bbox.xmax =
-          ((w + 0.5) * strides[layer] + bbox_data[2 * aligned_hw + offset + w]) *
-          w_scale;
-      detection.bbox.ymax =
-          ((h + 0.5) * strides[layer] + bbox_data[3 * aligned_hw + offset + w]) *
-          h_scale;
-
-      detection.score = tmp_score.score;
-      detection.id = tmp_score.id;
-      detection.class_name = fcos_config_.class_names[detection.id].c_str();
-      fcos_dets.push_back(detection);
     }
   }
 }
 
-void GetBboxAndScoresScaleNCHW(hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors, FcosPostProcessInfo_t *post_info, int layer) {
-  int ori_h = post_info->ori_height;
-  int ori_w = post_info->ori_width;
-  int input_h = post_info->height;
-  int input_w = post_info->width;
-  float w_scale;
-  float h_scale;
-  // preprocess action is pad and resize
-  if (post_info->is_pad_resize) {
-    float scale = ori_h > ori_w ? ori_h : ori_w;
-    w_scale = scale / input_w;
-    h_scale = scale / input_h;
+// 单个网格沿通道求类别最大值，第一个最大值的下标作为 id
+static int fcos_nchw_argmax(const FcosLevel &level, int cell, float *max_value) {
+  int id = 0;
+  float max_data;
+  if (level.quanti) {
+    const int32_t *cls_q = reinterpret_cast<const int32_t *>(level.cls_data) + cell;
+    max_data = cls_q[0] * level.cls_scale[0];
+    for (int c = 1; c < level.channels; c++) {
+      float value = cls_q[c * level.plane] * level.cls_scale[c];
+      if (value > max_data) {
+        max_data = value;
+        id = c;
+      }
+    }
   } else {
-    w_scale = static_cast<float>(ori_w) / input_w;
-    h_scale = static_cast<float>(ori_h) / input_h;
+    const float *cls_value = reinterpret_cast<const float *>(level.cls_data) + cell;
+    max_data = cls_value[0];
+    for (int c = 1; c < level.channels; c++) {
+      if (cls_value[c * level.plane] > max_data) {
+        max_data = cls_value[c * level.plane];
+        id = c;
+      }
+    }
   }
+  *max_value = max_data;
+  return id;
+}
 
-  /* sqrt(sigmoid(cls) * sigmoid(ce)) <= score_threshold_  equals to
-   ** sigmoid(cls) * sigmoid(ce) <= score_threshold_^2
-   */
-  float score_thresh = post_info->score_threshold * post_info->score_threshold;
+// NCHW：同一个通道里相邻网格连续存放，4 个网格一组沿通道求最大值
+static void fcos_decode_nchw(const FcosLevel &level, int row_begin, int row_end, std::vector<Detection> &dets) {
+  const float neg_inf = -std::numeric_limits<float>::infinity();
+  float32x4_t pre_thresh = vdupq_n_f32(level.pre_thresh);
+  for (int h = row_begin; h < row_end; h++) {
+    int w = 0;
+    for (; w + 4 <= level.width; w += 4) {
+      int cell = h * level.row_step + w;
+      float32x4_t ce;
+      float32x4_t cls_max;
+      uint32x4_t cls_id = vdupq_n_u32(0);
+      if (level.quanti) {
+        int32x4_t ce_q = vld1q_s32(reinterpret_cast<const int32_t *>(level.ce_data) + cell);
+        if (vmaxvq_u32(vcgeq_s32(ce_q, vdupq_n_s32(level.ce_qthr))) == 0) {
+          continue;
+        }
+        ce = vmulq_f32(vcvtq_f32_s32(ce_q), vdupq_n_f32(level.ce_scale[0]));
+
+        const int32_t *cls_q = reinterpret_cast<const int32_t *>(level.cls_data) + cell;
+        cls_max = vmulq_f32(vcvtq_f32_s32(vld1q_s32(cls_q)), vdupq_n_f32(level.cls_scale[0]));
+        for (int c = 1; c < level.channels; c++) {
+          float32x4_t value = vmulq_f32(vcvtq_f32_s32(vld1q_s32(cls_q + c * level.plane)),
+                                        vdupq_n_f32(level.cls_scale[c]));
+          uint32x4_t greater = vcgtq_f32(value, cls_max);
+          cls_max = vbslq_f32(greater, value, cls_max);
+          cls_id = vbslq_u32(greater, vdupq_n_u32(c), cls_id);
+        }
+      } else {
+        ce = vld1q_f32(reinterpret_cast<const float *>(level.ce_data) + cell);
+        if (vmaxvq_u32(vcgtq_f32(ce, pre_thresh)) == 0) {
+          continue;
+        }
 
-  /* if cls <= -ln( 1 / score_threshold_^2 -1), then
-  ** 1 + exp(-cls) >= 1 / score_threshold_^2, then
-  ** sigmoid(cls) <= score_threshold_^2, then
-  ** sigmoid(cls) * sigmoid(ce) <= score_threshold_^2
-  ** use pre_thresh to pre-filter data for ce and cls data
-  */
-  float pre_thresh = -log(1 / score_thresh - 1);
+        const float *cls_value = reinterpret_cast<const float *>(level.cls_data) + cell;
+        cls_max = vld1q_f32(cls_value);
+        for (int c = 1; c < level.channels; c++) {
+          float32x4_t value = vld1q_f32(cls_value + c * level.plane);
+          uint32x4_t greater = vcgtq_f32(value, cls_max);
+          cls_max = vbslq_f32(greater, value, cls_max);
+          cls_id = vbslq_u32(greater, vdupq_n_u32(c), cls_id);
+        }
+      }
 
-  auto *cls_data = reinterpret_cast<int32_t *>(cls_tensors->sysMem[0].virAddr);
-  float *de_cls = cls_tensors->properties.scale.scaleData;
+      int32_t ids[4];
+      vst1q_s32(ids, vreinterpretq_s32_u32(cls_id));
+      fcos_score_cells(level, h, w, 4, cls_max, ce, ids, dets);
+    }
 
-  auto *bbox_data =
-      reinterpret_cast<int32_t *>(bbox_tensors->sysMem[0].virAddr);
-  float *de_bbox = bbox_tensors->properties.scale.scaleData;
+    // 每行最后不够 4 个的网格
+    for (; w < level.width; w++) {
+      int cell = h * level.row_step + w;
+      float ce_value;
+      if (level.quanti) {
+        int32_t ce_q = reinterpret_cast<const int32_t *>(level.ce_data)[cell];
+        if (ce_q < level.ce_qthr) {
+          continue;
+        }
+        ce_value = ce_q * level.ce_scale[0];
+      } else {
+        ce_value = reinterpret_cast<const float *>(level.ce_data)[cell];
+      }
+      if (!(ce_value > level.pre_thresh)) {
+        continue;
+      }
 
-  auto *ce_data =
-      reinterpret_cast<int32_t *>(ce_tensors->sysMem[0].virAddr);
-  float *de_ce = ce_tensors->properties.scale.scaleData;
+      float cls_value;
+      int32_t ids[4] = {0, 0, 0, 0};
+      ids[0] = fcos_nchw_argmax(level, cell, &cls_value);
+      float32x4_t cls = vsetq_lane_f32(cls_value, vdupq_n_f32(neg_inf), 0);
+      fcos_score_cells(level, h, w, 1, cls, vdupq_n_f32(ce_value), ids, dets);
+    }
+  }
+}
 
-  int *shape = cls_tensors->properties.alignedShape.dimensionSize;
-  int tensor_c = shape[1];
-  int tensor_h = shape[2];
-  int tensor_w = shape[3];
-  int tensor_vw = cls_tensors->properties.validShape.dimensionSize[3];
-  int aligned_hw = tensor_h * tensor_w;
-
-  ScoreId tmp;
-
-  tmp.score = pre_thresh;
-  tmp.id = -1;
-  // mask score stored the max score and id in 80 classes for every pixels
-  std::vector<std::vector<ScoreId>> mask_score(
-      tensor_h, std::vector<ScoreId>(tensor_w, tmp));
-
-  for (int c = 0; c < tensor_c; c++) {
-    int offset_c = c * aligned_hw;
-    for (int h = 0; h < tensor_h; h++) {
-      int ce_offset_h = h * tensor_w;
-      int offset_h = offset_c + ce_offset_h;
-      for (int w = 0; w < tensor_vw; w++) {
-        int score_offset = offset_h + w;
-        float tmp_score = cls_data[score_offset] * de_cls[c];
-        if (tmp_score <= mask_score[h][w].score) continue;
-        mask_score[h][w].score = tmp_score;
-        mask_score[h][w].id = c;
+/**
+ * 解码 ctx->levels 的前 level_num 层
+ * 各层的行首尾相接，按网格数连续地分给各个线程，小层不会单独占一个线程；
+ * 每个线程的结果按编号顺序合并，检测框的顺序和逐层单线程解码一致
+ */
+static void fcos_decode_levels(FcosPostProcessCtx *ctx, int level_num) {
+  const std::vector<FcosLevel> &levels = ctx->levels;
+  int total_rows = 0;
+  int total_cells = 0;
+  for (int i = 0; i < level_num; i++) {
+    total_rows += levels[i].height;
+    total_cells += levels[i].height * levels[i].width;
+  }
+  int thread_num = total_cells >= FCOS_PARALLEL_CELLS ? PostProcessThreadNum(ctx->threads, total_rows) : 1;
+
+  // worker i 解码 [bounds[i], bounds[i + 1]) 这些行
+  int bounds[POST_PROCESS_MAX_THREADS + 1];
+  int worker = 1;
+  int row = 0;
+  int cells = 0;
+  bounds[0] = 0;
+  for (int i = 0; i < level_num; i++) {
+    for (int h = 0; h < levels[i].height; h++) {
+      row++;
+      cells += levels[i].width;
+      while (worker < thread_num && static_cast<int64_t>(cells) * thread_num >=
+                                        static_cast<int64_t>(total_cells) * worker) {
+        bounds[worker++] = row;
       }
     }
   }
+  for (; worker <= thread_num; worker++) {
+    bounds[worker] = total_rows;
+  }
 
-  auto &strides = fcos_config_.strides;
-
-  for (int h = 0; h < tensor_h; h++) {
-    int ce_offset_h = h * tensor_w;
-    for (int w = 0; w < tensor_w; w++) {
-      // if cls <= -ln( 1 / score_threshold_^2 -1)
-      if (mask_score[h][w].score <= pre_thresh) continue;
-      int offset = ce_offset_h + w;
-      float tmp_ce = ce_data[offset] * de_ce[0];
-      if (tmp_ce <= pre_thresh) continue;
-      float ce = 1.0 / (1.0 + exp(-tmp_ce));
-      float tmp_score = 1.0 / (1.0 + exp(-mask_score[h][w].score));
-      // sigmoid(ce) * sigmoid(cls)
-      tmp_score = tmp_score * ce;
-      if (tmp_score <= score_thresh) {
-        continue;
+  ctx->workers.Run(thread_num, [&](int worker) {
+    std::vector<Detection> &dets = worker == 0 ? ctx->dets : ctx->worker_dets[worker];
+    int level_row = 0;
+    for (int l = 0; l < level_num; l++) {
+      const FcosLevel &level = levels[l];
+      int row_begin = std::max(bounds[worker] - level_row, 0);
+      int row_end = std::min(bounds[worker + 1] - level_row, level.height);
+      if (row_begin < row_end) {
+        if (level.nchw) {
+          fcos_decode_nchw(level, row_begin, row_end, dets);
+        } else {
+          fcos_decode_nhwc(level, row_begin, row_end, dets);
+        }
       }
-
-      float xmin = std::max(0.f, bbox_data[offset] * de_bbox[0]);
-      float ymin = std::max(0.f, bbox_data[offset + aligned_hw] * de_bbox[1]);
-      float xmax =
-          std::max(0.f, bbox_data[offset + 2 * aligned_hw] * de_bbox[2]);
-      float ymax =
-          std::max(0.f, bbox_data[offset + 3 * aligned_hw] * de_bbox[3]);
-
-      Detection detection;
-      detection.bbox.xmin = (w + 0.5 - xmin) * strides[layer] * w_scale;
-      detection.bbox.ymin = (h + 0.5 - ymin) * strides[layer] * h_scale;
-      detection.bbox.xmax = (w + 0.5 + xmax) * strides[layer] * w_scale;
-      detection.bbox.ymax = (h + 0.5 + ymax) * strides[layer] * h_scale;
-
-      detection.score = std::sqrt(tmp_score);
-      detection.id = mask_score[h][w].id;
-      detection.class_name = fcos_config_.class_names[detection.id].c_str();
-      fcos_dets.push_back(detection);
+      level_row += level.height;
     }
+  });
+
+  // 按 worker 顺序合并，检测框的顺序和单线程一致
+  for (int i = 1; i < thread_num; i++) {
+    ctx->dets.insert(ctx->dets.end(), ctx->worker_dets[i].begin(), ctx->worker_dets[i].end());
+    ctx->worker_dets[i].clear();
   }
 }
 
-void GetBboxAndScoresScaleNHWC(hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors, FcosPostProcessInfo_t *post_info, int layer) {
-  int ori_h = post_info->ori_height;
-  int ori_w = post_info->ori_width;
-  int input_h = post_info->height;
-  int input_w = post_info->width;
-  float w_scale;
-  float h_scale;
-  // preprocess action is pad and resize
-  if (post_info->is_pad_resize) {
-    float scale = ori_h > ori_w ? ori_h : ori_w;
-    w_scale = scale / input_w;
-    h_scale = scale / input_h;
-  } else {
-    w_scale = static_cast<float>(ori_w) / input_w;
-    h_scale = static_cast<float>(ori_h) / input_h;
+void FcosCtxDoProcess(FcosPostProcessCtx_t *ctx, hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors, FcosPostProcessInfo_t *post_info, int layer) {
+  if (fcos_prepare_level(ctx, 0, cls_tensors, bbox_tensors, ce_tensors, post_info, layer) != 0) {
+    return;
   }
+  fcos_decode_levels(ctx, 1);
+}
 
-  auto *cls_data = reinterpret_cast<int32_t *>(cls_tensors->sysMem[0].virAddr);
-  auto *bbox_data =
-      reinterpret_cast<int32_t *>(bbox_tensors->sysMem[0].virAddr);
-  auto *ce_data =
-      reinterpret_cast<int32_t *>(ce_tensors->sysMem[0].virAddr);
-  float *cls_scale = cls_tensors->properties.scale.scaleData;
-  float *bbox_scale = bbox_tensors->properties.scale.scaleData;
-  float *ce_scale = ce_tensors->properties.scale.scaleData;
-
-  // 同一个尺度下，tensor[i],tensor[i+5],tensor[i+10]出来的hw都一致，64*64/32*32/...
-  int *shape = cls_tensors->properties.alignedShape.dimensionSize;
-  int tensor_h = shape[1];
-  int tensor_w = shape[2];
-  int tensor_c = shape[3];
-  int32_t bbox_c_stride=4;//{bbox_tensors->properties.alignedShape.dimensionSize[3]};
-  int32_t ce_c_stride=4;//{ce_tensors->properties.alignedShape.dimensionSize[3]};
-
-  for (int h = 0; h < tensor_h; h++) {
-    for (int w = 0; w < tensor_w; w++) {
-      // get score
-      int ce_offset = (h * tensor_w + w) * ce_c_stride;
-      float ce_data_offset =
-          1.0 / (1.0 + exp(-ce_data[ce_offset] * ce_scale[0]));
-
-      int cls_offset = (h * tensor_w + w) * tensor_c;
-      ScoreId tmp_score = {cls_data[cls_offset] * cls_scale[0], 0};
-      for (int cls_c = 1; cls_c < tensor_c; cls_c++) {
-        int cls_index = cls_offset + cls_c;
-        float score = cls_data[cls_index] * cls_scale[cls_c];
-        if (score > tmp_score.score) {
-          tmp_score.id = cls_c;
-          tmp_score.score = score;
-        }
-      }
-      tmp_score.score = 1.0 / (1.0 + exp(-tmp_score.score));
-      tmp_score.score = std::sqrt(tmp_score.score * ce_data_offset);
-      if (tmp_score.score <= post_info->score_threshold) continue;
-
-      // get detection box
-      Detection detection;
-      int index = bbox_c_stride * (h * tensor_w + w);
-      auto &strides = fcos_config_.strides;
-
-      detection.bbox.xmin =
-          ((w + 0.5) * strides[layer] - (bbox_data[index] * bbox_scale[0])) *
-          w_scale;
-      detection.bbox.ymin =
-          ((h + 0.5) * strides[layer] - (bbox_data[index + 1] * bbox_scale[1])) *
-          h_scale;
-      detection.bbox.xmax =
-          ((w + 0.5) * strides[layer] + (bbox_data[index + 2] * bbox_scale[2])) *
-          w_scale;
-      detection.bbox.ymax =
-          ((h + 0.5) * strides[layer] + (bbox_data[index + 3] * bbox_scale[3])) *
-          h_scale;
-
-      detection.score = tmp_score.score;
-      detection.id = tmp_score.id;
-      detection.class_name = fcos_config_.class_names[detection.id].c_str();
-      fcos_dets.push_back(detection);
+void FcosCtxDoProcessLevels(FcosPostProcessCtx_t *ctx, hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors, FcosPostProcessInfo_t *post_info, int layer_num) {
+  layer_num = std::min(layer_num, static_cast<int>(fcos_config_.strides.size()));
+  for (int i = 0; i < layer_num; i++) {
+    if (fcos_prepare_level(ctx, i, cls_tensors + i, bbox_tensors + i, ce_tensors + i, post_info, i) != 0) {
+      return;
     }
   }
+  fcos_decode_levels(ctx, layer_num);
 }
 
-void FcosdoProcess(hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors, FcosPostProcessInfo_t *post_info, int layer) {
+char* FcosCtxPostProcess(FcosPostProcessCtx_t *ctx, FcosPostProcessInfo_t *post_info) {
 
-  auto quanti_type = cls_tensors->properties.quantiType;
+  std::vector<Detection> &fcos_det_restuls = ctx->results;
 
-  if (quanti_type == hbDNNQuantiType::SCALE) {
-      if (cls_tensors->properties.tensorLayout == HB_DNN_LAYOUT_NHWC) {
-        GetBboxAndScoresScaleNHWC(cls_tensors, bbox_tensors, ce_tensors, post_info, layer);
-      } else if (cls_tensors->properties.tensorLayout == HB_DNN_LAYOUT_NCHW) {
-        GetBboxAndScoresScaleNCHW(cls_tensors, bbox_tensors, ce_tensors, post_info, layer);
-      } else {
-        printf("tensor layout error.\n");
-      }
-    } else if (quanti_type == hbDNNQuantiType::NONE) {
-      if (cls_tensors->properties.tensorLayout == HB_DNN_LAYOUT_NHWC) {
-        GetBboxAndScoresNHWC(cls_tensors, bbox_tensors, ce_tensors, post_info, layer);
-      } else if (cls_tensors->properties.tensorLayout == HB_DNN_LAYOUT_NCHW) {
-        GetBboxAndScoresNCHW(cls_tensors, bbox_tensors, ce_tensors, post_info, layer);
-      } else {
-        printf("tensor layout error.\n");
-      }
-    } else {
-      printf("error quanti_type: %d\n", quanti_type);
+  // 计算交并比来合并检测框，传入交并比阈值和返回box数量
+  fcos_nms(ctx, post_info->nms_threshold, post_info->nms_top_k, false);
+
+  // 算法结果转换成json格式
+  PostProcessJson &json = ctx->json;
+  json.Reset();
+  json.Raw("\"fcos_result\": [");
+  for (size_t i = 0; i < fcos_det_restuls.size(); i++) {
+    const Detection &det = fcos_det_restuls[i];
+    if (i > 0) {
+      json.Raw(",");
     }
+    json.Detection(det.bbox.xmin, det.bbox.ymin, det.bbox.xmax, det.bbox.ymax,
+                   det.score, det.id, fcos_config_.class_names[det.id].c_str());
+  }
+  json.Raw("]");
+
+  ctx->dets.clear();
+  fcos_det_restuls.clear();
+  return json.Dup();
+}
+
+int FcosCtxGetBoxes(FcosPostProcessCtx_t *ctx, FcosPostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes) {
 
+  fcos_nms(ctx, post_info->nms_threshold, post_info->nms_top_k, false);
+  int count = PostProcessPackBoxes(ctx->results, boxes, max_boxes);
+
+  ctx->dets.clear();
+  ctx->results.clear();
+  return count;
 }
 
-char* FcosPostProcess(FcosPostProcessInfo_t *post_info) {
+FcosPostProcessCtx_t *FcosPostProcessCreate(int max_dets) {
+  if (max_dets <= 0) {
+    max_dets = FCOS_DEFAULT_MAX_DETS;
+  }
+  return new (std::nothrow) FcosPostProcessCtx(max_dets);
+}
 
-  int i = 0;
-  char *str_dets;
+void FcosPostProcessDestroy(FcosPostProcessCtx_t *ctx) {
+  delete ctx;
+}
 
-  std::vector<Detection> fcos_det_restuls;
-  // 计算交并比来合并检测框，传入交并比阈值和返回box数量
-  fcos_nms(fcos_dets, post_info->nms_threshold, post_info->nms_top_k, fcos_det_restuls, false);
+void FcosPostProcessSetNms(FcosPostProcessCtx_t *ctx, const PostProcessNmsConfig_t *config) {
+  ctx->nms_config = config != NULL ? *config : PostProcessNmsDefaultConfig();
+}
 
-  std::stringstream out_string;
+void FcosPostProcessSetThreads(FcosPostProcessCtx_t *ctx, int threads) {
+  ctx->threads = threads;
+}
 
-  // 算法结果转换成json格式
-  out_string << "\"fcos_result\": [";
-  for (i = 0; i < fcos_det_restuls.size(); i++) {
-  	auto det_ret = fcos_det_restuls[i];
-  	out_string << det_ret;
-  	if (i < fcos_det_restuls.size() - 1)
-		out_string << ",";
-  }
-  out_string << "]" << std::endl;
+void FcosdoProcess(hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors, FcosPostProcessInfo_t *post_info, int layer) {
+  FcosCtxDoProcess(&fcos_default_ctx, cls_tensors, bbox_tensors, ce_tensors, post_info, layer);
+}
 
-  str_dets = (char *)malloc(out_string.str().length() + 1);
-  str_dets[out_string.str().length()] = '\0';
-  snprintf(str_dets, out_string.str().length(), "%s", out_string.str().c_str());
-  /*printf("str_dets: %s\n", str_dets);*/
+void FcosdoProcessLevels(hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors, FcosPostProcessInfo_t *post_info, int layer_num) {
+  FcosCtxDoProcessLevels(&fcos_default_ctx, cls_tensors, bbox_tensors, ce_tensors, post_info, layer_num);
+}
 
-  fcos_dets.clear();
-  fcos_det_restuls.clear();
-  return str_dets;
+char* FcosPostProcess(FcosPostProcessInfo_t *post_info) {
+  return FcosCtxPostProcess(&fcos_default_ctx, post_info);
+}
+
+int FcosPostProcessBoxes(FcosPostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes) {
+  return FcosCtxGetBoxes(&fcos_default_ctx, post_info, boxes, max_boxes);
 }
 
@@ -10,6 +10,8 @@
 #define _POST_PROCESS_FCOS_POST_PROCESS_H_
 
 #include "dnn/hb_dnn.h"
+#include "post_process_output.h"
+#include "post_process_nms.h"
 
 #ifdef __cplusplus
   extern "C"{
@@ -38,6 +40,51 @@ typedef struct {
 
   void FcosdoProcess(hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors, FcosPostProcessInfo_t *post_info, int layer) ;
 
+  // 后处理上下文：每个上下文独立保存一路模型输出的检测结果，内部缓存逐帧复用。
+  // 同一个上下文同一时间只能在一个线程里使用，不同上下文可以并行处理。
+  // 上面两个不带上下文的接口共用一个内部的默认上下文。
+  typedef struct FcosPostProcessCtx FcosPostProcessCtx_t;
+
+  /**
+   * 创建后处理上下文
+   * @param[in] max_dets: 预分配的检测框数量，<= 0 时使用默认值
+   * @return 上下文句柄，失败返回 NULL
+   */
+  FcosPostProcessCtx_t *FcosPostProcessCreate(int max_dets);
+
+  void FcosPostProcessDestroy(FcosPostProcessCtx_t *ctx);
+
+  void FcosCtxDoProcess(FcosPostProcessCtx_t *ctx, hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors, FcosPostProcessInfo_t *post_info, int layer);
+
+  /**
+   * 一次解码所有层的输出，各层的行按网格数分给多个线程，结果和逐层调用 FcosCtxDoProcess 一致
+   * @param[in] cls_tensors: 各层的类别输出，cls_tensors[i] 是第 i 层，bbox_tensors、ce_tensors 同理
+   * @param[in] layer_num: 层数，超过模型的层数时只取前面的层
+   */
+  void FcosCtxDoProcessLevels(FcosPostProcessCtx_t *ctx, hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors, FcosPostProcessInfo_t *post_info, int layer_num);
+
+  // 使用默认上下文，代替逐层调用 FcosdoProcess
+  void FcosdoProcessLevels(hbDNNTensor *cls_tensors, hbDNNTensor *bbox_tensors, hbDNNTensor *ce_tensors, FcosPostProcessInfo_t *post_info, int layer_num);
+
+  char* FcosCtxPostProcess(FcosPostProcessCtx_t *ctx, FcosPostProcessInfo_t *post_info);
+
+  /**
+   * 把结果写到调用者提供的数组里，不生成 json 字符串
+   * @param[out] boxes: 结果数组，按分数从高到低排列
+   * @param[in] max_boxes: 数组长度，超出的结果被丢弃
+   * @return 写入的结果个数
+   */
+  int FcosCtxGetBoxes(FcosPostProcessCtx_t *ctx, FcosPostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes);
+
+  // 使用默认上下文，和 FcosdoProcess 配合使用
+  int FcosPostProcessBoxes(FcosPostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes);
+
+  // 设置检测框去重的方法，默认贪心 NMS；config 为 NULL 时恢复默认
+  void FcosPostProcessSetNms(FcosPostProcessCtx_t *ctx, const PostProcessNmsConfig_t *config);
+
+  // 设置解码使用的线程数，<= 0 时按 CPU 核数；所有层的网格加起来较少时始终单线程
+  void FcosPostProcessSetThreads(FcosPostProcessCtx_t *ctx, int threads);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,49 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#include "post_process_anchors.h"
+
+typedef std::tuple<std::string, int, int, int> AnchorKey;
+
+// 全局的 anchor 缓存，表只增不删，已经返回出去的指针一直有效
+static std::mutex anchors_mutex;
+static std::map<AnchorKey, std::unique_ptr<PostProcessAnchors>> anchors_cache;
+
+const PostProcessAnchors *PostProcessGetAnchors(const char *model,
+                                                int layer,
+                                                int feat_height,
+                                                int feat_width,
+                                                PostProcessAnchorBuilder builder) {
+  AnchorKey key(model, layer, feat_height, feat_width);
+
+  std::lock_guard<std::mutex> lock(anchors_mutex);
+  auto iter = anchors_cache.find(key);
+  if (iter != anchors_cache.end()) {
+    return iter->second.get();
+  }
+
+  std::unique_ptr<PostProcessAnchors> anchors(new PostProcessAnchors());
+  anchors->layer = layer;
+  anchors->feat_height = feat_height;
+  anchors->feat_width = feat_width;
+  builder(layer, feat_height, feat_width, anchors.get());
+  anchors->cx.shrink_to_fit();
+  anchors->cy.shrink_to_fit();
+  anchors->w.shrink_to_fit();
+  anchors->h.shrink_to_fit();
+
+  const PostProcessAnchors *result = anchors.get();
+  anchors_cache.emplace(key, std::move(anchors));
+  return result;
+}
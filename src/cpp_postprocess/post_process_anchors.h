@@ -0,0 +1,67 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#ifndef _POST_PROCESS_POST_PROCESS_ANCHORS_H_
+#define _POST_PROCESS_POST_PROCESS_ANCHORS_H_
+
+#include <vector>
+
+// 一层输出的 anchor 表，按 structure-of-arrays 存放，
+// 第 i 个 anchor 的中心和宽高是 cx[i], cy[i], w[i], h[i]，可以直接按 4 个一组加载
+// 构建完成之后只读，多个线程可以同时使用
+struct PostProcessAnchors {
+  int layer;
+  int feat_height;
+  int feat_width;
+  std::vector<float> cx;
+  std::vector<float> cy;
+  std::vector<float> w;
+  std::vector<float> h;
+
+  int Size() const { return static_cast<int>(cx.size()); }
+
+  void Add(float c_x, float c_y, float width, float height) {
+    cx.push_back(c_x);
+    cy.push_back(c_y);
+    w.push_back(width);
+    h.push_back(height);
+  }
+};
+
+// 按模型配置生成一层的 anchor，只在第一次用到时调用
+typedef void (*PostProcessAnchorBuilder)(int layer, int feat_height, int feat_width,
+                                         PostProcessAnchors *anchors);
+
+/**
+ * 取出 (model, layer, feat_height, feat_width) 对应的 anchor 表
+ * 第一次取的时候加锁调用 builder 生成，之后返回同一份缓存，进程退出之前一直有效，
+ * 输入尺寸不变时不会再分配内存
+ * @param[in] model: 模型配置的名字，同一个名字必须对应同一个 builder
+ * @return anchor 表，不会返回 NULL
+ */
+const PostProcessAnchors *PostProcessGetAnchors(const char *model,
+                                                int layer,
+                                                int feat_height,
+                                                int feat_width,
+                                                PostProcessAnchorBuilder builder);
+
+// 上下文里缓存的 anchor 表和当前输出尺寸一致时直接使用，否则到全局缓存里取
+inline const PostProcessAnchors *PostProcessLayerAnchors(const PostProcessAnchors *&cached,
+                                                         const char *model,
+                                                         int layer,
+                                                         int feat_height,
+                                                         int feat_width,
+                                                         PostProcessAnchorBuilder builder) {
+  if (cached == nullptr || cached->feat_height != feat_height ||
+      cached->feat_width != feat_width) {
+    cached = PostProcessGetAnchors(model, layer, feat_height, feat_width, builder);
+  }
+  return cached;
+}
+
+#endif  // _POST_PROCESS_POST_PROCESS_ANCHORS_H_
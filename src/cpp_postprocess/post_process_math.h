@@ -0,0 +1,239 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#ifndef _POST_PROCESS_POST_PROCESS_MATH_H_
+#define _POST_PROCESS_POST_PROCESS_MATH_H_
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// 板端（aarch64）用 NEON；其他平台上是逐个计算的标量实现，公式相同，
+// 用于在主机上编译后处理的单元测试
+
+// 阈值换算到 logit 上时留的余量，抵消近似 sigmoid 和浮点舍入的误差，
+// 只会让预筛多放过一点点，不会误删
+#define POST_PROCESS_LOGIT_MARGIN 1e-3f
+
+/**
+ * exp 的近似实现（Cephes expf 的多项式）
+ * 输入限制在 [-87, 88] 之内，在这个范围里相对误差小于 2e-7，
+ * 超出范围的输入按边界值计算，对 sigmoid 来说已经饱和
+ */
+static inline float PostProcessExp(float x) {
+  x = std::min(std::max(x, -87.0f), 88.0f);
+
+  float fx = 0.5f + x * 1.44269504088896341f;
+  float n = static_cast<float>(static_cast<int32_t>(fx));
+  if (n > fx) {
+    n -= 1.0f;
+  }
+
+  x = x + n * -0.693359375f;
+  x = x + n * 2.12194440e-4f;
+
+  float y = 1.9875691500e-4f;
+  y = 1.3981999507e-3f + y * x;
+  y = 8.3334519073e-3f + y * x;
+  y = 4.1665795894e-2f + y * x;
+  y = 1.6666665459e-1f + y * x;
+  y = 5.0000001201e-1f + y * x;
+  y = (x + 1.0f) + y * (x * x);
+
+  int32_t pow2n_bits = (static_cast<int32_t>(n) + 127) << 23;
+  float pow2n;
+  memcpy(&pow2n, &pow2n_bits, sizeof(pow2n));
+  return y * pow2n;
+}
+
+#if defined(__ARM_NEON)
+// PostProcessExp 的 NEON 版本，4 个数一起算
+static inline float32x4_t PostProcessExp4(float32x4_t x) {
+  x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-87.0f)), vdupq_n_f32(88.0f));
+
+  // x = n * ln2 + r，n = floor(x / ln2 + 0.5)
+  float32x4_t fx = vmlaq_f32(vdupq_n_f32(0.5f), x, vdupq_n_f32(1.44269504088896341f));
+  float32x4_t n = vcvtq_f32_s32(vcvtq_s32_f32(fx));
+  uint32x4_t over = vcgtq_f32(n, fx);
+  n = vsubq_f32(n, vreinterpretq_f32_u32(vandq_u32(over, vreinterpretq_u32_f32(vdupq_n_f32(1.0f)))));
+
+  // ln2 拆成两部分，减少 r 的舍入误差
+  x = vmlaq_f32(x, n, vdupq_n_f32(-0.693359375f));
+  x = vmlaq_f32(x, n, vdupq_n_f32(2.12194440e-4f));
+
+  float32x4_t y = vdupq_n_f32(1.9875691500e-4f);
+  y = vmlaq_f32(vdupq_n_f32(1.3981999507e-3f), y, x);
+  y = vmlaq_f32(vdupq_n_f32(8.3334519073e-3f), y, x);
+  y = vmlaq_f32(vdupq_n_f32(4.1665795894e-2f), y, x);
+  y = vmlaq_f32(vdupq_n_f32(1.6666665459e-1f), y, x);
+  y = vmlaq_f32(vdupq_n_f32(5.0000001201e-1f), y, x);
+  y = vmlaq_f32(vaddq_f32(x, vdupq_n_f32(1.0f)), y, vmulq_f32(x, x));
+
+  // 2^n 直接拼出浮点数的指数位
+  int32x4_t pow2n = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23);
+  return vmulq_f32(y, vreinterpretq_f32_s32(pow2n));
+}
+
+// 1 / (1 + exp(-x))，4 个数一起算
+static inline float32x4_t PostProcessSigmoid4(float32x4_t x) {
+  float32x4_t e = PostProcessExp4(vnegq_f32(x));
+  return vdivq_f32(vdupq_n_f32(1.0f), vaddq_f32(vdupq_n_f32(1.0f), e));
+}
+
+static inline float PostProcessSigmoid(float x) {
+  return vgetq_lane_f32(PostProcessSigmoid4(vdupq_n_f32(x)), 0);
+}
+#else
+static inline float PostProcessSigmoid(float x) {
+  return 1.0f / (1.0f + PostProcessExp(-x));
+}
+#endif
+
+// 一个框的 4 个值（x, y, w, h）一起算 exp / sigmoid，in 和 out 可以相同
+static inline void PostProcessExpBox(const float *in, float *out) {
+#if defined(__ARM_NEON)
+  vst1q_f32(out, PostProcessExp4(vld1q_f32(in)));
+#else
+  for (int i = 0; i < 4; i++) {
+    out[i] = PostProcessExp(in[i]);
+  }
+#endif
+}
+
+static inline void PostProcessSigmoidBox(const float *in, float *out) {
+#if defined(__ARM_NEON)
+  vst1q_f32(out, PostProcessSigmoid4(vld1q_f32(in)));
+#else
+  for (int i = 0; i < 4; i++) {
+    out[i] = PostProcessSigmoid(in[i]);
+  }
+#endif
+}
+
+// 一个框的 4 个 int32 定点数按通道反量化
+static inline void PostProcessDequantiBox(const int32_t *data, const float *scale, float *out) {
+#if defined(__ARM_NEON)
+  vst1q_f32(out, vmulq_f32(vcvtq_f32_s32(vld1q_s32(data)), vld1q_f32(scale)));
+#else
+  for (int i = 0; i < 4; i++) {
+    out[i] = static_cast<float>(data[i]) * scale[i];
+  }
+#endif
+}
+
+/**
+ * sigmoid(x) >= score_threshold 对应的 x 的下界，用来在 sigmoid 之前预筛
+ * @param[in] score_threshold: sigmoid 之后的阈值
+ * @return logit 阈值，阈值不在 (0, 1) 之内时返回 -inf，表示不预筛
+ */
+static inline float PostProcessLogitThreshold(float score_threshold) {
+  if (!(score_threshold > 0.0f && score_threshold < 1.0f)) {
+    return -std::numeric_limits<float>::infinity();
+  }
+  return std::log(score_threshold / (1.0f - score_threshold)) - POST_PROCESS_LOGIT_MARGIN;
+}
+
+/**
+ * 把反量化之后的阈值换算成 int32 定点数上的阈值，q * scale < threshold 的数满足 q < 返回值
+ * scale 非正或者阈值为 -inf 时返回 INT32_MIN，表示不预筛
+ */
+static inline int32_t PostProcessQuantiThreshold(float threshold, float scale) {
+  if (!(scale > 0.0f) || std::isinf(threshold)) {
+    return std::numeric_limits<int32_t>::min();
+  }
+  double q = std::floor(static_cast<double>(threshold) / scale);
+  q = std::max(q, static_cast<double>(std::numeric_limits<int32_t>::min()));
+  q = std::min(q, static_cast<double>(std::numeric_limits<int32_t>::max()));
+  return static_cast<int32_t>(q);
+}
+
+/**
+ * 最大值第一次出现的下标，和 std::max_element 的结果一致
+ * @param[in] data: 数据
+ * @param[in] num: 个数，大于 0
+ * @param[out] max_value: 最大值
+ */
+static inline int PostProcessArgmax(const float *data, int num, float *max_value) {
+  int i = 0;
+  float max_data = data[0];
+#if defined(__ARM_NEON)
+  if (num >= 4) {
+    float32x4_t vmax = vld1q_f32(data);
+    for (i = 4; i + 4 <= num; i += 4) {
+      vmax = vmaxq_f32(vmax, vld1q_f32(data + i));
+    }
+    max_data = vmaxvq_f32(vmax);
+  }
+#endif
+  for (; i < num; i++) {
+    max_data = std::max(max_data, data[i]);
+  }
+
+  // 第二遍找下标，整块比较，命中的块里再逐个找
+  *max_value = max_data;
+  i = 0;
+#if defined(__ARM_NEON)
+  float32x4_t vmax = vdupq_n_f32(max_data);
+  for (; i + 4 <= num; i += 4) {
+    if (vmaxvq_u32(vceqq_f32(vld1q_f32(data + i), vmax)) != 0) {
+      break;
+    }
+  }
+#endif
+  for (; i < num; i++) {
+    if (data[i] == max_data) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+// 同 PostProcessArgmax，输入是 int32 定点数，按通道反量化之后比较
+static inline int PostProcessArgmaxScale(const int32_t *data, const float *scale, int num, float *max_value) {
+  int i = 0;
+  float max_data = static_cast<float>(data[0]) * scale[0];
+#if defined(__ARM_NEON)
+  if (num >= 4) {
+    float32x4_t vmax = vmulq_f32(vcvtq_f32_s32(vld1q_s32(data)), vld1q_f32(scale));
+    for (i = 4; i + 4 <= num; i += 4) {
+      float32x4_t value = vmulq_f32(vcvtq_f32_s32(vld1q_s32(data + i)), vld1q_f32(scale + i));
+      vmax = vmaxq_f32(vmax, value);
+    }
+    max_data = vmaxvq_f32(vmax);
+  }
+#endif
+  for (; i < num; i++) {
+    max_data = std::max(max_data, static_cast<float>(data[i]) * scale[i]);
+  }
+
+  *max_value = max_data;
+  i = 0;
+#if defined(__ARM_NEON)
+  float32x4_t vmax = vdupq_n_f32(max_data);
+  for (; i + 4 <= num; i += 4) {
+    float32x4_t value = vmulq_f32(vcvtq_f32_s32(vld1q_s32(data + i)), vld1q_f32(scale + i));
+    if (vmaxvq_u32(vceqq_f32(value, vmax)) != 0) {
+      break;
+    }
+  }
+#endif
+  for (; i < num; i++) {
+    if (static_cast<float>(data[i]) * scale[i] == max_data) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+#endif  // _POST_PROCESS_POST_PROCESS_MATH_H_
@@ -0,0 +1,449 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "post_process_nms.h"
+#include "post_process_math.h"
+
+// 贪心 NMS 第一次排序的候选框数，保留的框不够 top_k 个时翻倍继续
+#define NMS_MIN_CHUNK 256
+// 线性衰减时 1 - IoU 的下限，避免除 0
+#define NMS_LINEAR_EPS 1e-6f
+
+static inline int align4(int num) { return (num + 3) & ~3; }
+
+#if defined(__ARM_NEON)
+/**
+ * 一个框和连续 4 个框的 IoU
+ * 计算方法和原来各个模型里的标量 NMS 一致，保证结果逐位相同
+ * @param[out] overlap: 两个框有交集的通道
+ */
+static inline float32x4_t nms_iou4(float32x4_t xmin, float32x4_t ymin,
+                                   float32x4_t xmax, float32x4_t ymax,
+                                   float32x4_t area,
+                                   const float *wxmin, const float *wymin,
+                                   const float *wxmax, const float *wymax,
+                                   const float *warea,
+                                   uint32x4_t *overlap) {
+  float32x4_t xx1 = vmaxq_f32(xmin, vld1q_f32(wxmin));
+  float32x4_t yy1 = vmaxq_f32(ymin, vld1q_f32(wymin));
+  float32x4_t xx2 = vminq_f32(xmax, vld1q_f32(wxmax));
+  float32x4_t yy2 = vminq_f32(ymax, vld1q_f32(wymax));
+  *overlap = vandq_u32(vcgtq_f32(xx2, xx1), vcgtq_f32(yy2, yy1));
+
+  float32x4_t inter = vmulq_f32(vsubq_f32(xx2, xx1), vsubq_f32(yy2, yy1));
+  float32x4_t uni = vsubq_f32(vaddq_f32(area, vld1q_f32(warea)), inter);
+  return vdivq_f32(inter, uni);
+}
+#else
+// nms_iou4 的标量版本，一次算一个框
+static inline float nms_iou(float xmin, float ymin, float xmax, float ymax, float area,
+                            float wxmin, float wymin, float wxmax, float wymax, float warea,
+                            bool *overlap) {
+  float xx1 = std::max(xmin, wxmin);
+  float yy1 = std::max(ymin, wymin);
+  float xx2 = std::min(xmax, wxmax);
+  float yy2 = std::min(ymax, wymax);
+  *overlap = xx2 > xx1 && yy2 > yy1;
+
+  float inter = (xx2 - xx1) * (yy2 - yy1);
+  float uni = (area + warea) - inter;
+  return inter / uni;
+}
+#endif
+
+void PostProcessNms::Reserve(int num) {
+  m_xmin.reserve(num);
+  m_ymin.reserve(num);
+  m_xmax.reserve(num);
+  m_ymax.reserve(num);
+  m_score.reserve(num);
+  m_id.reserve(num);
+  m_order.reserve(num);
+  m_keep.reserve(num);
+  m_out_score.reserve(num);
+}
+
+void PostProcessNms::Reset() {
+  m_xmin.clear();
+  m_ymin.clear();
+  m_xmax.clear();
+  m_ymax.clear();
+  m_score.clear();
+  m_id.clear();
+}
+
+// 把 m_order[begin, last) 里分数最高的 end - begin 个按分数从高到低排到 [begin, end)
+void PostProcessNms::SelectTop(int begin, int end, int last) {
+  auto greater = [this](int a, int b) { return ScoreGreater(a, b); };
+  if (end < last) {
+    std::nth_element(m_order.begin() + begin, m_order.begin() + end,
+                     m_order.begin() + last, greater);
+  }
+  std::sort(m_order.begin() + begin, m_order.begin() + end, greater);
+}
+
+void PostProcessNms::PadWork(int pos) {
+  m_wxmin[pos] = 0.0f;
+  m_wymin[pos] = 0.0f;
+  m_wxmax[pos] = 0.0f;
+  m_wymax[pos] = 0.0f;
+  m_warea[pos] = 0.0f;
+  m_wscore[pos] = 0.0f;
+  m_wid[pos] = -1;
+  m_windex[pos] = -1;
+}
+
+void PostProcessNms::MoveWork(int to, int from) {
+  m_wxmin[to] = m_wxmin[from];
+  m_wymin[to] = m_wymin[from];
+  m_wxmax[to] = m_wxmax[from];
+  m_wymax[to] = m_wymax[from];
+  m_warea[to] = m_warea[from];
+  m_wscore[to] = m_wscore[from];
+  m_wid[to] = m_wid[from];
+  m_windex[to] = m_windex[from];
+}
+
+// 把 m_order 的前 count 个框拷贝到连续的 work 数组里
+void PostProcessNms::LoadWork(int count) {
+  int size = align4(count);
+  m_wxmin.resize(size);
+  m_wymin.resize(size);
+  m_wxmax.resize(size);
+  m_wymax.resize(size);
+  m_warea.resize(size);
+  m_wscore.resize(size);
+  m_wid.resize(size);
+  m_windex.resize(size);
+  for (int i = 0; i < count; i++) {
+    int c = m_order[i];
+    m_wxmin[i] = m_xmin[c];
+    m_wymin[i] = m_ymin[c];
+    m_wxmax[i] = m_xmax[c];
+    m_wymax[i] = m_ymax[c];
+    m_warea[i] = (m_xmax[c] - m_xmin[c]) * (m_ymax[c] - m_ymin[c]);
+    m_wscore[i] = m_score[c];
+    m_wid[i] = m_id[c];
+    m_windex[i] = c;
+  }
+  for (int i = count; i < size; i++) {
+    PadWork(i);
+  }
+}
+
+// 贪心 NMS：候选框按分数从高到低，和已经保留的框都不重叠才保留。
+// work 数组里放的是已经保留的框
+void PostProcessNms::RunHard(const PostProcessNmsParam &param, int limit) {
+  int top_k = param.top_k;
+  int size = align4(std::min(top_k, limit));
+  m_wxmin.assign(size, 0.0f);
+  m_wymin.assign(size, 0.0f);
+  m_wxmax.assign(size, 0.0f);
+  m_wymax.assign(size, 0.0f);
+  m_warea.assign(size, 0.0f);
+  m_wid.assign(size, -1);
+
+  // 有 max_input 限制时先把分数最高的 limit 个框挑到前面，后面只在这里面分批排序
+  if (limit < Size()) {
+    std::nth_element(m_order.begin(), m_order.begin() + limit, m_order.end(),
+                     [this](int a, int b) { return ScoreGreater(a, b); });
+  }
+
+#if defined(__ARM_NEON)
+  float32x4_t threshold = vdupq_n_f32(param.iou_threshold);
+#endif
+  int kept = 0;
+  int begin = 0;
+  int chunk = std::min(limit, std::max(NMS_MIN_CHUNK, top_k));
+  while (begin < limit && kept < top_k) {
+    int end = std::min(limit, begin + chunk);
+    SelectTop(begin, end, limit);
+
+    for (int i = begin; i < end && kept < top_k; i++) {
+      int c = m_order[i];
+      float area = (m_xmax[c] - m_xmin[c]) * (m_ymax[c] - m_ymin[c]);
+      bool suppressed = false;
+#if defined(__ARM_NEON)
+      float32x4_t xmin = vdupq_n_f32(m_xmin[c]);
+      float32x4_t ymin = vdupq_n_f32(m_ymin[c]);
+      float32x4_t xmax = vdupq_n_f32(m_xmax[c]);
+      float32x4_t ymax = vdupq_n_f32(m_ymax[c]);
+      float32x4_t varea = vdupq_n_f32(area);
+      int32x4_t id = vdupq_n_s32(m_id[c]);
+
+      for (int k = 0; k < kept; k += 4) {
+        uint32x4_t overlap;
+        float32x4_t iou = nms_iou4(xmin, ymin, xmax, ymax, varea,
+                                   &m_wxmin[k], &m_wymin[k], &m_wxmax[k], &m_wymax[k],
+                                   &m_warea[k], &overlap);
+        uint32x4_t mask = vandq_u32(overlap, vcgtq_f32(iou, threshold));
+        if (!param.class_agnostic) {
+          mask = vandq_u32(mask, vceqq_s32(id, vld1q_s32(&m_wid[k])));
+        }
+        if (vmaxvq_u32(mask) != 0) {
+          suppressed = true;
+          break;
+        }
+      }
+#else
+      for (int k = 0; k < kept; k++) {
+        bool overlap = false;
+        float iou = nms_iou(m_xmin[c], m_ymin[c], m_xmax[c], m_ymax[c], area,
+                            m_wxmin[k], m_wymin[k], m_wxmax[k], m_wymax[k], m_warea[k], &overlap);
+        if (overlap && iou > param.iou_threshold &&
+            (param.class_agnostic || m_id[c] == m_wid[k])) {
+          suppressed = true;
+          break;
+        }
+      }
+#endif
+      if (suppressed) {
+        continue;
+      }
+
+      m_wxmin[kept] = m_xmin[c];
+      m_wymin[kept] = m_ymin[c];
+      m_wxmax[kept] = m_xmax[c];
+      m_wymax[kept] = m_ymax[c];
+      m_warea[kept] = area;
+      m_wid[kept] = m_id[c];
+      m_keep.push_back(c);
+      kept++;
+    }
+
+    begin = end;
+    chunk = std::min(limit, chunk * 2);
+  }
+}
+
+// Soft-NMS：每次取出剩下的框里分数最高的一个，和它重叠的框按 IoU 衰减分数。
+// work 数组里放的是还没有取出的框，取出的框用最后一个框填上
+void PostProcessNms::RunSoft(const PostProcessNmsParam &param, int limit) {
+  SelectTop(0, limit, Size());
+  LoadWork(limit);
+
+  bool gaussian = param.config.method == POST_PROCESS_NMS_SOFT_GAUSSIAN;
+  float min_score = param.config.min_score;
+  float neg_inv_sigma = -1.0f / param.config.sigma;
+#if defined(__ARM_NEON)
+  float32x4_t vthreshold = vdupq_n_f32(param.iou_threshold);
+  float32x4_t vneg_inv_sigma = vdupq_n_f32(neg_inv_sigma);
+  float32x4_t one = vdupq_n_f32(1.0f);
+#endif
+
+  int remain = limit;
+  while (remain > 0 && static_cast<int>(m_keep.size()) < param.top_k) {
+    // 分数相同时取原来排在前面的框，保证结果稳定
+    int best = 0;
+    for (int i = 1; i < remain; i++) {
+      if (m_wscore[i] > m_wscore[best] ||
+          (m_wscore[i] == m_wscore[best] && m_windex[i] < m_windex[best])) {
+        best = i;
+      }
+    }
+    if (m_wscore[best] < min_score) {
+      break;
+    }
+
+    int c = m_windex[best];
+    m_keep.push_back(c);
+    m_out_score[c] = m_wscore[best];
+    // MoveWork 会覆盖 best 的位置，先把它的框取出来
+    float bxmin = m_wxmin[best];
+    float bymin = m_wymin[best];
+    float bxmax = m_wxmax[best];
+    float bymax = m_wymax[best];
+    float barea = m_warea[best];
+    int bid = m_wid[best];
+
+    remain--;
+    MoveWork(best, remain);
+    PadWork(remain);
+
+#if defined(__ARM_NEON)
+    float32x4_t xmin = vdupq_n_f32(bxmin);
+    float32x4_t ymin = vdupq_n_f32(bymin);
+    float32x4_t xmax = vdupq_n_f32(bxmax);
+    float32x4_t ymax = vdupq_n_f32(bymax);
+    float32x4_t area = vdupq_n_f32(barea);
+    int32x4_t id = vdupq_n_s32(bid);
+    for (int k = 0; k < remain; k += 4) {
+      uint32x4_t overlap;
+      float32x4_t iou = nms_iou4(xmin, ymin, xmax, ymax, area,
+                                 &m_wxmin[k], &m_wymin[k], &m_wxmax[k], &m_wymax[k],
+                                 &m_warea[k], &overlap);
+      if (!param.class_agnostic) {
+        overlap = vandq_u32(overlap, vceqq_s32(id, vld1q_s32(&m_wid[k])));
+      }
+      float32x4_t factor;
+      if (gaussian) {
+        factor = PostProcessExp4(vmulq_f32(vmulq_f32(iou, iou), vneg_inv_sigma));
+      } else {
+        overlap = vandq_u32(overlap, vcgtq_f32(iou, vthreshold));
+        factor = vsubq_f32(one, iou);
+      }
+      factor = vbslq_f32(overlap, factor, one);
+      vst1q_f32(&m_wscore[k], vmulq_f32(vld1q_f32(&m_wscore[k]), factor));
+    }
+#else
+    for (int k = 0; k < remain; k++) {
+      bool overlap = false;
+      float iou = nms_iou(bxmin, bymin, bxmax, bymax, barea,
+                          m_wxmin[k], m_wymin[k], m_wxmax[k], m_wymax[k], m_warea[k], &overlap);
+      if (!param.class_agnostic) {
+        overlap = overlap && bid == m_wid[k];
+      }
+      float factor;
+      if (gaussian) {
+        factor = PostProcessExp((iou * iou) * neg_inv_sigma);
+      } else {
+        overlap = overlap && iou > param.iou_threshold;
+        factor = 1.0f - iou;
+      }
+      if (overlap) {
+        m_wscore[k] *= factor;
+      }
+    }
+#endif
+
+    // 衰减之后分数过低的框直接丢掉
+    for (int i = 0; i < remain;) {
+      if (m_wscore[i] < min_score) {
+        remain--;
+        MoveWork(i, remain);
+        PadWork(remain);
+      } else {
+        i++;
+      }
+    }
+  }
+}
+
+// Matrix NMS：所有框按分数排序之后，一次算出每个框被分数更高的框压制的程度，
+// decay_j = min_i f(iou_ij) / f(max_k iou_ki)，i、k 是分数比 j、i 高的同类框
+void PostProcessNms::RunMatrix(const PostProcessNmsParam &param, int limit) {
+  SelectTop(0, limit, Size());
+  LoadWork(limit);
+
+  int size = align4(limit);
+  m_wcomp.assign(size, 0.0f);
+  m_wdecay.assign(size, 1.0f);
+
+  bool gaussian = param.config.method == POST_PROCESS_NMS_MATRIX_GAUSSIAN;
+  float inv_sigma = 1.0f / param.config.sigma;
+#if defined(__ARM_NEON)
+  float32x4_t vinv_sigma = vdupq_n_f32(inv_sigma);
+  float32x4_t one = vdupq_n_f32(1.0f);
+  float32x4_t zero = vdupq_n_f32(0.0f);
+#endif
+
+  for (int i = 0; i < limit; i++) {
+    // 第 i 个框自己被压制的程度，前面的行都已经处理过，这里是最终值
+    float comp = m_wcomp[i];
+    float comp_inv = 1.0f / std::max(1.0f - comp, NMS_LINEAR_EPS);
+#if defined(__ARM_NEON)
+    float32x4_t xmin = vdupq_n_f32(m_wxmin[i]);
+    float32x4_t ymin = vdupq_n_f32(m_wymin[i]);
+    float32x4_t xmax = vdupq_n_f32(m_wxmax[i]);
+    float32x4_t ymax = vdupq_n_f32(m_wymax[i]);
+    float32x4_t area = vdupq_n_f32(m_warea[i]);
+    int32x4_t id = vdupq_n_s32(m_wid[i]);
+    int32x4_t row = vdupq_n_s32(i);
+    float32x4_t vcomp_sq = vdupq_n_f32(comp * comp);
+    float32x4_t vcomp_inv = vdupq_n_f32(comp_inv);
+
+    for (int k = (i + 1) & ~3; k < limit; k += 4) {
+      uint32x4_t overlap;
+      float32x4_t iou = nms_iou4(xmin, ymin, xmax, ymax, area,
+                                 &m_wxmin[k], &m_wymin[k], &m_wxmax[k], &m_wymax[k],
+                                 &m_warea[k], &overlap);
+      int32x4_t col = {k, k + 1, k + 2, k + 3};
+      overlap = vandq_u32(overlap, vcgtq_s32(col, row));
+      if (!param.class_agnostic) {
+        overlap = vandq_u32(overlap, vceqq_s32(id, vld1q_s32(&m_wid[k])));
+      }
+      iou = vbslq_f32(overlap, iou, zero);
+
+      vst1q_f32(&m_wcomp[k], vmaxq_f32(vld1q_f32(&m_wcomp[k]), iou));
+      float32x4_t factor;
+      if (gaussian) {
+        factor = PostProcessExp4(vmulq_f32(vsubq_f32(vcomp_sq, vmulq_f32(iou, iou)), vinv_sigma));
+      } else {
+        factor = vmulq_f32(vsubq_f32(one, iou), vcomp_inv);
+      }
+      vst1q_f32(&m_wdecay[k], vminq_f32(vld1q_f32(&m_wdecay[k]), factor));
+    }
+#else
+    for (int k = i + 1; k < limit; k++) {
+      bool overlap = false;
+      float iou = nms_iou(m_wxmin[i], m_wymin[i], m_wxmax[i], m_wymax[i], m_warea[i],
+                          m_wxmin[k], m_wymin[k], m_wxmax[k], m_wymax[k], m_warea[k], &overlap);
+      if (!overlap || (!param.class_agnostic && m_wid[i] != m_wid[k])) {
+        iou = 0.0f;
+      }
+
+      m_wcomp[k] = std::max(m_wcomp[k], iou);
+      float factor;
+      if (gaussian) {
+        factor = PostProcessExp((comp * comp - iou * iou) * inv_sigma);
+      } else {
+        factor = (1.0f - iou) * comp_inv;
+      }
+      m_wdecay[k] = std::min(m_wdecay[k], factor);
+    }
+#endif
+  }
+
+  // 衰减之后重新按分数排序，分数相同时保持原来的顺序
+  std::vector<int> &order = m_order;
+  order.clear();
+  for (int i = 0; i < limit; i++) {
+    float score = m_wscore[i] * m_wdecay[i];
+    m_out_score[m_windex[i]] = score;
+    if (score >= param.config.min_score) {
+      order.push_back(m_windex[i]);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+    return m_out_score[a] > m_out_score[b];
+  });
+  int count = std::min(static_cast<int>(order.size()), param.top_k);
+  m_keep.assign(order.begin(), order.begin() + count);
+}
+
+const std::vector<int> &PostProcessNms::Run(const PostProcessNmsParam &param) {
+  int num = Size();
+  m_keep.clear();
+  m_out_score.assign(m_score.begin(), m_score.end());
+  m_order.resize(num);
+  std::iota(m_order.begin(), m_order.end(), 0);
+
+  int limit = param.max_input > 0 ? std::min(num, param.max_input) : num;
+  if (limit <= 0 || param.top_k <= 0) {
+    return m_keep;
+  }
+
+  switch (param.config.method) {
+    case POST_PROCESS_NMS_SOFT_LINEAR:
+    case POST_PROCESS_NMS_SOFT_GAUSSIAN:
+      RunSoft(param, limit);
+      break;
+    case POST_PROCESS_NMS_MATRIX_LINEAR:
+    case POST_PROCESS_NMS_MATRIX_GAUSSIAN:
+      RunMatrix(param, limit);
+      break;
+    default:
+      RunHard(param, limit);
+      break;
+  }
+  return m_keep;
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#ifndef _POST_PROCESS_POST_PROCESS_NMS_H_
+#define _POST_PROCESS_POST_PROCESS_NMS_H_
+
+#include <stdint.h>
+
+// 检测框去重的方法
+typedef enum {
+  POST_PROCESS_NMS_HARD = 0,            // 贪心 NMS，IoU 超过阈值的框直接丢弃，默认
+  POST_PROCESS_NMS_SOFT_LINEAR = 1,     // Soft-NMS，IoU 超过阈值的框分数乘以 (1 - IoU)
+  POST_PROCESS_NMS_SOFT_GAUSSIAN = 2,   // Soft-NMS，分数乘以 exp(-IoU^2 / sigma)
+  POST_PROCESS_NMS_MATRIX_LINEAR = 3,   // Matrix NMS，线性衰减，不使用 IoU 阈值
+  POST_PROCESS_NMS_MATRIX_GAUSSIAN = 4, // Matrix NMS，高斯衰减
+} PostProcessNmsMethod_t;
+
+typedef struct {
+  int method;      // PostProcessNmsMethod_t
+  float sigma;     // 高斯衰减的参数，默认 0.5
+  float min_score; // Soft/Matrix NMS 衰减之后分数低于这个值的框丢弃，默认 0.001
+} PostProcessNmsConfig_t;
+
+#ifdef __cplusplus
+
+#include <vector>
+
+// 一次 NMS 的参数
+struct PostProcessNmsParam {
+  float iou_threshold;
+  int top_k;           // 最多保留的框数
+  int max_input;       // 只取分数最高的这么多个框参与 NMS，<= 0 时不限制
+  bool class_agnostic; // true 时不同类别的框也互相抑制
+  PostProcessNmsConfig_t config;
+};
+
+inline PostProcessNmsConfig_t PostProcessNmsDefaultConfig() {
+  PostProcessNmsConfig_t config;
+  config.method = POST_PROCESS_NMS_HARD;
+  config.sigma = 0.5f;
+  config.min_score = 0.001f;
+  return config;
+}
+
+/**
+ * 各个检测模型共用的 NMS
+ * 候选框按 structure-of-arrays 存放，IoU 在 aarch64 上用 NEON 4 个一组计算，其他平台逐个计算。
+ * 贪心 NMS 的结果和按分数 stable_sort 之后逐个抑制完全一致，
+ * 但是只对需要的部分排序：先用 nth_element 取出分数最高的一批，保留够 top_k 个就停止。
+ * 内部缓存 Reset 之后保留容量，跨帧复用；同一个对象同一时间只能在一个线程里使用。
+ */
+class PostProcessNms {
+ public:
+  void Reserve(int num);
+  void Reset();
+
+  // 候选框的下标就是添加的顺序
+  void Add(float xmin, float ymin, float xmax, float ymax, float score, int id) {
+    m_xmin.push_back(xmin);
+    m_ymin.push_back(ymin);
+    m_xmax.push_back(xmax);
+    m_ymax.push_back(ymax);
+    m_score.push_back(score);
+    m_id.push_back(id);
+  }
+
+  int Size() const { return static_cast<int>(m_score.size()); }
+
+  /**
+   * 执行 NMS
+   * @return 保留下来的候选框下标，按输出顺序（分数从高到低）排列
+   */
+  const std::vector<int> &Run(const PostProcessNmsParam &param);
+
+  // Run 之后候选框的分数，Soft/Matrix NMS 时是衰减之后的分数
+  float Score(int index) const { return m_out_score[index]; }
+
+ private:
+  bool ScoreGreater(int a, int b) const {
+    return m_score[a] > m_score[b] || (m_score[a] == m_score[b] && a < b);
+  }
+  void SelectTop(int begin, int end, int last);
+  void RunHard(const PostProcessNmsParam &param, int limit);
+  void RunSoft(const PostProcessNmsParam &param, int limit);
+  void RunMatrix(const PostProcessNmsParam &param, int limit);
+  void LoadWork(int count);
+  void MoveWork(int to, int from);
+  void PadWork(int pos);
+
+  // 候选框
+  std::vector<float> m_xmin;
+  std::vector<float> m_ymin;
+  std::vector<float> m_xmax;
+  std::vector<float> m_ymax;
+  std::vector<float> m_score;
+  std::vector<int32_t> m_id;
+
+  std::vector<int> m_order;
+  std::vector<int> m_keep;
+  std::vector<float> m_out_score;
+
+  // 参与计算的框按顺序连续存放，长度补齐到 4 的倍数，补齐的框面积为 0，和任何框都不相交
+  std::vector<float> m_wxmin;
+  std::vector<float> m_wymin;
+  std::vector<float> m_wxmax;
+  std::vector<float> m_wymax;
+  std::vector<float> m_warea;
+  std::vector<float> m_wscore;
+  std::vector<int32_t> m_wid;
+  std::vector<int> m_windex;
+  std::vector<float> m_wcomp;
+  std::vector<float> m_wdecay;
+};
+
+/**
+ * 对检测结果做 NMS，保留下来的结果按顺序追加到 results
+ * Det 需要有 bbox.xmin/ymin/xmax/ymax、score 和 id 成员
+ */
+template <typename Det>
+void PostProcessNmsDetections(PostProcessNms &nms,
+                              const PostProcessNmsParam &param,
+                              const std::vector<Det> &dets,
+                              std::vector<Det> &results) {
+  nms.Reset();
+  for (const Det &det : dets) {
+    nms.Add(det.bbox.xmin, det.bbox.ymin, det.bbox.xmax, det.bbox.ymax, det.score, det.id);
+  }
+  const std::vector<int> &keep = nms.Run(param);
+  for (int index : keep) {
+    results.push_back(dets[index]);
+    results.back().score = nms.Score(index);
+  }
+}
+
+#endif  // __cplusplus
+
+#endif  // _POST_PROCESS_POST_PROCESS_NMS_H_
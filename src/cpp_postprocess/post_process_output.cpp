@@ -0,0 +1,105 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "post_process_output.h"
+
+#define JSON_FIXED_MAX_PRECISION 6
+// 超过这个值的数走 snprintf，保证放大后的整数部分不会溢出
+#define JSON_FIXED_MAX_VALUE 1e12
+
+static const uint64_t kPow10[JSON_FIXED_MAX_PRECISION + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000};
+
+// 把无符号整数写到 buf 的末尾，返回起始位置
+static char *format_uint(uint64_t value, char *end) {
+  char *p = end;
+  do {
+    *--p = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  return p;
+}
+
+PostProcessJson &PostProcessJson::Raw(const char *str) {
+  m_buf.append(str);
+  return *this;
+}
+
+PostProcessJson &PostProcessJson::Int(int64_t value) {
+  char buf[24];
+  char *end = buf + sizeof(buf);
+  uint64_t abs_value = value < 0 ? 0 - static_cast<uint64_t>(value)
+                                 : static_cast<uint64_t>(value);
+  char *p = format_uint(abs_value, end);
+  if (value < 0) {
+    *--p = '-';
+  }
+  m_buf.append(p, end - p);
+  return *this;
+}
+
+PostProcessJson &PostProcessJson::Fixed(float value, int precision) {
+  double v = value;
+  if (precision < 0 || precision > JSON_FIXED_MAX_PRECISION ||
+      !std::isfinite(v) || std::fabs(v) >= JSON_FIXED_MAX_VALUE) {
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "%.*f", precision, v);
+    m_buf.append(buf, len);
+    return *this;
+  }
+
+  // float 只有 24 位尾数，乘上 10^6 以内的数在 double 里是精确的，
+  // nearbyint 在默认舍入模式下是四舍六入五成双，和 printf 的舍入结果一致
+  uint64_t scaled = static_cast<uint64_t>(
+      std::nearbyint(std::fabs(v) * static_cast<double>(kPow10[precision])));
+  uint64_t int_part = scaled / kPow10[precision];
+  uint64_t frac_part = scaled % kPow10[precision];
+
+  char buf[32];
+  char *end = buf + sizeof(buf);
+  char *p = end;
+  if (precision > 0) {
+    for (int i = 0; i < precision; i++) {
+      *--p = static_cast<char>('0' + frac_part % 10);
+      frac_part /= 10;
+    }
+    *--p = '.';
+  }
+  p = format_uint(int_part, p);
+  // 和 printf 一样，-0.0 和舍入到 0 的负数都带负号
+  if (std::signbit(v)) {
+    *--p = '-';
+  }
+  m_buf.append(p, end - p);
+  return *this;
+}
+
+PostProcessJson &PostProcessJson::Detection(float xmin, float ymin,
+                                            float xmax, float ymax,
+                                            float score, int id,
+                                            const char *name) {
+  Raw("{\"bbox\":[").Fixed(xmin, 6).Raw(",").Fixed(ymin, 6).Raw(",");
+  Fixed(xmax, 6).Raw(",").Fixed(ymax, 6).Raw("],\"score\":");
+  Fixed(score, 6).Raw(",\"id\":").Int(id).Raw(",\"name\":\"");
+  return Raw(name).Raw("\"}");
+}
+
+char *PostProcessJson::Dup() const {
+  char *str = static_cast<char *>(malloc(m_buf.size() + 1));
+  if (str == nullptr) {
+    return nullptr;
+  }
+  memcpy(str, m_buf.data(), m_buf.size());
+  str[m_buf.size()] = '\0';
+  return str;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#ifndef _POST_PROCESS_POST_PROCESS_OUTPUT_H_
+#define _POST_PROCESS_POST_PROCESS_OUTPUT_H_
+
+#include <stdint.h>
+
+// 检测结果的二进制输出格式，坐标已经换算到原图上
+// 6 个 4 字节成员，没有填充，python 端可以直接按 numpy 结构体数组读取
+typedef struct {
+	float xmin;
+	float ymin;
+	float xmax;
+	float ymax;
+	float score;
+	int32_t id;
+} PostProcessBox_t;
+
+// 分类结果的二进制输出格式
+typedef struct {
+	float score;
+	int32_t id;
+} PostProcessClass_t;
+
+#ifdef __cplusplus
+
+#include <string>
+#include <vector>
+
+// 后处理结果转 json 字符串
+// 输出内容和原来 std::stringstream + std::fixed/std::setprecision 的结果逐字节一致，
+// 但是不经过 iostream，m_buf 在 Reset 之后保留容量，跨帧复用
+class PostProcessJson {
+ public:
+  void Reset() { m_buf.clear(); }
+
+  PostProcessJson &Raw(const char *str);
+  PostProcessJson &Int(int64_t value);
+  // 等价于 printf("%.*f", precision, value)
+  PostProcessJson &Fixed(float value, int precision);
+
+  // {"bbox":[xmin,ymin,xmax,ymax],"score":score,"id":id,"name":"name"}
+  PostProcessJson &Detection(float xmin, float ymin, float xmax, float ymax,
+                             float score, int id, const char *name);
+
+  // 拷贝一份 malloc 出来的字符串，由调用者 free
+  char *Dup() const;
+
+ private:
+  std::string m_buf;
+};
+
+// 把检测结果拷贝到调用者提供的数组里，返回拷贝的个数
+template <typename Det>
+int PostProcessPackBoxes(const std::vector<Det> &dets,
+                         PostProcessBox_t *boxes,
+                         int max_boxes) {
+  if (boxes == nullptr || max_boxes <= 0) {
+    return 0;
+  }
+  int count = static_cast<int>(dets.size());
+  if (count > max_boxes) {
+    count = max_boxes;
+  }
+  for (int i = 0; i < count; i++) {
+    boxes[i].xmin = dets[i].bbox.xmin;
+    boxes[i].ymin = dets[i].bbox.ymin;
+    boxes[i].xmax = dets[i].bbox.xmax;
+    boxes[i].ymax = dets[i].bbox.ymax;
+    boxes[i].score = dets[i].score;
+    boxes[i].id = dets[i].id;
+  }
+  return count;
+}
+
+#endif  // __cplusplus
+
+#endif  // _POST_PROCESS_POST_PROCESS_OUTPUT_H_
@@ -0,0 +1,134 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#ifndef _POST_PROCESS_POST_PROCESS_PARALLEL_H_
+#define _POST_PROCESS_POST_PROCESS_PARALLEL_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define POST_PROCESS_MAX_THREADS 8
+
+// 计算实际使用的线程数：threads <= 0 时按 CPU 核数，
+// 最多 POST_PROCESS_MAX_THREADS 个，且不超过要拆分的行数
+inline int PostProcessThreadNum(int threads, int rows) {
+  if (threads <= 0) {
+    threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  threads = std::min(threads, POST_PROCESS_MAX_THREADS);
+  threads = std::min(threads, rows);
+  return std::max(threads, 1);
+}
+
+/**
+ * 常驻的工作线程，给逐帧调用的后处理用，省掉每帧创建和回收线程的开销。
+ * 线程在第一次需要时创建，之后在条件变量上等待下一次 Run，对象析构时退出。
+ * 同一个对象同一时间只能在一个线程里调用 Run。
+ */
+class PostProcessWorkers {
+ public:
+  PostProcessWorkers() = default;
+  PostProcessWorkers(const PostProcessWorkers &) = delete;
+  PostProcessWorkers &operator=(const PostProcessWorkers &) = delete;
+
+  ~PostProcessWorkers() {
+    {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_stop = true;
+    }
+    m_start_cond.notify_all();
+    for (auto &thread : m_threads) {
+      thread.join();
+    }
+  }
+
+  // worker 0 到 thread_num - 1 各执行一次 func(worker)，worker 0 在当前线程里执行，全部结束后返回
+  template <typename Func>
+  void Run(int thread_num, Func func) {
+    thread_num = std::min(thread_num, POST_PROCESS_MAX_THREADS);
+    if (thread_num <= 1) {
+      func(0);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      while (static_cast<int>(m_threads.size()) < thread_num - 1) {
+        int worker = static_cast<int>(m_threads.size()) + 1;
+        m_threads.emplace_back(&PostProcessWorkers::Loop, this, worker);
+      }
+      m_call = [](void *arg, int worker) { (*static_cast<Func *>(arg))(worker); };
+      m_arg = &func;
+      m_active = thread_num;
+      m_pending = thread_num - 1;
+      m_generation++;
+    }
+    m_start_cond.notify_all();
+
+    func(0);
+
+    std::unique_lock<std::mutex> lock(m_mtx);
+    m_done_cond.wait(lock, [this] { return m_pending == 0; });
+  }
+
+  // 把 [0, rows) 按行均分给 thread_num 个线程，每个线程执行 func(worker, row_begin, row_end)。
+  // worker 0 拿到的是最前面的行，调用者可以按 worker 编号各自保存结果，
+  // 结束后按编号顺序合并，结果和单线程一致；行数不够分时后面的 worker 不执行
+  template <typename Func>
+  void RunRows(int thread_num, int rows, Func func) {
+    if (thread_num <= 1 || rows <= 1) {
+      func(0, 0, rows);
+      return;
+    }
+    int step = (rows + thread_num - 1) / thread_num;
+    Run((rows + step - 1) / step, [&](int worker) {
+      func(worker, worker * step, std::min(rows, (worker + 1) * step));
+    });
+  }
+
+ private:
+  void Loop(int worker) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(m_mtx);
+    while (true) {
+      m_start_cond.wait(lock, [this, &seen] { return m_stop || m_generation != seen; });
+      if (m_stop) {
+        return;
+      }
+      seen = m_generation;
+      // 这一轮用不到的线程继续等下一轮
+      if (worker >= m_active) {
+        continue;
+      }
+      lock.unlock();
+      m_call(m_arg, worker);
+      lock.lock();
+      if (--m_pending == 0) {
+        m_done_cond.notify_one();
+      }
+    }
+  }
+
+  std::mutex m_mtx;
+  std::condition_variable m_start_cond;
+  std::condition_variable m_done_cond;
+  std::vector<std::thread> m_threads; /* m_threads[i] 是 worker i + 1 */
+  void (*m_call)(void *, int) = nullptr;
+  void *m_arg = nullptr;
+  uint64_t m_generation = 0;
+  int m_active = 0;
+  int m_pending = 0;
+  bool m_stop = false;
+};
+
+#endif  // _POST_PROCESS_POST_PROCESS_PARALLEL_H_
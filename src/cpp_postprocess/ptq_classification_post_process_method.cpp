@@ -15,6 +15,8 @@
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <new>
+#include <arm_neon.h>
 
 // #include "utils/utils_log.h"
 
@@ -1074,11 +1076,83 @@ bool compareObjects(const Classification &lhs, const Classification &rhs) {
   return (lhs.score > rhs.score);
 }
 
-std::vector<Classification> classification_dets;
+// 分数相同时 id 小的排在前面
+static inline bool classification_better(const Classification &lhs, const Classification &rhs) {
+  return lhs.score > rhs.score || (lhs.score == rhs.score && lhs.id < rhs.id);
+}
+
+#define CLASSIFICATION_DEFAULT_MAX_DETS 1000
+
+// 一路后处理的上下文，分类结果的缓存预先分配好，逐帧复用
+struct ClassificationPostProcessCtx {
+  std::vector<Classification> dets;
+  std::vector<Classification> topk; /* 取 top-k 的候选缓冲，攒到 2*top_k 个时用 nth_element 截回 top_k 个 */
+  PostProcessJson json;
+
+  explicit ClassificationPostProcessCtx(int max_dets) {
+    dets.reserve(max_dets);
+    topk.reserve(max_dets);
+  }
+};
+
+// 兼容原来的全局接口
+static ClassificationPostProcessCtx classification_default_ctx(CLASSIFICATION_DEFAULT_MAX_DETS);
+
+// 留下最好的 top_k 个，剩下的候选不再按顺序排列
+static void classification_shrink(std::vector<Classification> &topk, int top_k) {
+  std::nth_element(topk.begin(), topk.begin() + (top_k - 1), topk.end(), classification_better);
+  topk.resize(top_k);
+}
+
+/**
+ * 选出分数超过阈值的前 top_k 个，按分数从高到低写到 topk，不填 class_name
+ * 分数 4 个一组和阈值比较，整组都不超过阈值时直接跳过；候选攒到 2 * top_k 个时
+ * 用 nth_element 留下前 top_k 个，阈值提高到其中最差的分数，之后大部分分数只比较一次
+ */
+static void classification_topk(const float *scores, int num, float score_threshold, int top_k,
+                                std::vector<Classification> &topk) {
+  topk.clear();
+  if (top_k <= 0) {
+    return;
+  }
+
+  // 按下标顺序扫描，后面的分数和阈值相同时 id 更大，不会更好，所以只需要严格大于
+  float cutoff = score_threshold;
+  int capacity = top_k * 2;
+  auto push = [&](int i) {
+    if (!(scores[i] > cutoff)) {
+      return;
+    }
+    topk.emplace_back(i, scores[i], nullptr);
+    if (static_cast<int>(topk.size()) == capacity) {
+      classification_shrink(topk, top_k);
+      cutoff = topk[top_k - 1].score;
+    }
+  };
+
+  int i = 0;
+  for (; i + 4 <= num; i += 4) {
+    if (vmaxvq_u32(vcgtq_f32(vld1q_f32(scores + i), vdupq_n_f32(cutoff))) == 0) {
+      continue;
+    }
+    for (int k = 0; k < 4; k++) {
+      push(i + k);
+    }
+  }
+  for (; i < num; i++) {
+    push(i);
+  }
+
+  if (static_cast<int>(topk.size()) > top_k) {
+    classification_shrink(topk, top_k);
+  }
+  std::sort(topk.begin(), topk.end(), classification_better);
+}
+
+static void GetTopkResult(ClassificationPostProcessCtx *ctx, hbDNNTensor *tensor, ClassificationPostProcessInfo_t *post_info) {
 
-void GetTopkResult(hbDNNTensor *tensor, ClassificationPostProcessInfo_t *post_info) {
+  std::vector<Classification> &classification_dets = ctx->dets;
 
-  Classification classification;
   int n_dim = tensor->properties.validShape.numDimensions;
   int *shape = tensor->properties.validShape.dimensionSize;
   int tensor_len{1};
@@ -1086,60 +1160,127 @@ void GetTopkResult(hbDNNTensor *tensor, ClassificationPostProcessInfo_t *post_in
     tensor_len *= shape[i];
   }
 
-  for (auto i = 0; i < tensor_len; i++) {
-    float score = reinterpret_cast<float *>(tensor->sysMem[0].virAddr)[i];
-    classification.score = score;
-    classification.id = i;
+  auto *scores = reinterpret_cast<float *>(tensor->sysMem[0].virAddr);
+  classification_topk(scores, tensor_len, post_info->score_threshold, post_info->nms_top_k, ctx->topk);
+
+  // 只有选出来的结果需要类别名
+  for (Classification &classification : ctx->topk) {
     classification.class_name = classification_config_.class_names[classification.id].c_str();
-    if (classification.score > post_info->score_threshold){
-          classification_dets.push_back(classification);
+  }
+
+  // 上一次的结果还没有取走时和这次的合并，重新取前 top_k 个
+  bool merge = !classification_dets.empty();
+  classification_dets.insert(classification_dets.end(), ctx->topk.begin(), ctx->topk.end());
+  if (merge) {
+    std::sort(classification_dets.begin(), classification_dets.end(), classification_better);
+    int top_k = std::max(post_info->nms_top_k, 0);
+    if (static_cast<int>(classification_dets.size()) > top_k) {
+      classification_dets.resize(top_k);
     }
   }
+}
 
-  // 排序，根据对象的score从大到小排序  
-  std::sort(classification_dets.begin(), classification_dets.end(), compareObjects);  
+void ClassificationCtxDoProcess(ClassificationPostProcessCtx_t *ctx, hbDNNTensor *tensors, ClassificationPostProcessInfo_t *post_info) {
 
-  // 如果对象数量超过top_k个，删除多余的对象，只保留前top_k个  
-  int classification_dets_size = classification_dets.size();
-  if (classification_dets_size > post_info->nms_top_k) {  
-      classification_dets.resize(post_info->nms_top_k);  
-  }  
+  GetTopkResult(ctx, tensors, post_info);
 
 }
 
-void ClassificationDoProcess(hbDNNTensor *tensors, ClassificationPostProcessInfo_t *post_info) {
+char* ClassificationCtxPostProcess(ClassificationPostProcessCtx_t *ctx, ClassificationPostProcessInfo_t *post_info) {
+
+  std::vector<Classification> &classification_restuls = ctx->dets;
 
-  GetTopkResult(tensors, post_info);
+  // 算法结果转换成json格式
+  PostProcessJson &json = ctx->json;
+  json.Reset();
+  json.Raw("\"classification_result\": [");
+  for (size_t i = 0; i < classification_restuls.size(); i++) {
+    const Classification &cls = classification_restuls[i];
+    if (i > 0) {
+      json.Raw(",");
+    }
+    json.Raw("{\"prob\":").Fixed(cls.score, 5).Raw(",\"label\":").Int(cls.id);
+    json.Raw(",\"class_name\":\"").Raw(cls.class_name).Raw("\"}");
+  }
+  json.Raw("]");
 
+  classification_restuls.clear();
+  return json.Dup();
 }
 
-char* ClassificationPostProcess(ClassificationPostProcessInfo_t *post_info) {
+int ClassificationCtxGetResults(ClassificationPostProcessCtx_t *ctx, ClassificationPostProcessInfo_t *post_info, PostProcessClass_t *results, int max_results) {
 
-  int i = 0;
-  char *str_dets;
+  std::vector<Classification> &classification_restuls = ctx->dets;
+  int count = 0;
 
-  std::vector<Classification> classification_restuls;
-  classification_restuls = classification_dets;
+  if (results != nullptr && max_results > 0) {
+    count = std::min(static_cast<int>(classification_restuls.size()), max_results);
+    for (int i = 0; i < count; i++) {
+      results[i].score = classification_restuls[i].score;
+      results[i].id = classification_restuls[i].id;
+    }
+  }
 
-  std::stringstream out_string;
+  classification_restuls.clear();
+  return count;
+}
 
-  // 算法结果转换成json格式
-  int classification_restuls_size = classification_restuls.size();
-  out_string << "\"classification_result\": [";
-  for (i = 0; i < classification_restuls_size; i++) {
-  	auto det_ret = classification_restuls[i];
-  	out_string << det_ret;
-  	if (i < classification_restuls_size - 1)
-		out_string << ",";
+int ClassificationCtxGetBatchResults(ClassificationPostProcessCtx_t *ctx, hbDNNTensor *tensor, ClassificationPostProcessInfo_t *post_info, PostProcessClass_t *results, int *counts, int max_results) {
+
+  int n_dim = tensor->properties.validShape.numDimensions;
+  int *shape = tensor->properties.validShape.dimensionSize;
+  int *aligned_shape = tensor->properties.alignedShape.dimensionSize;
+  if (n_dim <= 0) {
+    return 0;
+  }
+  int batch = shape[0];
+  int tensor_len{1};
+  int row_stride{1};
+  for (int i = 1; i < n_dim; i++) {
+    tensor_len *= shape[i];
+    row_stride *= aligned_shape[i];
   }
-  out_string << "]" << std::endl;
 
-  str_dets = (char *)malloc(out_string.str().length() + 1);
-  str_dets[out_string.str().length()] = '\0';
-  snprintf(str_dets, out_string.str().length(), "%s", out_string.str().c_str());
-  // printf("str_dets: %s\n", str_dets);
-  classification_dets.clear();
-  classification_restuls.clear();
-  return str_dets;
+  int top_k = results != nullptr ? std::min(post_info->nms_top_k, max_results) : 0;
+  auto *scores = reinterpret_cast<float *>(tensor->sysMem[0].virAddr);
+  for (int b = 0; b < batch; b++) {
+    classification_topk(scores + static_cast<size_t>(b) * row_stride, tensor_len,
+                        post_info->score_threshold, top_k, ctx->topk);
+    int count = static_cast<int>(ctx->topk.size());
+    PostProcessClass_t *row = results + static_cast<size_t>(b) * max_results;
+    for (int i = 0; i < count; i++) {
+      row[i].score = ctx->topk[i].score;
+      row[i].id = ctx->topk[i].id;
+    }
+    counts[b] = count;
+  }
+  return batch;
+}
+
+ClassificationPostProcessCtx_t *ClassificationPostProcessCreate(int max_dets) {
+  if (max_dets <= 0) {
+    max_dets = CLASSIFICATION_DEFAULT_MAX_DETS;
+  }
+  return new (std::nothrow) ClassificationPostProcessCtx(max_dets);
+}
+
+void ClassificationPostProcessDestroy(ClassificationPostProcessCtx_t *ctx) {
+  delete ctx;
+}
+
+void ClassificationDoProcess(hbDNNTensor *tensors, ClassificationPostProcessInfo_t *post_info) {
+  ClassificationCtxDoProcess(&classification_default_ctx, tensors, post_info);
+}
+
+char* ClassificationPostProcess(ClassificationPostProcessInfo_t *post_info) {
+  return ClassificationCtxPostProcess(&classification_default_ctx, post_info);
+}
+
+int ClassificationPostProcessResults(ClassificationPostProcessInfo_t *post_info, PostProcessClass_t *results, int max_results) {
+  return ClassificationCtxGetResults(&classification_default_ctx, post_info, results, max_results);
+}
+
+int ClassificationPostProcessBatchResults(hbDNNTensor *tensor, ClassificationPostProcessInfo_t *post_info, PostProcessClass_t *results, int *counts, int max_results) {
+  return ClassificationCtxGetBatchResults(&classification_default_ctx, tensor, post_info, results, counts, max_results);
 }
 
@@ -10,6 +10,7 @@
 #define _POST_PROCESS_CLASSIFICATION_POST_PROCESS_H_
 
 #include "dnn/hb_dnn.h"
+#include "post_process_output.h"
 
 #ifdef __cplusplus
   extern "C"{
@@ -37,6 +38,48 @@ char* ClassificationPostProcess(ClassificationPostProcessInfo_t *post_info);
 
 void ClassificationDoProcess(hbDNNTensor *tensors, ClassificationPostProcessInfo_t *post_info);
 
+// 后处理上下文：每个上下文独立保存一路模型输出的分类结果，内部缓存逐帧复用。
+// 同一个上下文同一时间只能在一个线程里使用，不同上下文可以并行处理。
+// 上面两个不带上下文的接口共用一个内部的默认上下文。
+typedef struct ClassificationPostProcessCtx ClassificationPostProcessCtx_t;
+
+/**
+ * 创建后处理上下文
+ * @param[in] max_dets: 预分配的结果数量，<= 0 时使用默认值
+ * @return 上下文句柄，失败返回 NULL
+ */
+ClassificationPostProcessCtx_t *ClassificationPostProcessCreate(int max_dets);
+
+void ClassificationPostProcessDestroy(ClassificationPostProcessCtx_t *ctx);
+
+void ClassificationCtxDoProcess(ClassificationPostProcessCtx_t *ctx, hbDNNTensor *tensors, ClassificationPostProcessInfo_t *post_info);
+
+char* ClassificationCtxPostProcess(ClassificationPostProcessCtx_t *ctx, ClassificationPostProcessInfo_t *post_info);
+
+/**
+ * 把结果写到调用者提供的数组里，不生成 json 字符串
+ * @param[out] results: 结果数组，按概率从高到低排列
+ * @param[in] max_results: 数组长度，超出的结果被丢弃
+ * @return 写入的结果个数
+ */
+int ClassificationCtxGetResults(ClassificationPostProcessCtx_t *ctx, ClassificationPostProcessInfo_t *post_info, PostProcessClass_t *results, int max_results);
+
+// 使用默认上下文，和 ClassificationDoProcess 配合使用
+int ClassificationPostProcessResults(ClassificationPostProcessInfo_t *post_info, PostProcessClass_t *results, int max_results);
+
+/**
+ * 批量分类：tensor 的第 0 维是 batch（例如 ROI 推理时的多个抠图），每一行单独取 top-k，
+ * 直接写到调用者提供的数组里，不经过 ClassificationCtxDoProcess，也不影响上下文里已有的结果
+ * @param[out] results: 第 b 行的结果从 results[b * max_results] 开始，按概率从高到低排列
+ * @param[out] counts: 每一行写入的结果个数，长度不小于 batch
+ * @param[in] max_results: 每一行最多写入的结果个数，同时受 post_info->nms_top_k 限制
+ * @return batch 数
+ */
+int ClassificationCtxGetBatchResults(ClassificationPostProcessCtx_t *ctx, hbDNNTensor *tensor, ClassificationPostProcessInfo_t *post_info, PostProcessClass_t *results, int *counts, int max_results);
+
+// 使用默认上下文
+int ClassificationPostProcessBatchResults(hbDNNTensor *tensor, ClassificationPostProcessInfo_t *post_info, PostProcessClass_t *results, int *counts, int max_results);
+
 #ifdef __cplusplus
 }
 #endif
@@ -18,8 +18,10 @@
 #include <queue>
 #include <arm_neon.h>
 #include <cassert>
+#include <new>
 
 #include "ptq_efficientdet_post_process.h"
+#include "post_process_anchors.h"
 
 /**
  * Config definition for EfficientDet
@@ -41,15 +43,6 @@ struct EDBaseAnchor {
   float y2_;
 };
 
-struct EDAnchor {
-  EDAnchor(float c_x, float c_y, float w, float h)
-      : c_x_(c_x), c_y_(c_y), w_(w), h_(h) {}
-  float c_x_;
-  float c_y_;
-  float w_;
-  float h_;
-};
-
 
 const int kEfficientDetClassNum = 80;
 
@@ -172,64 +165,41 @@ typedef struct Detection {
   ~Detection() {}
 } Detection;
 
-std::vector<Detection> efficient_det_dets;
-std::vector<Detection> efficient_det_restuls;
-static std::vector<std::vector<EDAnchor>> anchors_table;
+#define EFFICIENTDET_DEFAULT_MAX_DETS 1024
+
+// 一路后处理的上下文，检测框和 NMS 的缓存逐帧复用，
+// 各层 anchor 表指向全局缓存里只读的那一份
+struct EfficientdetPostProcessCtx {
+  std::vector<Detection> dets;
+  std::vector<Detection> results;
+  PostProcessNms nms;
+  PostProcessNmsConfig_t nms_config;
+  PostProcessJson json;
+  std::vector<const PostProcessAnchors *> anchors_table;
+
+  explicit EfficientdetPostProcessCtx(int max_dets)
+      : anchors_table(default_efficient_det_config.feature_strides.size(), nullptr) {
+    dets.reserve(max_dets);
+    results.reserve(max_dets);
+    nms.Reserve(max_dets);
+    nms_config = PostProcessNmsDefaultConfig();
+  }
+};
+
+// 兼容原来的全局接口
+static EfficientdetPostProcessCtx efficientdet_default_ctx(EFFICIENTDET_DEFAULT_MAX_DETS);
 
-static void efficient_det_nms(std::vector<Detection> &input,
+static void efficient_det_nms(EfficientdetPostProcessCtx *ctx,
                float iou_threshold,
                int top_k,
-               std::vector<Detection> &result,
                bool suppress) {
-  // sort order by score desc
-  std::stable_sort(input.begin(), input.end(), std::greater<Detection>());
-
-  std::vector<bool> skip(input.size(), false);
-
-  // pre-calculate boxes area
-  std::vector<float> areas;
-  areas.reserve(input.size());
-  for (size_t i = 0; i < input.size(); i++) {
-    float width = input[i].bbox.xmax - input[i].bbox.xmin;
-    float height = input[i].bbox.ymax - input[i].bbox.ymin;
-    areas.push_back(width * height);
-  }
-
-  int count = 0;
-  for (size_t i = 0; count < top_k && i < skip.size(); i++) {
-    if (skip[i]) {
-      continue;
-    }
-    skip[i] = true;
-    ++count;
-
-    for (size_t j = i + 1; j < skip.size(); ++j) {
-      if (skip[j]) {
-        continue;
-      }
-      if (suppress == false) {
-        if (input[i].id != input[j].id) {
-          continue;
-        }
-      }
-
-      // intersection area
-      float xx1 = std::max(input[i].bbox.xmin, input[j].bbox.xmin);
-      float yy1 = std::max(input[i].bbox.ymin, input[j].bbox.ymin);
-      float xx2 = std::min(input[i].bbox.xmax, input[j].bbox.xmax);
-      float yy2 = std::min(input[i].bbox.ymax, input[j].bbox.ymax);
-
-      if (xx2 > xx1 && yy2 > yy1) {
-        float area_intersection = (xx2 - xx1) * (yy2 - yy1);
-        float iou_ratio =
-            area_intersection / (areas[j] + areas[i] - area_intersection);
-        if (iou_ratio > iou_threshold) {
-          skip[j] = true;
-        }
-      }
-    }
-    result.push_back(input[i]);
-  }
+  PostProcessNmsParam param;
+  param.iou_threshold = iou_threshold;
+  param.top_k = top_k;
+  param.max_input = 0;
+  param.class_agnostic = suppress;
+  param.config = ctx->nms_config;
+  PostProcessNmsDetections(ctx->nms, param, ctx->dets, ctx->results);
 }
 
 static inline uint32x4x4_t CalculateIndex(uint32_t idx,
@@ -297,10 +267,11 @@ static std::pair<float, int> MaxScoreID(int32_t *input,
   return result_id_score;
 }
 
-int GetAnchors(std::vector<EDAnchor> &anchors,
-                                                 int layer,
-                                                 int feat_height,
-                                                 int feat_width) {
+// 生成一层的 anchor 表，只在这一层的输出尺寸第一次出现时调用
+static void GetAnchors(int layer,
+                       int feat_height,
+                       int feat_width,
+                       PostProcessAnchors *anchors) {
   int stride = default_efficient_det_config.feature_strides[layer];
   auto scales = default_efficient_det_config.anchor_scales[layer];
   const auto &ratios = default_efficient_det_config.anchor_ratio;
@@ -322,6 +293,11 @@ int GetAnchors(std::vector<EDAnchor> &anchors,
     }
   }
 
+  int anchor_num = feat_height * feat_width * base_anchors.size();
+  anchors->cx.reserve(anchor_num);
+  anchors->cy.reserve(anchor_num);
+  anchors->w.reserve(anchor_num);
+  anchors->h.reserve(anchor_num);
   for (int i = 0; i < feat_height; ++i) {
     for (int j = 0; j < feat_width; ++j) {
       auto ori_y = i * stride;
@@ -336,17 +312,17 @@ int GetAnchors(std::vector<EDAnchor> &anchors,
         float ctr_x = x1 + 0.5f * (width - 1.f);
         float ctr_y = y1 + 0.5f * (height - 1.f);
 
-        anchors.push_back(EDAnchor(ctr_x, ctr_y, width, height));
+        anchors->Add(ctr_x, ctr_y, width, height);
       }
     }
   }
-  return 0;
 }
 
-int GetBboxAndScores(
+static int GetBboxAndScores(
+    EfficientdetPostProcessCtx *ctx,
     hbDNNTensor *c_tensor,
     hbDNNTensor *bbox_tensor,
-    std::vector<EDAnchor> &anchors,
+    const PostProcessAnchors &anchors,
     int class_num,
     float img_h,
     float img_w,
@@ -451,10 +427,10 @@ int GetBboxAndScores(
       float dy = raw_box_data[start + 1];
       float dw = raw_box_data[start + 2];
       float dh = raw_box_data[start + 3];
-      float width = anchors[i].w_;
-      float height = anchors[i].h_;
-      float ctr_x = anchors[i].c_x_;
-      float ctr_y = anchors[i].c_y_;
+      float width = anchors.w[i];
+      float height = anchors.h[i];
+      float ctr_x = anchors.cx[i];
+      float ctr_y = anchors.cy[i];
 
       float pred_ctr_x = dx * width + ctr_x;
       float pred_ctr_y = dy * height + ctr_y;
@@ -473,7 +449,7 @@ int GetBboxAndScores(
       bbox.xmax = std::min(xmax, img_w);
       bbox.ymax = std::min(ymax, img_h);
 
-      efficient_det_dets.push_back(Detection(max_id,
+      ctx->dets.push_back(Detection(max_id,
                                               max_score,
                                               bbox,
                                               default_efficient_det_config.class_names[max_id].c_str()));
@@ -509,10 +485,10 @@ int GetBboxAndScores(
       float dy = raw_box_data[start + 1] * box_scales[1];
       float dw = raw_box_data[start + 2] * box_scales[2];
       float dh = raw_box_data[start + 3] * box_scales[3];
-      float width = anchors[i].w_;
-      float height = anchors[i].h_;
-      float ctr_x = anchors[i].c_x_;
-      float ctr_y = anchors[i].c_y_;
+      float width = anchors.w[i];
+      float height = anchors.h[i];
+      float ctr_x = anchors.cx[i];
+      float ctr_y = anchors.cy[i];
 
       float pred_ctr_x = dx * width + ctr_x;
       float pred_ctr_y = dy * height + ctr_y;
@@ -531,7 +507,7 @@ int GetBboxAndScores(
       bbox.xmax = std::min(xmax, img_w);
       bbox.ymax = std::min(ymax, img_h);
 
-      efficient_det_dets.push_back(Detection(max_id,
+      ctx->dets.push_back(Detection(max_id,
                                     max_score,
                                     bbox,
                                     default_efficient_det_config.class_names[max_id].c_str()));
@@ -540,7 +516,7 @@ int GetBboxAndScores(
   return 0;
 }
 
-void EfficientdetdoProcess(hbDNNTensor *cls_tensor, hbDNNTensor *bbox_tensor, EfficientdetPostProcessInfo_t *post_info, int layer) {
+void EfficientdetCtxDoProcess(EfficientdetPostProcessCtx_t *ctx, hbDNNTensor *cls_tensor, hbDNNTensor *bbox_tensor, EfficientdetPostProcessInfo_t *post_info, int layer) {
 
   float origin_height = post_info->ori_height;
   float origin_width = post_info->ori_width;
@@ -565,25 +541,17 @@ void EfficientdetdoProcess(hbDNNTensor *cls_tensor, hbDNNTensor *bbox_tensor, Ef
 
   int height = bbox_tensor->properties.alignedShape.dimensionSize[1];
   int width = bbox_tensor->properties.alignedShape.dimensionSize[2];
-  int layer_num = default_efficient_det_config.feature_strides.size();
-  if (anchors_table.empty()) {
-    // Note: note thread safe
-    anchors_table.resize(layer_num);
-    printf("init anchors_table.\n");
-  }
-  GetAnchors(anchors_table[layer], layer, height, width);
-
-  std::vector<EDAnchor> &anchors = anchors_table[layer];
-  GetBboxAndScores(cls_tensor, bbox_tensor, anchors, kEfficientDetClassNum, new_h, new_w, post_info);
+  const PostProcessAnchors *anchors =
+      PostProcessLayerAnchors(ctx->anchors_table[layer], "efficientdet", layer, height, width, GetAnchors);
+  GetBboxAndScores(ctx, cls_tensor, bbox_tensor, *anchors, kEfficientDetClassNum, new_h, new_w, post_info);
 
 }
 
 
-char* EfficientdetPostProcess(EfficientdetPostProcessInfo_t *post_info) {
+// NMS 之后把检测框换算到原图上，结果留在 ctx->results 里
+static void efficient_det_finish(EfficientdetPostProcessCtx *ctx, EfficientdetPostProcessInfo_t *post_info) {
 
-  int i = 0;
-  char *str_dets;
-  std::stringstream out_string;
+  std::vector<Detection> &efficient_det_restuls = ctx->results;
 
   float origin_height = post_info->ori_height;
   float origin_width = post_info->ori_width;
@@ -605,7 +573,7 @@ char* EfficientdetPostProcess(EfficientdetPostProcessInfo_t *post_info) {
     h_ratio = scale;
   }
 
-  efficient_det_nms(efficient_det_dets, post_info->nms_threshold, post_info->nms_top_k, efficient_det_restuls, false);
+  efficient_det_nms(ctx, post_info->nms_threshold, post_info->nms_top_k, false);
 
   if (efficient_det_restuls.size() > post_info->nms_top_k) {
     efficient_det_restuls.resize(post_info->nms_top_k);
@@ -622,23 +590,67 @@ char* EfficientdetPostProcess(EfficientdetPostProcessInfo_t *post_info) {
     box.bbox.xmax = std::min(static_cast<float>(box.bbox.xmax), static_cast<float>(post_info->ori_width - 1)) + 1;
     box.bbox.ymax = std::min(static_cast<float>(box.bbox.ymax), static_cast<float>(post_info->ori_height - 1)) + 1;
   }
+}
+
+char* EfficientdetCtxPostProcess(EfficientdetPostProcessCtx_t *ctx, EfficientdetPostProcessInfo_t *post_info) {
+
+  std::vector<Detection> &efficient_det_restuls = ctx->results;
+
+  efficient_det_finish(ctx, post_info);
 
   // 算法结果转换成json格式
-  out_string << "\"efficient_det_result\": [";
-  for (i = 0; i < efficient_det_restuls.size(); i++) {
-  	auto det_ret = efficient_det_restuls[i];
-  	out_string << det_ret;
-  	if (i < efficient_det_restuls.size() - 1)
-		out_string << ",";
+  PostProcessJson &json = ctx->json;
+  json.Reset();
+  json.Raw("\"efficient_det_result\": [");
+  for (size_t i = 0; i < efficient_det_restuls.size(); i++) {
+    const Detection &det = efficient_det_restuls[i];
+    if (i > 0) {
+      json.Raw(",");
+    }
+    json.Detection(det.bbox.xmin, det.bbox.ymin, det.bbox.xmax, det.bbox.ymax,
+                   det.score, det.id, default_efficient_det_config.class_names[det.id].c_str());
   }
-  out_string << "]" << std::endl;
+  json.Raw("]");
 
-  str_dets = (char *)malloc(out_string.str().length() + 1);
-  str_dets[out_string.str().length()] = '\0';
-  snprintf(str_dets, out_string.str().length(), "%s", out_string.str().c_str());
-  // printf("str_dets: %s\n", str_dets);
-  efficient_det_dets.clear();
+  ctx->dets.clear();
   efficient_det_restuls.clear();
-  return str_dets;
+  return json.Dup();
+}
+
+int EfficientdetCtxGetBoxes(EfficientdetPostProcessCtx_t *ctx, EfficientdetPostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes) {
+
+  efficient_det_finish(ctx, post_info);
+  int count = PostProcessPackBoxes(ctx->results, boxes, max_boxes);
+
+  ctx->dets.clear();
+  ctx->results.clear();
+  return count;
+}
+
+EfficientdetPostProcessCtx_t *EfficientdetPostProcessCreate(int max_dets) {
+  if (max_dets <= 0) {
+    max_dets = EFFICIENTDET_DEFAULT_MAX_DETS;
+  }
+  return new (std::nothrow) EfficientdetPostProcessCtx(max_dets);
+}
+
+void EfficientdetPostProcessDestroy(EfficientdetPostProcessCtx_t *ctx) {
+  delete ctx;
+}
+
+void EfficientdetPostProcessSetNms(EfficientdetPostProcessCtx_t *ctx, const PostProcessNmsConfig_t *config) {
+  ctx->nms_config = config != NULL ? *config : PostProcessNmsDefaultConfig();
+}
+
+void EfficientdetdoProcess(hbDNNTensor *cls_tensor, hbDNNTensor *bbox_tensor, EfficientdetPostProcessInfo_t *post_info, int layer) {
+  EfficientdetCtxDoProcess(&efficientdet_default_ctx, cls_tensor, bbox_tensor, post_info, layer);
+}
+
+char* EfficientdetPostProcess(EfficientdetPostProcessInfo_t *post_info) {
+  return EfficientdetCtxPostProcess(&efficientdet_default_ctx, post_info);
+}
+
+int EfficientdetPostProcessBoxes(EfficientdetPostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes) {
+  return EfficientdetCtxGetBoxes(&efficientdet_default_ctx, post_info, boxes, max_boxes);
 }
 
@@ -18,8 +18,10 @@
 #include <queue>
 #include <arm_neon.h>
 #include <cassert>
+#include <new>
 
 #include "ptq_ssd_post_process.h"
+#include "post_process_anchors.h"
 
 inline float fastExp(float x) {
   union {
@@ -112,20 +114,6 @@ inline size_t argmax(ForwardIterator first, ForwardIterator last) {
 }
 
 
-typedef struct Anchor {
-  float cx{0.0};
-  float cy{0.0};
-  float w{0.0};
-  float h{0.0};
-  Anchor(float cx, float cy, float w, float h) : cx(cx), cy(cy), w(w), h(h) {}
-
-  friend std::ostream &operator<<(std::ostream &os, const Anchor &anchor) {
-    os << "[" << anchor.cx << "," << anchor.cy << "," << anchor.w << ","
-       << anchor.h << "]";
-    return os;
-  }
-} Anchor;
-
 /**
  * Bounding box definition
  */
@@ -188,102 +176,84 @@ static float DequantiScale(int32_t data,
   return static_cast<float>(r_int32(data, big_endian)) * scale_value;
 }
 
-std::vector<Detection> ssd_dets;
-std::vector<Detection> ssd_det_restuls;
-std::vector<std::vector<Anchor>> anchors_table;
+#define SSD_DEFAULT_MAX_DETS 1024
+
+// 一路后处理的上下文，检测框和 NMS 的缓存逐帧复用，
+// 各层 anchor 表指向全局缓存里只读的那一份
+struct SsdPostProcessCtx {
+  std::vector<Detection> dets;
+  std::vector<Detection> results;
+  PostProcessNms nms;
+  PostProcessNmsConfig_t nms_config;
+  PostProcessJson json;
+  std::vector<const PostProcessAnchors *> anchors_table;
+
+  explicit SsdPostProcessCtx(int max_dets)
+      : anchors_table(default_ssd_config.step.size(), nullptr) {
+    dets.reserve(max_dets);
+    results.reserve(max_dets);
+    nms.Reserve(max_dets);
+    nms_config = PostProcessNmsDefaultConfig();
+  }
+};
+
+// 兼容原来的全局接口
+static SsdPostProcessCtx ssd_default_ctx(SSD_DEFAULT_MAX_DETS);
 
 #define NMS_MAX_INPUT (400)
-void ssd_nms(std::vector<Detection> &input,
+static void ssd_nms(SsdPostProcessCtx *ctx,
          float iou_threshold,
          int top_k,
-         std::vector<Detection> &result,
          bool suppress) {
-  // sort order by score desc
-  std::stable_sort(input.begin(), input.end(), std::greater<Detection>());
-  if (input.size() > NMS_MAX_INPUT) {
-    input.resize(NMS_MAX_INPUT);
-  }
-
-  std::vector<bool> skip(input.size(), false);
-
-  // pre-calculate boxes area
-  std::vector<float> areas;
-  areas.reserve(input.size());
-  for (size_t i = 0; i < input.size(); i++) {
-    float width = input[i].bbox.xmax - input[i].bbox.xmin;
-    float height = input[i].bbox.ymax - input[i].bbox.ymin;
-    areas.push_back(width * height);
-  }
-
-  int count = 0;
-  for (size_t i = 0; count < top_k && i < skip.size(); i++) {
-    if (skip[i]) {
-      continue;
-    }
-    skip[i] = true;
-    ++count;
-
-    for (size_t j = i + 1; j < skip.size(); ++j) {
-      if (skip[j]) {
-        continue;
-      }
-      if (suppress == false) {
-        if (input[i].id != input[j].id) {
-          continue;
-        }
-      }
-
-      // intersection area
-      float xx1 = std::max(input[i].bbox.xmin, input[j].bbox.xmin);
-      float yy1 = std::max(input[i].bbox.ymin, input[j].bbox.ymin);
-      float xx2 = std::min(input[i].bbox.xmax, input[j].bbox.xmax);
-      float yy2 = std::min(input[i].bbox.ymax, input[j].bbox.ymax);
-
-      if (xx2 > xx1 && yy2 > yy1) {
-        float area_intersection = (xx2 - xx1) * (yy2 - yy1);
-        float iou_ratio =
-            area_intersection / (areas[j] + areas[i] - area_intersection);
-        if (iou_ratio > iou_threshold) {
-          skip[j] = true;
-        }
-      }
-    }
-    result.push_back(input[i]);
-  }
+  PostProcessNmsParam param;
+  param.iou_threshold = iou_threshold;
+  param.top_k = top_k;
+  param.max_input = NMS_MAX_INPUT;
+  param.class_agnostic = suppress;
+  param.config = ctx->nms_config;
+  PostProcessNmsDetections(ctx->nms, param, ctx->dets, ctx->results);
 }
 
-int SsdAnchors(std::vector<Anchor> &anchors, int layer, int layer_height, int layer_width) {
+// 生成一层的 anchor 表，只在这一层的输出尺寸第一次出现时调用
+static void SsdAnchors(int layer, int layer_height, int layer_width, PostProcessAnchors *anchors) {
   int step = default_ssd_config.step[layer];
   float min_size = default_ssd_config.anchor_size[layer].first;
   float max_size = default_ssd_config.anchor_size[layer].second;
   auto &anchor_ratio = default_ssd_config.anchor_ratio[layer];
+
+  // 每个位置上的 anchor 宽高都一样，先算好
+  std::vector<std::pair<float, float>> sizes;
+  sizes.emplace_back(min_size, min_size);
+  if (max_size > 0) {
+    sizes.emplace_back(std::sqrt(max_size * min_size), std::sqrt(max_size * min_size));
+  }
+  for (int k = 0; k < 4; k++) {
+    if (anchor_ratio[k] == 0) continue;
+    float sr = std::sqrt(anchor_ratio[k]);
+    sizes.emplace_back(min_size * sr, min_size / sr);
+  }
+
+  int anchor_num = layer_height * layer_width * sizes.size();
+  anchors->cx.reserve(anchor_num);
+  anchors->cy.reserve(anchor_num);
+  anchors->w.reserve(anchor_num);
+  anchors->h.reserve(anchor_num);
   for (int i = 0; i < layer_height; i++) {
     for (int j = 0; j < layer_width; j++) {
       float cy = (i + default_ssd_config.offset[0]) * step;
       float cx = (j + default_ssd_config.offset[1]) * step;
-      anchors.emplace_back(Anchor(cx, cy, min_size, min_size));
-      if (max_size > 0) {
-        anchors.emplace_back(Anchor(cx,
-                                    cy,
-                                    std::sqrt(max_size * min_size),
-                                    std::sqrt(max_size * min_size)));
-      }
-      for (int k = 0; k < 4; k++) {
-        if (anchor_ratio[k] == 0) continue;
-        float sr = std::sqrt(anchor_ratio[k]);
-        float w = min_size * sr;
-        float h = min_size / sr;
-        anchors.emplace_back(Anchor(cx, cy, w, h));
+      for (const auto &size : sizes) {
+        anchors->Add(cx, cy, size.first, size.second);
       }
     }
   }
-  return 0;
 }
 
-int GetBboxAndScoresQuantiNONE(
+static int GetBboxAndScoresQuantiNONE(
+    SsdPostProcessCtx *ctx,
     hbDNNTensor *bbox_tensor,
     hbDNNTensor *cls_tensor,
-    std::vector<Anchor> &anchors,
+    const PostProcessAnchors &anchors,
     int class_num, SsdPostProcessInfo_t *post_info) {
   int *shape = cls_tensor->properties.validShape.dimensionSize;
   //uint32_t c_batch_size = shape[0];
@@ -360,10 +330,10 @@ int GetBboxAndScoresQuantiNONE(
     float dw = raw_box_data[start + 2];
     float dh = raw_box_data[start + 3];
 
-    auto x_min = (anchors[i].cx - anchors[i].w / 2) / post_info->width;
-    auto y_min = (anchors[i].cy - anchors[i].h / 2) / post_info->height;
-    auto x_max = (anchors[i].cx + anchors[i].w / 2) / post_info->width;
-    auto y_max = (anchors[i].cy + anchors[i].h / 2) / post_info->height;
+    auto x_min = (anchors.cx[i] - anchors.w[i] / 2) / post_info->width;
+    auto y_min = (anchors.cy[i] - anchors.h[i] / 2) / post_info->height;
+    auto x_max = (anchors.cx[i] + anchors.w[i] / 2) / post_info->width;
+    auto y_max = (anchors.cy[i] + anchors.h[i] / 2) / post_info->height;
 
     auto prior_w = x_max - x_min;
     auto prior_h = y_max - y_min;
@@ -388,16 +358,17 @@ int GetBboxAndScoresQuantiNONE(
     if (xmin_org > xmax_org || ymin_org > ymax_org) continue;
 
     Bbox bbox(xmin_org, ymin_org, xmax_org, ymax_org);
-    ssd_dets.emplace_back(Detection(
+    ctx->dets.emplace_back(Detection(
         (int)max_id, max_score, bbox, default_ssd_config.class_names[max_id].c_str()));
   }
   return 0;
 }
 
-int GetBboxAndScoresQuantiSCALE(
+static int GetBboxAndScoresQuantiSCALE(
+    SsdPostProcessCtx *ctx,
     hbDNNTensor *bbox_tensor,
     hbDNNTensor *cls_tensor,
-    std::vector<Anchor> &anchors,
+    const PostProcessAnchors &anchors,
     int class_num, SsdPostProcessInfo_t *post_info) {
   int h_idx{1}, w_idx{2}, c_idx{3};
 
@@ -469,10 +440,10 @@ int GetBboxAndScoresQuantiSCALE(
         float dh = DequantiScale(cur_bbox_data[3], false, cur_bbox_scale[3]);
 
         int i = h * bbox_w * stride + w * stride + k;
-        auto x_min = (anchors[i].cx - anchors[i].w / 2) / post_info->width;
-        auto y_min = (anchors[i].cy - anchors[i].h / 2) / post_info->height;
-        auto x_max = (anchors[i].cx + anchors[i].w / 2) / post_info->width;
-        auto y_max = (anchors[i].cy + anchors[i].h / 2) / post_info->height;
+        auto x_min = (anchors.cx[i] - anchors.w[i] / 2) / post_info->width;
+        auto y_min = (anchors.cy[i] - anchors.h[i] / 2) / post_info->height;
+        auto x_max = (anchors.cx[i] + anchors.w[i] / 2) / post_info->width;
+        auto y_max = (anchors.cy[i] + anchors.h[i] / 2) / post_info->height;
 
         auto prior_w = x_max - x_min;
         auto prior_h = y_max - y_min;
@@ -497,7 +468,7 @@ int GetBboxAndScoresQuantiSCALE(
         if (xmin_org > xmax_org || ymin_org > ymax_org) continue;
 
         Bbox bbox(xmin_org, ymin_org, xmax_org, ymax_org);
-        ssd_dets.emplace_back(Detection((int)max_id,
+        ctx->dets.emplace_back(Detection((int)max_id,
                                     max_score,
                                     bbox,
                                     default_ssd_config.class_names[max_id].c_str()));
@@ -510,55 +481,84 @@ int GetBboxAndScoresQuantiSCALE(
 }
 
 
-void SsddoProcess(hbDNNTensor *bbox_tensor, hbDNNTensor *cls_tensor, SsdPostProcessInfo_t *post_info, int layer) {
+void SsdCtxDoProcess(SsdPostProcessCtx_t *ctx, hbDNNTensor *bbox_tensor, hbDNNTensor *cls_tensor, SsdPostProcessInfo_t *post_info, int layer) {
 
   int height = bbox_tensor->properties.alignedShape.dimensionSize[1];
   int width = bbox_tensor->properties.alignedShape.dimensionSize[2];
-  int layer_num = default_ssd_config.step.size();
-  if (anchors_table.empty()) {
-    // Note: note thread safe
-    anchors_table.resize(layer_num);
-    printf("init anchors_table.\n");
-  }
-  SsdAnchors(anchors_table[layer], layer, height, width);
+  const PostProcessAnchors *anchors =
+      PostProcessLayerAnchors(ctx->anchors_table[layer], "ssd", layer, height, width, SsdAnchors);
 
   auto quanti_type = bbox_tensor->properties.quantiType;
   if (quanti_type == hbDNNQuantiType::SCALE) {
-    GetBboxAndScoresQuantiSCALE(bbox_tensor, cls_tensor, anchors_table[layer], default_ssd_config.class_num + 1, post_info);
+    GetBboxAndScoresQuantiSCALE(ctx, bbox_tensor, cls_tensor, *anchors, default_ssd_config.class_num + 1, post_info);
   } else if (quanti_type == hbDNNQuantiType::NONE) {
-    GetBboxAndScoresQuantiNONE(bbox_tensor, cls_tensor, anchors_table[layer], default_ssd_config.class_num + 1, post_info);
+    GetBboxAndScoresQuantiNONE(ctx, bbox_tensor, cls_tensor, *anchors, default_ssd_config.class_num + 1, post_info);
   } else {
     printf("error quanti_type: %d\n", quanti_type);
   }
 }
 
 
-char* SsdPostProcess(SsdPostProcessInfo_t *post_info) {
+char* SsdCtxPostProcess(SsdPostProcessCtx_t *ctx, SsdPostProcessInfo_t *post_info) {
 
-  int i = 0;
-  char *str_dets;
+  std::vector<Detection> &ssd_det_restuls = ctx->results;
 
   // 计算交并比来合并检测框，传入交并比阈值(0.65)和返回box数量(5000)
-  ssd_nms(ssd_dets, post_info->nms_threshold, post_info->nms_top_k, ssd_det_restuls, false);
-  std::stringstream out_string;
+  ssd_nms(ctx, post_info->nms_threshold, post_info->nms_top_k, false);
 
   // 算法结果转换成json格式
-  int ssd_det_restuls_size = ssd_det_restuls.size();
-  out_string << "\"ssd_result\": [";
-  for (i = 0; i < ssd_det_restuls_size; i++) {
-  	auto det_ret = ssd_det_restuls[i];
-  	out_string << det_ret;
-  	if (i < ssd_det_restuls_size - 1)
-		out_string << ",";
+  PostProcessJson &json = ctx->json;
+  json.Reset();
+  json.Raw("\"ssd_result\": [");
+  for (size_t i = 0; i < ssd_det_restuls.size(); i++) {
+    const Detection &det = ssd_det_restuls[i];
+    if (i > 0) {
+      json.Raw(",");
+    }
+    json.Detection(det.bbox.xmin, det.bbox.ymin, det.bbox.xmax, det.bbox.ymax,
+                   det.score, det.id, default_ssd_config.class_names[det.id].c_str());
   }
-  out_string << "]" << std::endl;
+  json.Raw("]");
 
-  str_dets = (char *)malloc(out_string.str().length() + 1);
-  str_dets[out_string.str().length()] = '\0';
-  snprintf(str_dets, out_string.str().length(), "%s", out_string.str().c_str());
-  // printf("str_dets: %s\n", str_dets);
-  ssd_dets.clear();
+  ctx->dets.clear();
   ssd_det_restuls.clear();
-  return str_dets;
+  return json.Dup();
+}
+
+int SsdCtxGetBoxes(SsdPostProcessCtx_t *ctx, SsdPostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes) {
+
+  ssd_nms(ctx, post_info->nms_threshold, post_info->nms_top_k, false);
+  int count = PostProcessPackBoxes(ctx->results, boxes, max_boxes);
+
+  ctx->dets.clear();
+  ctx->results.clear();
+  return count;
+}
+
+SsdPostProcessCtx_t *SsdPostProcessCreate(int max_dets) {
+  if (max_dets <= 0) {
+    max_dets = SSD_DEFAULT_MAX_DETS;
+  }
+  return new (std::nothrow) SsdPostProcessCtx(max_dets);
+}
+
+void SsdPostProcessDestroy(SsdPostProcessCtx_t *ctx) {
+  delete ctx;
+}
+
+void SsdPostProcessSetNms(SsdPostProcessCtx_t *ctx, const PostProcessNmsConfig_t *config) {
+  ctx->nms_config = config != NULL ? *config : PostProcessNmsDefaultConfig();
+}
+
+void SsddoProcess(hbDNNTensor *bbox_tensor, hbDNNTensor *cls_tensor, SsdPostProcessInfo_t *post_info, int layer) {
+  SsdCtxDoProcess(&ssd_default_ctx, bbox_tensor, cls_tensor, post_info, layer);
+}
+
+char* SsdPostProcess(SsdPostProcessInfo_t *post_info) {
+  return SsdCtxPostProcess(&ssd_default_ctx, post_info);
+}
+
+int SsdPostProcessBoxes(SsdPostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes) {
+  return SsdCtxGetBoxes(&ssd_default_ctx, post_info, boxes, max_boxes);
 }
 
@@ -8,6 +8,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <utility>
@@ -17,18 +18,39 @@
 #include <algorithm>
 #include <arm_neon.h>
 #include <queue>
+#include <new>
 
 #include "unet_post_process.h"
+#include "post_process_parallel.h"
 
 typedef struct Segmentation {
-  std::vector<int8_t> seg;
+  std::vector<uint8_t> seg;
   int32_t num_classes;
   int32_t width;
   int32_t height;
 }Segmentation;
 
+#define UNET_DEFAULT_MAX_PIXELS (512 * 512)
+#define UNET_MAX_CLASSES 256 /* 分割结果按 uint8_t 保存 */
+#define UNET_ARGMAX_PARALLEL_PIXELS (128 * 128) /* 少于这个像素数时不值得开线程 */
 
-Segmentation Segmentation_dets;
+// 一路后处理的上下文，分割结果的缓存预先分配好，逐帧复用
+struct UnetPostProcessCtx {
+  Segmentation dets;
+  PostProcessJson json;
+  int threads = 0; /* argmax 使用的线程数，<= 0 时按 CPU 核数 */
+  PostProcessWorkers workers;  /* argmax 用的常驻线程 */
+
+  explicit UnetPostProcessCtx(int max_pixels) {
+    dets.seg.reserve(max_pixels);
+    dets.width = 0;
+    dets.height = 0;
+    dets.num_classes = 0;
+  }
+};
+
+// 兼容原来的全局接口
+static UnetPostProcessCtx unet_default_ctx(UNET_DEFAULT_MAX_PIXELS);
 
 static inline uint32x4x4_t CalculateIndex(uint32_t idx,
                                           float32x4_t a,
@@ -95,7 +117,9 @@ static std::pair<float, int> MaxScoreID(int32_t *input,
   return result_id_score;
 }
 
-int PostProcessNone(hbDNNTensor *tensors, UnetPostProcessInfo_t *post_info, int layer) {
+static int PostProcessNone(UnetPostProcessCtx *ctx, hbDNNTensor *tensors, UnetPostProcessInfo_t *post_info, int layer) {
+
+  Segmentation &Segmentation_dets = ctx->dets;
 
   int height = tensors->properties.validShape.dimensionSize[1];
   int width = tensors->properties.validShape.dimensionSize[2];
@@ -107,25 +131,32 @@ int PostProcessNone(hbDNNTensor *tensors, UnetPostProcessInfo_t *post_info, int
   Segmentation_dets.height = height;
   Segmentation_dets.num_classes = layer;
 
+  uint8_t *seg = Segmentation_dets.seg.data();
+  int thread_num = height * width >= UNET_ARGMAX_PARALLEL_PIXELS ? PostProcessThreadNum(ctx->threads, height) : 1;
+
   // argmax, operate in NHWC format
-  for (int h = 0; h < height; ++h) {
-    for (int w = 0; w < width; ++w) {
-      float top_score = -1000000.0f;
-      int top_index = 0;
-      float *c_data = data + (width * h + w) * channel;
-      for (int c = 0; c < channel; c++) {
-        if (c_data[c] > top_score) {
-          top_score = c_data[c];
-          top_index = c;
+  ctx->workers.RunRows(thread_num, height, [=](int worker, int row_begin, int row_end) {
+    for (int h = row_begin; h < row_end; ++h) {
+      for (int w = 0; w < width; ++w) {
+        float top_score = -1000000.0f;
+        int top_index = 0;
+        float *c_data = data + (width * h + w) * channel;
+        for (int c = 0; c < channel; c++) {
+          if (c_data[c] > top_score) {
+            top_score = c_data[c];
+            top_index = c;
+          }
         }
+        seg[h * width + w] = top_index;
       }
-      Segmentation_dets.seg[h * width + w] = top_index;
     }
-  }
+  });
   return 0;
 }
 
-int PostProcessScale(hbDNNTensor *tensors, UnetPostProcessInfo_t *post_info, int layer) {
+static int PostProcessScale(UnetPostProcessCtx *ctx, hbDNNTensor *tensors, UnetPostProcessInfo_t *post_info, int layer) {
+
+  Segmentation &Segmentation_dets = ctx->dets;
 
   // get shape
   int height = tensors->properties.validShape.dimensionSize[1];
@@ -140,56 +171,175 @@ int PostProcessScale(hbDNNTensor *tensors, UnetPostProcessInfo_t *post_info, int
   Segmentation_dets.height = height;
   Segmentation_dets.num_classes = layer;
 
+  uint8_t *seg = Segmentation_dets.seg.data();
+  int thread_num = height * width >= UNET_ARGMAX_PARALLEL_PIXELS ? PostProcessThreadNum(ctx->threads, height) : 1;
+
   // argmax, operate in NHWC format
-  for (int h = 0; h < height; ++h) {
-    for (int w = 0; w < width; ++w) {
-      float top_score = -1000000.0f;
-      int top_index = 0;
-      int32_t *c_data = data + (width * h + w) * c_stride;
-      auto max_score_id = MaxScoreID(c_data, scale, channel);
-      top_score = max_score_id.first;
-      top_index = max_score_id.second;
-      Segmentation_dets.seg[h * width + w] = top_index;
+  ctx->workers.RunRows(thread_num, height, [=](int worker, int row_begin, int row_end) {
+    for (int h = row_begin; h < row_end; ++h) {
+      for (int w = 0; w < width; ++w) {
+        int32_t *c_data = data + (width * h + w) * c_stride;
+        seg[h * width + w] = MaxScoreID(c_data, scale, channel).second;
+      }
     }
-  }
+  });
   return 0;
 }
 
-void UnetdoProcess(hbDNNTensor *tensors, UnetPostProcessInfo_t *post_info, int layer) {
+void UnetCtxDoProcess(UnetPostProcessCtx_t *ctx, hbDNNTensor *tensors, UnetPostProcessInfo_t *post_info, int layer) {
 
   if (tensors->properties.quantiType == hbDNNQuantiType::SCALE) {
-    PostProcessScale(tensors, post_info, layer);
+    PostProcessScale(ctx, tensors, post_info, layer);
   } else if (tensors->properties.quantiType == hbDNNQuantiType::NONE) {
-    PostProcessNone(tensors, post_info, layer);
+    PostProcessNone(ctx, tensors, post_info, layer);
   } else {
     printf("error quanti_type: %d\n" ,tensors->properties.quantiType);
   }
 }
 
 
-char* UnetPostProcess(UnetPostProcessInfo_t *post_info) {
-
-  int i = 0;
-  char *str_dets;
+char* UnetCtxPostProcess(UnetPostProcessCtx_t *ctx, UnetPostProcessInfo_t *post_info) {
 
-  std::stringstream out_string;
+  Segmentation &Segmentation_dets = ctx->dets;
 
   // 算法结果转换成json格式
-  out_string << "\"unet_result\": [";
-  for (i = 0; i < Segmentation_dets.seg.size(); i++) {
-  	auto det_ret = Segmentation_dets.seg[i];
-  	out_string << std::to_string(det_ret);
-  	if (i < Segmentation_dets.seg.size() - 1)
-		out_string << ",";
+  PostProcessJson &json = ctx->json;
+  json.Reset();
+  json.Raw("\"unet_result\": [");
+  for (size_t i = 0; i < Segmentation_dets.seg.size(); i++) {
+    if (i > 0) {
+      json.Raw(",");
+    }
+    json.Int(Segmentation_dets.seg[i]);
   }
-  out_string << "]" << std::endl;
-
-  str_dets = (char *)malloc(out_string.str().length() + 1);
-  str_dets[out_string.str().length()] = '\0';
-  snprintf(str_dets, out_string.str().length(), "%s", out_string.str().c_str());
-  /*printf("str_dets: %s\n", str_dets);*/
+  json.Raw("]");
 
   Segmentation_dets.seg.clear();
-  return str_dets;
+  return json.Dup();
+}
+
+int UnetCtxGetMask(UnetPostProcessCtx_t *ctx, uint8_t *mask, int size, int *width, int *height) {
+
+  Segmentation &Segmentation_dets = ctx->dets;
+  int pixels = static_cast<int>(Segmentation_dets.seg.size());
+
+  if (width != nullptr) {
+    *width = Segmentation_dets.width;
+  }
+  if (height != nullptr) {
+    *height = Segmentation_dets.height;
+  }
+  if (mask != nullptr && size > 0) {
+    memcpy(mask, Segmentation_dets.seg.data(), std::min(size, pixels));
+  }
+  return pixels;
+}
+
+int UnetCtxGetRle(UnetPostProcessCtx_t *ctx, UnetRleRun_t *runs, int max_runs) {
+
+  const std::vector<uint8_t> &seg = ctx->dets.seg;
+  int run_num = 0;
+
+  size_t i = 0;
+  while (i < seg.size()) {
+    size_t start = i;
+    uint8_t id = seg[i];
+    while (i < seg.size() && seg[i] == id) {
+      i++;
+    }
+    if (runs != nullptr && run_num < max_runs) {
+      runs[run_num].id = id;
+      runs[run_num].count = static_cast<int32_t>(i - start);
+    }
+    run_num++;
+  }
+  return run_num;
+}
+
+int UnetCtxGetSummary(UnetPostProcessCtx_t *ctx, UnetClassSummary_t *summary, int max_classes) {
+
+  Segmentation &Segmentation_dets = ctx->dets;
+  int width = Segmentation_dets.width;
+  int height = Segmentation_dets.height;
+  if (Segmentation_dets.seg.empty()) {
+    return 0;
+  }
+
+  UnetClassSummary_t stats[UNET_MAX_CLASSES];
+  for (int c = 0; c < UNET_MAX_CLASSES; c++) {
+    stats[c].id = c;
+    stats[c].area = 0;
+    stats[c].xmin = width;
+    stats[c].ymin = height;
+    stats[c].xmax = -1;
+    stats[c].ymax = -1;
+  }
+
+  // 按行扫描，每一段同类像素只更新一次外接框
+  const uint8_t *seg = Segmentation_dets.seg.data();
+  for (int h = 0; h < height; h++) {
+    const uint8_t *row = seg + h * width;
+    int w = 0;
+    while (w < width) {
+      int start = w;
+      uint8_t id = row[w];
+      while (w < width && row[w] == id) {
+        w++;
+      }
+      UnetClassSummary_t &stat = stats[id];
+      stat.area += w - start;
+      stat.xmin = std::min(stat.xmin, start);
+      stat.xmax = std::max(stat.xmax, w - 1);
+      stat.ymin = std::min(stat.ymin, h);
+      stat.ymax = h;
+    }
+  }
+
+  int class_num = 0;
+  for (int c = 0; c < UNET_MAX_CLASSES; c++) {
+    if (stats[c].area == 0) {
+      continue;
+    }
+    if (summary != nullptr && class_num < max_classes) {
+      summary[class_num] = stats[c];
+    }
+    class_num++;
+  }
+  return class_num;
+}
+
+void UnetPostProcessSetThreads(UnetPostProcessCtx_t *ctx, int threads) {
+  ctx->threads = threads;
+}
+
+UnetPostProcessCtx_t *UnetPostProcessCreate(int max_pixels) {
+  if (max_pixels <= 0) {
+    max_pixels = UNET_DEFAULT_MAX_PIXELS;
+  }
+  return new (std::nothrow) UnetPostProcessCtx(max_pixels);
+}
+
+void UnetPostProcessDestroy(UnetPostProcessCtx_t *ctx) {
+  delete ctx;
+}
+
+void UnetdoProcess(hbDNNTensor *tensors, UnetPostProcessInfo_t *post_info, int layer) {
+  UnetCtxDoProcess(&unet_default_ctx, tensors, post_info, layer);
+}
+
+char* UnetPostProcess(UnetPostProcessInfo_t *post_info) {
+  return UnetCtxPostProcess(&unet_default_ctx, post_info);
+}
+
+int UnetPostProcessMask(uint8_t *mask, int size, int *width, int *height) {
+  return UnetCtxGetMask(&unet_default_ctx, mask, size, width, height);
+}
+
+int UnetPostProcessRle(UnetRleRun_t *runs, int max_runs) {
+  return UnetCtxGetRle(&unet_default_ctx, runs, max_runs);
+}
+
+int UnetPostProcessSummary(UnetClassSummary_t *summary, int max_classes) {
+  return UnetCtxGetSummary(&unet_default_ctx, summary, max_classes);
 }
 
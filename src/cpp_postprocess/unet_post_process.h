@@ -10,6 +10,7 @@
 #define _POST_PROCESS_UNET_POST_PROCESS_H_
 
 #include "dnn/hb_dnn.h"
+#include "post_process_output.h"
 
 #ifdef __cplusplus
   extern "C"{
@@ -26,6 +27,22 @@ typedef struct {
 	int is_pad_resize;
 } UnetPostProcessInfo_t;
 
+// 分割结果的游程编码，按行优先顺序展开，一段可以跨行
+typedef struct {
+	int32_t id;
+	int32_t count;
+} UnetRleRun_t;
+
+// 每个类别的像素数和外接框（像素坐标，闭区间）
+typedef struct {
+	int32_t id;
+	int32_t area;
+	int32_t xmin;
+	int32_t ymin;
+	int32_t xmax;
+	int32_t ymax;
+} UnetClassSummary_t;
+
   /**
    * Post process
    * @param[in] tensor: Model output tensors
@@ -37,6 +54,51 @@ typedef struct {
 
   void UnetdoProcess(hbDNNTensor *tensors, UnetPostProcessInfo_t *post_info, int layer);
 
+  // 后处理上下文：每个上下文独立保存一路模型输出的分割结果，内部缓存逐帧复用。
+  // 同一个上下文同一时间只能在一个线程里使用，不同上下文可以并行处理。
+  // 上面两个不带上下文的接口共用一个内部的默认上下文。
+  typedef struct UnetPostProcessCtx UnetPostProcessCtx_t;
+
+  /**
+   * 创建后处理上下文
+   * @param[in] max_pixels: 预分配的分割结果像素数，<= 0 时使用默认值
+   * @return 上下文句柄，失败返回 NULL
+   */
+  UnetPostProcessCtx_t *UnetPostProcessCreate(int max_pixels);
+
+  void UnetPostProcessDestroy(UnetPostProcessCtx_t *ctx);
+
+  void UnetCtxDoProcess(UnetPostProcessCtx_t *ctx, hbDNNTensor *tensors, UnetPostProcessInfo_t *post_info, int layer);
+
+  char* UnetCtxPostProcess(UnetPostProcessCtx_t *ctx, UnetPostProcessInfo_t *post_info);
+
+  // 下面几个接口直接读取上一次 DoProcess 的分割结果，不生成 json。
+  // 分割结果一直保留到下一次 DoProcess，可以多次读取；UnetCtxPostProcess 生成 json 之后会清空。
+  // 返回值都是完整结果需要的元素个数，只拷贝其中不超过缓冲区大小的部分，缓冲区传 NULL 时只查询大小。
+
+  /**
+   * 拷贝每个像素的类别 id，行优先
+   * @param[out] mask: 调用者提供的缓冲区
+   * @param[in] size: 缓冲区字节数
+   * @param[out] width/height: 分割结果的宽高，可以为 NULL
+   * @return 像素数
+   */
+  int UnetCtxGetMask(UnetPostProcessCtx_t *ctx, uint8_t *mask, int size, int *width, int *height);
+
+  int UnetCtxGetRle(UnetPostProcessCtx_t *ctx, UnetRleRun_t *runs, int max_runs);
+
+  // 只输出出现过的类别，按类别 id 升序
+  int UnetCtxGetSummary(UnetPostProcessCtx_t *ctx, UnetClassSummary_t *summary, int max_classes);
+
+  int UnetPostProcessMask(uint8_t *mask, int size, int *width, int *height);
+
+  int UnetPostProcessRle(UnetRleRun_t *runs, int max_runs);
+
+  int UnetPostProcessSummary(UnetClassSummary_t *summary, int max_classes);
+
+  // 设置 argmax 使用的线程数，<= 0 时按 CPU 核数；输出较小时始终单线程
+  void UnetPostProcessSetThreads(UnetPostProcessCtx_t *ctx, int threads);
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,8 +15,11 @@
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <new>
 
 #include "yolov3_post_process.h"
+#include "post_process_math.h"
+#include "post_process_parallel.h"
 
 /**
  * Config definition for Yolov3
@@ -145,291 +148,266 @@ typedef struct Detection {
   ~Detection() {}
 } Detection;
 
-std::vector<Detection> yolov3_dets;
+#define YOLOV3_DEFAULT_MAX_DETS 1024
+#define YOLOV3_PARALLEL_CELLS (52 * 52) /* 网格数少于这个值时单线程解码 */
+
+// 一路后处理的上下文，检测框、NMS 和类别概率用到的缓存都预先分配好，逐帧复用
+struct Yolov3PostProcessCtx {
+  std::vector<Detection> dets;
+  std::vector<Detection> results;
+  PostProcessNms nms;
+  PostProcessNmsConfig_t nms_config;
+  PostProcessJson json;
+  std::vector<float> class_pred;
+  int threads = 0; /* 解码使用的线程数，<= 0 时按 CPU 核数 */
+  std::vector<Detection> worker_dets[POST_PROCESS_MAX_THREADS]; /* worker 0 直接写 dets */
+  PostProcessWorkers workers;  /* 解码用的常驻线程 */
+  std::vector<int32_t> obj_qthr; /* 每个 anchor 的 objness 定点阈值 */
+
+  explicit Yolov3PostProcessCtx(int max_dets)
+      : class_pred(default_yolov3_config.class_num, 0.0) {
+    dets.reserve(max_dets);
+    results.reserve(max_dets);
+    nms.Reserve(max_dets);
+    nms_config = PostProcessNmsDefaultConfig();
+  }
+};
+
+// 兼容原来的全局接口
+static Yolov3PostProcessCtx yolov3_default_ctx(YOLOV3_DEFAULT_MAX_DETS);
 
 #define NMS_MAX_INPUT (400)
 
-static void yolov3_nms(std::vector<Detection> &input,
+static void yolov3_nms(Yolov3PostProcessCtx *ctx,
                float iou_threshold,
                int top_k,
-               std::vector<Detection> &result,
                bool suppress) {
- // sort order by score desc
-  std::stable_sort(input.begin(), input.end(), std::greater<Detection>());
-  if (input.size() > NMS_MAX_INPUT) {
-    input.resize(NMS_MAX_INPUT);
-  }
+  PostProcessNmsParam param;
+  param.iou_threshold = iou_threshold;
+  param.top_k = top_k;
+  param.max_input = NMS_MAX_INPUT;
+  param.class_agnostic = suppress;
+  param.config = ctx->nms_config;
+  PostProcessNmsDetections(ctx->nms, param, ctx->dets, ctx->results);
+}
 
-  std::vector<bool> skip(input.size(), false);
+float DequantiScale(int32_t data,
+                                                      bool big_endian,
+                                                      float &scale_value) {
+  return static_cast<float>(r_int32(data, big_endian)) * scale_value;
+}
 
-  // pre-calculate boxes area
-  std::vector<float> areas;
-  areas.reserve(input.size());
-  for (size_t i = 0; i < input.size(); i++) {
-    float width = input[i].bbox.xmax - input[i].bbox.xmin;
-    float height = input[i].bbox.ymax - input[i].bbox.ymin;
-    areas.push_back(width * height);
-  }
+// 一层输出解码时不变的参数
+struct Yolov3LayerParam {
+  int stride;
+  const std::pair<double, double> *anchors;
+  double w_ratio;
+  double h_ratio;
+  double w_padding;
+  double h_padding;
+  int ori_width;
+  int ori_height;
+};
 
-  int count = 0;
-  for (size_t i = 0; count < top_k && i < skip.size(); i++) {
-    if (skip[i]) {
-      continue;
-    }
-    skip[i] = true;
-    ++count;
+static void yolov3_layer_param(Yolov3PostProcessInfo_t *post_info, int layer, Yolov3LayerParam &param) {
+  param.stride = default_yolov3_config.strides[layer];
+  param.anchors = default_yolov3_config.anchors_table[layer].data();
 
-    for (size_t j = i + 1; j < skip.size(); ++j) {
-      if (skip[j]) {
-        continue;
-      }
-      if (suppress == false) {
-        if (input[i].id != input[j].id) {
-          continue;
-        }
-      }
+  param.h_ratio = post_info->height * 1.0 / post_info->ori_height;
+  param.w_ratio = post_info->width * 1.0 / post_info->ori_width;
+  double resize_ratio = std::min(param.w_ratio, param.h_ratio);
+  if (post_info->is_pad_resize) {
+    param.w_ratio = resize_ratio;
+    param.h_ratio = resize_ratio;
+  }
+  param.w_padding = (post_info->width - param.w_ratio * post_info->ori_width) / 2.0;
+  param.h_padding = (post_info->height - param.h_ratio * post_info->ori_height) / 2.0;
+  param.ori_width = post_info->ori_width;
+  param.ori_height = post_info->ori_height;
+}
 
-      // intersection area
-      float xx1 = std::max(input[i].bbox.xmin, input[j].bbox.xmin);
-      float yy1 = std::max(input[i].bbox.ymin, input[j].bbox.ymin);
-      float xx2 = std::min(input[i].bbox.xmax, input[j].bbox.xmax);
-      float yy2 = std::min(input[i].bbox.ymax, input[j].bbox.ymax);
-
-      if (xx2 > xx1 && yy2 > yy1) {
-        float area_intersection = (xx2 - xx1) * (yy2 - yy1);
-        float iou_ratio =
-            area_intersection / (areas[j] + areas[i] - area_intersection);
-        if (iou_ratio > iou_threshold) {
-          skip[j] = true;
-        }
-      }
-    }
-    result.push_back(input[i]);
+// box 为反量化之后的 (x, y, w, h)，中心点取 sigmoid，宽高取 exp，换算到原图上
+static void yolov3_add_detection(const Yolov3LayerParam &param,
+                                 const float *box,
+                                 int h,
+                                 int w,
+                                 int k,
+                                 double confidence,
+                                 int id,
+                                 std::vector<Detection> &dets) {
+  double anchor_x = param.anchors[k].first;
+  double anchor_y = param.anchors[k].second;
+
+  // 一次 exp 同时算出 exp(-x), exp(-y), exp(w), exp(h)
+  float e[4] = {-box[0], -box[1], box[2], box[3]};
+  PostProcessExpBox(e, e);
+
+  double box_center_x = (1.0 / (1.0 + e[0]) + w) * param.stride;
+  double box_center_y = (1.0 / (1.0 + e[1]) + h) * param.stride;
+
+  double box_scale_x = e[2] * anchor_x * param.stride;
+  double box_scale_y = e[3] * anchor_y * param.stride;
+
+  double xmin = (box_center_x - box_scale_x / 2.0);
+  double ymin = (box_center_y - box_scale_y / 2.0);
+  double xmax = (box_center_x + box_scale_x / 2.0);
+  double ymax = (box_center_y + box_scale_y / 2.0);
+
+  double xmin_org = (xmin - param.w_padding) / param.w_ratio;
+  double xmax_org = (xmax - param.w_padding) / param.w_ratio;
+  double ymin_org = (ymin - param.h_padding) / param.h_ratio;
+  double ymax_org = (ymax - param.h_padding) / param.h_ratio;
+
+  if (xmin_org > xmax_org || ymin_org > ymax_org) {
+    return;
   }
+
+  xmin_org = std::max(xmin_org, 0.0);
+  xmax_org = std::min(xmax_org, param.ori_width - 1.0);
+  ymin_org = std::max(ymin_org, 0.0);
+  ymax_org = std::min(ymax_org, param.ori_height - 1.0);
+
+  Bbox bbox(xmin_org, ymin_org, xmax_org, ymax_org);
+  dets.push_back(Detection(id,
+                           confidence,
+                           bbox,
+                           default_yolov3_config.class_names[id].c_str()));
 }
 
-float DequantiScale(int32_t data,
-                                                      bool big_endian,
-                                                      float &scale_value) {
-  return static_cast<float>(r_int32(data, big_endian)) * scale_value;
+// 按 worker 顺序合并，检测框的顺序和单线程一致
+static void yolov3_merge_dets(Yolov3PostProcessCtx *ctx, int thread_num) {
+  for (int i = 1; i < thread_num; i++) {
+    ctx->dets.insert(ctx->dets.end(), ctx->worker_dets[i].begin(), ctx->worker_dets[i].end());
+    ctx->worker_dets[i].clear();
+  }
 }
 
-void PostProcessQuantiScaleNHWC(
+// 置信度 = sigmoid(objness) * sigmoid(cls)，sigmoid(cls) <= 1，
+// 所以 objness 先和 logit(score_threshold) 比较，不到阈值的框不用再算 argmax 和 exp
+static void PostProcessQuantiScaleNHWC(
+    Yolov3PostProcessCtx *ctx,
     hbDNNTensor *tensor,
     Yolov3PostProcessInfo_t *post_info,
     int layer) {
   auto *data = reinterpret_cast<int32_t *>(tensor->sysMem[0].virAddr);
   float *scale = tensor->properties.scale.scaleData;
   int num_classes = default_yolov3_config.class_num;
-  int stride = default_yolov3_config.strides[layer];
   int num_pred = default_yolov3_config.class_num + 4 + 1;
+  int anchors_size = default_yolov3_config.anchors_table[layer].size();
 
-  std::vector<float> class_pred(default_yolov3_config.class_num, 0.0);
-  std::vector<std::pair<double, double>> &anchors =
-      default_yolov3_config.anchors_table[layer];
-
-  double h_ratio = post_info->height * 1.0 / post_info->ori_height;
-  double w_ratio = post_info->width * 1.0 / post_info->ori_width;
-  double resize_ratio = std::min(w_ratio, h_ratio);
-  if (post_info->is_pad_resize) {
-    w_ratio = resize_ratio;
-    h_ratio = resize_ratio;
-  }
+  Yolov3LayerParam param;
+  yolov3_layer_param(post_info, layer, param);
 
   int height = tensor->properties.validShape.dimensionSize[1];
   int width = tensor->properties.validShape.dimensionSize[2];
 
-  int channel_valid = tensor->properties.validShape.dimensionSize[3];
   int channel_aligned = tensor->properties.alignedShape.dimensionSize[3];
-  printf("channel_valid: %d\n", channel_valid);
-  printf("channel_aligned: %d\n", channel_aligned);
-
-  int anchors_size = anchors.size();
-  for (int32_t h = 0; h < height; h++) {
-    for (int32_t w = 0; w < width; w++) {
-      for (int k = 0; k < anchors_size; k++) {
-        double anchor_x = anchors[k].first;
-        double anchor_y = anchors[k].second;
-
-        int32_t *cur_data = data + k * num_pred;
-        float *cur_scale = scale + k * num_pred;
-        float objness = DequantiScale(cur_data[4], false, cur_scale[4]);
-
-        for (int index = 0; index < num_classes; ++index) {
-          class_pred[index] =
-              DequantiScale(cur_data[5 + index], false, cur_scale[5 + index]);
-        }
-
-        float id = argmax(class_pred.begin(), class_pred.end());
-        double x1 = 1 / (1 + std::exp(-objness)) * 1;
-        double x2 = 1 / (1 + std::exp(-class_pred[id]));
-        double confidence = x1 * x2;
-
-        if (confidence < post_info->score_threshold) {
-          continue;
-        }
 
-        float center_x = DequantiScale(cur_data[0], false, cur_scale[0]);
-        float center_y = DequantiScale(cur_data[1], false, cur_scale[1]);
-        float scale_x = DequantiScale(cur_data[2], false, cur_scale[2]);
-        float scale_y = DequantiScale(cur_data[3], false, cur_scale[3]);
-
-        double box_center_x =
-            ((1.0 / (1.0 + std::exp(-center_x))) + w) * stride;
-        double box_center_y =
-            ((1.0 / (1.0 + std::exp(-center_y))) + h) * stride;
-
-        double box_scale_x = std::exp(scale_x) * anchor_x * stride;
-        double box_scale_y = std::exp(scale_y) * anchor_y * stride;
-
-        double xmin = (box_center_x - box_scale_x / 2.0);
-        double ymin = (box_center_y - box_scale_y / 2.0);
-        double xmax = (box_center_x + box_scale_x / 2.0);
-        double ymax = (box_center_y + box_scale_y / 2.0);
-
-        double w_padding =
-            (post_info->width - w_ratio * post_info->ori_width) / 2.0;
-        double h_padding =
-            (post_info->height - h_ratio * post_info->ori_height) / 2.0;
-
-        double xmin_org = (xmin - w_padding) / w_ratio;
-        double xmax_org = (xmax - w_padding) / w_ratio;
-        double ymin_org = (ymin - h_padding) / h_ratio;
-        double ymax_org = (ymax - h_padding) / h_ratio;
+  // objness 的阈值换算到每个 anchor 的定点数上，预筛不用反量化
+  float score_threshold = post_info->score_threshold;
+  float obj_threshold = PostProcessLogitThreshold(score_threshold);
+  std::vector<int32_t> &obj_qthr = ctx->obj_qthr;
+  obj_qthr.resize(anchors_size);
+  for (int k = 0; k < anchors_size; k++) {
+    obj_qthr[k] = PostProcessQuantiThreshold(obj_threshold, scale[k * num_pred + 4]);
+  }
 
-        if (xmin_org > xmax_org || ymin_org > ymax_org) {
-          continue;
+  int thread_num = height * width >= YOLOV3_PARALLEL_CELLS ? PostProcessThreadNum(ctx->threads, height) : 1;
+  ctx->workers.RunRows(thread_num, height, [&](int worker, int row_begin, int row_end) {
+    std::vector<Detection> &dets = worker == 0 ? ctx->dets : ctx->worker_dets[worker];
+    for (int32_t h = row_begin; h < row_end; h++) {
+      for (int32_t w = 0; w < width; w++) {
+        int32_t *cell = data + (h * width + w) * channel_aligned;
+        for (int k = 0; k < anchors_size; k++) {
+          int32_t *cur_data = cell + k * num_pred;
+          if (cur_data[4] < obj_qthr[k]) {
+            continue;
+          }
+          float *cur_scale = scale + k * num_pred;
+          float objness = DequantiScale(cur_data[4], false, cur_scale[4]);
+
+          float max_cls_data;
+          int id = PostProcessArgmaxScale(cur_data + 5, cur_scale + 5, num_classes, &max_cls_data);
+          double confidence = static_cast<double>(PostProcessSigmoid(objness)) *
+                              PostProcessSigmoid(max_cls_data);
+
+          if (confidence < score_threshold) {
+            continue;
+          }
+
+          float box[4];
+          PostProcessDequantiBox(cur_data, cur_scale, box);
+          yolov3_add_detection(param, box, h, w, k, confidence, id, dets);
         }
-
-        xmin_org = std::max(xmin_org, 0.0);
-        xmax_org = std::min(xmax_org, post_info->ori_width - 1.0);
-        ymin_org = std::max(ymin_org, 0.0);
-        ymax_org = std::min(ymax_org, post_info->ori_height - 1.0);
-
-        Bbox bbox(xmin_org, ymin_org, xmax_org, ymax_org);
-        yolov3_dets.push_back(Detection((int)id,
-                                 confidence,
-                                 bbox,
-                                 default_yolov3_config.class_names[(int)id].c_str()));
       }
-      data = data + channel_aligned;
     }
-  }
+  });
+  yolov3_merge_dets(ctx, thread_num);
 }
 
-void PostProcessQuantiNoneNHWC(
+static void PostProcessQuantiNoneNHWC(
+    Yolov3PostProcessCtx *ctx,
     hbDNNTensor *tensor,
     Yolov3PostProcessInfo_t *post_info,
     int layer) {
   auto *data = reinterpret_cast<float *>(tensor->sysMem[0].virAddr);
   int num_classes = default_yolov3_config.class_num;
-  int stride = default_yolov3_config.strides[layer];
   int num_pred = default_yolov3_config.class_num + 4 + 1;
+  int anchors_size = default_yolov3_config.anchors_table[layer].size();
 
-  std::vector<float> class_pred(default_yolov3_config.class_num, 0.0);
-  std::vector<std::pair<double, double>> &anchors =
-      default_yolov3_config.anchors_table[layer];
-
-  double h_ratio = post_info->height * 1.0 / post_info->ori_height;
-  double w_ratio = post_info->width * 1.0 / post_info->ori_width;
-  double resize_ratio = std::min(w_ratio, h_ratio);
-  if (post_info->is_pad_resize) {
-    w_ratio = resize_ratio;
-    h_ratio = resize_ratio;
-  }
+  Yolov3LayerParam param;
+  yolov3_layer_param(post_info, layer, param);
 
   int height = tensor->properties.validShape.dimensionSize[1];
   int width = tensor->properties.validShape.dimensionSize[2];
 
-  int anchors_size = anchors.size();
-  for (int32_t h = 0; h < height; h++) {
-    for (int32_t w = 0; w < width; w++) {
-      for (int k = 0; k < anchors_size; k++) {
-        double anchor_x = anchors[k].first;
-        double anchor_y = anchors[k].second;
-        float *cur_data = data + k * num_pred;
-        float objness = cur_data[4];
-        for (int index = 0; index < num_classes; ++index) {
-          class_pred[index] = cur_data[5 + index];
-        }
-
-        float id = argmax(class_pred.begin(), class_pred.end());
-        double x1 = 1 / (1 + std::exp(-objness)) * 1;
-        double x2 = 1 / (1 + std::exp(-class_pred[id]));
-        double confidence = x1 * x2;
-
-        if (confidence < post_info->score_threshold) {
-          continue;
-        }
-
-        float center_x = cur_data[0];
-        float center_y = cur_data[1];
-        float scale_x = cur_data[2];
-        float scale_y = cur_data[3];
-
-        double box_center_x =
-            ((1.0 / (1.0 + std::exp(-center_x))) + w) * stride;
-        double box_center_y =
-            ((1.0 / (1.0 + std::exp(-center_y))) + h) * stride;
-
-        double box_scale_x = std::exp(scale_x) * anchor_x * stride;
-        double box_scale_y = std::exp(scale_y) * anchor_y * stride;
-
-        double xmin = (box_center_x - box_scale_x / 2.0);
-        double ymin = (box_center_y - box_scale_y / 2.0);
-        double xmax = (box_center_x + box_scale_x / 2.0);
-        double ymax = (box_center_y + box_scale_y / 2.0);
+  float score_threshold = post_info->score_threshold;
+  float obj_threshold = PostProcessLogitThreshold(score_threshold);
 
-        double w_padding =
-            (post_info->width - w_ratio * post_info->ori_width) / 2.0;
-        double h_padding =
-            (post_info->height - h_ratio * post_info->ori_height) / 2.0;
-
-        double xmin_org = (xmin - w_padding) / w_ratio;
-        double xmax_org = (xmax - w_padding) / w_ratio;
-        double ymin_org = (ymin - h_padding) / h_ratio;
-        double ymax_org = (ymax - h_padding) / h_ratio;
-
-        if (xmin_org > xmax_org || ymin_org > ymax_org) {
-          continue;
+  int thread_num = height * width >= YOLOV3_PARALLEL_CELLS ? PostProcessThreadNum(ctx->threads, height) : 1;
+  ctx->workers.RunRows(thread_num, height, [&](int worker, int row_begin, int row_end) {
+    std::vector<Detection> &dets = worker == 0 ? ctx->dets : ctx->worker_dets[worker];
+    for (int32_t h = row_begin; h < row_end; h++) {
+      for (int32_t w = 0; w < width; w++) {
+        float *cell = data + (h * width + w) * num_pred * anchors_size;
+        for (int k = 0; k < anchors_size; k++) {
+          float *cur_data = cell + k * num_pred;
+          if (cur_data[4] < obj_threshold) {
+            continue;
+          }
+
+          float max_cls_data;
+          int id = PostProcessArgmax(cur_data + 5, num_classes, &max_cls_data);
+          double confidence = static_cast<double>(PostProcessSigmoid(cur_data[4])) *
+                              PostProcessSigmoid(max_cls_data);
+
+          if (confidence < score_threshold) {
+            continue;
+          }
+
+          yolov3_add_detection(param, cur_data, h, w, k, confidence, id, dets);
         }
-
-        xmin_org = std::max(xmin_org, 0.0);
-        xmax_org = std::min(xmax_org, post_info->ori_width - 1.0);
-        ymin_org = std::max(ymin_org, 0.0);
-        ymax_org = std::min(ymax_org, post_info->ori_height - 1.0);
-
-        Bbox bbox(xmin_org, ymin_org, xmax_org, ymax_org);
-        yolov3_dets.push_back(Detection((int)id,
-                                 confidence,
-                                 bbox,
-                                 default_yolov3_config.class_names[(int)id].c_str()));
       }
-      data = data + num_pred * anchors.size();
     }
-  }
+  });
+  yolov3_merge_dets(ctx, thread_num);
 }
 
-void PostProcessNCHW(
+// NCHW 按 anchor 优先的顺序输出检测框，为了保持这个顺序不拆线程
+static void PostProcessNCHW(
+    Yolov3PostProcessCtx *ctx,
     hbDNNTensor *tensor,
     Yolov3PostProcessInfo_t *post_info,
     int layer) {
   auto *data = reinterpret_cast<float *>(tensor->sysMem[0].virAddr);
   int num_classes = default_yolov3_config.class_num;
-  int stride = default_yolov3_config.strides[layer];
   int num_pred = default_yolov3_config.class_num + 4 + 1;
+  int anchors_size = default_yolov3_config.anchors_table[layer].size();
 
-  std::vector<float> class_pred(default_yolov3_config.class_num, 0.0);
-  std::vector<std::pair<double, double>> &anchors =
-      default_yolov3_config.anchors_table[layer];
+  std::vector<float> &class_pred = ctx->class_pred;
 
-  double h_ratio = post_info->height * 1.0 / post_info->ori_height;
-  double w_ratio = post_info->width * 1.0 / post_info->ori_width;
-  double resize_ratio = std::min(w_ratio, h_ratio);
-  if (post_info->is_pad_resize) {
-    w_ratio = resize_ratio;
-    h_ratio = resize_ratio;
-  }
+  Yolov3LayerParam param;
+  yolov3_layer_param(post_info, layer, param);
 
   int height = tensor->properties.validShape.dimensionSize[2];
   int width = tensor->properties.validShape.dimensionSize[3];
@@ -438,98 +416,65 @@ void PostProcessNCHW(
   int aligned_w = tensor->properties.validShape.dimensionSize[3];
   int aligned_hw = aligned_h * aligned_w;
 
-  int anchors_size = anchors.size();
+  float score_threshold = post_info->score_threshold;
+  float obj_threshold = PostProcessLogitThreshold(score_threshold);
+
   for (int k = 0; k < anchors_size; k++) {
     for (int32_t h = 0; h < height; h++) {
       for (int32_t w = 0; w < width; w++) {
-        double anchor_x = anchors[k].first;
-        double anchor_y = anchors[k].second;
         int stride_hw = h * aligned_w + w;
 
         float objness = data[(k * num_pred + 4) * aligned_hw + stride_hw];
+        if (objness < obj_threshold) {
+          continue;
+        }
         for (int index = 0; index < num_classes; ++index) {
           class_pred[index] =
               data[(k * num_pred + index + 5) * aligned_hw + stride_hw];
         }
 
-        float id = argmax(class_pred.begin(), class_pred.end());
-        double x1 = 1 / (1 + std::exp(-objness)) * 1;
-        double x2 = 1 / (1 + std::exp(-class_pred[id]));
-        double confidence = x1 * x2;
+        float max_cls_data;
+        int id = PostProcessArgmax(class_pred.data(), num_classes, &max_cls_data);
+        double confidence = static_cast<double>(PostProcessSigmoid(objness)) *
+                            PostProcessSigmoid(max_cls_data);
 
-        if (confidence < post_info->score_threshold) {
+        if (confidence < score_threshold) {
           continue;
         }
 
-        float center_x = data[(k * num_pred) * aligned_hw + stride_hw];
-        float center_y = data[(k * num_pred + 1) * aligned_hw + stride_hw];
-        float scale_x = data[(k * num_pred + 2) * aligned_hw + stride_hw];
-        float scale_y = data[(k * num_pred + 3) * aligned_hw + stride_hw];
-
-        double box_center_x =
-            ((1.0 / (1.0 + std::exp(-center_x))) + w) * stride;
-        double box_center_y =
-            ((1.0 / (1.0 + std::exp(-center_y))) + h) * stride;
-
-	double box_scale_x = std::exp(scale_x) * anchor_x * stride;
-        double box_scale_y = std::exp(scale_y) * anchor_y * stride;
-
-        double xmin = (box_center_x - box_scale_x / 2.0);
-        double ymin = (box_center_y - box_scale_y / 2.0);
-        double xmax = (box_center_x + box_scale_x / 2.0);
-        double ymax = (box_center_y + box_scale_y / 2.0);
-
-        double w_padding =
-            (post_info->width - w_ratio * post_info->ori_width) / 2.0;
-        double h_padding =
-            (post_info->height - h_ratio * post_info->ori_height) / 2.0;
-
-        double xmin_org = (xmin - w_padding) / w_ratio;
-        double xmax_org = (xmax - w_padding) / w_ratio;
-        double ymin_org = (ymin - h_padding) / h_ratio;
-        double ymax_org = (ymax - h_padding) / h_ratio;
-
-        if (xmin_org > xmax_org || ymin_org > ymax_org) {
-          continue;
+        float box[4];
+        for (int i = 0; i < 4; i++) {
+          box[i] = data[(k * num_pred + i) * aligned_hw + stride_hw];
         }
-
-        xmin_org = std::max(xmin_org, 0.0);
-        xmax_org = std::min(xmax_org, post_info->ori_width - 1.0);
-        ymin_org = std::max(ymin_org, 0.0);
-        ymax_org = std::min(ymax_org, post_info->ori_height - 1.0);
-
-        Bbox bbox(xmin_org, ymin_org, xmax_org, ymax_org);
-        yolov3_dets.push_back(Detection((int)id,
-                                 confidence,
-                                 bbox,
-                                 default_yolov3_config.class_names[(int)id].c_str()));
+        yolov3_add_detection(param, box, h, w, k, confidence, id, ctx->dets);
       }
     }
   }
 }
 
 
-void PostProcessNHWC(
+static void PostProcessNHWC(
+    Yolov3PostProcessCtx *ctx,
     hbDNNTensor *tensor,
     Yolov3PostProcessInfo_t *post_info,
     int layer) {
   auto quanti_type = tensor->properties.quantiType;
   if (quanti_type == hbDNNQuantiType::SCALE) {
-    PostProcessQuantiScaleNHWC(tensor, post_info, layer);
+    PostProcessQuantiScaleNHWC(ctx, tensor, post_info, layer);
   } else if (quanti_type == hbDNNQuantiType::NONE) {
-    PostProcessQuantiNoneNHWC(tensor, post_info, layer);
+    PostProcessQuantiNoneNHWC(ctx, tensor, post_info, layer);
   } else {
     printf("PostProcessNHWC quanti_type : %d\n",  quanti_type);
   }
 }
 
 
-void Yolov3doProcess(hbDNNTensor *tensor, Yolov3PostProcessInfo_t *post_info, int layer) {
+void Yolov3CtxDoProcess(Yolov3PostProcessCtx_t *ctx, hbDNNTensor *tensor, Yolov3PostProcessInfo_t *post_info, int layer) {
 
   if (tensor->properties.quantizeAxis == 3) {
-    PostProcessNHWC(tensor, post_info, layer);
+    PostProcessNHWC(ctx, tensor, post_info, layer);
   } else if (tensor->properties.quantizeAxis == 1) {
-    PostProcessNCHW(tensor, post_info, layer);
+    PostProcessNCHW(ctx, tensor, post_info, layer);
   } else {
     printf("tensor layout error.\n");
   }
@@ -538,33 +483,70 @@ void Yolov3doProcess(hbDNNTensor *tensor, Yolov3PostProcessInfo_t *post_info, in
 
 // Yolov3 输出tensor格式
 // 3次下采样得到三组缩小后的gred，然后对每个gred进行三次预测，最后输出结果
-char* Yolov3PostProcess(Yolov3PostProcessInfo_t *post_info) {
+char* Yolov3CtxPostProcess(Yolov3PostProcessCtx_t *ctx, Yolov3PostProcessInfo_t *post_info) {
 
-  int i = 0;
-  char *str_yolov3_dets;
-  std::vector<Detection> det_restuls;
+  std::vector<Detection> &det_restuls = ctx->results;
 
   // 计算交并比来合并检测框，传入交并比阈值(0.65)和返回box数量(5000)
-  yolov3_nms(yolov3_dets, post_info->nms_threshold, post_info->nms_top_k, det_restuls, false);
-  std::stringstream out_string;
+  yolov3_nms(ctx, post_info->nms_threshold, post_info->nms_top_k, false);
 
   // 算法结果转换成json格式
-  int det_restuls_size = det_restuls.size();
-  out_string << "\"yolov3_result\": [";
-  for (i = 0; i < det_restuls_size; i++) {
-  	auto det_ret = det_restuls[i];
-  	out_string << det_ret;
-  	if (i < det_restuls_size - 1)
-		out_string << ",";
+  PostProcessJson &json = ctx->json;
+  json.Reset();
+  json.Raw("\"yolov3_result\": [");
+  for (size_t i = 0; i < det_restuls.size(); i++) {
+    const Detection &det = det_restuls[i];
+    if (i > 0) {
+      json.Raw(",");
+    }
+    json.Detection(det.bbox.xmin, det.bbox.ymin, det.bbox.xmax, det.bbox.ymax,
+                   det.score, det.id, default_yolov3_config.class_names[det.id].c_str());
   }
-  out_string << "]" << std::endl;
+  json.Raw("]");
 
-  str_yolov3_dets = (char *)malloc(out_string.str().length() + 1);
-  str_yolov3_dets[out_string.str().length()] = '\0';
-  snprintf(str_yolov3_dets, out_string.str().length(), "%s", out_string.str().c_str());
-  // printf("str_yolov3_dets: %s\n", str_yolov3_dets);
-  yolov3_dets.clear();
+  ctx->dets.clear();
   det_restuls.clear();
-  return str_yolov3_dets;
+  return json.Dup();
+}
+
+int Yolov3CtxGetBoxes(Yolov3PostProcessCtx_t *ctx, Yolov3PostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes) {
+
+  yolov3_nms(ctx, post_info->nms_threshold, post_info->nms_top_k, false);
+  int count = PostProcessPackBoxes(ctx->results, boxes, max_boxes);
+
+  ctx->dets.clear();
+  ctx->results.clear();
+  return count;
+}
+
+Yolov3PostProcessCtx_t *Yolov3PostProcessCreate(int max_dets) {
+  if (max_dets <= 0) {
+    max_dets = YOLOV3_DEFAULT_MAX_DETS;
+  }
+  return new (std::nothrow) Yolov3PostProcessCtx(max_dets);
+}
+
+void Yolov3PostProcessDestroy(Yolov3PostProcessCtx_t *ctx) {
+  delete ctx;
+}
+
+void Yolov3PostProcessSetNms(Yolov3PostProcessCtx_t *ctx, const PostProcessNmsConfig_t *config) {
+  ctx->nms_config = config != NULL ? *config : PostProcessNmsDefaultConfig();
+}
+
+void Yolov3PostProcessSetThreads(Yolov3PostProcessCtx_t *ctx, int threads) {
+  ctx->threads = threads;
+}
+
+void Yolov3doProcess(hbDNNTensor *tensor, Yolov3PostProcessInfo_t *post_info, int layer) {
+  Yolov3CtxDoProcess(&yolov3_default_ctx, tensor, post_info, layer);
+}
+
+char* Yolov3PostProcess(Yolov3PostProcessInfo_t *post_info) {
+  return Yolov3CtxPostProcess(&yolov3_default_ctx, post_info);
+}
+
+int Yolov3PostProcessBoxes(Yolov3PostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes) {
+  return Yolov3CtxGetBoxes(&yolov3_default_ctx, post_info, boxes, max_boxes);
 }
 
@@ -16,11 +16,13 @@
 #include <iomanip>
 #include <algorithm>
 #include <queue>
-#include <arm_neon.h>
+#include <new>
 
 // #include "utils/utils_log.h"
 
 #include "yolov5_post_process.h"
+#include "post_process_math.h"
+#include "post_process_parallel.h"
 
 #define BSWAP_32(x) static_cast<int32_t>(__builtin_bswap32(x))
 
@@ -190,8 +192,43 @@ typedef struct Detection {
   ~Detection() {}
 } Detection;
 
-std::vector<Detection> dets;
-std::vector<Detection> det_restuls;
+#define YOLOV5_DEFAULT_MAX_DETS 1024
+#define YOLOV5_PARALLEL_CELLS (80 * 80) /* 网格数少于这个值时单线程解码 */
+
+// 一路后处理的上下文，检测框和 NMS 用到的缓存都预先分配好，逐帧 clear 后复用
+struct Yolov5PostProcessCtx {
+  std::vector<Detection> dets;
+  std::vector<Detection> results;
+  PostProcessNms nms;
+  PostProcessNmsConfig_t nms_config;
+  PostProcessJson json;
+  int threads = 0; /* 解码使用的线程数，<= 0 时按 CPU 核数 */
+  std::vector<Detection> worker_dets[POST_PROCESS_MAX_THREADS]; /* worker 0 直接写 dets */
+  PostProcessWorkers workers;  /* 解码用的常驻线程 */
+  std::vector<int32_t> obj_qthr; /* 每个 anchor 的 objness 定点阈值 */
+
+  explicit Yolov5PostProcessCtx(int max_dets) {
+    dets.reserve(max_dets);
+    results.reserve(max_dets);
+    nms.Reserve(max_dets);
+    nms_config = PostProcessNmsDefaultConfig();
+  }
+};
+
+// 一层输出解码时不变的参数
+struct Yolov5LayerParam {
+  int stride;
+  const std::pair<double, double> *anchors;
+  double w_ratio;
+  double h_ratio;
+  double w_padding;
+  double h_padding;
+  int ori_width;
+  int ori_height;
+};
+
+// 兼容原来的全局接口
+static Yolov5PostProcessCtx yolov5_default_ctx(YOLOV5_DEFAULT_MAX_DETS);
 
 
 static float DequantiScale(int32_t data, bool big_endian, float &scale_value) {
@@ -216,68 +253,78 @@ static int get_tensor_hw(hbDNNTensor &tensor, int *height, int *width) {
   return 0;
 }
 
-static void yolov5_nms(std::vector<Detection> &input,
+static void yolov5_nms(Yolov5PostProcessCtx *ctx,
                float iou_threshold,
                int top_k,
-               std::vector<Detection> &result,
                bool suppress) {
-  // sort order by score desc
-  std::stable_sort(input.begin(), input.end(), std::greater<Detection>());
-
-  std::vector<bool> skip(input.size(), false);
-
-  // pre-calculate boxes area
-  std::vector<float> areas;
-  areas.reserve(input.size());
-  for (size_t i = 0; i < input.size(); i++) {
-    float width = input[i].bbox.xmax - input[i].bbox.xmin;
-    float height = input[i].bbox.ymax - input[i].bbox.ymin;
-    areas.push_back(width * height);
+  PostProcessNmsParam param;
+  param.iou_threshold = iou_threshold;
+  param.top_k = top_k;
+  param.max_input = 0;
+  param.class_agnostic = suppress;
+  param.config = ctx->nms_config;
+  PostProcessNmsDetections(ctx->nms, param, ctx->dets, ctx->results);
+}
+
+// box 为反量化之后的 (x, y, w, h)，取 sigmoid 之后换算到原图上，落在图像外的框丢弃
+static void yolov5_add_detection(const Yolov5LayerParam &param,
+                                 const float *raw_box,
+                                 int h,
+                                 int w,
+                                 int k,
+                                 double confidence,
+                                 int id,
+                                 std::vector<Detection> &dets) {
+  double anchor_x = param.anchors[k].first;
+  double anchor_y = param.anchors[k].second;
+
+  float box[4];
+  PostProcessSigmoidBox(raw_box, box);
+
+  double box_center_x = (box[0] * 2.0 - 0.5 + w) * param.stride;
+  double box_center_y = (box[1] * 2.0 - 0.5 + h) * param.stride;
+
+  double scale_x = box[2] * 2.0;
+  double scale_y = box[3] * 2.0;
+  double box_scale_x = scale_x * scale_x * anchor_x;
+  double box_scale_y = scale_y * scale_y * anchor_y;
+
+  double xmin = (box_center_x - box_scale_x / 2.0);
+  double ymin = (box_center_y - box_scale_y / 2.0);
+  double xmax = (box_center_x + box_scale_x / 2.0);
+  double ymax = (box_center_y + box_scale_y / 2.0);
+
+  double xmin_org = (xmin - param.w_padding) / param.w_ratio;
+  double xmax_org = (xmax - param.w_padding) / param.w_ratio;
+  double ymin_org = (ymin - param.h_padding) / param.h_ratio;
+  double ymax_org = (ymax - param.h_padding) / param.h_ratio;
+
+  if (xmax_org <= 0 || ymax_org <= 0) {
+    return;
   }
 
-  int count = 0;
-  for (size_t i = 0; count < top_k && i < skip.size(); i++) {
-    if (skip[i]) {
-      continue;
-    }
-    skip[i] = true;
-    ++count;
+  if (xmin_org > xmax_org || ymin_org > ymax_org) {
+    return;
+  }
 
-    for (size_t j = i + 1; j < skip.size(); ++j) {
-      if (skip[j]) {
-        continue;
-      }
-      if (suppress == false) {
-        if (input[i].id != input[j].id) {
-          continue;
-        }
-      }
+  // 把box的坐标限制在图像大小范围内
+  xmin_org = std::max(xmin_org, 0.0);
+  xmax_org = std::min(xmax_org, param.ori_width - 1.0);
+  ymin_org = std::max(ymin_org, 0.0);
+  ymax_org = std::min(ymax_org, param.ori_height - 1.0);
 
-      // intersection area
-      float xx1 = std::max(input[i].bbox.xmin, input[j].bbox.xmin);
-      float yy1 = std::max(input[i].bbox.ymin, input[j].bbox.ymin);
-      float xx2 = std::min(input[i].bbox.xmax, input[j].bbox.xmax);
-      float yy2 = std::min(input[i].bbox.ymax, input[j].bbox.ymax);
-
-      if (xx2 > xx1 && yy2 > yy1) {
-        float area_intersection = (xx2 - xx1) * (yy2 - yy1);
-        float iou_ratio =
-            area_intersection / (areas[j] + areas[i] - area_intersection);
-        if (iou_ratio > iou_threshold) {
-          skip[j] = true;
-        }
-      }
-    }
-    result.push_back(input[i]);
-  }
+  // 实际在原图上的box，添加到检测结果中
+  Bbox bbox(xmin_org, ymin_org, xmax_org, ymax_org);
+  dets.emplace_back(id,
+                    confidence,
+                    bbox,
+                    default_yolov5_config.class_names[id].c_str());
 }
 
-void Yolov5doProcess(hbDNNTensor *tensor, Yolov5PostProcessInfo_t *post_info, int layer) {
+void Yolov5CtxDoProcess(Yolov5PostProcessCtx_t *ctx, hbDNNTensor *tensor, Yolov5PostProcessInfo_t *post_info, int layer) {
 
   // 80个分类
   int num_classes = default_yolov5_config.class_num;
-  // 下采样值 8 16 32
-  int stride = default_yolov5_config.strides[layer];
   // 每个预测值占用多少空间
   // 一组条件类别概率，都是区间在[0,1]之间的值，代表概率。
   // box参数即box的中心点坐标（x,y）和box的宽和高（w,h）
@@ -288,209 +335,121 @@ void Yolov5doProcess(hbDNNTensor *tensor, Yolov5PostProcessInfo_t *post_info, in
    */
   int num_pred = default_yolov5_config.class_num + 4 + 1;
 
-  std::vector<float> class_pred(default_yolov5_config.class_num, 0.0);
   // 3组 预设检测框类型
   std::vector<std::pair<double, double>> &anchors = default_yolov5_config.anchors_table[layer];
+  int anchor_num = anchors.size();
+
+  Yolov5LayerParam param;
+  // 下采样值 8 16 32
+  param.stride = default_yolov5_config.strides[layer];
+  param.anchors = anchors.data();
 
   // 计算原始图像与算法推理实际使用图像的缩放比
-  double h_ratio = post_info->height * 1.0 / post_info->ori_height;
-  double w_ratio = post_info->width * 1.0 / post_info->ori_width;
-  double resize_ratio = std::min(w_ratio, h_ratio);
+  param.h_ratio = post_info->height * 1.0 / post_info->ori_height;
+  param.w_ratio = post_info->width * 1.0 / post_info->ori_width;
+  double resize_ratio = std::min(param.w_ratio, param.h_ratio);
   if (post_info->is_pad_resize) {
-    w_ratio = resize_ratio;
-    h_ratio = resize_ratio;
+    param.w_ratio = resize_ratio;
+    param.h_ratio = resize_ratio;
   }
-
-  // int height, width;
-  // auto ret = get_tensor_hw(*tensor, &height, &width);
-  // if (ret != 0) {
-  //   printf("get_tensor_hw failed\n");
-  // }
+  param.w_padding = (post_info->width - param.w_ratio * post_info->ori_width) / 2.0;
+  param.h_padding = (post_info->height - param.h_ratio * post_info->ori_height) / 2.0;
+  param.ori_width = post_info->ori_width;
+  param.ori_height = post_info->ori_height;
 
   int height = tensor->properties.validShape.dimensionSize[1];
   int width = tensor->properties.validShape.dimensionSize[2];
 
-  int anchor_num = anchors.size();
   auto quanti_type = tensor->properties.quantiType;
+  if (quanti_type != hbDNNQuantiType::NONE && quanti_type != hbDNNQuantiType::SCALE) {
+    printf("yolov5x unsupport shift dequantzie now!\n");
+    return;
+  }
 
-  if (quanti_type == hbDNNQuantiType::NONE) {
-    auto *data = reinterpret_cast<float *>(tensor->sysMem[0].virAddr);
-    for (int32_t h = 0; h < height; h++) {
-      for (int32_t w = 0; w < width; w++) {
-        for (int k = 0; k < anchor_num; k++) {
-          double anchor_x = anchors[k].first;
-          double anchor_y = anchors[k].second;
-          // 取出一个预测结果
-          float *cur_data = data + k * num_pred;
-          // 置信度
-          float objness = cur_data[4];
-
-          // 获得概率值最大的分类对应的编号，作为id
-          int id = argmax(cur_data + 5, cur_data + 5 + num_classes);
-          // 计算置信度
-          double x1 = 1 / (1 + std::exp(-objness)) * 1;
-          double x2 = 1 / (1 + std::exp(-cur_data[id + 5]));
-          double confidence = x1 * x2;
-
-          // 过滤执行度不足的检测框
-          if (confidence < post_info->score_threshold) {
-            continue;
-          }
+  // 置信度 = sigmoid(objness) * sigmoid(cls)，sigmoid(cls) <= 1，
+  // 所以 sigmoid(objness) 不到阈值的框一定会被过滤，直接在 sigmoid 之前比较 objness，
+  // 绝大部分框不用再算 argmax 和 exp
+  float score_threshold = post_info->score_threshold;
+  float obj_threshold = PostProcessLogitThreshold(score_threshold);
 
-          // box参数即box的中心点坐标（x,y）和box的宽和高（w,h）
-          float center_x = cur_data[0];
-          float center_y = cur_data[1];
-          float scale_x = cur_data[2];
-          float scale_y = cur_data[3];
-
-          double box_center_x =
-              ((1.0 / (1.0 + std::exp(-center_x))) * 2 - 0.5 + w) * stride;
-          double box_center_y =
-              ((1.0 / (1.0 + std::exp(-center_y))) * 2 - 0.5 + h) * stride;
-
-          double box_scale_x =
-              std::pow((1.0 / (1.0 + std::exp(-scale_x))) * 2, 2) * anchor_x;
-          double box_scale_y =
-              std::pow((1.0 / (1.0 + std::exp(-scale_y))) * 2, 2) * anchor_y;
-
-          double xmin = (box_center_x - box_scale_x / 2.0);
-          double ymin = (box_center_y - box_scale_y / 2.0);
-          double xmax = (box_center_x + box_scale_x / 2.0);
-          double ymax = (box_center_y + box_scale_y / 2.0);
-
-          double w_padding =
-              (post_info->width - w_ratio * post_info->ori_width) / 2.0;
-          double h_padding =
-              (post_info->height - h_ratio * post_info->ori_height) / 2.0;
-
-          double xmin_org = (xmin - w_padding) / w_ratio;
-          double xmax_org = (xmax - w_padding) / w_ratio;
-          double ymin_org = (ymin - h_padding) / h_ratio;
-          double ymax_org = (ymax - h_padding) / h_ratio;
-
-          if (xmax_org <= 0 || ymax_org <= 0) {
-            continue;
-          }
+  int thread_num = height * width >= YOLOV5_PARALLEL_CELLS ? PostProcessThreadNum(ctx->threads, height) : 1;
 
-          if (xmin_org > xmax_org || ymin_org > ymax_org) {
-            continue;
-          }
+  if (quanti_type == hbDNNQuantiType::NONE) {
+    auto *data = reinterpret_cast<float *>(tensor->sysMem[0].virAddr);
+    ctx->workers.RunRows(thread_num, height, [&](int worker, int row_begin, int row_end) {
+      std::vector<Detection> &dets = worker == 0 ? ctx->dets : ctx->worker_dets[worker];
+      for (int32_t h = row_begin; h < row_end; h++) {
+        for (int32_t w = 0; w < width; w++) {
+          float *cell = data + (h * width + w) * num_pred * anchor_num;
+          for (int k = 0; k < anchor_num; k++) {
+            // 取出一个预测结果
+            float *cur_data = cell + k * num_pred;
+            if (cur_data[4] < obj_threshold) {
+              continue;
+            }
 
-          // 把box的坐标限制在图像大小范围内
-          xmin_org = std::max(xmin_org, 0.0);
-          xmax_org = std::min(xmax_org, post_info->ori_width - 1.0);
-          ymin_org = std::max(ymin_org, 0.0);
-          ymax_org = std::min(ymax_org, post_info->ori_height - 1.0);
+            // 获得概率值最大的分类对应的编号，作为id
+            float max_cls_data;
+            int id = PostProcessArgmax(cur_data + 5, num_classes, &max_cls_data);
+            double confidence = static_cast<double>(PostProcessSigmoid(cur_data[4])) *
+                                PostProcessSigmoid(max_cls_data);
 
-          // 实际在原图上的box，添加到检测结果中
-          Bbox bbox(xmin_org, ymin_org, xmax_org, ymax_org);
-          dets.emplace_back((int)id,
-                    confidence,
-                    bbox,
-                    default_yolov5_config.class_names[(int)id].c_str());
+            // 过滤执行度不足的检测框
+            if (confidence < score_threshold) {
+              continue;
+            }
 
+            yolov5_add_detection(param, cur_data, h, w, k, confidence, id, dets);
+          }
         }
-        data = data + num_pred * anchors.size();
       }
-    }
-  }else if (quanti_type == hbDNNQuantiType::SCALE) {
+    });
+  } else {
     auto *data = reinterpret_cast<int32_t *>(tensor->sysMem[0].virAddr);
     auto dequantize_scale_ptr = reinterpret_cast<float *>(tensor->properties.scale.scaleData);
-    bool big_endian = false;
-    for (int32_t h = 0; h < height; h++) {
-      for (int32_t w = 0; w < width; w++) {
-        for (int k = 0; k < anchor_num; k++) {
-          double anchor_x = anchors[k].first;
-          double anchor_y = anchors[k].second;
-          int32_t *cur_data = data + k * num_pred;
-          int offset = num_pred * k;
-
-          float objness = DequantiScale(
-              cur_data[4], big_endian, *(dequantize_scale_ptr + offset + 4));
-
-          double max_cls_data = std::numeric_limits<double>::lowest();
-          int id{0};
-          float32x4_t max;
-          for (int cls = 0; cls < num_classes; cls += 4) {
-            for (int j = 0; j < 4; j++) {
-              float score = cur_data[cls + 5 + j] *
-                            dequantize_scale_ptr[offset + cls + 5 + j];
-              if (score > max_cls_data) {
-                max_cls_data = score;
-                id = cls + j;
-              }
-            }
-          }
 
-          double x1 = 1 / (1 + std::exp(-objness)) * 1;
-          double x2 = 1 / (1 + std::exp(-max_cls_data));
-          double confidence = x1 * x2;
+    // objness 的阈值换算到每个 anchor 的定点数上，预筛不用反量化
+    std::vector<int32_t> &obj_qthr = ctx->obj_qthr;
+    obj_qthr.resize(anchor_num);
+    for (int k = 0; k < anchor_num; k++) {
+      obj_qthr[k] = PostProcessQuantiThreshold(obj_threshold, dequantize_scale_ptr[num_pred * k + 4]);
+    }
 
-          if (confidence < post_info->score_threshold) {
-            continue;
-          }
+    ctx->workers.RunRows(thread_num, height, [&](int worker, int row_begin, int row_end) {
+      std::vector<Detection> &dets = worker == 0 ? ctx->dets : ctx->worker_dets[worker];
+      for (int32_t h = row_begin; h < row_end; h++) {
+        for (int32_t w = 0; w < width; w++) {
+          int32_t *cell = data + (h * width + w) * num_pred * anchor_num;
+          for (int k = 0; k < anchor_num; k++) {
+            int32_t *cur_data = cell + k * num_pred;
+            if (cur_data[4] < obj_qthr[k]) {
+              continue;
+            }
+            float *cur_scale = dequantize_scale_ptr + num_pred * k;
 
-          float center_x = DequantiScale(
-              cur_data[0], big_endian, *(dequantize_scale_ptr + offset));
-          float center_y = DequantiScale(
-              cur_data[1], big_endian, *(dequantize_scale_ptr + offset + 1));
-          float scale_x = DequantiScale(
-              cur_data[2], big_endian, *(dequantize_scale_ptr + offset + 2));
-          float scale_y = DequantiScale(
-              cur_data[3], big_endian, *(dequantize_scale_ptr + offset + 3));
-
-          double box_center_x =
-              ((1.0 / (1.0 + std::exp(-center_x))) * 2 - 0.5 + w) * stride;
-          double box_center_y =
-              ((1.0 / (1.0 + std::exp(-center_y))) * 2 - 0.5 + h) * stride;
-
-          double box_scale_x =
-              std::pow((1.0 / (1.0 + std::exp(-scale_x))) * 2, 2) * anchor_x;
-          double box_scale_y =
-              std::pow((1.0 / (1.0 + std::exp(-scale_y))) * 2, 2) * anchor_y;
-
-          double xmin = (box_center_x - box_scale_x / 2.0);
-          double ymin = (box_center_y - box_scale_y / 2.0);
-          double xmax = (box_center_x + box_scale_x / 2.0);
-          double ymax = (box_center_y + box_scale_y / 2.0);
-
-          double w_padding =
-              (post_info->width - w_ratio * post_info->ori_width) / 2.0;
-          double h_padding =
-              (post_info->height - h_ratio * post_info->ori_height) / 2.0;
-
-          double xmin_org = (xmin - w_padding) / w_ratio;
-          double xmax_org = (xmax - w_padding) / w_ratio;
-          double ymin_org = (ymin - h_padding) / h_ratio;
-          double ymax_org = (ymax - h_padding) / h_ratio;
-
-          if (xmax_org <= 0 || ymax_org <= 0) {
-            continue;
-          }
+            float objness = DequantiScale(cur_data[4], false, cur_scale[4]);
+            float max_cls_data;
+            int id = PostProcessArgmaxScale(cur_data + 5, cur_scale + 5, num_classes, &max_cls_data);
+            double confidence = static_cast<double>(PostProcessSigmoid(objness)) *
+                                PostProcessSigmoid(max_cls_data);
 
-          if (xmin_org > xmax_org || ymin_org > ymax_org) {
-            continue;
-          }
+            if (confidence < score_threshold) {
+              continue;
+            }
 
-          xmin_org = std::max(xmin_org, 0.0);
-          xmax_org = std::min(xmax_org, post_info->ori_width - 1.0);
-          ymin_org = std::max(ymin_org, 0.0);
-          ymax_org = std::min(ymax_org, post_info->ori_height - 1.0);
-          xmax_org = std::max(xmax_org, 0.0);
-          ymax_org = std::max(ymax_org, 0.0);
-
-          Bbox bbox(xmin_org, ymin_org, xmax_org, ymax_org);
-          dets.emplace_back((int)id,
-                            confidence,
-                            bbox,
-                            default_yolov5_config.class_names[(int)id].c_str());
+            float box[4];
+            PostProcessDequantiBox(cur_data, cur_scale, box);
+            yolov5_add_detection(param, box, h, w, k, confidence, id, dets);
+          }
         }
-        data = data + num_pred * anchors.size();
       }
-    }
-  } else {
-    printf("yolov5x unsupport shift dequantzie now!\n");
-    return;
+    });
+  }
+
+  // 按 worker 顺序合并，检测框的顺序和单线程一致
+  for (int i = 1; i < thread_num; i++) {
+    ctx->dets.insert(ctx->dets.end(), ctx->worker_dets[i].begin(), ctx->worker_dets[i].end());
+    ctx->worker_dets[i].clear();
   }
 }
 
@@ -498,32 +457,69 @@ void Yolov5doProcess(hbDNNTensor *tensor, Yolov5PostProcessInfo_t *post_info, in
 
 // Yolov5 输出tensor格式
 // 3次下采样得到三组缩小后的gred，然后对每个gred进行三次预测，最后输出结果
-char* Yolov5PostProcess(Yolov5PostProcessInfo_t *post_info) {
+char* Yolov5CtxPostProcess(Yolov5PostProcessCtx_t *ctx, Yolov5PostProcessInfo_t *post_info) {
 
-  int i = 0;
-  char *str_dets;
+  std::vector<Detection> &det_restuls = ctx->results;
 
   // 计算交并比来合并检测框，传入交并比阈值(0.65)和返回box数量(5000)
-  yolov5_nms(dets, post_info->nms_threshold, post_info->nms_top_k, det_restuls, false);
-  std::stringstream out_string;
+  yolov5_nms(ctx, post_info->nms_threshold, post_info->nms_top_k, false);
 
   // 算法结果转换成json格式
-  int det_restuls_size = det_restuls.size();
-  out_string << "\"yolov5_result\": [";
-  for (i = 0; i < det_restuls_size; i++) {
-  	auto det_ret = det_restuls[i];
-  	out_string << det_ret;
-  	if (i < det_restuls_size - 1)
-		out_string << ",";
+  PostProcessJson &json = ctx->json;
+  json.Reset();
+  json.Raw("\"yolov5_result\": [");
+  for (size_t i = 0; i < det_restuls.size(); i++) {
+    const Detection &det = det_restuls[i];
+    if (i > 0) {
+      json.Raw(",");
+    }
+    json.Detection(det.bbox.xmin, det.bbox.ymin, det.bbox.xmax, det.bbox.ymax,
+                   det.score, det.id, default_yolov5_config.class_names[det.id].c_str());
   }
-  out_string << "]" << std::endl;
+  json.Raw("]");
 
-  str_dets = (char *)malloc(out_string.str().length() + 1);
-  str_dets[out_string.str().length()] = '\0';
-  snprintf(str_dets, out_string.str().length(), "%s", out_string.str().c_str());
-  // printf("str_dets: %s\n", str_dets);
-  dets.clear();
+  ctx->dets.clear();
   det_restuls.clear();
-  return str_dets;
+  return json.Dup();
 }
 
+int Yolov5CtxGetBoxes(Yolov5PostProcessCtx_t *ctx, Yolov5PostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes) {
+
+  yolov5_nms(ctx, post_info->nms_threshold, post_info->nms_top_k, false);
+  int count = PostProcessPackBoxes(ctx->results, boxes, max_boxes);
+
+  ctx->dets.clear();
+  ctx->results.clear();
+  return count;
+}
+
+Yolov5PostProcessCtx_t *Yolov5PostProcessCreate(int max_dets) {
+  if (max_dets <= 0) {
+    max_dets = YOLOV5_DEFAULT_MAX_DETS;
+  }
+  return new (std::nothrow) Yolov5PostProcessCtx(max_dets);
+}
+
+void Yolov5PostProcessDestroy(Yolov5PostProcessCtx_t *ctx) {
+  delete ctx;
+}
+
+void Yolov5PostProcessSetNms(Yolov5PostProcessCtx_t *ctx, const PostProcessNmsConfig_t *config) {
+  ctx->nms_config = config != NULL ? *config : PostProcessNmsDefaultConfig();
+}
+
+void Yolov5PostProcessSetThreads(Yolov5PostProcessCtx_t *ctx, int threads) {
+  ctx->threads = threads;
+}
+
+void Yolov5doProcess(hbDNNTensor *tensor, Yolov5PostProcessInfo_t *post_info, int layer) {
+  Yolov5CtxDoProcess(&yolov5_default_ctx, tensor, post_info, layer);
+}
+
+char* Yolov5PostProcess(Yolov5PostProcessInfo_t *post_info) {
+  return Yolov5CtxPostProcess(&yolov5_default_ctx, post_info);
+}
+
+int Yolov5PostProcessBoxes(Yolov5PostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes) {
+  return Yolov5CtxGetBoxes(&yolov5_default_ctx, post_info, boxes, max_boxes);
+}
@@ -10,6 +10,8 @@
 #define _POST_PROCESS_YOLOV5_POST_PROCESS_H_
 
 #include "dnn/hb_dnn.h"
+#include "post_process_output.h"
+#include "post_process_nms.h"
 
 #ifdef __cplusplus
   extern "C"{
@@ -37,6 +39,41 @@ typedef struct {
 
   void Yolov5doProcess(hbDNNTensor *tensor, Yolov5PostProcessInfo_t *post_info, int layer);
 
+  // 后处理上下文：每个上下文独立保存一路模型输出的检测结果，内部缓存逐帧复用。
+  // 同一个上下文同一时间只能在一个线程里使用，不同上下文可以并行处理。
+  // 上面两个不带上下文的接口共用一个内部的默认上下文。
+  typedef struct Yolov5PostProcessCtx Yolov5PostProcessCtx_t;
+
+  /**
+   * 创建后处理上下文
+   * @param[in] max_dets: 预分配的检测框数量，<= 0 时使用默认值
+   * @return 上下文句柄，失败返回 NULL
+   */
+  Yolov5PostProcessCtx_t *Yolov5PostProcessCreate(int max_dets);
+
+  void Yolov5PostProcessDestroy(Yolov5PostProcessCtx_t *ctx);
+
+  void Yolov5CtxDoProcess(Yolov5PostProcessCtx_t *ctx, hbDNNTensor *tensor, Yolov5PostProcessInfo_t *post_info, int layer);
+
+  char* Yolov5CtxPostProcess(Yolov5PostProcessCtx_t *ctx, Yolov5PostProcessInfo_t *post_info);
+
+  /**
+   * 把结果写到调用者提供的数组里，不生成 json 字符串
+   * @param[out] boxes: 结果数组，按分数从高到低排列
+   * @param[in] max_boxes: 数组长度，超出的结果被丢弃
+   * @return 写入的结果个数
+   */
+  int Yolov5CtxGetBoxes(Yolov5PostProcessCtx_t *ctx, Yolov5PostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes);
+
+  // 使用默认上下文，和 Yolov5doProcess 配合使用
+  int Yolov5PostProcessBoxes(Yolov5PostProcessInfo_t *post_info, PostProcessBox_t *boxes, int max_boxes);
+
+  // 设置解码使用的线程数，<= 0 时按 CPU 核数；网格较小的输出层始终单线程
+  void Yolov5PostProcessSetThreads(Yolov5PostProcessCtx_t *ctx, int threads);
+
+  // 设置检测框去重的方法，默认贪心 NMS；config 为 NULL 时恢复默认
+  void Yolov5PostProcessSetNms(Yolov5PostProcessCtx_t *ctx, const PostProcessNmsConfig_t *config);
+
 #ifdef __cplusplus
 }
 #endif
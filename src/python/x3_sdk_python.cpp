@@ -307,9 +307,8 @@ PyObject *Camera_close_cam(libsrcampy_Object *self)
 
     VPPCamera *cam = (VPPCamera *)self->pobj;
 
-    cam->CloseCamera();
-
-    Py_RETURN_NONE;
+    // 还有帧租约没有归还时关闭失败，把错误返回给调用者
+    return Py_BuildValue("i", cam->CloseCamera());
 }
 
 PyObject *Camera_get_img(libsrcampy_Object *self, PyObject *args, PyObject *kw)
@@ -710,6 +709,67 @@ static PyObject *Display_set_graph_rect(libsrcampy_Object *self, PyObject *args,
     return Py_BuildValue("i", ((VPPDisplay *)pobj)->set_graph_rect(x0, y0, x1, y1, chn, flush, (uint32_t)color, line_width));
 }
 
+// rects 是 (x0, y0, x1, y1[, color[, line_width]]) 的列表，缺省项取 color/line_width 参数
+static PyObject *Display_set_graph_rects(libsrcampy_Object *self, PyObject *args, PyObject *kw)
+{
+    libsrcampy_Object *pobj = nullptr;
+    PyObject *rects_obj = nullptr, *seq = nullptr, *item = nullptr;
+    int chn = 2, flush = 0, line_width = 4, ret = 0;
+    uint64_t color = 0xffff0000;
+    Py_ssize_t i = 0, num = 0, item_len = 0;
+    vector<x3_disp_rect_t> rects;
+    static char *kwlist[] = {(char *)"rects", (char *)"chn", (char *)"flush",
+        (char *)"color", (char *)"line_width", NULL};
+
+    if (!self->pobj) {
+        PyErr_SetString(PyExc_Exception, "display not inited");
+        return Py_BuildValue("i", -1);
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "O|iili", kwlist, &rects_obj, &chn, &flush, &color, &line_width)) {
+        return Py_BuildValue("i", -1);
+    }
+
+    seq = PySequence_Fast(rects_obj, "rects must be a sequence");
+    if (seq == NULL) {
+        return NULL;
+    }
+    num = PySequence_Fast_GET_SIZE(seq);
+    rects.resize(num);
+    for (i = 0; i < num; i++) {
+        item = PySequence_Fast(PySequence_Fast_GET_ITEM(seq, i), "rect must be a sequence");
+        if (item == NULL) {
+            Py_DECREF(seq);
+            return NULL;
+        }
+        item_len = PySequence_Fast_GET_SIZE(item);
+        if (item_len < 4 || item_len > 6) {
+            PyErr_SetString(PyExc_ValueError, "rect must be (x0, y0, x1, y1[, color[, line_width]])");
+            Py_DECREF(item);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        rects[i].x0 = PyLong_AsLong(PySequence_Fast_GET_ITEM(item, 0));
+        rects[i].y0 = PyLong_AsLong(PySequence_Fast_GET_ITEM(item, 1));
+        rects[i].x1 = PyLong_AsLong(PySequence_Fast_GET_ITEM(item, 2));
+        rects[i].y1 = PyLong_AsLong(PySequence_Fast_GET_ITEM(item, 3));
+        rects[i].color = item_len > 4 ?
+            (uint32_t)PyLong_AsUnsignedLongMask(PySequence_Fast_GET_ITEM(item, 4)) : (uint32_t)color;
+        rects[i].line_width = item_len > 5 ?
+            (int)PyLong_AsLong(PySequence_Fast_GET_ITEM(item, 5)) : line_width;
+        Py_DECREF(item);
+    }
+    Py_DECREF(seq);
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+
+    pobj = (libsrcampy_Object *)self->pobj;
+
+    ret = ((VPPDisplay *)pobj)->set_graph_rects(rects.data(), (int)num, chn, flush);
+
+    return Py_BuildValue("i", ret);
+}
+
 static PyObject *Display_set_graph_word(libsrcampy_Object *self, PyObject *args, PyObject *kw)
 {
     libsrcampy_Object *pobj = nullptr;
@@ -732,6 +792,25 @@ static PyObject *Display_set_graph_word(libsrcampy_Object *self, PyObject *args,
     return Py_BuildValue("i", ((VPPDisplay *)pobj)->set_graph_word(x, y, PyBytes_AsString(str_obj), chn, flush, (uint32_t)color, line_width));
 }
 
+static PyObject *Display_present_graph(libsrcampy_Object *self, PyObject *args, PyObject *kw)
+{
+    libsrcampy_Object *pobj = nullptr;
+    int chn = 2;
+    static char *kwlist[] = {(char *)"chn", NULL};
+
+    if (!self->pobj) {
+        PyErr_SetString(PyExc_Exception, "display not inited");
+        return Py_BuildValue("i", -1);
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|i", kwlist, &chn)) {
+        return Py_BuildValue("i", -1);
+    }
+
+    pobj = (libsrcampy_Object *)self->pobj;
+
+    return Py_BuildValue("i", ((VPPDisplay *)pobj)->present_graph(chn));
+}
+
 static PyObject *Display_close(libsrcampy_Object *self)
 {
     if (!self->pobj) {
@@ -1046,7 +1125,9 @@ static PyMethodDef Display_methods[] = {
     {"display", (PyCFunction)Display_display, METH_VARARGS | METH_KEYWORDS, "Init display"},
     {"set_img", (PyCFunction)Display_set_img, METH_VARARGS | METH_KEYWORDS, "Set display image"},
     {"set_graph_rect", (PyCFunction)Display_set_graph_rect, METH_VARARGS | METH_KEYWORDS, "Set display grapth rect"},
+    {"set_graph_rects", (PyCFunction)Display_set_graph_rects, METH_VARARGS | METH_KEYWORDS, "Set display grapth rects in one call"},
     {"set_graph_word", (PyCFunction)Display_set_graph_word, METH_VARARGS | METH_KEYWORDS, "Set display grapth word"},
+    {"present_graph", (PyCFunction)Display_present_graph, METH_VARARGS | METH_KEYWORDS, "Present the graph layer once per frame"},
     {"close", (PyCFunction)Display_close, METH_NOARGS, "Closes Display."},
     {nullptr, nullptr, 0, nullptr},
 };
@@ -14,6 +14,8 @@ typedef enum {
     E_QUEUE_ERROR_FAILED,
     E_QUEUE_ERROR_TIMEOUT,
     E_QUEUE_ERROR_NO_MEM,
+    E_QUEUE_ERROR_FULL,
+    E_QUEUE_ERROR_EMPTY,
 } teQueueStatus;
 
 typedef struct
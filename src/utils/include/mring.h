@@ -0,0 +1,90 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2020 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+#ifndef MRING_H_
+#define MRING_H_
+
+#include <stdint.h>
+
+#include "mqueue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 无锁环形队列，用于替代 tsQueue 在帧传递路径上的 mutex + condvar
+// tsRingSpsc: 单生产者/单消费者，入队出队都是 wait-free
+// tsRingMpmc: 多生产者/多消费者，基于每个槽位的序号（bounded MPMC）
+// 两者都可以选择 eventfd 挂起模式：只有队列从空变为非空且有消费者在睡眠时才唤醒
+
+#define MRING_CACHE_LINE 64
+#define MRING_ALIGNED __attribute__((aligned(MRING_CACHE_LINE)))
+
+typedef enum {
+    E_RING_WAIT_NONE,    /* 只支持非阻塞的 Push/Pop */
+    E_RING_WAIT_EVENTFD, /* 额外支持 PopTimed，空队列时消费者挂起在 eventfd 上 */
+} teRingWaitMode;
+
+typedef struct
+{
+    int iEventFd;         /* -1 表示未启用挂起模式 */
+    uint32_t u32Sleepers; /* 正在（或准备）挂起的消费者数量 */
+} tsRingParker;
+
+typedef struct
+{
+    void **apvBuffer;
+    uint32_t u32Mask;
+
+    /* 消费者独占 */
+    uint32_t u32Head MRING_ALIGNED;
+    uint32_t u32TailCache;
+
+    /* 生产者独占 */
+    uint32_t u32Tail MRING_ALIGNED;
+    uint32_t u32HeadCache;
+
+    tsRingParker sParker MRING_ALIGNED;
+} tsRingSpsc;
+
+typedef struct
+{
+    uint32_t u32Seq;
+    void *pvData;
+} tsRingCell;
+
+typedef struct
+{
+    tsRingCell *asCells;
+    uint32_t u32Mask;
+
+    uint32_t u32EnqPos MRING_ALIGNED;
+    uint32_t u32DeqPos MRING_ALIGNED;
+
+    tsRingParker sParker MRING_ALIGNED;
+} tsRingMpmc;
+
+// u32Length 会向上取整到 2 的幂
+teQueueStatus mRingSpscCreate(tsRingSpsc *psRing, uint32_t u32Length, teRingWaitMode eWaitMode);
+teQueueStatus mRingSpscDestroy(tsRingSpsc *psRing);
+teQueueStatus mRingSpscPush(tsRingSpsc *psRing, void *pvData);
+teQueueStatus mRingSpscPop(tsRingSpsc *psRing, void **ppvData);
+teQueueStatus mRingSpscPopTimed(tsRingSpsc *psRing, uint32_t u32WaitTimeMil, void **ppvData);
+uint32_t mRingSpscCount(tsRingSpsc *psRing);
+int mRingSpscGetFd(tsRingSpsc *psRing);
+
+teQueueStatus mRingMpmcCreate(tsRingMpmc *psRing, uint32_t u32Length, teRingWaitMode eWaitMode);
+teQueueStatus mRingMpmcDestroy(tsRingMpmc *psRing);
+teQueueStatus mRingMpmcPush(tsRingMpmc *psRing, void *pvData);
+teQueueStatus mRingMpmcPop(tsRingMpmc *psRing, void **ppvData);
+teQueueStatus mRingMpmcPopTimed(tsRingMpmc *psRing, uint32_t u32WaitTimeMil, void **ppvData);
+uint32_t mRingMpmcCount(tsRingMpmc *psRing);
+int mRingMpmcGetFd(tsRingMpmc *psRing);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MRING_H_
@@ -0,0 +1,436 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "mring.h"
+
+#define RING_LOAD_ACQ(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RING_LOAD_RLX(p)     __atomic_load_n((p), __ATOMIC_RELAXED)
+#define RING_STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static uint32_t ring_round_up_pow2(uint32_t u32Length)
+{
+    uint32_t u32Size = 2;
+
+    while (u32Size < u32Length && u32Size < 0x80000000U)
+        u32Size <<= 1;
+    return u32Size;
+}
+
+static int64_t ring_now_ms(void)
+{
+    struct timespec sNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &sNow);
+    return (int64_t)sNow.tv_sec * 1000 + sNow.tv_nsec / 1000000;
+}
+
+/************************** eventfd 挂起/唤醒 ****************************/
+
+static teQueueStatus ring_parker_init(tsRingParker *psParker, teRingWaitMode eWaitMode)
+{
+    psParker->u32Sleepers = 0;
+    psParker->iEventFd = -1;
+
+    if (eWaitMode == E_RING_WAIT_EVENTFD) {
+        psParker->iEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (psParker->iEventFd < 0) {
+            printf("eventfd:%s\n", strerror(errno));
+            return E_QUEUE_ERROR_FAILED;
+        }
+    }
+    return E_QUEUE_OK;
+}
+
+static void ring_parker_deinit(tsRingParker *psParker)
+{
+    if (psParker->iEventFd >= 0) {
+        close(psParker->iEventFd);
+        psParker->iEventFd = -1;
+    }
+}
+
+/*******************************************************************************
+** 函 数 名  : ring_parker_notify
+** 功能描述  : 生产者发布数据后调用，只有在队列由空变为非空（bWasEmpty）并且有
+               消费者挂起时才写 eventfd，避免每次入队都进入内核
+** 输入参数  : tsRingParker *psParker
+             : int bWasEmpty
+** 返 回 值  :
+*******************************************************************************/
+static void ring_parker_notify(tsRingParker *psParker, int bWasEmpty)
+{
+    if (bWasEmpty && __atomic_load_n(&psParker->u32Sleepers, __ATOMIC_SEQ_CST) > 0) {
+        eventfd_write(psParker->iEventFd, 1);
+    }
+}
+
+/*******************************************************************************
+** 函 数 名  : ring_parker_wait
+** 功能描述  : 在 eventfd 上等待最多 i32WaitMil 毫秒，醒来后清空计数
+** 输入参数  : tsRingParker *psParker
+             : int32_t i32WaitMil
+** 返 回 值  : 0 被唤醒或超时，-1 出错
+*******************************************************************************/
+static int ring_parker_wait(tsRingParker *psParker, int32_t i32WaitMil)
+{
+    struct pollfd sPfd;
+    eventfd_t u64Val;
+    int ret;
+
+    sPfd.fd = psParker->iEventFd;
+    sPfd.events = POLLIN;
+    sPfd.revents = 0;
+
+    ret = poll(&sPfd, 1, i32WaitMil);
+    if (ret < 0 && errno != EINTR) {
+        printf("poll:%s\n", strerror(errno));
+        return -1;
+    }
+    if (ret > 0) {
+        eventfd_read(psParker->iEventFd, &u64Val);
+    }
+    return 0;
+}
+
+/************************** SPSC ring ****************************/
+
+/*******************************************************************************
+** 函 数 名  : mRingSpscCreate
+** 功能描述  : 创建单生产者/单消费者无锁队列
+** 输入参数  : tsRingSpsc *psRing
+             : uint32_t u32Length    队列深度，向上取整到 2 的幂
+             : teRingWaitMode eWaitMode
+** 返 回 值  :
+*******************************************************************************/
+teQueueStatus mRingSpscCreate(tsRingSpsc *psRing, uint32_t u32Length, teRingWaitMode eWaitMode)
+{
+    uint32_t u32Size = ring_round_up_pow2(u32Length);
+
+    memset(psRing, 0, sizeof(tsRingSpsc));
+    psRing->apvBuffer = calloc(u32Size, sizeof(void *));
+    if (!psRing->apvBuffer) {
+        return E_QUEUE_ERROR_NO_MEM;
+    }
+    psRing->u32Mask = u32Size - 1;
+
+    if (ring_parker_init(&psRing->sParker, eWaitMode) != E_QUEUE_OK) {
+        free(psRing->apvBuffer);
+        psRing->apvBuffer = NULL;
+        return E_QUEUE_ERROR_FAILED;
+    }
+    return E_QUEUE_OK;
+}
+
+teQueueStatus mRingSpscDestroy(tsRingSpsc *psRing)
+{
+    if (NULL == psRing->apvBuffer) {
+        return E_QUEUE_ERROR_FAILED;
+    }
+    ring_parker_deinit(&psRing->sParker);
+    free(psRing->apvBuffer);
+    psRing->apvBuffer = NULL;
+    return E_QUEUE_OK;
+}
+
+/*******************************************************************************
+** 函 数 名  : mRingSpscPush
+** 功能描述  : 入队，只能由唯一的生产者线程调用；队列满时立即返回
+               E_QUEUE_ERROR_FULL，不会阻塞
+** 输入参数  : tsRingSpsc *psRing
+             : void *pvData
+** 返 回 值  :
+*******************************************************************************/
+teQueueStatus mRingSpscPush(tsRingSpsc *psRing, void *pvData)
+{
+    uint32_t u32Tail = psRing->u32Tail;
+
+    if (u32Tail - psRing->u32HeadCache > psRing->u32Mask) {
+        psRing->u32HeadCache = RING_LOAD_ACQ(&psRing->u32Head);
+        if (u32Tail - psRing->u32HeadCache > psRing->u32Mask) {
+            return E_QUEUE_ERROR_FULL;
+        }
+    }
+
+    psRing->apvBuffer[u32Tail & psRing->u32Mask] = pvData;
+    RING_STORE_REL(&psRing->u32Tail, u32Tail + 1);
+
+    if (psRing->sParker.iEventFd >= 0) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        ring_parker_notify(&psRing->sParker,
+            __atomic_load_n(&psRing->u32Head, __ATOMIC_SEQ_CST) == u32Tail);
+    }
+    return E_QUEUE_OK;
+}
+
+/*******************************************************************************
+** 函 数 名  : mRingSpscPop
+** 功能描述  : 出队，只能由唯一的消费者线程调用；队列空时立即返回
+               E_QUEUE_ERROR_EMPTY
+** 输入参数  : tsRingSpsc *psRing
+             : void **ppvData
+** 返 回 值  :
+*******************************************************************************/
+teQueueStatus mRingSpscPop(tsRingSpsc *psRing, void **ppvData)
+{
+    uint32_t u32Head = psRing->u32Head;
+
+    if (u32Head == psRing->u32TailCache) {
+        psRing->u32TailCache = RING_LOAD_ACQ(&psRing->u32Tail);
+        if (u32Head == psRing->u32TailCache) {
+            return E_QUEUE_ERROR_EMPTY;
+        }
+    }
+
+    *ppvData = psRing->apvBuffer[u32Head & psRing->u32Mask];
+    RING_STORE_REL(&psRing->u32Head, u32Head + 1);
+    return E_QUEUE_OK;
+}
+
+/*******************************************************************************
+** 函 数 名  : mRingSpscPopTimed
+** 功能描述  : 具有超时等待功能的出队函数，需要以 E_RING_WAIT_EVENTFD 模式创建
+** 输入参数  : tsRingSpsc *psRing
+             : uint32_t u32WaitTimeMil
+             : void **ppvData
+** 返 回 值  :
+*******************************************************************************/
+teQueueStatus mRingSpscPopTimed(tsRingSpsc *psRing, uint32_t u32WaitTimeMil, void **ppvData)
+{
+    tsRingParker *psParker = &psRing->sParker;
+    int64_t i64Deadline = ring_now_ms() + u32WaitTimeMil;
+    int64_t i64Remain = 0;
+
+    if (psParker->iEventFd < 0) {
+        return E_QUEUE_ERROR_FAILED;
+    }
+
+    for (;;) {
+        if (mRingSpscPop(psRing, ppvData) == E_QUEUE_OK) {
+            return E_QUEUE_OK;
+        }
+
+        // 先登记为睡眠者再复查队列，与生产者的 notify 构成 Dekker 式握手，不会丢失唤醒
+        __atomic_add_fetch(&psParker->u32Sleepers, 1, __ATOMIC_SEQ_CST);
+        if (psRing->u32Head != __atomic_load_n(&psRing->u32Tail, __ATOMIC_SEQ_CST)) {
+            __atomic_sub_fetch(&psParker->u32Sleepers, 1, __ATOMIC_SEQ_CST);
+            continue;
+        }
+
+        i64Remain = i64Deadline - ring_now_ms();
+        if (i64Remain <= 0) {
+            __atomic_sub_fetch(&psParker->u32Sleepers, 1, __ATOMIC_SEQ_CST);
+            return E_QUEUE_ERROR_TIMEOUT;
+        }
+        if (ring_parker_wait(psParker, (int32_t)i64Remain) != 0) {
+            __atomic_sub_fetch(&psParker->u32Sleepers, 1, __ATOMIC_SEQ_CST);
+            return E_QUEUE_ERROR_FAILED;
+        }
+        __atomic_sub_fetch(&psParker->u32Sleepers, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+uint32_t mRingSpscCount(tsRingSpsc *psRing)
+{
+    return RING_LOAD_ACQ(&psRing->u32Tail) - RING_LOAD_ACQ(&psRing->u32Head);
+}
+
+int mRingSpscGetFd(tsRingSpsc *psRing)
+{
+    return psRing->sParker.iEventFd;
+}
+
+/************************** MPMC ring ****************************/
+
+/*******************************************************************************
+** 函 数 名  : mRingMpmcCreate
+** 功能描述  : 创建多生产者/多消费者有界无锁队列，每个槽位带一个序号：
+               seq == pos 表示可写，seq == pos + 1 表示可读
+** 输入参数  : tsRingMpmc *psRing
+             : uint32_t u32Length    队列深度，向上取整到 2 的幂
+             : teRingWaitMode eWaitMode
+** 返 回 值  :
+*******************************************************************************/
+teQueueStatus mRingMpmcCreate(tsRingMpmc *psRing, uint32_t u32Length, teRingWaitMode eWaitMode)
+{
+    uint32_t i = 0;
+    uint32_t u32Size = ring_round_up_pow2(u32Length);
+
+    memset(psRing, 0, sizeof(tsRingMpmc));
+    psRing->asCells = calloc(u32Size, sizeof(tsRingCell));
+    if (!psRing->asCells) {
+        return E_QUEUE_ERROR_NO_MEM;
+    }
+    for (i = 0; i < u32Size; i++) {
+        psRing->asCells[i].u32Seq = i;
+    }
+    psRing->u32Mask = u32Size - 1;
+
+    if (ring_parker_init(&psRing->sParker, eWaitMode) != E_QUEUE_OK) {
+        free(psRing->asCells);
+        psRing->asCells = NULL;
+        return E_QUEUE_ERROR_FAILED;
+    }
+    return E_QUEUE_OK;
+}
+
+teQueueStatus mRingMpmcDestroy(tsRingMpmc *psRing)
+{
+    if (NULL == psRing->asCells) {
+        return E_QUEUE_ERROR_FAILED;
+    }
+    ring_parker_deinit(&psRing->sParker);
+    free(psRing->asCells);
+    psRing->asCells = NULL;
+    return E_QUEUE_OK;
+}
+
+/*******************************************************************************
+** 函 数 名  : mRingMpmcPush
+** 功能描述  : 入队，可被多个线程并发调用；队列满时立即返回 E_QUEUE_ERROR_FULL
+** 输入参数  : tsRingMpmc *psRing
+             : void *pvData
+** 返 回 值  :
+*******************************************************************************/
+teQueueStatus mRingMpmcPush(tsRingMpmc *psRing, void *pvData)
+{
+    tsRingCell *psCell = NULL;
+    uint32_t u32Pos = RING_LOAD_RLX(&psRing->u32EnqPos);
+    uint32_t u32Seq = 0;
+    int32_t i32Diff = 0;
+
+    for (;;) {
+        psCell = &psRing->asCells[u32Pos & psRing->u32Mask];
+        u32Seq = RING_LOAD_ACQ(&psCell->u32Seq);
+        i32Diff = (int32_t)(u32Seq - u32Pos);
+        if (i32Diff == 0) {
+            if (__atomic_compare_exchange_n(&psRing->u32EnqPos, &u32Pos, u32Pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (i32Diff < 0) {
+            return E_QUEUE_ERROR_FULL;
+        } else {
+            u32Pos = RING_LOAD_RLX(&psRing->u32EnqPos);
+        }
+    }
+
+    psCell->pvData = pvData;
+    RING_STORE_REL(&psCell->u32Seq, u32Pos + 1);
+
+    if (psRing->sParker.iEventFd >= 0) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        ring_parker_notify(&psRing->sParker,
+            __atomic_load_n(&psRing->u32DeqPos, __ATOMIC_SEQ_CST) == u32Pos);
+    }
+    return E_QUEUE_OK;
+}
+
+/*******************************************************************************
+** 函 数 名  : mRingMpmcPop
+** 功能描述  : 出队，可被多个线程并发调用；队列空时立即返回 E_QUEUE_ERROR_EMPTY
+** 输入参数  : tsRingMpmc *psRing
+             : void **ppvData
+** 返 回 值  :
+*******************************************************************************/
+teQueueStatus mRingMpmcPop(tsRingMpmc *psRing, void **ppvData)
+{
+    tsRingCell *psCell = NULL;
+    uint32_t u32Pos = RING_LOAD_RLX(&psRing->u32DeqPos);
+    uint32_t u32Seq = 0;
+    int32_t i32Diff = 0;
+
+    for (;;) {
+        psCell = &psRing->asCells[u32Pos & psRing->u32Mask];
+        u32Seq = RING_LOAD_ACQ(&psCell->u32Seq);
+        i32Diff = (int32_t)(u32Seq - (u32Pos + 1));
+        if (i32Diff == 0) {
+            if (__atomic_compare_exchange_n(&psRing->u32DeqPos, &u32Pos, u32Pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (i32Diff < 0) {
+            return E_QUEUE_ERROR_EMPTY;
+        } else {
+            u32Pos = RING_LOAD_RLX(&psRing->u32DeqPos);
+        }
+    }
+
+    *ppvData = psCell->pvData;
+    RING_STORE_REL(&psCell->u32Seq, u32Pos + psRing->u32Mask + 1);
+    return E_QUEUE_OK;
+}
+
+static int ring_mpmc_is_empty(tsRingMpmc *psRing)
+{
+    uint32_t u32Pos = __atomic_load_n(&psRing->u32DeqPos, __ATOMIC_SEQ_CST);
+    tsRingCell *psCell = &psRing->asCells[u32Pos & psRing->u32Mask];
+
+    return __atomic_load_n(&psCell->u32Seq, __ATOMIC_SEQ_CST) != u32Pos + 1;
+}
+
+/*******************************************************************************
+** 函 数 名  : mRingMpmcPopTimed
+** 功能描述  : 具有超时等待功能的出队函数，需要以 E_RING_WAIT_EVENTFD 模式创建。
+               生产者只在空->非空时唤醒一个消费者，取到数据的消费者如果发现
+               队列仍非空且还有睡眠者，再接力唤醒下一个
+** 输入参数  : tsRingMpmc *psRing
+             : uint32_t u32WaitTimeMil
+             : void **ppvData
+** 返 回 值  :
+*******************************************************************************/
+teQueueStatus mRingMpmcPopTimed(tsRingMpmc *psRing, uint32_t u32WaitTimeMil, void **ppvData)
+{
+    tsRingParker *psParker = &psRing->sParker;
+    int64_t i64Deadline = ring_now_ms() + u32WaitTimeMil;
+    int64_t i64Remain = 0;
+
+    if (psParker->iEventFd < 0) {
+        return E_QUEUE_ERROR_FAILED;
+    }
+
+    for (;;) {
+        if (mRingMpmcPop(psRing, ppvData) == E_QUEUE_OK) {
+            if (!ring_mpmc_is_empty(psRing)) {
+                ring_parker_notify(psParker, 1);
+            }
+            return E_QUEUE_OK;
+        }
+
+        __atomic_add_fetch(&psParker->u32Sleepers, 1, __ATOMIC_SEQ_CST);
+        if (!ring_mpmc_is_empty(psRing)) {
+            __atomic_sub_fetch(&psParker->u32Sleepers, 1, __ATOMIC_SEQ_CST);
+            continue;
+        }
+
+        i64Remain = i64Deadline - ring_now_ms();
+        if (i64Remain <= 0) {
+            __atomic_sub_fetch(&psParker->u32Sleepers, 1, __ATOMIC_SEQ_CST);
+            return E_QUEUE_ERROR_TIMEOUT;
+        }
+        if (ring_parker_wait(psParker, (int32_t)i64Remain) != 0) {
+            __atomic_sub_fetch(&psParker->u32Sleepers, 1, __ATOMIC_SEQ_CST);
+            return E_QUEUE_ERROR_FAILED;
+        }
+        __atomic_sub_fetch(&psParker->u32Sleepers, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+uint32_t mRingMpmcCount(tsRingMpmc *psRing)
+{
+    uint32_t u32Enq = RING_LOAD_ACQ(&psRing->u32EnqPos);
+    uint32_t u32Deq = RING_LOAD_ACQ(&psRing->u32DeqPos);
+
+    return ((int32_t)(u32Enq - u32Deq) > 0) ? (u32Enq - u32Deq) : 0;
+}
+
+int mRingMpmcGetFd(tsRingMpmc *psRing)
+{
+    return psRing->sParker.iEventFd;
+}
@@ -7,9 +7,16 @@
 #ifndef __X3_SDK_CAM_H__
 #define __X3_SDK_CAM_H__
 
+#include <stdlib.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
 #include <sstream>
 #include <string>
 
+#include "mring.h"
+#include "x3_sdk_frame.h"
 #include "x3_sdk_wrap.h"
 
 namespace srpy_cam
@@ -19,12 +26,10 @@ namespace srpy_cam
 #define srpy_PIXEL_FORMAT_RAW  2
 #define CAMERA_CHN_NUM 6
 #define VPS_FEEDBACK_BUF_BUM 2
-
-enum DevModule {
-    Dev_SIF,
-    Dev_ISP,
-    Dev_IPU
-};
+#define VIN_DESC_EXTRA_NUM 8 /* SIF/ISP 取图预留的描述符数量 */
+#define VIN_LEASE_DRAIN_TIMEOUT_MS 3000 /* 关闭相机时等待帧租约全部归还的时间 */
+#define VPS_MAX_CHN_NUM 7
+#define VPS_CHN_LUT_SIZE 16 /* 2 的幂，至少是通道数的两倍，保证探测很短 */
 
 enum VPS_PROCESS_MODE {
     VPS_SCALE = 1,
@@ -33,19 +38,179 @@ enum VPS_PROCESS_MODE {
     VPS_SCALE_ROTATE_CROP = 4,
 };
 
+// 分辨率 -> 通道下标 的查找表项，一个分辨率可能对应多个通道
+typedef struct {
+    uint32_t m_key;      /* (width << 16) | height，0 表示空 */
+    uint32_t m_chn_mask; /* 命中的 m_vps_chn_attrs 下标位图 */
+} x3_vps_chn_lut_t;
+
 typedef struct {
     int m_enable;
     int m_vin_enable;         // 使能标志
     x3_vin_info_t m_vin_info; // 包括 sensor、 mipi、isp、 ldc、dis的配置
     int m_vps_enable;
     x3_vps_infos_t m_vps_infos; // vps的配置，支持多个vps group
+    x3_vps_chn_lut_t m_chn_lut[VPS_CHN_LUT_SIZE]; // 打开vps时建立，取图时 O(1) 查通道
+    uint32_t m_chn_all_mask;
 } x3_modules_info_t;
 
+class VPPCamera;
+
+typedef struct {
+    uint64_t m_capacity;       /* 池中描述符数量 */
+    uint64_t m_in_use;         /* 当前借出的描述符数量 */
+    uint64_t m_get_cnt;        /* 累计借出次数 */
+    uint64_t m_heap_alloc_cnt; /* 池耗尽时回退到堆上分配的次数 */
+} DescPoolStats;
+
+// 固定容量的描述符池，每个描述符按 cache line 对齐
+// 空闲链表使用无锁 MPMC 队列，取图/还图路径上不做任何堆分配
+// Deinit 时还有借出的描述符，存储保留到最后一个描述符 Put 回来再释放；
+// 池对象本身析构前，使用者要保证描述符已经全部归还
+template <typename T>
+class DescPool
+{
+  public:
+    DescPool() = default;
+    ~DescPool() { Deinit(); }
+    DescPool(const DescPool &) = delete;
+    DescPool &operator=(const DescPool &) = delete;
+
+    int Init(int capacity)
+    {
+        void *mem = nullptr;
+        void *ring = nullptr;
+
+        Deinit();
+        if (m_slots != nullptr) {
+            // 上一次借出的描述符还没有全部归还，存储既不能释放也不能复用
+            return -1;
+        }
+        if (capacity <= 0)
+            return -1;
+        if (posix_memalign(&mem, MRING_CACHE_LINE, sizeof(Slot) * capacity))
+            return -1;
+        // 队列内部按 cache line 对齐，C++14 的 new 不保证这种对齐，所以单独分配
+        if (posix_memalign(&ring, MRING_CACHE_LINE, sizeof(tsRingMpmc))) {
+            free(mem);
+            return -1;
+        }
+        m_free = static_cast<tsRingMpmc *>(ring);
+        if (mRingMpmcCreate(m_free, capacity, E_RING_WAIT_NONE) != E_QUEUE_OK) {
+            free(m_free);
+            m_free = nullptr;
+            free(mem);
+            return -1;
+        }
+        m_slots = static_cast<Slot *>(mem);
+        m_capacity = capacity;
+        for (int i = 0; i < capacity; i++) {
+            new (&m_slots[i].m_obj) T();
+            mRingMpmcPush(m_free, &m_slots[i].m_obj);
+        }
+        m_in_use.store(0);
+        m_retired.store(false);
+        m_released.store(false);
+        ResetStats();
+        return 0;
+    }
+
+    void Deinit()
+    {
+        if (m_slots == nullptr || m_retired.exchange(true))
+            return;
+        if (m_in_use.load() == 0)
+            Release();
+    }
+
+    // 借出一个值初始化的描述符，池耗尽或者已经 Deinit 时回退到 new 并计数
+    T *Get()
+    {
+        void *obj = nullptr;
+
+        m_get_cnt.fetch_add(1, std::memory_order_relaxed);
+        m_in_use.fetch_add(1, std::memory_order_relaxed);
+        if (m_slots != nullptr && !m_retired.load() && mRingMpmcPop(m_free, &obj) == E_QUEUE_OK) {
+            static_cast<T *>(obj)->~T();
+            return new (obj) T();
+        }
+        m_heap_alloc_cnt.fetch_add(1, std::memory_order_relaxed);
+        return new T();
+    }
+
+    void Put(T *obj)
+    {
+        if (obj == nullptr)
+            return;
+        if (Owns(obj)) {
+            // Deinit 之后不再放回空闲队列，只计数
+            if (!m_retired.load())
+                mRingMpmcPush(m_free, obj);
+        } else {
+            delete obj;
+        }
+        // 先放回再减计数，Deinit 看到计数为 0 时不会再有 Put 访问存储
+        if (m_in_use.fetch_sub(1) == 1 && m_retired.load())
+            Release();
+    }
+
+    void GetStats(DescPoolStats *stats)
+    {
+        stats->m_capacity = m_capacity;
+        stats->m_in_use = m_in_use.load(std::memory_order_relaxed);
+        stats->m_get_cnt = m_get_cnt.load(std::memory_order_relaxed);
+        stats->m_heap_alloc_cnt = m_heap_alloc_cnt.load(std::memory_order_relaxed);
+    }
+
+    void ResetStats()
+    {
+        m_get_cnt.store(0);
+        m_heap_alloc_cnt.store(0);
+    }
+
+  private:
+    struct alignas(MRING_CACHE_LINE) Slot {
+        T m_obj;
+    };
+
+    // Deinit 和最后一个 Put 可能同时看到计数归零，只释放一次
+    void Release()
+    {
+        if (m_released.exchange(true))
+            return;
+        for (int i = 0; i < m_capacity; i++)
+            m_slots[i].m_obj.~T();
+        mRingMpmcDestroy(m_free);
+        free(m_free);
+        m_free = nullptr;
+        free(m_slots);
+        m_slots = nullptr;
+        m_capacity = 0;
+    }
+
+    bool Owns(T *obj)
+    {
+        uintptr_t addr = reinterpret_cast<uintptr_t>(obj);
+        uintptr_t base = reinterpret_cast<uintptr_t>(m_slots);
+        return (m_slots != nullptr) && (addr >= base) &&
+               (addr < base + sizeof(Slot) * m_capacity);
+    }
+
+    Slot *m_slots = nullptr;
+    int m_capacity = 0;
+    tsRingMpmc *m_free = nullptr;
+    std::atomic<int64_t> m_in_use{0};
+    std::atomic<bool> m_retired{false};  /* 已经 Deinit，等借出的描述符归还 */
+    std::atomic<bool> m_released{false}; /* 存储已经释放 */
+    std::atomic<uint64_t> m_get_cnt{0};
+    std::atomic<uint64_t> m_heap_alloc_cnt{0};
+};
+
 class VPPCamera
 {
   public:
     VPPCamera() = default;
-    virtual ~VPPCamera() = default;
+    virtual ~VPPCamera();
 
     /**
      * @brief 开启相机
@@ -100,10 +265,12 @@ class VPPCamera
 
     /**
      * @brief 关闭相机
+     * 先拒绝新的帧租约，再等待已经借出的租约（包括还在 BPU 任务里的）全部归还，
+     * 之后才停止 VIO 并释放描述符池；等待超时则不做任何释放，返回失败，可以稍后重试
      * @param void
      *
      * @retval 0      成功
-     * @retval -1      失败
+     * @retval -1      失败，仍有帧租约没有归还
      */
     int CloseCamera(void);
 
@@ -176,6 +343,42 @@ class VPPCamera
     void ReturnImageFrame(ImageFrame *image_frame, DevModule module,
               int width, int height);
 
+    /**
+     * @brief 以租约方式获取图像（dqbuf），不拷贝数据，初始引用计数为 1
+     * @param [in] module        从哪个模块取图：0:SIF 1:ISP: 2: IPU CHN
+     * @param [in] width         IPU 通道的宽
+     * @param [in] height        IPU 通道的高
+     *
+     * @retval 非NULL   成功
+     * @retval NULL     失败
+     */
+    ImageFrameLease *AcquireImageFrame(DevModule module, int width, int height,
+            const int timeout = 0);
+
+    /**
+     * @brief 增加租约引用计数，供新的消费者共享同一帧
+     * @param [in] lease   AcquireImageFrame 返回的租约
+     */
+    void RetainImageFrame(ImageFrameLease *lease);
+
+    /**
+     * @brief 释放一个租约引用，引用计数归零时归还硬件 buffer（qbuf）
+     * @param [in] lease   AcquireImageFrame 返回的租约
+     */
+    void ReleaseImageFrame(ImageFrameLease *lease);
+
+    /**
+     * @brief 获取描述符池的统计信息，稳定运行后 m_heap_alloc_cnt 应保持为 0
+     * @param [out] buf_stats     hb_vio_buffer_t 描述符池
+     * @param [out] lease_stats   帧租约描述符池
+     */
+    void GetDescPoolStats(DescPoolStats *buf_stats, DescPoolStats *lease_stats);
+
+    /**
+     * @brief 清零描述符池的计数（容量和使用中数量除外），用于预热结束后开始统计
+     */
+    void ResetDescPoolStats(void);
+
     /**
      * @brief 获取pipe id
      *
@@ -196,12 +399,28 @@ class VPPCamera
     int GetChnId(Sdk_Object_e object, int for_bind, int width, int height);
 
   private:
+    int GetModuleFrame(ImageFrame *image_frame, DevModule module, int chn_id,
+            const int timeout);
+    void ReleaseModuleFrame(ImageFrame *image_frame, DevModule module, int chn_id);
+    int InitDescPools(void);
+    void DeinitDescPools(void);
+    void ResetChnOwners(void);
+    void LeaseDone(void);
+
     int m_pipe_id = -1;
     int init_ = 0;
     int video_format = srpy_PIXEL_FORMAT_NV12;
     int last_frame_id = 0;
     vp_param_t m_vp_param = {0};
     x3_modules_info_t m_x3_modules_info;
+    std::atomic<int> m_lease_cnt{0};
+    std::atomic<bool> m_closing{false}; /* CloseCamera 期间不再借出新的租约 */
+    std::mutex m_lease_mutex;
+    std::condition_variable m_lease_cond; /* 租约数归零时通知 CloseCamera */
+    // 每个 vps 通道当前被哪个模块绑定（Sdk_Object_e），VPP_CAMERA 表示未绑定，可直接取图
+    std::atomic<int> m_chn_owner[VPS_MAX_CHN_NUM];
+    DescPool<hb_vio_buffer_t> m_buf_pool;
+    DescPool<ImageFrameLease> m_lease_pool;
 };
 
 } // namespace srpy_cam
@@ -0,0 +1,162 @@
+/***************************************************************************
+ * @COPYRIGHT NOTICE
+ * @Copyright 2023 Horizon Robotics, Inc.
+ * @All rights reserved.
+ ***************************************************************************/
+#ifndef X3_SDK_CAPTURE_H_
+#define X3_SDK_CAPTURE_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "mring.h"
+#include "x3_sdk_frame.h"
+
+namespace srpy_cam
+{
+
+#define CAPTURE_MAX_CHN_NUM 32 /* 4 路 pipe * 7 个 vps 通道 */
+#define CAPTURE_FAKE_BUF_NUM 2 /* 模拟源默认的 buffer 数，和 VPS 通道的 VPS_FEEDBACK_BUF_BUM 一致 */
+
+// 帧就绪源：reactor 通过它知道通道什么时候有帧，并以非阻塞方式取帧
+class CaptureSource
+{
+  public:
+    virtual ~CaptureSource() = default;
+
+    // 可以加入 epoll 的就绪 fd，有帧时可读；返回 -1 表示取不到，reactor 拒绝启动
+    virtual int GetReadyFd() = 0;
+
+    // 非阻塞取一帧，没有帧时返回 nullptr，返回的租约引用计数为 1
+    virtual ImageFrameLease *TryAcquire() = 0;
+
+    // 释放一个租约引用，引用计数归零时归还 buffer
+    virtual void Release(ImageFrameLease *lease) = 0;
+};
+
+// VPS 输出通道，就绪 fd 由 HB_VPS_GetChnFd 提供，通道有帧时可读
+// 实现在 x3_sdk_capture_vps.cpp，reactor 本身不依赖 VIO，可以在主机上用 FakeCaptureSource 测试
+class VpsChannelSource : public CaptureSource
+{
+  public:
+    VpsChannelSource(VPPCamera *camera, int width, int height)
+        : m_camera(camera), m_width(width), m_height(height) {}
+
+    // 在 camera 打开之后调用，fd 归 VIO 所有，不需要关闭
+    int GetReadyFd() override;
+    ImageFrameLease *TryAcquire() override;
+    void Release(ImageFrameLease *lease) override;
+
+  private:
+    VPPCamera *m_camera;
+    int m_width;
+    int m_height;
+    int m_ready_fd = -1;
+};
+
+// 主机侧的模拟 VIO 源：按帧率用 timerfd 产生就绪事件，输出 NV12 测试帧
+// 用于没有 sensor 的环境下验证 reactor 的调度逻辑
+class FakeCaptureSource : public CaptureSource
+{
+  public:
+    FakeCaptureSource() = default;
+    ~FakeCaptureSource() override { Close(); }
+
+    int Open(int width, int height, int fps, int buf_num = CAPTURE_FAKE_BUF_NUM);
+    void Close();
+
+    int GetReadyFd() override { return m_timer_fd; }
+    ImageFrameLease *TryAcquire() override;
+    void Release(ImageFrameLease *lease) override;
+
+  private:
+    int m_timer_fd = -1;
+    int m_width = 0;
+    int m_height = 0;
+    int m_buf_num = 0;
+    int64_t m_frame_id = 0;
+    uint64_t m_pending = 0;
+    uint8_t *m_buffers = nullptr;
+    ImageFrameLease *m_leases = nullptr;
+    tsRingMpmc *m_free = nullptr;
+};
+
+// 多通道取图 reactor：一个线程等待所有 pipe 的所有使能通道，
+// 帧就绪后分发给回调，或者放入每个通道自己的无锁队列
+class VPPCaptureReactor
+{
+  public:
+    // 回调在 reactor 线程中执行，返回后 reactor 释放自己的引用；
+    // 如果需要在回调之外继续使用该帧，先调用 RetainFrame
+    using CaptureCallback = std::function<void(int chn, ImageFrameLease *lease)>;
+
+    VPPCaptureReactor() = default;
+    ~VPPCaptureReactor();
+
+    /**
+     * @brief 注册回调模式的通道，只能在 Start 之前调用
+     * @retval >=0   通道句柄
+     * @retval -1    失败
+     */
+    int AddChannel(CaptureSource *source, CaptureCallback callback);
+
+    /**
+     * @brief 注册队列模式的通道，帧放入 MPMC 队列，由 PopFrame 取出；
+     *        队列满时丢弃新帧并计数。Stop 会和 PopFrame 并发地清空队列，
+     *        所以这里不能用 SPSC
+     * @retval >=0   通道句柄
+     * @retval -1    失败
+     */
+    int AddChannel(CaptureSource *source, int queue_depth);
+
+    /**
+     * @brief 启动 reactor 线程，所有通道都必须有就绪 fd
+     * @retval 0      成功
+     * @retval -1     失败
+     */
+    int Start();
+    int Stop();
+
+    /**
+     * @brief 从队列模式的通道取一帧，使用完后调用 ReleaseFrame
+     * @retval 0      成功
+     * @retval -1     超时或失败
+     */
+    int PopFrame(int chn, ImageFrameLease **lease, int timeout_ms);
+
+    // 队列模式下用来等待该通道的 eventfd，可以加入调用者自己的 epoll
+    int GetChannelFd(int chn);
+
+    void RetainFrame(ImageFrameLease *lease);
+    void ReleaseFrame(int chn, ImageFrameLease *lease);
+
+    uint64_t GetFrameCount(int chn);
+    uint64_t GetDropCount(int chn);
+
+  private:
+    typedef struct {
+        CaptureSource *m_source;
+        CaptureCallback m_callback;
+        tsRingMpmc *m_queue;
+        std::atomic<uint64_t> m_frames;
+        std::atomic<uint64_t> m_dropped;
+    } CaptureChannel;
+
+    int AddChannel(CaptureSource *source, CaptureCallback callback, int queue_depth);
+    void Drain(int chn);
+    void Dispatch(int chn, ImageFrameLease *lease);
+    void Loop();
+
+    CaptureChannel m_chns[CAPTURE_MAX_CHN_NUM];
+    int m_chn_num = 0;
+    int m_epoll_fd = -1;
+    int m_stop_fd = -1;
+    std::atomic<bool> m_running{false};
+    std::unique_ptr<std::thread> m_thread;
+};
+
+} // namespace srpy_cam
+
+#endif // X3_SDK_CAPTURE_H_
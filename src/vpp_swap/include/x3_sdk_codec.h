@@ -21,8 +21,12 @@
 #include <cstring>
 #include <functional>
 #include <iostream>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 #include "vio/hb_comm_vdec.h"
 #include "vio/hb_comm_venc.h"
@@ -34,6 +38,7 @@
 #include "vio/hb_vot.h"
 #include "vio/hb_vp_api.h"
 
+#include "x3_sdk_dec_workers.h"
 #include "x3_vio_vdec.h"
 #include "x3_vio_venc.h"
 #include "x3_vio_vp.h"
@@ -53,6 +58,15 @@ enum {
     TYPE_JPEG
 };
 
+// 解码送流节奏
+enum {
+    DEC_PACE_FREE, /* 有空闲输入 buffer 就送，按硬件速度解码，用于离线转码、分析 */
+    DEC_PACE_PTS   /* 按码流时间戳送流，用于实时播放 */
+};
+
+#define VDEC_INPUT_MAX_NUM 32     /* 与 vp_param_t 中 mmz 数量一致 */
+#define CODEC_MAX_CHN_NUM 32      /* 编码、解码各自的通道数 */
+
 enum {
     MODE_VENC,
     MODE_VDEC,
@@ -70,6 +84,7 @@ struct x3_codec_param_t {
     bool is_quit = false;
     const char *fname;
     int frame_count;
+    int pace_mode = DEC_PACE_FREE;
     sem_t read_done;
     struct {
         int alloc_nums = 0;
@@ -79,7 +94,129 @@ struct x3_codec_param_t {
     };
 };
 
-class VPPCodec
+// 解码输入 buffer 的空闲环
+// buffer 以 src_idx 送入解码器，解码器按送入顺序消耗，
+// 根据 HB_VDEC_QueryStatus 中还在排队的输入数量得出哪些 src_idx 已经用完并放回空闲环
+class VdecInputRing
+{
+  public:
+    void Reset(int cnt)
+    {
+        m_cnt = cnt > VDEC_INPUT_MAX_NUM ? VDEC_INPUT_MAX_NUM : cnt;
+        m_free_head = 0;
+        m_free_num = m_cnt;
+        m_busy_head = 0;
+        m_busy_num = 0;
+        for (int i = 0; i < m_cnt; i++)
+            m_free[i] = i;
+    }
+
+    // 返回一个空闲的 src_idx，没有时返回 -1
+    int Acquire()
+    {
+        int idx = -1;
+
+        if (m_free_num == 0)
+            return -1;
+        idx = m_free[m_free_head];
+        m_free_head = (m_free_head + 1) % m_cnt;
+        m_free_num--;
+        return idx;
+    }
+
+    // src_idx 已经送入解码器
+    void Submit(int idx)
+    {
+        m_busy[(m_busy_head + m_busy_num) % m_cnt] = idx;
+        m_busy_num++;
+    }
+
+    // pending: 解码器中还在排队的输入数量；
+    // 最近一个出队的输入可能还在解码，多保留一个
+    void Reclaim(uint32_t pending)
+    {
+        int done = m_busy_num - static_cast<int>(pending) - (m_cnt > 1 ? 1 : 0);
+
+        while (done-- > 0) {
+            m_free[(m_free_head + m_free_num) % m_cnt] = m_busy[m_busy_head];
+            m_free_num++;
+            m_busy_head = (m_busy_head + 1) % m_cnt;
+            m_busy_num--;
+        }
+    }
+
+  private:
+    int m_cnt = 0;
+    int m_free[VDEC_INPUT_MAX_NUM];
+    int m_free_head = 0;
+    int m_free_num = 0;
+    int m_busy[VDEC_INPUT_MAX_NUM];
+    int m_busy_head = 0;
+    int m_busy_num = 0;
+};
+
+// 调用者持有的解码输入 buffer（VPPDecode::send_frame 的物理地址版本）
+// src_idx 由调用者指定，和 VdecInputRing 一样按送入顺序排队，根据解码器里还在排队的输入数量
+// 判断哪些已经读完，再按顺序交还给调用者；eos 包也占一个位置，但不交还
+class VdecExternalInput
+{
+  public:
+    bool Full() { return m_num == VDEC_INPUT_MAX_NUM; }
+
+    bool Empty() { return m_num == 0; }
+
+    // src_idx 为 -1 表示 eos 包
+    void Submit(int idx)
+    {
+        m_busy[(m_head + m_num) % VDEC_INPUT_MAX_NUM] = idx;
+        m_num++;
+    }
+
+    // 解码器已经停止，当前排队的 buffer 都不会再被读取
+    void Flush() { m_flush_num = m_num; }
+
+    // pending 同 VdecInputRing::Reclaim，最近一个出队的输入可能还在解码，多保留一个
+    // 返回一个已经读完的 src_idx，没有时返回 -1
+    int Reclaim(uint32_t pending)
+    {
+        int done = m_num - static_cast<int>(pending) - 1;
+        int idx = -1;
+
+        if (done < m_flush_num)
+            done = m_flush_num;
+        while (done-- > 0) {
+            idx = m_busy[m_head];
+            m_head = (m_head + 1) % VDEC_INPUT_MAX_NUM;
+            m_num--;
+            if (m_flush_num > 0)
+                m_flush_num--;
+            if (idx >= 0)
+                return idx;
+        }
+        return -1;
+    }
+
+  private:
+    int m_busy[VDEC_INPUT_MAX_NUM];
+    int m_head = 0;
+    int m_num = 0;
+    int m_flush_num = 0;
+};
+
+// 解码送流状态，可以在独立线程中循环推进，也可以由 VPPDecodeWorkers 的工作线程分步推进
+typedef struct {
+    x3_codec_param_t *param;
+    AVFormatContext *av_ctx;
+    AVPacket av_pkt;
+    int video_idx;
+    int raw_fd; /* 裸码流文件，-1 表示走 ffmpeg 解复用 */
+    bool first_packet;
+    bool eos;
+    int64_t pace_base_ts;
+    std::chrono::steady_clock::time_point pace_base_time;
+} x3_vdec_feed_t;
+
+class VPPCodec : public DecodeFeeder
 {
   public:
     using get_dec_name_ptr = function<string()>;
@@ -156,13 +293,31 @@ class VPPCodec
 
     int x3_vdec_stop()
     {
-        return HB_VDEC_StopRecvStream(m_chn);
+        int ret = HB_VDEC_StopRecvStream(m_chn);
+
+        x3_vdec_flush_external();
+        return ret;
     }
 
     int x3_vdec_restart();
 
     void x3_do_sync_decoding(void *param);
 
+    /**
+     * @brief 分步送流：open 之后反复调用 step，直到返回 DEC_FEED_DONE，再调用 close
+     *        x3_do_sync_decoding 就是在当前线程中完成这三步
+     */
+    int x3_vdec_feed_open(x3_codec_param_t *p_param);
+    int x3_vdec_feed_step() override;
+    void x3_vdec_feed_close() override;
+
+    int x3_vdec_send_stream(int chn, uint64_t paddr, char *vaddr, int src_idx, int size, int eos);
+
+    // 调用者持有的输入 buffer：送入时记下 src_idx，解码器读完后由 reclaim 按顺序取回
+    int x3_vdec_send_external(int chn, uint64_t paddr, char *vaddr, int src_idx, int size, int eos);
+    int x3_vdec_reclaim_external();
+    void x3_vdec_flush_external();
+
     ImageFrame *x3_vdec_get_frame();
 
     int x3_vdec_put_frame(ImageFrame *frame);
@@ -181,6 +336,12 @@ class VPPCodec
     int x3_av_open_stream(x3_codec_param_t *p_param,
                           AVFormatContext **p_avContext, AVPacket *p_avpacket);
 
+    int x3_vdec_try_input();
+
+    int x3_vdec_feed_raw(x3_vdec_feed_t *feed);
+
+    bool x3_vdec_is_raw_stream(const char *fname);
+
   protected:
     std::atomic_flag m_vp_inited = ATOMIC_FLAG_INIT;
 
@@ -215,6 +376,18 @@ class VPPCodec
 
     VIDEO_FRAME_S m_dec_pstFrame;
 
+    VdecInputRing m_dec_input;
+
+    VdecExternalInput m_dec_ext;
+
+    x3_vdec_feed_t m_dec_feed;
+
+    uint64_t m_dec_pkt_cnt = 0;
+
+    int64_t m_enc_frame_id = 0;
+
+    int64_t m_dec_frame_id = 0;
+
     std::mutex m_dec_mtx;
 };
 
@@ -246,6 +419,15 @@ class VPPEncode
 
   private:
     atomic_flag m_enc_inited = ATOMIC_FLAG_INIT;
+
+    // 第一次 do_encoding 的参数，之后的调用必须一致
+    int m_chn = -1;
+    int m_type = 0;
+    int m_width = 0;
+    int m_height = 0;
+    int m_bits = 0;
+
+    int start_encoder();
 };
 
 class VPPDecode
@@ -270,8 +452,20 @@ class VPPDecode
 
     int send_frame(int chn, void *addr, int size, int eos);
 
+    // 送入调用者持有的物理连续 buffer（例如 HB_SYS_Alloc 分配的内存），不做拷贝。
+    // src_idx 是调用者给该 buffer 的编号（0 ~ VDEC_INPUT_MAX_NUM-1），原样传给解码器；
+    // reclaim_frame 交还这个编号之前不能改写该 buffer。最多 VDEC_INPUT_MAX_NUM 个没有交还，超出时返回 -1
+    int send_frame(int chn, uint64_t paddr, void *vaddr, int src_idx, int size, int eos);
+
+    // 按送入顺序返回一个解码器已经读完的 src_idx，没有时返回 -1，不阻塞。
+    // 最近送入的一个 buffer 要等后面的输入（包括 eos）被解码器取走，或者 undo_decoding 之后才交还
+    int reclaim_frame();
+
     int put_frame(ImageFrame *frame);
 
+    // 设置文件/rtsp 解码的送流节奏：DEC_PACE_FREE 或 DEC_PACE_PTS，下一次 do_decoding 生效
+    int set_pace_mode(int mode);
+
   public:
     std::unique_ptr<VPPCodec> m_dec_obj = nullptr;
 
@@ -282,9 +476,72 @@ class VPPDecode
 
     string m_dec_file;
 
+    int m_pace_mode = DEC_PACE_FREE;
+
+    // 第一次 do_decoding 的参数，之后的调用必须一致
+    int m_chn = -1;
+    int m_type = 0;
+    int m_width = 0;
+    int m_height = 0;
+    int m_mode = 0;
+
+    int m_send_cnt = 0;
+
     atomic_flag m_start_once = ATOMIC_FLAG_INIT;
 
     shared_ptr<thread> m_running_thread;
+
+    // 为 true 时送流交给 VPPDecodeWorkers，不再单独起线程
+    bool m_use_workers = false;
+
+    void start_feeding();
+
+    void stop_feeding();
+
+    int start_decoder();
+
+    friend class VPPDecodeManager;
+};
+
+// 编解码通道号分配，编码、解码各有 CODEC_MAX_CHN_NUM 个通道，进程内的所有实例共享
+class VPPCodecChns
+{
+  public:
+    // chn < 0 时自动分配一个空闲通道，返回分配到的通道号，失败返回 -1
+    static int Alloc(int codec_type, int chn);
+
+    static void Free(int codec_type, int chn);
+
+  private:
+    static std::mutex s_mtx;
+    static uint32_t s_used[MODE_INVAL];
+};
+
+// 同一进程中同时运行多路解码：每一路是独立的 VPPDecode，
+// 通道号从解码通道预算中分配，送流共用 VPPDecodeWorkers
+class VPPDecodeManager
+{
+  public:
+    ~VPPDecodeManager() { CloseAll(); }
+
+    /**
+     * @brief 打开一路文件或 rtsp 解码
+     * @param[in] chn  解码通道号，-1 表示自动分配
+     * @retval >=0     解码通道号
+     * @retval -1      失败
+     */
+    int Open(const char *file_name, int type, int width, int height,
+             int *frame_cnt, int chn = -1, int dec_mode = 1);
+
+    VPPDecode *Get(int chn);
+
+    int Close(int chn);
+
+    void CloseAll();
+
+  private:
+    std::mutex m_mtx;
+    std::unique_ptr<VPPDecode> m_decoders[CODEC_MAX_CHN_NUM];
 };
 
 }; // namespace srpy_cam
@@ -0,0 +1,87 @@
+/*
+ * Horizon Robotics
+ *
+ * Copyright (C) 2023 Horizon Robotics Inc.
+ * All rights reserved.
+ * Author:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef _X3_SDK_DEC_WORKERS_H_
+#define _X3_SDK_DEC_WORKERS_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace srpy_cam
+{
+
+#define DEC_FEED_RECLAIM_US 1000 /* 没有空闲输入 buffer 时查询解码器状态的间隔 */
+#define DEC_WORKER_NUM 2          /* 多路解码共享的送流线程数 */
+
+// x3_vdec_feed_step 的返回值
+enum {
+    DEC_FEED_SENT, /* 送出了一包，或者有进展 */
+    DEC_FEED_IDLE, /* 没有空闲输入 buffer，或者还没到送流时间 */
+    DEC_FEED_DONE  /* 码流结束或者出错，需要调用 x3_vdec_feed_close */
+};
+
+// 可以由 VPPDecodeWorkers 分步推进的送流，VPPCodec 实现这个接口，测试程序用软件模拟的解码器实现
+class DecodeFeeder
+{
+  public:
+    virtual ~DecodeFeeder() = default;
+
+    virtual int x3_vdec_feed_step() = 0;
+    virtual void x3_vdec_feed_close() = 0;
+};
+
+// 多路解码共享的送流线程池
+// 所有通道放在一个列表里，空闲的工作线程按顺序取下一个没有被推进的通道推进一步，
+// 连续一轮都没有进展时才短暂休眠。推进时不持锁，并把通道标记为忙，同一通道同一时间只在一个线程里推进；
+// 某一路送流阻塞（例如 SendStream 等待超时、rtsp 重连）只占住一个工作线程，
+// 其他通道由别的工作线程继续推进，Attach/Detach 也不用等它
+class VPPDecodeWorkers
+{
+  public:
+    static VPPDecodeWorkers &Instance();
+
+    ~VPPDecodeWorkers();
+
+    // feeder 的送流已经 open，之后由工作线程推进，结束时工作线程负责 close
+    void Attach(DecodeFeeder *feeder);
+
+    // 返回后工作线程不会再访问 feeder；正在推进时等这一步结束，送流还没结束时在这里 close
+    void Detach(DecodeFeeder *feeder);
+
+  private:
+    typedef struct {
+        DecodeFeeder *feeder;
+        bool busy; /* 有工作线程正在推进，没有持锁 */
+    } DecodeEntry;
+
+    VPPDecodeWorkers() = default;
+
+    void Loop();
+    std::vector<DecodeEntry>::iterator Find(DecodeFeeder *feeder);
+
+    std::mutex m_mtx;
+    std::condition_variable m_cond;
+    std::vector<DecodeEntry> m_entries;
+    size_t m_next = 0; /* 下一次从这个位置开始找空闲通道，轮流推进 */
+    std::unique_ptr<std::thread> m_threads[DEC_WORKER_NUM];
+    std::atomic<bool> m_running{true};
+    std::once_flag m_start_flag;
+};
+
+} // namespace srpy_cam
+
+#endif // _X3_SDK_DEC_WORKERS_H_
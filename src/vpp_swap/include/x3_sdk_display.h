@@ -34,6 +34,7 @@
 #include "vio/hb_vp_api.h"
 
 #include "x3_sdk_camera.h"
+#include "x3_sdk_osd.h"
 #include "iar_interface.h"
 using namespace std;
 
@@ -45,6 +46,17 @@ namespace srpy_cam
 #define VOT_GRAPH_LAYER_NUM 2
 #define IAR_DEV_PATH "/dev/iar_cdev"
 #define IAR_CHANNEL_CFG 	_IOW(IAR_CDEV_MAGIC,0x14, channel_base_cfg_t)
+
+// 批量画框的一项，内存布局与 sp_display.h 中的 sp_display_rect_t 一致
+typedef struct {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    uint32_t color;  /* ARGB8888 */
+    int line_width;  /* <= 0 表示画实心矩形 */
+} x3_disp_rect_t;
+
 class VPPDisplay
 {
   public:
@@ -69,9 +81,17 @@ class VPPDisplay
     int set_graph_rect(int x0, int y0, int x1, int y1, int chn,
         int flush, uint32_t color, int line_width);
 
+    // 一次画 num 个框，只做一次参数检查和清屏，适合每帧上百个检测框的场景
+    int set_graph_rects(const x3_disp_rect_t *rects, int num, int chn = 2,
+        int flush = 0);
+
     int set_graph_word(int x, int y, char *str, int chn,
         int flush, uint32_t color, int line_width);
 
+    // 把图形层这一帧画过的内容一次性送显。默认每个 set_graph_* 各自送显；
+    // 一旦调用过 present_graph，该通道改为只在这里送显，翻页模式下每帧只翻一次页
+    int present_graph(int chn = 2);
+
     int get_video_chn();
 
   public:
@@ -89,6 +109,11 @@ class VPPDisplay
   private:
     int reset_iar_crop(void);
 
+    void draw_graph_rect(int chn, int x0, int y0, int x1, int y1,
+        uint32_t color, int line_width, int fill);
+
+    int auto_present_graph(int chn);
+
   private:
     /// default VOT_OUTPUT_1920x1080
     int m_vot_intf = 0;
@@ -98,6 +123,8 @@ class VPPDisplay
 
     int m_fbfd[VOT_GRAPH_LAYER_NUM] = {-1, -1};
     uint8_t *m_fbp[VOT_GRAPH_LAYER_NUM] = {NULL, NULL};
+    OsdCanvas m_osd[VOT_GRAPH_LAYER_NUM];
+    bool m_graph_explicit[VOT_GRAPH_LAYER_NUM] = {false, false}; /* 调用过 present_graph */
 
     atomic_flag m_disp_inited = ATOMIC_FLAG_INIT;
 
@@ -0,0 +1,101 @@
+/*
+ * Horizon Robotics
+ *
+ * Copyright (C) 2023 Horizon Robotics Inc.
+ * All rights reserved.
+ * Author:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef _X3_SDK_FONT_H_
+#define _X3_SDK_FONT_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace srpy_cam
+{
+
+#define VOT_ARGB_BYTES 4
+
+// 测试程序可以在编译选项中指向别的字库
+#ifndef FONT_HZK16_FILE
+#define FONT_HZK16_FILE "/etc/vio/HZK16"
+#endif
+#ifndef FONT_ASC16_FILE
+#define FONT_ASC16_FILE "/etc/vio/ASC16"
+#endif
+
+#define FONT_INTERVAL_CN_WORD_CNT 94
+#define FONT_CN_WORD_START_ENCODE 0xa0
+#define FONT_CN_WORD_BYTES 32
+#define FONT_EN_WORD_BYTES 16
+
+#define FONT_WORD_HEIGHT 16
+#define FONT_ONE_ENCODE_WIDTH 8
+#define FONT_CN_ENCODE_NUM 2
+#define FONT_EN_ENCODE_NUM 1
+#define FONT_CN_WORD_WIDTH \
+    (FONT_CN_ENCODE_NUM * FONT_ONE_ENCODE_WIDTH)
+#define FONT_EN_WORD_WIDTH \
+    (FONT_EN_ENCODE_NUM * FONT_ONE_ENCODE_WIDTH)
+#define FONT_HARD_PIXEL_BITS 4
+#define ONE_BYTE_BIT_CNT 8
+
+#define OSD_GLYPH_CACHE_MAX 4096 /* 超过后整体清空，避免随机颜色把缓存撑大 */
+
+// 已经按 line_width 放大、按颜色展开的字形
+// 点阵中为 1 的像素按行记录成连续段，绘制时每一段是一次 memcpy，背景像素保持不变
+typedef struct {
+    uint32_t m_width;  /* 像素，已乘以 line_width */
+    uint32_t m_height;
+    uint32_t m_line_width;
+    std::vector<uint8_t> m_color_row;            /* m_width 个 ARGB8888 像素，全部为字的颜色 */
+    std::vector<uint16_t> m_runs[FONT_WORD_HEIGHT]; /* 每个字模行的 (起始像素, 像素数) 对 */
+} OsdGlyph;
+
+// ASC16/HZK16 字库只 mmap 一次，字形按 (编码, line_width, color) 缓存
+class OsdFont
+{
+  public:
+    static OsdFont &Instance();
+
+    ~OsdFont();
+
+    /**
+     * @brief 取一个字形
+     * @param[in] code      英文 1 个字节，中文 2 个字节（GB2312 区位码）
+     * @retval nullptr      字库打不开或者编码超出字库范围
+     */
+    std::shared_ptr<const OsdGlyph> GetGlyph(const uint8_t *code, int code_len,
+                                             uint32_t line_width, uint32_t color);
+
+    // addr 指向字形左上角在 OSD 层中的位置，width 是 OSD 层一行的像素数
+    static void BlitGlyph(const OsdGlyph &glyph, uint8_t *addr, uint32_t width);
+
+  private:
+    OsdFont() = default;
+
+    int MapFont(const char *file, const uint8_t **data, size_t *size);
+
+    std::shared_ptr<OsdGlyph> BuildGlyph(const uint8_t *bitmap, uint32_t row_bytes,
+                                         uint32_t line_width, uint32_t color);
+
+    std::mutex m_mtx;
+    const uint8_t *m_asc_data = nullptr;
+    size_t m_asc_size = 0;
+    const uint8_t *m_hzk_data = nullptr;
+    size_t m_hzk_size = 0;
+    std::unordered_map<uint64_t, std::shared_ptr<const OsdGlyph>> m_glyphs;
+};
+
+}; // namespace srpy_cam
+
+#endif
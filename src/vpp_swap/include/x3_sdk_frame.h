@@ -0,0 +1,37 @@
+/***************************************************************************
+ * @COPYRIGHT NOTICE
+ * @Copyright 2023 Horizon Robotics, Inc.
+ * @All rights reserved.
+ ***************************************************************************/
+#ifndef X3_SDK_FRAME_H_
+#define X3_SDK_FRAME_H_
+
+#include <atomic>
+
+#include "x3_common.h"
+
+namespace srpy_cam
+{
+
+enum DevModule {
+    Dev_SIF,
+    Dev_ISP,
+    Dev_IPU
+};
+
+class VPPCamera;
+
+// 帧租约：直接把硬件 buffer 借给调用者，不做内存拷贝
+// 多个消费者（BPU、编码、显示）可以各持有一个引用，引用计数归零时才把 buffer 还给 VIO
+// 单独放在这里，不依赖 VIO 头文件，主机上的测试也可以使用
+typedef struct {
+    ImageFrame m_frame;
+    DevModule m_module;
+    int m_chn_id;
+    std::atomic<int> m_ref_cnt;
+    VPPCamera *m_owner;
+} ImageFrameLease;
+
+} // namespace srpy_cam
+
+#endif // X3_SDK_FRAME_H_
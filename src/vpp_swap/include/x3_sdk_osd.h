@@ -0,0 +1,100 @@
+/*
+ * Horizon Robotics
+ *
+ * Copyright (C) 2023 Horizon Robotics Inc.
+ * All rights reserved.
+ * Author:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef _X3_SDK_OSD_H_
+#define _X3_SDK_OSD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <linux/fb.h>
+
+namespace srpy_cam
+{
+
+#define OSD_DIRTY_RECT_MAX 256 /* 脏区超过这个数量时合并成一个外接矩形 */
+
+// 图形层（/dev/fbN）的双缓冲画布
+// 所有绘制都写在后台 buffer 上，并记录写过的矩形；Clear 只清掉上一帧写过的区域，
+// Present 时把这一帧改动过的区域送显，避免每次 flush 都 memset 整个 framebuffer。
+// 送显方式：
+//   framebuffer 的虚拟高度能放下两页时，在两页之间 FBIOPAN_DISPLAY 切换，
+//   切换后把改动过的区域同步到新的后台页；
+//   否则后台 buffer 在堆上，Present 只把改动过的区域拷贝到 framebuffer。
+class OsdCanvas
+{
+  public:
+    typedef struct {
+        int x0;
+        int y0;
+        int x1; /* 包含 */
+        int y1; /* 包含 */
+    } Rect;
+
+    OsdCanvas() = default;
+    ~OsdCanvas() { Deinit(); }
+
+    OsdCanvas(const OsdCanvas &) = delete;
+    OsdCanvas &operator=(const OsdCanvas &) = delete;
+
+    /**
+     * @brief 映射 fd 对应的 framebuffer 并清屏
+     * @retval 0      成功
+     * @retval -1     获取 framebuffer 信息或者 mmap 失败
+     */
+    int Init(int fd, int width, int height);
+
+    void Deinit();
+
+    // framebuffer 映射的起始地址，没有初始化时为 NULL
+    uint8_t *Mapped() const { return m_map; }
+
+    // 绘制目标，一行 m_width 个 ARGB8888 像素
+    uint8_t *Back() const { return m_back; }
+
+    int Width() const { return m_width; }
+    int Height() const { return m_height; }
+
+    // 记录 [x0, x1] x [y0, y1] 已被绘制，坐标会被裁剪到画布范围内
+    void Mark(int x0, int y0, int x1, int y1);
+
+    // 清除上一帧绘制过的区域，相当于原来 flush 时的整屏 memset
+    void Clear();
+
+    // 把本帧改动过的区域送显
+    int Present();
+
+  private:
+    void AddRect(std::vector<Rect> &rects, const Rect &rect);
+    void CopyRect(uint8_t *dst, const uint8_t *src, const Rect &rect);
+
+    int m_fd = -1;
+    int m_width = 0;
+    int m_height = 0;
+    size_t m_page_size = 0;
+    size_t m_map_size = 0;
+    uint8_t *m_map = nullptr;
+
+    struct fb_var_screeninfo m_vinfo;
+    int m_pan = 0;           /* 1: 两页翻转，0: 堆上的后台 buffer 拷贝送显 */
+    int m_back_page = 0;
+    uint8_t *m_back = nullptr;
+    std::vector<uint8_t> m_shadow;
+
+    std::vector<Rect> m_drawn;  /* 当前画面上有内容的区域 */
+    std::vector<Rect> m_damage; /* 上次送显之后改动过的区域 */
+};
+
+}; // namespace srpy_cam
+
+#endif
@@ -30,6 +30,7 @@ int x3_vps_get_output_cond(uint32_t vpsGrpId, int channel,
         hb_vio_buffer_t *buffer, const int timeout);
 int x3_vps_output_release(uint32_t vpsGrpId, int channel,
                           hb_vio_buffer_t *buffer);
+int x3_vps_get_chn_fd(uint32_t vpsGrpId, int channel);
 void x3_normal_buf_info_print(hb_vio_buffer_t *buf);
 int x3_dump_nv12(char *filename, char *srcBuf, char *srcBuf1,
                  unsigned int size, unsigned int size1);
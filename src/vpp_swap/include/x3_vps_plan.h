@@ -0,0 +1,71 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+#ifndef X3_VPS_PLAN_H_
+#define X3_VPS_PLAN_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// vps 输出通道规划：一次性拿到全部输出请求，在各通道的能力约束下搜索所有可行分配，
+// 选出放置数量最多、代价最小的一组；不依赖任何硬件接口，可以在主机上单独验证
+
+#define VPS_PLAN_MAX_REQ 8
+#define VPS_PLAN_REASON_LEN 160
+
+// 规划器内部的通道编号，与 HB_VIO_IPU_DSx_DATA / HB_VIO_IPU_US_DATA 的对应关系由调用者映射
+typedef enum {
+    VPS_PLAN_DS0 = 0,
+    VPS_PLAN_DS1,
+    VPS_PLAN_DS2,
+    VPS_PLAN_DS3,
+    VPS_PLAN_DS4,
+    VPS_PLAN_US,
+    VPS_PLAN_CHN_NUM
+} x3_vps_plan_chn_e;
+
+typedef struct {
+    int src_width;   /* group 输入 */
+    int src_height;
+    int crop_width;  /* 为 0 表示不裁剪，缩放输入就是整幅图 */
+    int crop_height;
+    int dst_width;
+    int dst_height;
+    int rotate;      /* ROTATION_E，90/270 度时缩放输入宽高互换 */
+} x3_vps_plan_req_t;
+
+typedef struct {
+    int chn[VPS_PLAN_MAX_REQ];    /* x3_vps_plan_chn_e，-1 表示该请求没有被放置 */
+    int placed;                   /* 成功放置的请求数量 */
+    uint64_t cost;                /* 被放置请求的总代价，见 x3_vps_plan_chn */
+    char reason[VPS_PLAN_MAX_REQ][VPS_PLAN_REASON_LEN]; /* 未放置请求的原因 */
+} x3_vps_plan_t;
+
+/**
+ * @brief 为 req_num 个输出请求分配 vps 通道
+ *        各通道约束：DS2 只缩小且不超过 4096；DS1/DS3 不超过 1920x1080，
+ *        DS0/DS4 不超过 1280x720，且至少一个方向不放大；US 只放大且不超过 4096。
+ *        代价 = (读入像素 + 写出像素) * VPS_PLAN_BW_SCALE + 通道能力余量：
+ *        放不下全部请求时优先放带宽小的那些；带宽相同时余量项让小输出优先落到
+ *        小通道上，把大通道留给大输出。
+ *        结果只取决于请求集合本身，代价相同的分配按请求顺序取第一个。
+ *        和原来的贪心选择不同，不需要 DS2 的请求会落到余量更小的通道上，
+ *        例如 1920x1080 原尺寸输出放在 DS1 而不是 DS2；调用者都按尺寸用 GetChnId 查通道，
+ *        不依赖具体放在哪个通道。
+ * @retval 0      全部请求都已放置
+ * @retval -1     有请求无法放置，plan 中仍然是能放置最多请求的最优分配，reason 给出原因
+ */
+int x3_vps_plan_chn(const x3_vps_plan_req_t *reqs, int req_num, x3_vps_plan_t *plan);
+
+const char *x3_vps_plan_chn_name(int chn);
+
+#ifdef __cplusplus
+}
+#endif /* extern "C" */
+
+#endif // X3_VPS_PLAN_H_
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -13,6 +14,7 @@
 #include "x3_sdk_wrap.h"
 #include "x3_vio_rgn.h"
 #include "x3_vio_vp.h"
+#include "x3_vps_plan.h"
 
 #include "utils_log.h"
 #include "x3_sdk_wrap.h"
@@ -24,35 +26,80 @@
 namespace srpy_cam
 {
 
-static int vps_select_chn(int *chn_en, int src_width, int src_height, int dst_width, int dst_height)
+// 规划器通道编号到 vio 通道号的映射
+static const int vps_plan_chn_data[VPS_PLAN_CHN_NUM] = {
+    HB_VIO_IPU_DS0_DATA, /* VPS_PLAN_DS0 */
+    HB_VIO_IPU_DS1_DATA, /* VPS_PLAN_DS1 */
+    HB_VIO_IPU_DS2_DATA, /* VPS_PLAN_DS2 */
+    HB_VIO_IPU_DS3_DATA, /* VPS_PLAN_DS3 */
+    HB_VIO_IPU_DS4_DATA, /* VPS_PLAN_DS4 */
+    HB_VIO_IPU_US_DATA, /* VPS_PLAN_US */
+};
+
+// 返回第 i 个请求分配到的 vio 通道号，没有分配时打印原因并返回 -1
+static int vps_plan_get_chn(x3_vps_plan_t *plan, int i, int dst_width, int dst_height)
 {
-    if (((dst_width <= src_width) && (dst_height <= src_height)) &&
-        (!(*chn_en & 1 << HB_VIO_IPU_DS2_DATA)) &&
-        (dst_width <= 4096 && dst_height <= 4096)) {
-        return HB_VIO_IPU_DS2_DATA;
+    if (i >= VPS_PLAN_MAX_REQ) {
+        LOGW_print("Invalid size:%dx%d, too many channels\n", dst_width, dst_height);
+        return -1;
+    }
+    if (plan->chn[i] < 0) {
+        LOGW_print("Invalid size:%dx%d, %s\n", dst_width, dst_height, plan->reason[i]);
+        return -1;
     }
-    if ((dst_width <= src_width) || (dst_height <= src_height)) {
-        if ((dst_width <= 1920 && dst_height <= 1080) &&
-            (!(*chn_en & 1 << HB_VIO_IPU_DS1_DATA))) {
-            return HB_VIO_IPU_DS1_DATA;
-        } else if ((dst_width <= 1920 && dst_height <= 1080) &&
-                (!(*chn_en & 1 << HB_VIO_IPU_DS3_DATA))) {
-            return HB_VIO_IPU_DS3_DATA;
-        } else if ((dst_width <= 1280 && dst_height <= 720) &&
-                (!(*chn_en & 1 << HB_VIO_IPU_DS0_DATA))) {
-            return HB_VIO_IPU_DS0_DATA;
-        } else if ((dst_width <= 1280 && dst_height <= 720) &&
-                (!(*chn_en & 1 << HB_VIO_IPU_DS4_DATA))) {
-            return HB_VIO_IPU_DS4_DATA;
+    return vps_plan_chn_data[plan->chn[i]];
+}
+
+static inline uint32_t vps_chn_lut_key(int width, int height)
+{
+    return ((uint32_t)width << 16) | ((uint32_t)height & 0xFFFF);
+}
+
+static inline uint32_t vps_chn_lut_hash(uint32_t key)
+{
+    return (key * 2654435761U) >> (32 - 4);
+}
+
+// 根据已配置的 vps 通道建立 分辨率 -> 通道 查找表，只在打开 vps 时调用一次
+static void vps_chn_lut_build(x3_modules_info_t *info)
+{
+    x3_vps_info_t *vps_info = &info->m_vps_infos.m_vps_info[0];
+    uint32_t key = 0, pos = 0;
+
+    memset(info->m_chn_lut, 0, sizeof(info->m_chn_lut));
+    info->m_chn_all_mask = 0;
+
+    for (int i = 0; i < vps_info->m_chn_num && i < VPS_MAX_CHN_NUM; i++) {
+        key = vps_chn_lut_key(vps_info->m_vps_chn_attrs[i].m_chn_attr.width,
+                              vps_info->m_vps_chn_attrs[i].m_chn_attr.height);
+        pos = vps_chn_lut_hash(key) & (VPS_CHN_LUT_SIZE - 1);
+        while (info->m_chn_lut[pos].m_key != 0 && info->m_chn_lut[pos].m_key != key) {
+            pos = (pos + 1) & (VPS_CHN_LUT_SIZE - 1);
         }
+        info->m_chn_lut[pos].m_key = key;
+        info->m_chn_lut[pos].m_chn_mask |= 1U << i;
+        info->m_chn_all_mask |= 1U << i;
     }
-    if (((dst_width >= src_width) && (dst_height >= src_height)) &&
-            (!(*chn_en & 1 << HB_VIO_IPU_US_DATA)) &&
-            (dst_width <= 4096 && dst_height <= 4096)) {
-        return HB_VIO_IPU_US_DATA;
+}
+
+// 返回该分辨率对应的通道下标位图，宽高都为 0 表示任意通道
+static uint32_t vps_chn_lut_find(const x3_modules_info_t *info, int width, int height)
+{
+    uint32_t key = 0, pos = 0;
+
+    if (width == 0 && height == 0) {
+        return info->m_chn_all_mask;
     }
 
-    return -1;
+    key = vps_chn_lut_key(width, height);
+    pos = vps_chn_lut_hash(key) & (VPS_CHN_LUT_SIZE - 1);
+    while (info->m_chn_lut[pos].m_key != 0) {
+        if (info->m_chn_lut[pos].m_key == key) {
+            return info->m_chn_lut[pos].m_chn_mask;
+        }
+        pos = (pos + 1) & (VPS_CHN_LUT_SIZE - 1);
+    }
+    return 0;
 }
 
 int x3_cam_init_param(x3_modules_info_t *info, const int pipe_id, const int video_index, int fps,
@@ -61,7 +108,9 @@ int x3_cam_init_param(x3_modules_info_t *info, const int pipe_id, const int vide
     int i = 0;
     int ret = 0;
     int mipi_width = 0, mipi_height = 0;
-    int chn_index = 0, chn_en = 0, chn_data = -1;
+    int chn_index = 0, chn_data = -1;
+    x3_vps_plan_req_t plan_reqs[VPS_PLAN_MAX_REQ];
+    x3_vps_plan_t plan;
     char file_name[SDK_MAX_PATH_LENGTH];
     char result[SDK_MAX_RESULT_LENGTH];
     char cmd[SDK_MAX_CMD_LENGTH] = {0};
@@ -131,33 +180,41 @@ int x3_cam_init_param(x3_modules_info_t *info, const int pipe_id, const int vide
                                 mipi_width, mipi_height);
     // 2.3 配置group每个通道的参数
     info->m_vps_infos.m_vps_info[0].m_chn_num = chn_num;
+    memset(plan_reqs, 0, sizeof(plan_reqs));
     for (int i = 0; i < chn_num; i++) {
         if((width[i] % 4 != 0) || (height[i] % 2 != 0))
         {
             LOGE_print("Width: %d must be divisible by 4, height: %d must be even!\n",width[i],height[i]);
-            ret = -1;
-            break;
+            return -1;
         }
-        chn_data = -1;
         if ((width[i] == 0) && (height[i] == 0)) {//如果高宽为0，那么就开一个和mipi原始高宽一致的通道
             width[i] = mipi_width;
             height[i] = mipi_height;
         }
-        chn_data = vps_select_chn(&chn_en, mipi_width, mipi_height, width[i], height[i]);
+        if (i < VPS_PLAN_MAX_REQ) {
+            plan_reqs[i].src_width = mipi_width;
+            plan_reqs[i].src_height = mipi_height;
+            plan_reqs[i].dst_width = width[i];
+            plan_reqs[i].dst_height = height[i];
+        }
+    }
+    // 2.4 根据全部输出请求一次性规划通道，而不是按请求顺序贪心选择
+    x3_vps_plan_chn(plan_reqs, chn_num < VPS_PLAN_MAX_REQ ? chn_num : VPS_PLAN_MAX_REQ, &plan);
+    for (int i = 0; i < chn_num; i++) {
+        chn_data = vps_plan_get_chn(&plan, i, width[i], height[i]);
         if (chn_data >= 0) {
             ret |= vps_chn_param_init(&info->m_vps_infos.m_vps_info[0].m_vps_chn_attrs[chn_index],
                     chn_data, width[i], height[i], fps);
-            chn_en |= 1 << chn_data;
             chn_index++;
             printf("Setting VPS channel-%d: src_w:%d, src_h:%d; dst_w:%d, dst_h:%d;\n", chn_data,
                 mipi_width, mipi_height, width[i], height[i]);
         } else {
-            LOGW_print("Invalid size:%dx%d\n", width[i], height[i]);
             info->m_vps_infos.m_vps_info[0].m_chn_num--;
         }
     }
 
     if (ret == 0) {
+        vps_chn_lut_build(info);
         info->m_enable = 1;
     }
     return ret;
@@ -168,8 +225,10 @@ int x3_cam_vps_init_param(x3_modules_info_t *info, const int pipe_id, int chn_nu
           int *crop_x, int *crop_y, int *crop_width, int *crop_height, int *rotate)
 {
     int ret = 0;
-    int chn_index = 0, chn_en = 0, chn_data = -1;
+    int chn_index = 0, chn_data = -1;
     int fps = 30;
+    x3_vps_plan_req_t plan_reqs[VPS_PLAN_MAX_REQ];
+    x3_vps_plan_t plan;
 
     memset(info, 0, sizeof(x3_modules_info_t));
 
@@ -181,6 +240,7 @@ int x3_cam_vps_init_param(x3_modules_info_t *info, const int pipe_id, int chn_nu
                                 src_width, src_height);
     // 2.3 配置group每个通道的参数
     info->m_vps_infos.m_vps_info[0].m_chn_num = chn_num;
+    memset(plan_reqs, 0, sizeof(plan_reqs));
     for (int i = 0; i < chn_num; i++) {
         switch (proc_mode)
         {
@@ -206,7 +266,24 @@ int x3_cam_vps_init_param(x3_modules_info_t *info, const int pipe_id, int chn_nu
             break;
         }
 
-        chn_data = vps_select_chn(&chn_en, src_width, src_height, dst_width[i], dst_height[i]);
+        if (i < VPS_PLAN_MAX_REQ) {
+            plan_reqs[i].src_width = src_width;
+            plan_reqs[i].src_height = src_height;
+            plan_reqs[i].dst_width = dst_width[i];
+            plan_reqs[i].dst_height = dst_height[i];
+            if ((proc_mode == VPS_SCALE_CROP) || (proc_mode == VPS_SCALE_ROTATE_CROP)) {
+                plan_reqs[i].crop_width = crop_width[i];
+                plan_reqs[i].crop_height = crop_height[i];
+            }
+            if ((proc_mode == VPS_SCALE_ROTATE) || (proc_mode == VPS_SCALE_ROTATE_CROP)) {
+                plan_reqs[i].rotate = rotate[i] % ROTATION_MAX;
+            }
+        }
+    }
+    // 2.4 根据全部输出请求（含裁剪、旋转）一次性规划通道
+    x3_vps_plan_chn(plan_reqs, chn_num < VPS_PLAN_MAX_REQ ? chn_num : VPS_PLAN_MAX_REQ, &plan);
+    for (int i = 0; i < chn_num; i++) {
+        chn_data = vps_plan_get_chn(&plan, i, dst_width[i], dst_height[i]);
         if (chn_data >= 0) {
             if (proc_mode >= VPS_SCALE) {
                 ret |= vps_chn_param_init(&info->m_vps_infos.m_vps_info[0].m_vps_chn_attrs[chn_index],
@@ -222,15 +299,14 @@ int x3_cam_vps_init_param(x3_modules_info_t *info, const int pipe_id, int chn_nu
             }
             printf("Setting VPS channel-%d: src_w:%d, src_h:%d; dst_w:%d, dst_h:%d;\n", chn_data,
                 src_width, src_height, dst_width[i], dst_height[i]);
-            chn_en |= 1 << chn_data;
             chn_index++;
         } else {
-            LOGW_print("Invalid size:%dx%d\n", dst_width[i], dst_height[i]);
             info->m_vps_infos.m_vps_info[0].m_chn_num--;
         }
     }
 
     if (ret == 0) {
+        vps_chn_lut_build(info);
         info->m_enable = 1;
     }
     return ret;
@@ -394,6 +470,10 @@ int VPPCamera::OpenCamera(const int pipe_id, const int video_index, int fps,
     ret = x3_cam_init_param(&m_x3_modules_info, pipe_id, video_index, fps, chn_num, parameters, width, height);
     if (ret)
         return -1;
+    ret = InitDescPools();
+    if (ret)
+        return -1;
+    ResetChnOwners();
     ret = x3_cam_init(&m_x3_modules_info);
     if (ret)
         return -1;
@@ -418,6 +498,10 @@ int VPPCamera::OpenVPS(const int pipe_id, int chn_num, int proc_mode,
         dst_width, dst_height, crop_x, crop_y, crop_width, crop_height, rotate);
     if (ret)
         return -1;
+    ret = InitDescPools();
+    if (ret)
+        return -1;
+    ResetChnOwners();
     ret = x3_cam_init(&m_x3_modules_info);
     if (ret)
         return -1;
@@ -439,16 +523,84 @@ int VPPCamera::OpenVPS(const int pipe_id, int chn_num, int proc_mode,
     return 0;
 }
 
+// 租约和描述符池都指向本对象，析构前等已经借出的租约归还；
+// 超时说明调用者在释放相机之后还持有租约，只能报错，这些租约之后不能再释放
+VPPCamera::~VPPCamera()
+{
+    std::unique_lock<std::mutex> lock(m_lease_mutex);
+
+    m_closing.store(true);
+    if (!m_lease_cond.wait_for(lock, std::chrono::milliseconds(VIN_LEASE_DRAIN_TIMEOUT_MS),
+            [this] { return m_lease_cnt.load() == 0; })) {
+        LOGE_print("%d frame leases are still held when pipe %d is destroyed\n",
+            m_lease_cnt.load(), m_pipe_id);
+    }
+}
+
 int VPPCamera::CloseCamera(void)
 {
+    // 租约归还时要把 buffer 还给 VIO，所以必须在停止 VIO 之前等它们全部归还
+    m_closing.store(true);
+    {
+        std::unique_lock<std::mutex> lock(m_lease_mutex);
+        bool drained = m_lease_cond.wait_for(lock, std::chrono::milliseconds(VIN_LEASE_DRAIN_TIMEOUT_MS),
+            [this] { return m_lease_cnt.load() == 0; });
+        if (!drained) {
+            LOGE_print("%d frame leases are still held, pipe %d not closed\n",
+                m_lease_cnt.load(), m_pipe_id);
+            m_closing.store(false);
+            return -1;
+        }
+    }
+
     if (m_vp_param.mmz_cnt > 0) {
         x3_cam_vp_deinit(&m_vp_param);
     }
     x3_cam_stop(&m_x3_modules_info);
     x3_cam_deinit(&m_x3_modules_info);
+    DeinitDescPools();
+    m_closing.store(false);
+    return 0;
+}
+
+// 描述符池按 VPS 各通道的图像队列深度之和分配，外加 SIF/ISP 取图的余量
+int VPPCamera::InitDescPools(void)
+{
+    int capacity = VIN_DESC_EXTRA_NUM;
+    x3_vps_info_t *vps_info = &m_x3_modules_info.m_vps_infos.m_vps_info[0];
+
+    for (int i = 0; i < vps_info->m_chn_num; i++) {
+        capacity += vps_info->m_vps_chn_attrs[i].m_chn_attr.frameDepth;
+    }
+
+    if (m_buf_pool.Init(capacity) || m_lease_pool.Init(capacity)) {
+        LOGE_print("init descriptor pool failed, capacity:%d\n", capacity);
+        DeinitDescPools();
+        return -1;
+    }
     return 0;
 }
 
+void VPPCamera::DeinitDescPools(void)
+{
+    m_buf_pool.Deinit();
+    m_lease_pool.Deinit();
+}
+
+void VPPCamera::GetDescPoolStats(DescPoolStats *buf_stats, DescPoolStats *lease_stats)
+{
+    if (buf_stats != nullptr)
+        m_buf_pool.GetStats(buf_stats);
+    if (lease_stats != nullptr)
+        m_lease_pool.GetStats(lease_stats);
+}
+
+void VPPCamera::ResetDescPoolStats(void)
+{
+    m_buf_pool.ResetStats();
+    m_lease_pool.ResetStats();
+}
+
 int VPPCamera::setExposureGain(int exp_val, int gain_val) { return -1; }
 
 #define SIF_EXCTRL_MAGIC             0x95
@@ -484,17 +636,18 @@ int VPPCamera::ResetSync(void)
     return -1;
 }
 
-static int GetSifRawData(const int pipe_id, ImageFrame *image_frame, const int timeout)
+static int GetSifRawData(DescPool<hb_vio_buffer_t> *pool, const int pipe_id,
+        ImageFrame *image_frame, const int timeout)
 {
     int ret = 0;
     hb_vio_buffer_t *sif_img = nullptr;
     int data_size = 0;
 
-    sif_img = new hb_vio_buffer_t();
+    sif_img = pool->Get();
 
     ret = x3_vin_sif_get_data(pipe_id, sif_img, timeout);
     if (ret) {
-        delete sif_img;
+        pool->Put(sif_img);
         sif_img = nullptr;
         return -1;
     }
@@ -502,14 +655,18 @@ static int GetSifRawData(const int pipe_id, ImageFrame *image_frame, const int t
     if (sif_img->img_info.planeCount == 1) { // raw的 planeCount是1
         data_size = sif_img->img_info.size[0];
         if (data_size == 0) {
-            delete sif_img;
+            pool->Put(sif_img);
             sif_img = nullptr;
             return -1;
         }
         LOGD_print("data_size:%d,width:%d,height:%d,stride:%d\n",data_size,sif_img->img_addr.width,sif_img->img_addr.height,sif_img->img_addr.stride_size);
         image_frame->data[0] = (uint8_t *)sif_img->img_addr.addr[0];
+        image_frame->pdata[0] = sif_img->img_addr.paddr[0];
         image_frame->data_size[0] = data_size;
         image_frame->plane_count = sif_img->img_info.planeCount;
+        image_frame->width = sif_img->img_addr.width;
+        image_frame->height = sif_img->img_addr.height;
+        image_frame->stride = sif_img->img_addr.stride_size;
         image_frame->frame_info = static_cast<void *>(sif_img);
 
         image_frame->image_id = sif_img->img_info.frame_id & 0xFFFF; // 低16位是帧id
@@ -523,16 +680,21 @@ static int GetSifRawData(const int pipe_id, ImageFrame *image_frame, const int t
     } else if (sif_img->img_info.planeCount == 2) { // yuv的 planeCount是2
         data_size = sif_img->img_info.size[0] + sif_img->img_info.size[1];
         if (data_size == 0) {
-            delete sif_img;
+            pool->Put(sif_img);
             sif_img = nullptr;
             return -1;
         }
         // y 和 uv 分量存放在连续地址上，可以只返回一个addr
         image_frame->data[0] = (uint8_t *)sif_img->img_addr.addr[0];
         image_frame->data[1] = (uint8_t *)sif_img->img_addr.addr[1];
+        image_frame->pdata[0] = sif_img->img_addr.paddr[0];
+        image_frame->pdata[1] = sif_img->img_addr.paddr[1];
         image_frame->data_size[0] = sif_img->img_info.size[0];
         image_frame->data_size[1] = sif_img->img_info.size[1];
         image_frame->plane_count = sif_img->img_info.planeCount;
+        image_frame->width = sif_img->img_addr.width;
+        image_frame->height = sif_img->img_addr.height;
+        image_frame->stride = sif_img->img_addr.stride_size;
         image_frame->frame_info = static_cast<void *>(sif_img);
 
         image_frame->image_id = sif_img->img_info.frame_id & 0xFFFF; // 低16位是帧id
@@ -545,7 +707,7 @@ static int GetSifRawData(const int pipe_id, ImageFrame *image_frame, const int t
 #endif
     } else {
         printf("pipe:%d raw buf planeCount wrong !!!\n", pipe_id);
-        delete sif_img;
+        pool->Put(sif_img);
         sif_img = nullptr;
         return -1;
     }
@@ -553,30 +715,32 @@ static int GetSifRawData(const int pipe_id, ImageFrame *image_frame, const int t
     return 0;
 }
 
-static int ReleaseSifRawData(const int pipe_id, ImageFrame *image_frame)
+static int ReleaseSifRawData(DescPool<hb_vio_buffer_t> *pool, const int pipe_id,
+        ImageFrame *image_frame)
 {
 
     // 释放 data buffer
     x3_vin_sif_release_data(pipe_id, (hb_vio_buffer_t *)image_frame->frame_info);
 
-    // 释放结构体本身内存
-    delete ((hb_vio_buffer_t *)image_frame->frame_info);
+    // 描述符还回池中
+    pool->Put((hb_vio_buffer_t *)image_frame->frame_info);
     image_frame->frame_info = nullptr;
 
     return 0;
 }
 
-static int GetISPYuvData(const int pipe_id, ImageFrame *image_frame, const int timeout)
+static int GetISPYuvData(DescPool<hb_vio_buffer_t> *pool, const int pipe_id,
+        ImageFrame *image_frame, const int timeout)
 {
     int ret = 0;
     hb_vio_buffer_t *isp_yuv = nullptr;
     uint32_t data_size = 0;
 
-    isp_yuv = new hb_vio_buffer_t();
+    isp_yuv = pool->Get();
 
     ret = x3_vin_isp_get_data(pipe_id, isp_yuv, timeout);
     if (ret) {
-        delete isp_yuv;
+        pool->Put(isp_yuv);
         isp_yuv = nullptr;
         return -1;
     }
@@ -584,16 +748,21 @@ static int GetISPYuvData(const int pipe_id, ImageFrame *image_frame, const int t
     if (isp_yuv->img_info.planeCount == 2) { // yuv的 planeCount是2
         data_size = isp_yuv->img_info.size[0] + isp_yuv->img_info.size[1];
         if (data_size == 0) {
-            delete isp_yuv;
+            pool->Put(isp_yuv);
             isp_yuv = nullptr;
             return -1;
         }
         // y 和 uv 分量存放在连续地址上，可以只返回一个addr
         image_frame->data[0] = (uint8_t *)isp_yuv->img_addr.addr[0];
         image_frame->data[1] = (uint8_t *)isp_yuv->img_addr.addr[1];
+        image_frame->pdata[0] = isp_yuv->img_addr.paddr[0];
+        image_frame->pdata[1] = isp_yuv->img_addr.paddr[1];
         image_frame->data_size[0] = isp_yuv->img_info.size[0];
         image_frame->data_size[1] = isp_yuv->img_info.size[1];
         image_frame->plane_count = isp_yuv->img_info.planeCount;
+        image_frame->width = isp_yuv->img_addr.width;
+        image_frame->height = isp_yuv->img_addr.height;
+        image_frame->stride = isp_yuv->img_addr.stride_size;
         image_frame->frame_info = static_cast<void *>(isp_yuv);
         LOGD_print("data_size:%d,width:%d,height:%d,stride:%d\n",data_size,isp_yuv->img_addr.width,isp_yuv->img_addr.height,isp_yuv->img_addr.stride_size);
         image_frame->image_id = isp_yuv->img_info.frame_id & 0xFFFF; // 低16位是帧id
@@ -606,7 +775,7 @@ static int GetISPYuvData(const int pipe_id, ImageFrame *image_frame, const int t
 #endif
     } else {
         printf("pipe:%d isp yuv buf planeCount wrong !!!\n", pipe_id);
-        delete isp_yuv;
+        pool->Put(isp_yuv);
         isp_yuv = nullptr;
         return -1;
     }
@@ -614,30 +783,32 @@ static int GetISPYuvData(const int pipe_id, ImageFrame *image_frame, const int t
     return 0;
 }
 
-static int ReleaseISPYuvData(const int pipe_id, ImageFrame *image_frame)
+static int ReleaseISPYuvData(DescPool<hb_vio_buffer_t> *pool, const int pipe_id,
+        ImageFrame *image_frame)
 {
 
     // 释放 data buffer
     x3_vin_isp_release_data(pipe_id, (hb_vio_buffer_t *)image_frame->frame_info);
 
-    // 释放结构体本身内存
-    delete ((hb_vio_buffer_t *)image_frame->frame_info);
+    // 描述符还回池中
+    pool->Put((hb_vio_buffer_t *)image_frame->frame_info);
     image_frame->frame_info = nullptr;
 
     return 0;
 }
 
-static int GetVpsChnData(const int pipe_id, int chn_id, ImageFrame *image_frame, const int timeout)
+static int GetVpsChnData(DescPool<hb_vio_buffer_t> *pool, const int pipe_id, int chn_id,
+        ImageFrame *image_frame, const int timeout)
 {
     int ret = 0;
     hb_vio_buffer_t *vps_yuv = nullptr;
     uint32_t data_size = 0;
 
-    vps_yuv = new hb_vio_buffer_t();
+    vps_yuv = pool->Get();
 
     ret = x3_vps_get_output(pipe_id, chn_id, vps_yuv, timeout);
     if (ret) {
-        delete vps_yuv;
+        pool->Put(vps_yuv);
         vps_yuv = nullptr;
         return -1;
     }
@@ -645,13 +816,18 @@ static int GetVpsChnData(const int pipe_id, int chn_id, ImageFrame *image_frame,
     if (vps_yuv->img_info.planeCount == 2) { // yuv的 planeCount是2
         data_size = vps_yuv->img_info.size[0] + vps_yuv->img_info.size[1];
         if (data_size == 0) {
-            delete vps_yuv;
+            pool->Put(vps_yuv);
             vps_yuv = nullptr;
             return -1;
         }
         // y 和 uv 分量存放在连续地址上，可以只返回一个addr
         image_frame->data[0] = (uint8_t *)vps_yuv->img_addr.addr[0];
         image_frame->data[1] = (uint8_t *)vps_yuv->img_addr.addr[1];
+        image_frame->pdata[0] = vps_yuv->img_addr.paddr[0];
+        image_frame->pdata[1] = vps_yuv->img_addr.paddr[1];
+        image_frame->width = vps_yuv->img_addr.width;
+        image_frame->height = vps_yuv->img_addr.height;
+        image_frame->stride = vps_yuv->img_addr.stride_size;
         image_frame->data_size[0] = vps_yuv->img_addr.stride_size * vps_yuv->img_addr.height;
         image_frame->data_size[1] = vps_yuv->img_addr.stride_size * vps_yuv->img_addr.height / 2;
         image_frame->plane_count = vps_yuv->img_info.planeCount;
@@ -667,7 +843,7 @@ static int GetVpsChnData(const int pipe_id, int chn_id, ImageFrame *image_frame,
 #endif
     } else {
         printf("pipe:%d isp yuv buf planeCount wrong !!!\n", pipe_id);
-        delete vps_yuv;
+        pool->Put(vps_yuv);
         vps_yuv = nullptr;
         return -1;
     }
@@ -675,37 +851,27 @@ static int GetVpsChnData(const int pipe_id, int chn_id, ImageFrame *image_frame,
     return 0;
 }
 
-static int ReleaseVpsChnData(const int pipe_id, int chn_id, ImageFrame *image_frame)
+static int ReleaseVpsChnData(DescPool<hb_vio_buffer_t> *pool, const int pipe_id, int chn_id,
+        ImageFrame *image_frame)
 {
     // 释放 data buffer
     x3_vps_output_release(pipe_id, chn_id, (hb_vio_buffer_t *)image_frame->frame_info);
 
-    // 释放结构体本身内存
-    delete ((hb_vio_buffer_t *)image_frame->frame_info);
+    // 描述符还回池中
+    pool->Put((hb_vio_buffer_t *)image_frame->frame_info);
     image_frame->frame_info = nullptr;
 
     return 0;
 }
 
-// 对一路的三个数据处理模块取数据
-int VPPCamera::GetImageFrame(ImageFrame *image_frame, DevModule module,
-                int width, int height, const int timeout)
+int VPPCamera::GetModuleFrame(ImageFrame *image_frame, DevModule module, int chn_id,
+                const int timeout)
 {
     int ret = 0;
-    int chn_id = -1;
 
     switch (module) {
     case Dev_IPU:
-        if (m_x3_modules_info.m_vps_enable == 0) {
-            printf("Error: vps was not enable\n");
-            return -1;
-        }
-        chn_id = GetChnId(VPP_CAMERA, 0, width, height);
-        if (chn_id == -1) {
-            printf("Error: no vps chn can be get\n");
-            return -1;
-        }
-        ret = GetVpsChnData(m_pipe_id, chn_id, image_frame, timeout);
+        ret = GetVpsChnData(&m_buf_pool, m_pipe_id, chn_id, image_frame, timeout);
         break;
     case Dev_ISP:
         if ((m_x3_modules_info.m_vin_enable == 0) ||
@@ -713,14 +879,14 @@ int VPPCamera::GetImageFrame(ImageFrame *image_frame, DevModule module,
             printf("Error: vin or isp was not enable\n");
             return -1;
         }
-        ret = GetISPYuvData(m_pipe_id, image_frame, timeout);
+        ret = GetISPYuvData(&m_buf_pool, m_pipe_id, image_frame, timeout);
         break;
     case Dev_SIF:
         if (m_x3_modules_info.m_vin_enable == 0) {
             printf("Error: vin was not enable\n");
             return -1;
         }
-        ret = GetSifRawData(m_pipe_id, image_frame, timeout);
+        ret = GetSifRawData(&m_buf_pool, m_pipe_id, image_frame, timeout);
         break;
     default:
         printf("Error: module not supported!\n");
@@ -733,31 +899,129 @@ int VPPCamera::GetImageFrame(ImageFrame *image_frame, DevModule module,
     return ret;
 }
 
-void VPPCamera::ReturnImageFrame(ImageFrame *image_frame, DevModule module,
-        int width, int height)
+void VPPCamera::ReleaseModuleFrame(ImageFrame *image_frame, DevModule module, int chn_id)
 {
-    int chn_id = -1;
-
     switch (module) {
     case Dev_IPU:
-        chn_id = GetChnId(VPP_CAMERA, 0, width, height);
-        if (chn_id == -1) {
-            printf("Error: no vps chn can be get\n");
-            return;
-        }
-        ReleaseVpsChnData(m_pipe_id, chn_id, image_frame);
+        ReleaseVpsChnData(&m_buf_pool, m_pipe_id, chn_id, image_frame);
         break;
     case Dev_ISP:
-        ReleaseISPYuvData(m_pipe_id, image_frame);
+        ReleaseISPYuvData(&m_buf_pool, m_pipe_id, image_frame);
         break;
     case Dev_SIF:
-        ReleaseSifRawData(m_pipe_id, image_frame);
+        ReleaseSifRawData(&m_buf_pool, m_pipe_id, image_frame);
         break;
     default:
         printf("Error: module not supported!\n");
     }
 }
 
+// 对一路的三个数据处理模块取数据
+int VPPCamera::GetImageFrame(ImageFrame *image_frame, DevModule module,
+                int width, int height, const int timeout)
+{
+    int chn_id = -1;
+
+    if (module == Dev_IPU) {
+        if (m_x3_modules_info.m_vps_enable == 0) {
+            printf("Error: vps was not enable\n");
+            return -1;
+        }
+        chn_id = GetChnId(VPP_CAMERA, 0, width, height);
+        if (chn_id == -1) {
+            printf("Error: no vps chn can be get\n");
+            return -1;
+        }
+    }
+
+    return GetModuleFrame(image_frame, module, chn_id, timeout);
+}
+
+void VPPCamera::ReturnImageFrame(ImageFrame *image_frame, DevModule module,
+        int width, int height)
+{
+    int chn_id = -1;
+
+    if (module == Dev_IPU) {
+        chn_id = GetChnId(VPP_CAMERA, 0, width, height);
+        if (chn_id == -1) {
+            printf("Error: no vps chn can be get\n");
+            return;
+        }
+    }
+
+    ReleaseModuleFrame(image_frame, module, chn_id);
+}
+
+ImageFrameLease *VPPCamera::AcquireImageFrame(DevModule module, int width, int height,
+        const int timeout)
+{
+    int chn_id = -1;
+    ImageFrameLease *lease = nullptr;
+
+    if (module == Dev_IPU) {
+        if (m_x3_modules_info.m_vps_enable == 0) {
+            printf("Error: vps was not enable\n");
+            return nullptr;
+        }
+        chn_id = GetChnId(VPP_CAMERA, 0, width, height);
+        if (chn_id == -1) {
+            printf("Error: no vps chn can be get\n");
+            return nullptr;
+        }
+    }
+
+    // 先占计数再检查 m_closing，和 CloseCamera 的先置位再看计数配对，
+    // 两边至少有一方能看到对方，不会在关闭之后还借出租约
+    m_lease_cnt.fetch_add(1);
+    if (m_closing.load()) {
+        LeaseDone();
+        return nullptr;
+    }
+
+    lease = m_lease_pool.Get();
+    if (GetModuleFrame(&lease->m_frame, module, chn_id, timeout)) {
+        m_lease_pool.Put(lease);
+        LeaseDone();
+        return nullptr;
+    }
+    lease->m_module = module;
+    lease->m_chn_id = chn_id;
+    lease->m_owner = this;
+    lease->m_ref_cnt.store(1, std::memory_order_relaxed);
+
+    return lease;
+}
+
+void VPPCamera::RetainImageFrame(ImageFrameLease *lease)
+{
+    if (lease == nullptr)
+        return;
+    lease->m_ref_cnt.fetch_add(1, std::memory_order_relaxed);
+}
+
+void VPPCamera::ReleaseImageFrame(ImageFrameLease *lease)
+{
+    if (lease == nullptr)
+        return;
+    // 最后一个持有者负责把 buffer 还给 VIO
+    if (lease->m_ref_cnt.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    ReleaseModuleFrame(&lease->m_frame, lease->m_module, lease->m_chn_id);
+    m_lease_pool.Put(lease);
+    LeaseDone();
+}
+
+// 租约计数减一，归零时唤醒等待关闭的线程
+void VPPCamera::LeaseDone(void)
+{
+    if (m_lease_cnt.fetch_sub(1) != 1)
+        return;
+    std::lock_guard<std::mutex> lock(m_lease_mutex);
+    m_lease_cond.notify_all();
+}
+
 // 对一路的三个数据处理模块取数据
 int VPPCamera::SetImageFrame(ImageFrame *image_frame, DevModule module)
 {
@@ -804,37 +1068,39 @@ int VPPCamera::GetPipeId()
     return m_pipe_id;
 }
 
+void VPPCamera::ResetChnOwners(void)
+{
+    for (int i = 0; i < VPS_MAX_CHN_NUM; i++) {
+        m_chn_owner[i].store(VPP_CAMERA);
+    }
+}
+
+// for_bind: 把一个空闲（VPP_CAMERA）通道的归属切换为 object
+// 否则:     把归属于 object 的通道还原为 VPP_CAMERA；object 为 VPP_CAMERA 时即取图查询
+// 宽高都为 0 时只查询第一个符合归属的通道，不改变归属
 int VPPCamera::GetChnId(Sdk_Object_e object, int for_bind, int width, int height)
 {
-    x3_vps_chn_attr_t *chn_attr = NULL;
-    for (int i = 0; i < m_x3_modules_info.m_vps_infos.m_vps_info[0].m_chn_num; i++) {
-        chn_attr = &m_x3_modules_info.m_vps_infos.m_vps_info[0].m_vps_chn_attrs[i];
-        if (for_bind) {
-            // for bind
-            if (chn_attr->m_is_bind == VPP_CAMERA) {
-                if(width == 0 && height == 0){
-                    return chn_attr->m_chn_id;
-                }
-                if ((width != (int)chn_attr->m_chn_attr.width ||
-                    height != (int)chn_attr->m_chn_attr.height)) {
-                    continue;
-                }
-                chn_attr->m_is_bind = object;
-                return chn_attr->m_chn_id;
-            }
-        } else {
-            // for unbind
-            if (chn_attr->m_is_bind == object) {
-                if(width == 0 && height == 0){
-                    return chn_attr->m_chn_id;
-                }
-                if ((width != (int)chn_attr->m_chn_attr.width ||
-                    height != (int)chn_attr->m_chn_attr.height)) {
-                    continue;
-                }
-                chn_attr->m_is_bind = VPP_CAMERA;
-                return chn_attr->m_chn_id;
+    x3_vps_info_t *vps_info = &m_x3_modules_info.m_vps_infos.m_vps_info[0];
+    uint32_t mask = vps_chn_lut_find(&m_x3_modules_info, width, height);
+    int from = for_bind ? VPP_CAMERA : object;
+    int to = for_bind ? object : VPP_CAMERA;
+    int expected = 0;
+    int i = 0;
+
+    while (mask) {
+        i = __builtin_ctz(mask);
+        mask &= mask - 1;
+
+        if ((width == 0 && height == 0) || (from == to)) {
+            if (m_chn_owner[i].load(std::memory_order_acquire) == from) {
+                return vps_info->m_vps_chn_attrs[i].m_chn_id;
             }
+            continue;
+        }
+
+        expected = from;
+        if (m_chn_owner[i].compare_exchange_strong(expected, to, std::memory_order_acq_rel)) {
+            return vps_info->m_vps_chn_attrs[i].m_chn_id;
         }
     }
     return -1;
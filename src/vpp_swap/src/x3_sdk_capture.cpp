@@ -0,0 +1,385 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "utils_log.h"
+#include "x3_sdk_capture.h"
+
+namespace srpy_cam
+{
+
+#define CAPTURE_STOP_TAG  0xFFFFFFF1U
+
+static int capture_timer_open(int interval_ms)
+{
+    struct itimerspec spec;
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (fd < 0) {
+        LOGE_print("timerfd_create failed: %s\n", strerror(errno));
+        return -1;
+    }
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(fd, 0, &spec, NULL)) {
+        LOGE_print("timerfd_settime failed: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static tsRingMpmc *capture_queue_create(int depth)
+{
+    void *mem = nullptr;
+
+    if (posix_memalign(&mem, MRING_CACHE_LINE, sizeof(tsRingMpmc)))
+        return nullptr;
+    if (mRingMpmcCreate(static_cast<tsRingMpmc *>(mem), depth, E_RING_WAIT_EVENTFD) != E_QUEUE_OK) {
+        free(mem);
+        return nullptr;
+    }
+    return static_cast<tsRingMpmc *>(mem);
+}
+
+static void capture_queue_destroy(tsRingMpmc *queue)
+{
+    if (queue == nullptr)
+        return;
+    mRingMpmcDestroy(queue);
+    free(queue);
+}
+
+/******************************** FakeCaptureSource ******************************/
+
+int FakeCaptureSource::Open(int width, int height, int fps, int buf_num)
+{
+    void *mem = nullptr;
+    int frame_size = width * height * 3 / 2;
+
+    Close();
+    if (width <= 0 || height <= 0 || fps <= 0 || buf_num <= 0)
+        return -1;
+
+    m_width = width;
+    m_height = height;
+    m_buf_num = buf_num;
+    m_frame_id = 0;
+    m_pending = 0;
+
+    m_buffers = new uint8_t[(size_t)frame_size * buf_num];
+    m_leases = new ImageFrameLease[buf_num]();
+    if (posix_memalign(&mem, MRING_CACHE_LINE, sizeof(tsRingMpmc)) ||
+        mRingMpmcCreate(static_cast<tsRingMpmc *>(mem), buf_num, E_RING_WAIT_NONE) != E_QUEUE_OK) {
+        free(mem);
+        Close();
+        return -1;
+    }
+    m_free = static_cast<tsRingMpmc *>(mem);
+
+    for (int i = 0; i < buf_num; i++) {
+        ImageFrame *frame = &m_leases[i].m_frame;
+        uint8_t *buf = m_buffers + (size_t)frame_size * i;
+
+        memset(buf, 0x10, width * height);
+        memset(buf + width * height, 0x80, width * height / 2);
+        frame->width = width;
+        frame->height = height;
+        frame->stride = width;
+        frame->plane_count = 2;
+        frame->data[0] = buf;
+        frame->data[1] = buf + width * height;
+        frame->data_size[0] = width * height;
+        frame->data_size[1] = width * height / 2;
+        m_leases[i].m_module = Dev_IPU;
+        m_leases[i].m_chn_id = -1;
+        m_leases[i].m_owner = nullptr;
+        mRingMpmcPush(m_free, &m_leases[i]);
+    }
+
+    m_timer_fd = capture_timer_open(1000 / fps > 0 ? 1000 / fps : 1);
+    if (m_timer_fd < 0) {
+        Close();
+        return -1;
+    }
+    return 0;
+}
+
+void FakeCaptureSource::Close()
+{
+    if (m_timer_fd >= 0) {
+        close(m_timer_fd);
+        m_timer_fd = -1;
+    }
+    if (m_free != nullptr) {
+        mRingMpmcDestroy(m_free);
+        free(m_free);
+        m_free = nullptr;
+    }
+    delete[] m_leases;
+    m_leases = nullptr;
+    delete[] m_buffers;
+    m_buffers = nullptr;
+}
+
+ImageFrameLease *FakeCaptureSource::TryAcquire()
+{
+    uint64_t expirations = 0;
+    void *obj = nullptr;
+    struct timespec now;
+
+    if (read(m_timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+        m_pending += expirations;
+    if (m_pending == 0)
+        return nullptr;
+    // 没有空闲 buffer 时和真实 VIO 一样丢帧
+    if (mRingMpmcPop(m_free, &obj) != E_QUEUE_OK) {
+        m_frame_id += m_pending;
+        m_pending = 0;
+        return nullptr;
+    }
+
+    ImageFrameLease *lease = static_cast<ImageFrameLease *>(obj);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    m_pending--;
+    lease->m_frame.image_id = ++m_frame_id;
+    lease->m_frame.lost_image_num = 0;
+    lease->m_frame.image_timestamp = now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    lease->m_ref_cnt.store(1, std::memory_order_relaxed);
+    return lease;
+}
+
+void FakeCaptureSource::Release(ImageFrameLease *lease)
+{
+    if (lease == nullptr)
+        return;
+    if (lease->m_ref_cnt.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        mRingMpmcPush(m_free, lease);
+}
+
+/******************************** VPPCaptureReactor ******************************/
+
+VPPCaptureReactor::~VPPCaptureReactor()
+{
+    Stop();
+    for (int i = 0; i < m_chn_num; i++) {
+        capture_queue_destroy(m_chns[i].m_queue);
+        m_chns[i].m_queue = nullptr;
+    }
+}
+
+int VPPCaptureReactor::AddChannel(CaptureSource *source, CaptureCallback callback,
+        int queue_depth)
+{
+    CaptureChannel *chn = nullptr;
+
+    if (source == nullptr || m_running.load()) {
+        LOGE_print("add channel must be called before start\n");
+        return -1;
+    }
+    if (m_chn_num >= CAPTURE_MAX_CHN_NUM) {
+        LOGE_print("too many capture channels, max:%d\n", CAPTURE_MAX_CHN_NUM);
+        return -1;
+    }
+
+    chn = &m_chns[m_chn_num];
+    chn->m_source = source;
+    chn->m_callback = callback;
+    chn->m_queue = nullptr;
+    chn->m_frames.store(0);
+    chn->m_dropped.store(0);
+    if (!callback) {
+        chn->m_queue = capture_queue_create(queue_depth);
+        if (chn->m_queue == nullptr) {
+            LOGE_print("create capture queue failed, depth:%d\n", queue_depth);
+            return -1;
+        }
+    }
+
+    return m_chn_num++;
+}
+
+int VPPCaptureReactor::AddChannel(CaptureSource *source, CaptureCallback callback)
+{
+    if (!callback)
+        return -1;
+    return AddChannel(source, callback, 0);
+}
+
+int VPPCaptureReactor::AddChannel(CaptureSource *source, int queue_depth)
+{
+    if (queue_depth <= 0)
+        return -1;
+    return AddChannel(source, nullptr, queue_depth);
+}
+
+int VPPCaptureReactor::Start()
+{
+    struct epoll_event ev;
+
+    if (m_running.load())
+        return 0;
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll_fd < 0 || m_stop_fd < 0) {
+        LOGE_print("create epoll/eventfd failed: %s\n", strerror(errno));
+        goto err;
+    }
+    ev.events = EPOLLIN;
+    ev.data.u32 = CAPTURE_STOP_TAG;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_stop_fd, &ev);
+
+    for (int i = 0; i < m_chn_num; i++) {
+        int fd = m_chns[i].m_source->GetReadyFd();
+        if (fd < 0) {
+            LOGE_print("chn:%d has no ready fd\n", i);
+            goto err;
+        }
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev)) {
+            LOGE_print("epoll_ctl chn:%d failed: %s\n", i, strerror(errno));
+            goto err;
+        }
+    }
+
+    m_running.store(true);
+    m_thread.reset(new std::thread(&VPPCaptureReactor::Loop, this));
+    return 0;
+
+err:
+    if (m_stop_fd >= 0)
+        close(m_stop_fd);
+    if (m_epoll_fd >= 0)
+        close(m_epoll_fd);
+    m_stop_fd = m_epoll_fd = -1;
+    return -1;
+}
+
+int VPPCaptureReactor::Stop()
+{
+    void *obj = nullptr;
+
+    if (!m_running.exchange(false))
+        return 0;
+
+    eventfd_write(m_stop_fd, 1);
+    if (m_thread && m_thread->joinable())
+        m_thread->join();
+    m_thread.reset();
+
+    close(m_stop_fd);
+    close(m_epoll_fd);
+    m_stop_fd = m_epoll_fd = -1;
+
+    // 队列里没有被取走的帧要还给源；消费者可能还在 PopFrame，MPMC 队列保证
+    // 每一帧只会被其中一方取走
+    for (int i = 0; i < m_chn_num; i++) {
+        if (m_chns[i].m_queue == nullptr)
+            continue;
+        while (mRingMpmcPop(m_chns[i].m_queue, &obj) == E_QUEUE_OK)
+            m_chns[i].m_source->Release(static_cast<ImageFrameLease *>(obj));
+    }
+    return 0;
+}
+
+void VPPCaptureReactor::Dispatch(int chn, ImageFrameLease *lease)
+{
+    CaptureChannel *c = &m_chns[chn];
+
+    c->m_frames.fetch_add(1, std::memory_order_relaxed);
+    if (c->m_callback) {
+        c->m_callback(chn, lease);
+        c->m_source->Release(lease);
+        return;
+    }
+    if (mRingMpmcPush(c->m_queue, lease) != E_QUEUE_OK) {
+        c->m_dropped.fetch_add(1, std::memory_order_relaxed);
+        c->m_source->Release(lease);
+    }
+}
+
+void VPPCaptureReactor::Drain(int chn)
+{
+    ImageFrameLease *lease = nullptr;
+
+    while ((lease = m_chns[chn].m_source->TryAcquire()) != nullptr)
+        Dispatch(chn, lease);
+}
+
+void VPPCaptureReactor::Loop()
+{
+    struct epoll_event events[CAPTURE_MAX_CHN_NUM + 2];
+    int n = 0;
+
+    while (m_running.load(std::memory_order_relaxed)) {
+        n = epoll_wait(m_epoll_fd, events, CAPTURE_MAX_CHN_NUM + 2, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            LOGE_print("epoll_wait failed: %s\n", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            uint32_t tag = events[i].data.u32;
+            if (tag == CAPTURE_STOP_TAG)
+                return;
+            Drain(tag);
+        }
+    }
+}
+
+int VPPCaptureReactor::PopFrame(int chn, ImageFrameLease **lease, int timeout_ms)
+{
+    void *obj = nullptr;
+
+    if (chn < 0 || chn >= m_chn_num || m_chns[chn].m_queue == nullptr || lease == nullptr)
+        return -1;
+    if (mRingMpmcPopTimed(m_chns[chn].m_queue, timeout_ms, &obj) != E_QUEUE_OK)
+        return -1;
+    *lease = static_cast<ImageFrameLease *>(obj);
+    return 0;
+}
+
+int VPPCaptureReactor::GetChannelFd(int chn)
+{
+    if (chn < 0 || chn >= m_chn_num || m_chns[chn].m_queue == nullptr)
+        return -1;
+    return mRingMpmcGetFd(m_chns[chn].m_queue);
+}
+
+void VPPCaptureReactor::RetainFrame(ImageFrameLease *lease)
+{
+    if (lease != nullptr)
+        lease->m_ref_cnt.fetch_add(1, std::memory_order_relaxed);
+}
+
+void VPPCaptureReactor::ReleaseFrame(int chn, ImageFrameLease *lease)
+{
+    if (chn < 0 || chn >= m_chn_num || lease == nullptr)
+        return;
+    m_chns[chn].m_source->Release(lease);
+}
+
+uint64_t VPPCaptureReactor::GetFrameCount(int chn)
+{
+    if (chn < 0 || chn >= m_chn_num)
+        return 0;
+    return m_chns[chn].m_frames.load();
+}
+
+uint64_t VPPCaptureReactor::GetDropCount(int chn)
+{
+    if (chn < 0 || chn >= m_chn_num)
+        return 0;
+    return m_chns[chn].m_dropped.load();
+}
+
+} // namespace srpy_cam
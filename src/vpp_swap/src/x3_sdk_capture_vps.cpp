@@ -0,0 +1,41 @@
+/***************************************************************************
+ * @COPYRIGHT NOTICE
+ * @Copyright 2023 Horizon Robotics, Inc.
+ * @All rights reserved.
+ ***************************************************************************/
+#include "utils_log.h"
+#include "x3_vio_vps.h"
+#include "x3_sdk_camera.h"
+#include "x3_sdk_capture.h"
+
+namespace srpy_cam
+{
+
+/******************************** VpsChannelSource *******************************/
+
+int VpsChannelSource::GetReadyFd()
+{
+    int chn_id = -1;
+
+    if (m_ready_fd >= 0)
+        return m_ready_fd;
+    chn_id = m_camera->GetChnId(VPP_CAMERA, 0, m_width, m_height);
+    if (chn_id < 0) {
+        LOGE_print("no vps chn for %dx%d\n", m_width, m_height);
+        return -1;
+    }
+    m_ready_fd = x3_vps_get_chn_fd(m_camera->GetPipeId(), chn_id);
+    return m_ready_fd;
+}
+
+ImageFrameLease *VpsChannelSource::TryAcquire()
+{
+    return m_camera->AcquireImageFrame(Dev_IPU, m_width, m_height, 0);
+}
+
+void VpsChannelSource::Release(ImageFrameLease *lease)
+{
+    m_camera->ReleaseImageFrame(lease);
+}
+
+} // namespace srpy_cam
@@ -12,10 +12,13 @@
  */
 
 #include <fcntl.h>
+#include <strings.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <cstdbool>
 #include <cstdint>
 #include <cstdio>
@@ -263,6 +266,7 @@ int VPPCodec::x3_vdec_restart()
     if (ret < 0) {
         return ret;
     }
+    x3_vdec_flush_external();
     ret = HB_VDEC_DestroyChn(m_chn);
     if (ret < 0) {
         return ret;
@@ -397,196 +401,377 @@ int VPPCodec::x3_av_open_stream(x3_codec_param_t *p_param,
     return video_idx;
 }
 
-void VPPCodec::x3_do_sync_decoding(void *param)
+// 取一个空闲的输入 buffer，没有时先根据解码器状态回收一次，仍然没有返回 -1
+int VPPCodec::x3_vdec_try_input()
 {
-    if (!param) {
-        LOGE_print("Invalid param.\n");
-        return;
+    VDEC_CHN_STATUS_S pstStatus;
+    int mmz_index = m_dec_input.Acquire();
+
+    if (mmz_index >= 0)
+        return mmz_index;
+
+    memset(&pstStatus, 0, sizeof(VDEC_CHN_STATUS_S));
+    if (HB_VDEC_QueryStatus(static_cast<VDEC_CHN>(m_chn), &pstStatus) == 0) {
+        m_dec_input.Reclaim(pstStatus.cur_input_buf_cnt);
+        mmz_index = m_dec_input.Acquire();
     }
 
-    int error = 0;
-    int s32Ret = 0;
-    AVFormatContext *avContext = nullptr;
-    AVPacket avpacket = {0};
-    int video_idx = -1;
-    uint8_t *seqHeader = nullptr;
-    int seqHeaderSize = 0;
-    int firstPacket = 1;
-    bool eos = false;
-    int bufSize = 0;
-    int pkt_cnt = 0;
-    int mmz_size = m_width * m_height;
-    int mmz_index = 0;
-    int mmz_cnt = 0;
+    return mmz_index;
+}
 
-    x3_codec_param_t *p_dec_param = static_cast<x3_codec_param_t *>(param);
+// 按 dts（没有时用 pts）把送流时间对齐到码流时间轴上，返回还需要等待的微秒数
+static int64_t vdec_pace_packet(AVStream *stream, AVPacket *pkt,
+        chrono::steady_clock::time_point *base_time, int64_t *base_ts)
+{
+    int64_t ts = (pkt->dts != AV_NOPTS_VALUE) ? pkt->dts : pkt->pts;
+    int64_t offset_us = 0;
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    chrono::steady_clock::time_point due;
+
+    if (ts == AV_NOPTS_VALUE)
+        return 0;
+
+    if (*base_ts == AV_NOPTS_VALUE || ts < *base_ts) {
+        *base_ts = ts;
+        *base_time = now;
+        return 0;
+    }
 
-    VDEC_CHN vdec_chn = static_cast<VDEC_CHN>(m_chn);
-    PAYLOAD_TYPE_E codec_type;
-    if (m_type == TYPE_H264) {
-        codec_type = PT_H264;
-    } else if (m_type == TYPE_H265) {
-        codec_type = PT_H265;
-    } else if (m_type == TYPE_JPEG) {
-        codec_type = PT_JPEG;
-    } else {
-        LOGE_print("codec error type:%d\n", m_type);
-        return;
+    offset_us = av_rescale_q(ts - *base_ts, stream->time_base, AVRational{1, 1000000});
+    due = *base_time + chrono::microseconds(offset_us);
+    if (now - due > chrono::seconds(1)) {
+        // 落后太多（例如 rtsp 卡顿后恢复），重新对齐而不是追赶
+        *base_ts = ts;
+        *base_time = now;
+        return 0;
+    }
+    if (due > now)
+        return chrono::duration_cast<chrono::microseconds>(due - now).count();
+    return 0;
+}
+
+bool VPPCodec::x3_vdec_is_raw_stream(const char *fname)
+{
+    static const char *raw_ext[] = {".h264", ".264", ".h265", ".265", ".hevc"};
+    const char *ext = nullptr;
+
+    // 只有码流模式可以把任意长度的数据块送给解码器，帧模式仍然需要 ffmpeg 分帧
+    if (m_dec_mode != VIDEO_MODE_STREAM || fname == nullptr || strstr(fname, "://"))
+        return false;
+    if (m_type != TYPE_H264 && m_type != TYPE_H265)
+        return false;
+
+    ext = strrchr(fname, '.');
+    if (ext == nullptr)
+        return false;
+    for (auto e : raw_ext) {
+        if (strcasecmp(ext, e) == 0)
+            return true;
     }
+    return false;
+}
 
+int VPPCodec::x3_vdec_send_stream(int chn, uint64_t paddr, char *vaddr, int src_idx, int size, int eos)
+{
     VIDEO_STREAM_S pstStream;
+    int s32Ret = 0;
+
     memset(&pstStream, 0, sizeof(VIDEO_STREAM_S));
+    pstStream.pstPack.phy_ptr = paddr;
+    pstStream.pstPack.vir_ptr = vaddr;
+    pstStream.pstPack.pts = m_dec_pkt_cnt++;
+    pstStream.pstPack.src_idx = src_idx;
+    if (eos == false) {
+        pstStream.pstPack.size = size;
+        pstStream.pstPack.stream_end = HB_FALSE;
+    } else {
+        pstStream.pstPack.size = 0;
+        pstStream.pstPack.stream_end = HB_TRUE;
+    }
+    LOGD_print("[pstStream] pts:%lu, vir_ptr:%p, size:%d\n",
+        pstStream.pstPack.pts,
+        pstStream.pstPack.vir_ptr,
+        pstStream.pstPack.size);
 
-    video_idx = x3_av_open_stream(p_dec_param, &avContext, &avpacket);
-    if (video_idx < 0) {
-        LOGE_print("failed to x3_av_open_stream\n");
-        goto err_av_open;
+    s32Ret = HB_VDEC_SendStream(static_cast<VDEC_CHN>(chn), &pstStream, 3000);
+    if (s32Ret < 0) {
+        LOGE_print("ERROR:HB_VDEC_SendStream failed\n");
     }
+    return s32Ret;
+}
 
-    do {
-        VDEC_CHN_STATUS_S pstStatus;
-        HB_VDEC_QueryStatus(vdec_chn, &pstStatus);
+int VPPCodec::x3_vdec_send_external(int chn, uint64_t paddr, char *vaddr, int src_idx, int size, int eos)
+{
+    int s32Ret = 0;
 
-        mmz_cnt = p_dec_param->vp_param->mmz_cnt;
-        if (pstStatus.cur_input_buf_cnt >= (uint32_t)mmz_cnt) {
-            usleep(10 * 1000);
-            continue;
+    AUTO_UNIQUE_MTX_LOCK(m_dec_mtx);
+    if (m_dec_ext.Full()) {
+        LOGE_print("Too many stream buffers not reclaimed, max:%d\n", VDEC_INPUT_MAX_NUM);
+        return -1;
+    }
+    s32Ret = x3_vdec_send_stream(chn, paddr, vaddr, eos ? 0 : src_idx, size, eos);
+    if (s32Ret < 0)
+        return s32Ret;
+    m_dec_ext.Submit(eos ? -1 : src_idx);
+    return s32Ret;
+}
+
+int VPPCodec::x3_vdec_reclaim_external()
+{
+    VDEC_CHN_STATUS_S pstStatus;
+    uint32_t pending = VDEC_INPUT_MAX_NUM;
+
+    AUTO_UNIQUE_MTX_LOCK(m_dec_mtx);
+    if (m_dec_ext.Empty())
+        return -1;
+    // 查询失败（通道已经销毁）时只交还 Flush 过的 buffer
+    memset(&pstStatus, 0, sizeof(VDEC_CHN_STATUS_S));
+    if (HB_VDEC_QueryStatus(static_cast<VDEC_CHN>(m_chn), &pstStatus) == 0)
+        pending = pstStatus.cur_input_buf_cnt;
+    return m_dec_ext.Reclaim(pending);
+}
+
+void VPPCodec::x3_vdec_flush_external()
+{
+    AUTO_UNIQUE_MTX_LOCK(m_dec_mtx);
+    m_dec_ext.Flush();
+}
+
+int VPPCodec::x3_vdec_feed_open(x3_codec_param_t *p_param)
+{
+    x3_vdec_feed_t *feed = &m_dec_feed;
+
+    feed->param = p_param;
+    feed->av_ctx = nullptr;
+    memset(&feed->av_pkt, 0, sizeof(AVPacket));
+    feed->video_idx = -1;
+    feed->raw_fd = -1;
+    feed->first_packet = true;
+    feed->eos = false;
+    feed->pace_base_ts = AV_NOPTS_VALUE;
+
+    if (!p_param || !p_param->vp_param) {
+        LOGE_print("Invalid param.\n");
+        return -1;
+    }
+
+    if (m_type != TYPE_H264 && m_type != TYPE_H265 && m_type != TYPE_JPEG) {
+        LOGE_print("codec error type:%d\n", m_type);
+        return -1;
+    }
+
+    m_dec_input.Reset(p_param->vp_param->mmz_cnt);
+
+    if (x3_vdec_is_raw_stream(p_param->fname)) {
+        feed->raw_fd = open(p_param->fname, O_RDONLY);
+        p_param->fname = NULL;
+        p_param->frame_count = 0; // 裸码流没有索引，帧数未知
+        sem_post(&p_param->read_done);
+        if (feed->raw_fd < 0) {
+            LOGE_print("Failed to open stream file, %s\n", strerror(errno));
+            return -1;
         }
+        return 0;
+    }
+
+    feed->video_idx = x3_av_open_stream(p_param, &feed->av_ctx, &feed->av_pkt);
+    if (feed->video_idx < 0) {
+        LOGE_print("failed to x3_av_open_stream\n");
+        if (feed->av_ctx)
+            avformat_close_input(&feed->av_ctx);
+        // 不让 do_decoding 一直等在 read_done 上
+        p_param->frame_count = 0;
+        sem_post(&p_param->read_done);
+        return -1;
+    }
+
+    return 0;
+}
+
+// 码流模式下的裸 h264/h265 文件直接 read 到 mmz 输入 buffer，不经过 ffmpeg 解复用和拷贝
+int VPPCodec::x3_vdec_feed_raw(x3_vdec_feed_t *feed)
+{
+    vp_param_t *vp_param = feed->param->vp_param;
+    int mmz_index = x3_vdec_try_input();
+    ssize_t size = 0;
+
+    if (mmz_index < 0)
+        return DEC_FEED_IDLE;
+
+    size = read(feed->raw_fd, vp_param->mmz_vaddr[mmz_index], vp_param->mmz_size);
+    if (size <= 0) {
+        if (size < 0)
+            LOGE_print("Failed to read stream file, %s\n", strerror(errno));
+        feed->eos = true;
+        feed->param->is_quit = true;
+        return DEC_FEED_DONE;
+    }
+
+    AUTO_UNIQUE_MTX_LOCK(m_dec_mtx);
+    x3_vdec_send_stream(m_chn, vp_param->mmz_paddr[mmz_index], vp_param->mmz_vaddr[mmz_index],
+                        mmz_index, static_cast<int>(size), false);
+    m_dec_input.Submit(mmz_index);
+    return DEC_FEED_SENT;
+}
 
-        /// wait for each frame for decoding
-        usleep(30 * 1000);
-        if (p_dec_param->is_quit) {
-            eos = true;
-            break;
+int VPPCodec::x3_vdec_feed_step()
+{
+    x3_vdec_feed_t *feed = &m_dec_feed;
+    x3_codec_param_t *p_dec_param = feed->param;
+    vp_param_t *vp_param = p_dec_param->vp_param;
+    int error = 0;
+    int mmz_index = 0;
+    int mmz_size = m_width * m_height;
+    uint8_t *seqHeader = nullptr;
+    int seqHeaderSize = 0;
+    int bufSize = 0;
+    PAYLOAD_TYPE_E codec_type = PT_H264;
+
+    if (p_dec_param->is_quit) {
+        feed->eos = true;
+        return DEC_FEED_DONE;
+    }
+
+    if (feed->raw_fd >= 0)
+        return x3_vdec_feed_raw(feed);
+
+    if (!feed->av_pkt.size) {
+        error = av_read_frame(feed->av_ctx, &feed->av_pkt);
+    }
+
+    if (error < 0) {
+        if (error == AVERROR_EOF || feed->av_ctx->pb->eof_reached == HB_TRUE) {
+            LOGD_print("There is no more input data, %d!\n", feed->av_pkt.size);
+            return DEC_FEED_DONE;
         }
+        LOGE_print("Failed to av_read_frame error(0x%08x)\n", error);
 
-        if (!avpacket.size) {
-            error = av_read_frame(avContext, &avpacket);
+        avformat_close_input(&feed->av_ctx);
+        if (p_dec_param->fname == NULL) {
+            feed->eos = true;
+            p_dec_param->is_quit = true;
+            return DEC_FEED_DONE;
         }
+        // 重新打开码流（例如 rtsp 断流后调用者设置了新的地址）
+        memset(&feed->av_pkt, 0, sizeof(AVPacket));
+        feed->pace_base_ts = AV_NOPTS_VALUE;
+        feed->video_idx = x3_av_open_stream(p_dec_param, &feed->av_ctx, &feed->av_pkt);
+        if (feed->video_idx < 0) {
+            LOGE_print("failed to x3_av_open_stream\n");
+            return DEC_FEED_DONE;
+        }
+        return DEC_FEED_SENT;
+    }
 
-        if (error < 0) {
-            if (error == AVERROR_EOF || avContext->pb->eof_reached == HB_TRUE) {
-                LOGD_print("There is no more input data, %d!\n", avpacket.size);
-                eos = false;
-                break;
-            } else {
-                LOGE_print("Failed to av_read_frame error(0x%08x)\n", error);
-            }
+    // 第一包之前先送序列头，数据包留到下一次
+    if (!feed->first_packet && p_dec_param->pace_mode == DEC_PACE_PTS) {
+        if (vdec_pace_packet(feed->av_ctx->streams[feed->video_idx], &feed->av_pkt,
+                             &feed->pace_base_time, &feed->pace_base_ts) > 0)
+            return DEC_FEED_IDLE;
+    }
 
-            if (avContext) {
-                avformat_close_input(&avContext);
-            }
-            if (p_dec_param->fname != NULL) {
-                avContext = nullptr;
-                memset(&avpacket, 0, sizeof(avpacket));
-                video_idx = x3_av_open_stream(p_dec_param, &avContext, &avpacket);
-                if (video_idx < 0) {
-                    LOGE_print("failed to x3_av_open_stream\n");
-                    goto err_av_open;
-                }
-            } else {
-                eos = true;
-            }
-        } else {
-            seqHeaderSize = 0;
-            mmz_index = pkt_cnt % mmz_cnt;
-            if (firstPacket) {
-                AUTO_UNIQUE_MTX_LOCK(m_dec_mtx);
-                AVCodecParameters *codec;
-                int retSize = 0;
-                codec = avContext->streams[video_idx]->codecpar;
-                seqHeader = (uint8_t *)calloc(1U, codec->extradata_size + 1024);
-                if (seqHeader == nullptr) {
-                    LOGE_print("Failed to mallock seqHeader\n");
-                    eos = true;
-                    break;
-                }
-
-                seqHeaderSize = AV_build_dec_seq_header(seqHeader,
-                                                        codec_type,
-                                                        avContext->streams[video_idx], &retSize);
-                if (seqHeaderSize < 0) {
-                    LOGE_print("Failed to build seqHeader\n");
-                    eos = true;
-                    break;
-                }
-                firstPacket = 0;
-            }
-            if (avpacket.size <= mmz_size) {
-                AUTO_UNIQUE_MTX_LOCK(m_dec_mtx);
-                if (seqHeaderSize) {
-                    memcpy((void *)p_dec_param->vp_param->mmz_vaddr[mmz_index],
-                           (void *)seqHeader, seqHeaderSize);
-                    bufSize = seqHeaderSize;
-                } else {
-                    memcpy((void *)p_dec_param->vp_param->mmz_vaddr[mmz_index],
-                           (void *)avpacket.data, avpacket.size);
-                    bufSize = avpacket.size;
-                    av_packet_unref(&avpacket);
-                    avpacket.size = 0;
-                }
-            } else {
-                LOGE_print("The external stream buffer is too small!"
-                      "avpacket.size:%d, mmz_size:%d\n",
-                      avpacket.size, mmz_size);
-                eos = true;
-                break;
-            }
+    mmz_index = x3_vdec_try_input();
+    if (mmz_index < 0)
+        return DEC_FEED_IDLE;
 
-            if (seqHeader) {
-                free(seqHeader);
-                seqHeader = nullptr;
-            }
+    AUTO_UNIQUE_MTX_LOCK(m_dec_mtx);
+    if (feed->first_packet) {
+        AVCodecParameters *codec;
+        int retSize = 0;
+
+        if (m_type == TYPE_H265)
+            codec_type = PT_H265;
+        else if (m_type == TYPE_JPEG)
+            codec_type = PT_JPEG;
+        codec = feed->av_ctx->streams[feed->video_idx]->codecpar;
+        seqHeader = (uint8_t *)calloc(1U, codec->extradata_size + 1024);
+        if (seqHeader == nullptr) {
+            LOGE_print("Failed to mallock seqHeader\n");
+            feed->eos = true;
+            return DEC_FEED_DONE;
         }
 
-        /// Decode of sending frame
-        {
-            AUTO_UNIQUE_MTX_LOCK(m_dec_mtx);
-            pstStream.pstPack.phy_ptr =
-                p_dec_param->vp_param->mmz_paddr[mmz_index];
-            pstStream.pstPack.vir_ptr =
-                p_dec_param->vp_param->mmz_vaddr[mmz_index];
-            pstStream.pstPack.pts = pkt_cnt++;
-            pstStream.pstPack.src_idx = mmz_index;
-            if (eos == false) {
-                pstStream.pstPack.size = bufSize;
-                pstStream.pstPack.stream_end = HB_FALSE;
-            } else {
-                pstStream.pstPack.size = 0;
-                pstStream.pstPack.stream_end = HB_TRUE;
-            }
-            LOGD_print("[pstStream] pts:%lu, vir_ptr:%p, size:%d\n",
-                pstStream.pstPack.pts,
-                pstStream.pstPack.vir_ptr,
-                pstStream.pstPack.size);
-
-            s32Ret = HB_VDEC_SendStream(vdec_chn, &pstStream, 3000);
-            if (s32Ret == -HB_ERR_VDEC_OPERATION_NOT_ALLOWDED ||
-                s32Ret == -HB_ERR_VDEC_UNKNOWN) {
-                LOGE_print("ERROR:HB_VDEC_SendStream failed\n");
-            }
+        seqHeaderSize = AV_build_dec_seq_header(seqHeader,
+                                                codec_type,
+                                                feed->av_ctx->streams[feed->video_idx], &retSize);
+        if (seqHeaderSize < 0) {
+            LOGE_print("Failed to build seqHeader\n");
+            free(seqHeader);
+            feed->eos = true;
+            return DEC_FEED_DONE;
         }
+        feed->first_packet = false;
+    }
 
-        if (eos) {
-            p_dec_param->is_quit = 1;
-        }
-    } while (!p_dec_param->is_quit);
+    if (feed->av_pkt.size > mmz_size) {
+        LOGE_print("The external stream buffer is too small!"
+              "avpacket.size:%d, mmz_size:%d\n",
+              feed->av_pkt.size, mmz_size);
+        if (seqHeader)
+            free(seqHeader);
+        feed->eos = true;
+        return DEC_FEED_DONE;
+    }
+
+    if (seqHeaderSize) {
+        memcpy((void *)vp_param->mmz_vaddr[mmz_index], (void *)seqHeader, seqHeaderSize);
+        bufSize = seqHeaderSize;
+    } else {
+        memcpy((void *)vp_param->mmz_vaddr[mmz_index],
+               (void *)feed->av_pkt.data, feed->av_pkt.size);
+        bufSize = feed->av_pkt.size;
+        av_packet_unref(&feed->av_pkt);
+        feed->av_pkt.size = 0;
+    }
+    if (seqHeader)
+        free(seqHeader);
 
-    if (eos) {
+    x3_vdec_send_stream(m_chn, vp_param->mmz_paddr[mmz_index], vp_param->mmz_vaddr[mmz_index],
+                        mmz_index, bufSize, false);
+    m_dec_input.Submit(mmz_index);
+
+    return DEC_FEED_SENT;
+}
+
+void VPPCodec::x3_vdec_feed_close()
+{
+    x3_vdec_feed_t *feed = &m_dec_feed;
+    vp_param_t *vp_param = feed->param ? feed->param->vp_param : nullptr;
+
+    if (feed->eos && vp_param) {
         AUTO_UNIQUE_MTX_LOCK(m_dec_mtx);
-        pstStream.pstPack.size = 0;
-        pstStream.pstPack.stream_end = HB_TRUE;
-        HB_VDEC_SendStream(vdec_chn, &pstStream, 3000);
+        x3_vdec_send_stream(m_chn, vp_param->mmz_paddr[0], vp_param->mmz_vaddr[0], 0, 0, true);
     }
+    feed->eos = false;
 
-    if (seqHeader) {
-        free(seqHeader);
-        seqHeader = nullptr;
+    if (feed->av_pkt.size) {
+        av_packet_unref(&feed->av_pkt);
+        feed->av_pkt.size = 0;
+    }
+    if (feed->av_ctx)
+        avformat_close_input(&feed->av_ctx);
+    if (feed->raw_fd >= 0) {
+        close(feed->raw_fd);
+        feed->raw_fd = -1;
     }
+}
+
+void VPPCodec::x3_do_sync_decoding(void *param)
+{
+    x3_codec_param_t *p_dec_param = static_cast<x3_codec_param_t *>(param);
+    int ret = 0;
 
-err_av_open:
-    if (avContext)
-        avformat_close_input(&avContext);
+    if (x3_vdec_feed_open(p_dec_param) != 0) {
+        x3_vdec_feed_close();
+        return;
+    }
+
+    while ((ret = x3_vdec_feed_step()) != DEC_FEED_DONE) {
+        if (ret == DEC_FEED_IDLE)
+            usleep(DEC_FEED_RECLAIM_US);
+    }
+
+    x3_vdec_feed_close();
 }
 
 int VPPCodec::x3_venc_file(char *addr, int32_t size)
@@ -658,7 +843,6 @@ err_vp_alloc:
 ImageFrame *VPPCodec::x3_venc_get_frame()
 {
     int ret = 0;
-    static int64_t frame_id = 0;
     VENC_CHN venc_chn = static_cast<VENC_CHN>(m_chn);
 
     memset(&m_enc_pstStream, 0, sizeof(VIDEO_STREAM_S));
@@ -673,7 +857,7 @@ ImageFrame *VPPCodec::x3_venc_get_frame()
     /// get venc frame
     m_enc_frame = make_unique<ImageFrame>();
     m_enc_frame->data[0] = reinterpret_cast<uint8_t *>(m_enc_pstStream.pstPack.vir_ptr);
-    m_enc_frame->image_id = frame_id++;
+    m_enc_frame->image_id = m_enc_frame_id++;
     m_enc_frame->image_timestamp = static_cast<int64_t>(time(nullptr));
     m_enc_frame->data_size[0] = m_enc_pstStream.pstPack.size;
     m_enc_frame->frame_info = static_cast<void *>(&m_enc_pstStream);
@@ -703,7 +887,6 @@ int VPPCodec::x3_venc_put_frame(ImageFrame *frame)
 ImageFrame *VPPCodec::x3_vdec_get_frame()
 {
     int ret = 0;
-    static int64_t frame_id = 0;
     VDEC_CHN vdec_chn = static_cast<VDEC_CHN>(m_chn);
 
     ret = HB_VDEC_GetFrame(vdec_chn, &m_dec_pstFrame, 1000);
@@ -716,7 +899,7 @@ ImageFrame *VPPCodec::x3_vdec_get_frame()
     m_dec_frame = make_unique<ImageFrame>();
     m_dec_frame->data[0] = reinterpret_cast<uint8_t *>(m_dec_pstFrame.stVFrame.vir_ptr[0]);
     m_dec_frame->data[1] = reinterpret_cast<uint8_t *>(m_dec_pstFrame.stVFrame.vir_ptr[1]);
-    m_dec_frame->image_id = frame_id++;
+    m_dec_frame->image_id = m_dec_frame_id++;
     m_dec_frame->image_timestamp = static_cast<int64_t>(time(nullptr));
     m_dec_frame->data_size[0] = m_width * m_height;
     m_dec_frame->data_size[1] = m_width * m_height / 2;
@@ -749,32 +932,27 @@ int VPPCodec::x3_vdec_put_frame(ImageFrame *frame)
 int VPPEncode::do_encoding(int video_chn, int type, int width,
                             int height, int bits)
 {
-    static int l_chn, l_type, l_width, l_height, l_bits;
-
     if (!m_enc_inited.test_and_set()) {
-        m_enc_obj = make_unique<VPPCodec>(video_chn,
-                                           type, width, height, bits);
-
-        if (x3_venc_common_init())
+        m_chn = VPPCodecChns::Alloc(MODE_VENC, video_chn);
+        if (m_chn < 0) {
+            m_enc_inited.clear();
             return -1;
-
-        if (m_enc_obj->x3_venc_init())
-            return -1;
-
-        if (m_enc_obj->x3_venc_start())
+        }
+        m_enc_obj = make_unique<VPPCodec>(m_chn,
+                                           type, width, height, bits);
+        if (start_encoder())
             return -1;
 
-        l_chn = video_chn;
-        l_type = type;
-        l_width = width;
-        l_height = height;
-        l_bits = bits;
+        m_type = type;
+        m_width = width;
+        m_height = height;
+        m_bits = bits;
     }
 
-    if (l_chn != video_chn || type != l_type ||
-        width != l_width || height != l_height || bits != l_bits) {
+    if ((video_chn >= 0 && m_chn != video_chn) || type != m_type ||
+        width != m_width || height != m_height || bits != m_bits) {
         LOGE_print("Invalid encode param, must be same as before(chn:%d typt:%d w:%d h:%d bits:%d)\n",
-              l_chn, l_type, l_width, l_height, l_bits);
+              m_chn, m_type, m_width, m_height, m_bits);
         return -1;
     }
 
@@ -784,19 +962,44 @@ int VPPEncode::do_encoding(int video_chn, int type, int width,
 int VPPEncode::do_encoding()
 {
     if (!m_enc_inited.test_and_set()) {
+        m_chn = VPPCodecChns::Alloc(MODE_VENC, 0);
+        if (m_chn < 0) {
+            m_enc_inited.clear();
+            return -1;
+        }
         m_enc_obj = make_unique<VPPCodec>();
-
-        if (x3_venc_common_init())
+        if (start_encoder())
             return -1;
+    }
 
-        if (m_enc_obj->x3_venc_init())
-            return -1;
+    return 0;
+}
 
-        if (m_enc_obj->x3_venc_start())
-            return -1;
-    }
+// 依次初始化并启动编码器，任何一步失败都回退已完成的步骤，
+// 归还通道号并清掉 m_enc_inited，之后可以重新 do_encoding
+int VPPEncode::start_encoder()
+{
+    if (x3_venc_common_init())
+        goto err_chn;
+
+    if (m_enc_obj->x3_venc_init())
+        goto err_common;
+
+    if (m_enc_obj->x3_venc_start())
+        goto err_init;
 
     return 0;
+
+err_init:
+    m_enc_obj->x3_venc_deinit();
+err_common:
+    x3_venc_common_deinit();
+err_chn:
+    m_enc_obj.reset();
+    VPPCodecChns::Free(MODE_VENC, m_chn);
+    m_chn = -1;
+    m_enc_inited.clear();
+    return -1;
 }
 
 int VPPEncode::encode_file(char *addr, int32_t size)
@@ -815,6 +1018,8 @@ int VPPEncode::undo_encoding()
     m_enc_obj->x3_venc_stop();
     m_enc_obj->x3_venc_deinit();
     x3_venc_common_deinit();
+    VPPCodecChns::Free(MODE_VENC, m_chn);
+    m_chn = -1;
 
     return 0;
 }
@@ -844,26 +1049,21 @@ int VPPDecode::do_decoding(const char *file_name, int video_chn,
         int type, int width, int height, int *frame_cnt, int dec_mode)
 {
 
-    static int l_chn, l_type, l_width, l_height, l_mode;
-
     if (!m_dec_inited.test_and_set()) {
-        m_dec_obj = make_unique<VPPCodec>(video_chn, type, width,
-                                           height, 8000, dec_mode);
-
-        if (x3_vdec_common_init())
+        m_chn = VPPCodecChns::Alloc(MODE_VDEC, video_chn);
+        if (m_chn < 0) {
+            m_dec_inited.clear();
             return -1;
-
-        if (m_dec_obj->x3_vdec_init())
-            return -1;
-
-        if (m_dec_obj->x3_vdec_start())
+        }
+        m_dec_obj = make_unique<VPPCodec>(m_chn, type, width,
+                                           height, 8000, dec_mode);
+        if (start_decoder())
             return -1;
 
-        l_chn = video_chn;
-        l_type = type;
-        l_width = width;
-        l_height = height;
-        l_mode = dec_mode;
+        m_type = type;
+        m_width = width;
+        m_height = height;
+        m_mode = dec_mode;
     }
 
     m_dec_file = file_name;
@@ -872,8 +1072,12 @@ int VPPDecode::do_decoding(const char *file_name, int video_chn,
         m_decode_param = make_unique<x3_codec_param_t>();
         m_decode_param->codec_type = MODE_VDEC;
         m_decode_param->alloc_nums = 3;
+        m_decode_param->pace_mode = m_pace_mode;
         if (m_dec_obj->x3_codec_vp_init(m_decode_param.get()) != 0) {
             LOGE_print("failed to x3_codec_vp_init\n");
+            // 解码器本身已经启动，留给 undo_decoding 回收
+            m_decode_param.reset();
+            m_start_once.clear();
             return -1;
         }
         m_decode_param->fname = m_dec_file.data();
@@ -881,24 +1085,19 @@ int VPPDecode::do_decoding(const char *file_name, int video_chn,
         sem_init(&m_decode_param->read_done, 0, 0);
         if ((m_decode_param->fname != NULL) && (strlen(m_decode_param->fname) > 0)) {
             m_decode_param->is_quit = false;
-            m_running_thread =
-                make_shared<thread>(&VPPDecode::decode_func,
-                                this, static_cast<void *>(m_decode_param.get()));
+            start_feeding();
         }
     } else {
         m_decode_param->fname = m_dec_file.data();
+        m_decode_param->pace_mode = m_pace_mode;
         if (m_decode_param->is_quit == true) {
             if (m_dec_obj->x3_vdec_restart())
                 return -1;
-            if (m_running_thread && m_running_thread->joinable()) {
-                m_running_thread->join();
-            }
+            stop_feeding();
             m_decode_param->is_quit = true;
             if ((m_decode_param->fname != NULL) && (strlen(m_decode_param->fname) > 0)) {
                 m_decode_param->is_quit = false;
-                m_running_thread =
-                    make_shared<thread>(&VPPDecode::decode_func,
-                                this, static_cast<void *>(m_decode_param.get()));
+                start_feeding();
             }
         }
     }
@@ -908,10 +1107,10 @@ int VPPDecode::do_decoding(const char *file_name, int video_chn,
         *frame_cnt = m_decode_param->frame_count;
     }
 
-    if (l_chn != video_chn || type != l_type ||
-        width != l_width || height != l_height || dec_mode != l_mode) {
+    if ((video_chn >= 0 && m_chn != video_chn) || type != m_type ||
+        width != m_width || height != m_height || dec_mode != m_mode) {
         LOGE_print("Invalid decode param, must be same as before(chn:%d type:%d w:%d h:%d mode:%d)\n",
-              l_chn, l_type, l_width, l_height, l_mode);
+              m_chn, m_type, m_width, m_height, m_mode);
         return -1;
     }
 
@@ -921,14 +1120,16 @@ int VPPDecode::do_decoding(const char *file_name, int video_chn,
 int VPPDecode::do_decoding()
 {
     if (!m_dec_inited.test_and_set()) {
-        m_dec_obj = make_unique<VPPCodec>();
-
-        if (x3_vdec_common_init())
+        m_chn = VPPCodecChns::Alloc(MODE_VDEC, 0);
+        if (m_chn < 0) {
+            m_dec_inited.clear();
             return -1;
-
-        if (m_dec_obj->x3_vdec_init())
+        }
+        m_dec_obj = make_unique<VPPCodec>();
+        if (start_decoder())
             return -1;
 
+        // 解码器启动成功之后才开始送流，失败时不会留下需要回收的送流线程
         if (!m_start_once.test_and_set()) {
             m_decode_param = make_unique<x3_codec_param_t>();
             m_decode_param->fname = m_dec_file.data();
@@ -939,14 +1140,37 @@ int VPPDecode::do_decoding()
                                     this, static_cast<void *>(m_decode_param.get()));
             }
         }
-
-        if (m_dec_obj->x3_vdec_start())
-            return -1;
     }
 
     return 0;
 }
 
+// 同 VPPEncode::start_encoder，失败时归还通道号并清掉 m_dec_inited
+int VPPDecode::start_decoder()
+{
+    if (x3_vdec_common_init())
+        goto err_chn;
+
+    if (m_dec_obj->x3_vdec_init())
+        goto err_common;
+
+    if (m_dec_obj->x3_vdec_start())
+        goto err_init;
+
+    return 0;
+
+err_init:
+    m_dec_obj->x3_vdec_deinit();
+err_common:
+    x3_vdec_common_deinit();
+err_chn:
+    m_dec_obj.reset();
+    VPPCodecChns::Free(MODE_VDEC, m_chn);
+    m_chn = -1;
+    m_dec_inited.clear();
+    return -1;
+}
+
 int VPPDecode::undo_decoding()
 {
     if (!m_dec_obj) {
@@ -954,14 +1178,23 @@ int VPPDecode::undo_decoding()
         return -1;
     }
 
-    m_dec_inited.clear();
-    m_decode_param->is_quit = true;
-    if (m_running_thread && m_running_thread->joinable()) {
-        m_running_thread->join();
+    // 先停止送流并等送流线程退出 feed_step，再停通道；通道号最后归还，避免被别的解码器拿到后还在往里送流
+    if (m_decode_param) {
+        m_decode_param->is_quit = true;
+        stop_feeding();
     }
 
     m_dec_obj->x3_vdec_stop();
 
+    if (!m_decode_param) {
+        m_dec_obj->x3_vdec_deinit();
+        x3_vdec_common_deinit();
+        VPPCodecChns::Free(MODE_VDEC, m_chn);
+        m_chn = -1;
+        m_dec_inited.clear();
+        return 0;
+    }
+
     m_start_once.clear();
 
     sem_destroy(&m_decode_param->read_done);
@@ -978,10 +1211,42 @@ int VPPDecode::undo_decoding()
     }
     m_dec_obj->x3_vdec_deinit();
     x3_vdec_common_deinit();
+    VPPCodecChns::Free(MODE_VDEC, m_chn);
+    m_chn = -1;
+    m_dec_inited.clear();
 
     return 0;
 }
 
+void VPPDecode::start_feeding()
+{
+    if (!m_use_workers) {
+        m_running_thread =
+            make_shared<thread>(&VPPDecode::decode_func,
+                            this, static_cast<void *>(m_decode_param.get()));
+        return;
+    }
+
+    // 打开码流在调用者线程中完成，之后的送流交给共享的工作线程
+    if (m_dec_obj->x3_vdec_feed_open(m_decode_param.get()) != 0) {
+        m_dec_obj->x3_vdec_feed_close();
+        return;
+    }
+    VPPDecodeWorkers::Instance().Attach(m_dec_obj.get());
+}
+
+void VPPDecode::stop_feeding()
+{
+    if (m_use_workers) {
+        VPPDecodeWorkers::Instance().Detach(m_dec_obj.get());
+        return;
+    }
+
+    if (m_running_thread && m_running_thread->joinable()) {
+        m_running_thread->join();
+    }
+}
+
 void VPPDecode::decode_func(void *param)
 {
     if (!m_dec_obj || !param) {
@@ -1012,45 +1277,155 @@ int VPPDecode::put_frame(ImageFrame *frame)
     return m_dec_obj->x3_vdec_put_frame(frame);
 }
 
+int VPPDecode::set_pace_mode(int mode)
+{
+    if (mode != DEC_PACE_FREE && mode != DEC_PACE_PTS) {
+        LOGE_print("Invalid pace mode:%d\n", mode);
+        return -1;
+    }
+    m_pace_mode = mode;
+    return 0;
+}
+
 int VPPDecode::send_frame(int chn, void *addr, int size, int eos)
 {
-    VIDEO_STREAM_S pstStream = {0};
-    static int pkt_cnt = 0;
     int mmz_index = 0;
-    int ret = 0;
 
     if (!m_dec_obj) {
         LOGE_print("Invalid param!\n");
         return -1;
     }
 
-    mmz_index = pkt_cnt % m_decode_param->alloc_nums;
+    mmz_index = m_send_cnt++ % m_decode_param->alloc_nums;
     memcpy(m_decode_param->vp_param->mmz_vaddr[mmz_index], addr, size);
 
-    pstStream.pstPack.phy_ptr =
-        m_decode_param->vp_param->mmz_paddr[mmz_index];
-    pstStream.pstPack.vir_ptr =
-        m_decode_param->vp_param->mmz_vaddr[mmz_index];
-    pstStream.pstPack.pts = pkt_cnt++;
-    pstStream.pstPack.src_idx = mmz_index;
-    if (eos == false) {
-        pstStream.pstPack.size = size;
-        pstStream.pstPack.stream_end = HB_FALSE;
-    } else {
-        pstStream.pstPack.size = 0;
-        pstStream.pstPack.stream_end = HB_TRUE;
+    return m_dec_obj->x3_vdec_send_stream(chn, m_decode_param->vp_param->mmz_paddr[mmz_index],
+                                          m_decode_param->vp_param->mmz_vaddr[mmz_index],
+                                          mmz_index, size, eos);
+}
+
+int VPPDecode::send_frame(int chn, uint64_t paddr, void *vaddr, int src_idx, int size, int eos)
+{
+    if (!m_dec_obj) {
+        LOGE_print("Invalid param!\n");
+        return -1;
+    }
+    if (eos == false && (paddr == 0 || src_idx < 0 || src_idx >= VDEC_INPUT_MAX_NUM)) {
+        LOGE_print("Invalid stream buffer, paddr:0x%lx src_idx:%d\n", paddr, src_idx);
+        return -1;
     }
-    LOGD_print("[pstStream] pts:%lu, vir_ptr:%p, size:%d\n",
-        pstStream.pstPack.pts,
-        pstStream.pstPack.vir_ptr,
-        pstStream.pstPack.size);
 
-    ret = HB_VDEC_SendStream(chn, &pstStream, 3000);
-    if (ret < 0) {
-        LOGE_print("ERROR:HB_VDEC_SendStream failed\n");
+    return m_dec_obj->x3_vdec_send_external(chn, paddr, static_cast<char *>(vaddr), src_idx, size, eos);
+}
+
+int VPPDecode::reclaim_frame()
+{
+    if (!m_dec_obj) {
+        LOGE_print("Invalid param!\n");
+        return -1;
     }
 
-    return ret;
+    return m_dec_obj->x3_vdec_reclaim_external();
+}
+
+/// Codec channel budget
+
+std::mutex VPPCodecChns::s_mtx;
+uint32_t VPPCodecChns::s_used[MODE_INVAL] = {0};
+
+int VPPCodecChns::Alloc(int codec_type, int chn)
+{
+    if (codec_type != MODE_VENC && codec_type != MODE_VDEC) {
+        LOGE_print("Invalid codec type:%d\n", codec_type);
+        return -1;
+    }
+    if (chn >= CODEC_MAX_CHN_NUM) {
+        LOGE_print("Invalid codec chn:%d\n", chn);
+        return -1;
+    }
+
+    AUTO_UNIQUE_MTX_LOCK(s_mtx);
+    if (chn < 0) {
+        if (s_used[codec_type] == 0xFFFFFFFFU) {
+            LOGE_print("No free %s chn\n", codec_type == MODE_VENC ? "venc" : "vdec");
+            return -1;
+        }
+        chn = __builtin_ctz(~s_used[codec_type]);
+    } else if (s_used[codec_type] & (1U << chn)) {
+        LOGE_print("%s chn %d is already in use\n", codec_type == MODE_VENC ? "venc" : "vdec", chn);
+        return -1;
+    }
+    s_used[codec_type] |= 1U << chn;
+
+    return chn;
+}
+
+void VPPCodecChns::Free(int codec_type, int chn)
+{
+    if ((codec_type != MODE_VENC && codec_type != MODE_VDEC) ||
+        chn < 0 || chn >= CODEC_MAX_CHN_NUM)
+        return;
+
+    AUTO_UNIQUE_MTX_LOCK(s_mtx);
+    s_used[codec_type] &= ~(1U << chn);
+}
+
+/// Class VPPDecodeManager related
+
+int VPPDecodeManager::Open(const char *file_name, int type, int width, int height,
+                           int *frame_cnt, int chn, int dec_mode)
+{
+    unique_ptr<VPPDecode> decoder = make_unique<VPPDecode>();
+    int ret = 0;
+
+    decoder->m_use_workers = true;
+    ret = decoder->do_decoding(file_name, chn, type, width, height, frame_cnt, dec_mode);
+    if (decoder->m_chn < 0) {
+        return -1;
+    }
+    if (ret != 0) {
+        decoder->undo_decoding();
+        return -1;
+    }
+
+    AUTO_UNIQUE_MTX_LOCK(m_mtx);
+    chn = decoder->m_chn;
+    m_decoders[chn] = std::move(decoder);
+
+    return chn;
+}
+
+VPPDecode *VPPDecodeManager::Get(int chn)
+{
+    if (chn < 0 || chn >= CODEC_MAX_CHN_NUM)
+        return nullptr;
+
+    AUTO_UNIQUE_MTX_LOCK(m_mtx);
+    return m_decoders[chn].get();
+}
+
+int VPPDecodeManager::Close(int chn)
+{
+    unique_ptr<VPPDecode> decoder;
+
+    if (chn < 0 || chn >= CODEC_MAX_CHN_NUM)
+        return -1;
+
+    {
+        AUTO_UNIQUE_MTX_LOCK(m_mtx);
+        decoder = std::move(m_decoders[chn]);
+    }
+    if (!decoder)
+        return -1;
+
+    return decoder->undo_decoding();
+}
+
+void VPPDecodeManager::CloseAll()
+{
+    for (int i = 0; i < CODEC_MAX_CHN_NUM; i++) {
+        Close(i);
+    }
 }
 
 }; // namespace srpy_cam
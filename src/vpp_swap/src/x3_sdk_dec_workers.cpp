@@ -0,0 +1,139 @@
+/*
+ * Horizon Robotics
+ *
+ * Copyright (C) 2023 Horizon Robotics Inc.
+ * All rights reserved.
+ * Author:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+
+#include "x3_sdk_dec_workers.h"
+
+namespace srpy_cam
+{
+
+/// Class VPPDecodeWorkers related
+
+VPPDecodeWorkers &VPPDecodeWorkers::Instance()
+{
+    static VPPDecodeWorkers workers;
+    return workers;
+}
+
+VPPDecodeWorkers::~VPPDecodeWorkers()
+{
+    m_running = false;
+    {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        m_cond.notify_all();
+    }
+    for (auto &thread : m_threads) {
+        if (thread && thread->joinable())
+            thread->join();
+    }
+}
+
+std::vector<VPPDecodeWorkers::DecodeEntry>::iterator VPPDecodeWorkers::Find(DecodeFeeder *feeder)
+{
+    return std::find_if(m_entries.begin(), m_entries.end(),
+                        [feeder](const DecodeEntry &entry) { return entry.feeder == feeder; });
+}
+
+void VPPDecodeWorkers::Loop()
+{
+    std::unique_lock<std::mutex> lock(m_mtx);
+    std::vector<DecodeEntry>::iterator it;
+    DecodeFeeder *feeder = nullptr;
+    size_t idle_steps = 0;
+    size_t i = 0, index = 0;
+    int ret = 0;
+
+    while (m_running) {
+        // 从上次的位置往后找一个没有在别的线程里推进的通道
+        feeder = nullptr;
+        for (i = 0; i < m_entries.size(); i++) {
+            index = (m_next + i) % m_entries.size();
+            if (!m_entries[index].busy) {
+                feeder = m_entries[index].feeder;
+                m_entries[index].busy = true;
+                m_next = index + 1;
+                break;
+            }
+        }
+        if (feeder == nullptr) {
+            // 没有通道，或者通道都在别的线程里推进
+            m_cond.wait(lock);
+            continue;
+        }
+
+        lock.unlock();
+        ret = feeder->x3_vdec_feed_step();
+        if (ret == DEC_FEED_DONE)
+            feeder->x3_vdec_feed_close();
+        lock.lock();
+
+        // 忙的通道不会被 Detach 删除，这里一定能找到
+        it = Find(feeder);
+        if (ret == DEC_FEED_DONE)
+            m_entries.erase(it);
+        else
+            it->busy = false;
+        // 唤醒在等这个通道的 Detach，以及因为通道都忙而等待的工作线程
+        m_cond.notify_all();
+
+        // 连续推进了一轮都没有进展，说明各路都在等解码器释放输入 buffer，短暂休眠
+        if (ret == DEC_FEED_SENT) {
+            idle_steps = 0;
+        } else if (++idle_steps >= m_entries.size()) {
+            idle_steps = 0;
+            lock.unlock();
+            usleep(DEC_FEED_RECLAIM_US);
+            lock.lock();
+        }
+    }
+}
+
+void VPPDecodeWorkers::Attach(DecodeFeeder *feeder)
+{
+    std::call_once(m_start_flag, [this]() {
+        for (auto &thread : m_threads)
+            thread = std::unique_ptr<std::thread>(new std::thread(&VPPDecodeWorkers::Loop, this));
+    });
+
+    std::unique_lock<std::mutex> lock(m_mtx);
+    m_entries.push_back({feeder, false});
+    m_cond.notify_all();
+}
+
+void VPPDecodeWorkers::Detach(DecodeFeeder *feeder)
+{
+    std::unique_lock<std::mutex> lock(m_mtx);
+    std::vector<DecodeEntry>::iterator it = Find(feeder);
+
+    // 工作线程正在推进这个通道时，等这一步结束
+    m_cond.wait(lock, [this, feeder, &it]() {
+        it = Find(feeder);
+        return it == m_entries.end() || !it->busy;
+    });
+    if (it == m_entries.end()) {
+        // 不在列表里，或者这一步送流已经结束，工作线程已经 close
+        return;
+    }
+    m_entries.erase(it);
+    lock.unlock();
+
+    // 调用者已经设置了 is_quit，这一步会标记 eos，close 时送出结束包
+    feeder->x3_vdec_feed_step();
+    feeder->x3_vdec_feed_close();
+}
+
+} // namespace srpy_cam
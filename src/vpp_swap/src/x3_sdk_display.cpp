@@ -30,13 +30,18 @@
 #include <memory>
 #include <thread>
 #include <unordered_map>
+#include <algorithm>
 #include <vector>
 #include <linux/fb.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "utils_log.h"
 #include "x3_sdk_display.h"
+#include "x3_sdk_font.h"
 
 using namespace std;
 
@@ -45,237 +50,80 @@ namespace srpy_cam
 
 /// Class VPPDisplay related
 
-#define VOT_ARGB_BYTES 4
-
-#define FONT_HZK16_FILE "/etc/vio/HZK16"
-#define FONT_ASC16_FILE "/etc/vio/ASC16"
-
-#define FONT_MASK_80 0x80
-#define FONT_MASK_40 0x40
-#define FONT_MASK_20 0x20
-#define FONT_MASK_10 0x10
-#define FONT_MASK_08 0x08
-#define FONT_MASK_04 0x04
-#define FONT_MASK_02 0x02
-#define FONT_MASK_01 0x01
-
-#define FONT_INTERVAL_CN_WORD_CNT 94
-#define FONT_CN_WORD_START_ENCODE 0xa0
-#define FONT_CN_WORD_BYTES 32
-#define FONT_EN_WORD_BYTES 16
-
-#define FONT_WORD_HEIGHT 16
-#define FONT_ONE_ENCODE_WIDTH 8
-#define FONT_CN_ENCODE_NUM 2
-#define FONT_EN_ENCODE_NUM 1
-#define FONT_CN_WORD_WIDTH \
-    (FONT_CN_ENCODE_NUM * FONT_ONE_ENCODE_WIDTH)
-#define FONT_EN_WORD_WIDTH \
-    (FONT_EN_ENCODE_NUM * FONT_ONE_ENCODE_WIDTH)
-#define FONT_HARD_PIXEL_BITS 4
-#define ONE_BYTE_BIT_CNT 8
-
-static void draw_dot(uint8_t *frame, int x, int y, int color,
-                     int screen_width, int screen_height)
+// OSD 层是小端的 ARGB8888，一个像素按 uint32_t 整体写入，与原来逐字节写颜色的结果一致
+static inline void fill_span(uint32_t *dst, int num, uint32_t color)
 {
-    int pbyte = VOT_ARGB_BYTES;
+#if defined(__ARM_NEON)
+    uint32x4_t v = vdupq_n_u32(color);
 
-    if (x >= screen_width || y >= screen_height)
-        return;
-
-    frame += ((y * screen_width) + x) * pbyte;
-    while (pbyte) {
-        pbyte--;
-        frame[pbyte] = (color >> (pbyte * 8)) & 0xFF;
-    }
-}
-static void draw_hline(uint8_t *frame, int x0, int x1, int y, int color,
-                       int screen_width, int screen_height)
-{
-    int xi, xa;
-
-    xi = (x0 < x1) ? x0 : x1;
-    xa = (x0 > x1) ? x0 : x1;
-    while (xi <= xa) {
-        draw_dot(frame, xi, y, color, screen_width, screen_height);
-        xi++;
-    }
+    for (; num >= 4; num -= 4, dst += 4)
+        vst1q_u32(dst, v);
+#endif
+    std::fill_n(dst, num, color);
 }
 
-static void draw_vline(uint8_t *frame, int x, int y0, int y1, int color,
-                       int screen_width, int screen_height)
+// 填充 [x0, x1] x [y0, y1]（包含端点），只在这里按屏幕范围裁剪一次，之后逐行整段写入
+static void fill_rect(OsdCanvas &canvas, int x0, int y0, int x1, int y1, uint32_t color)
 {
-    int yi, ya;
+    int screen_width = canvas.Width(), screen_height = canvas.Height();
+    uint32_t *row = nullptr;
+    int y = 0;
+
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, screen_width - 1);
+    y1 = std::min(y1, screen_height - 1);
+    if (x0 > x1 || y0 > y1)
+        return;
 
-    yi = (y0 < y1) ? y0 : y1;
-    ya = (y0 > y1) ? y0 : y1;
-    while (yi <= ya) {
-        draw_dot(frame, x, yi, color, screen_width, screen_height);
-        yi++;
-    }
+    row = reinterpret_cast<uint32_t *>(canvas.Back()) + (size_t)y0 * screen_width + x0;
+    for (y = y0; y <= y1; y++, row += screen_width)
+        fill_span(row, x1 - x0 + 1, color);
+    canvas.Mark(x0, y0, x1, y1);
 }
 
-static void draw_rect(uint8_t *frame, int x0, int y0, int x1, int y1, int color,
-                      int fill, int screen_width, int screen_height, int line_width)
+// 线宽为 line_width 的边框拆成上下左右四个实心矩形
+static void draw_rect(OsdCanvas &canvas, int x0, int y0, int x1, int y1, uint32_t color,
+                      int fill, int line_width)
 {
+    int screen_width = canvas.Width(), screen_height = canvas.Height();
     int xi, xa, yi, ya;
-    int i = 0;
 
     xi = (x0 < x1) ? x0 : x1; // left
     xa = (x0 > x1) ? x0 : x1; // right
     yi = (y0 < y1) ? y0 : y1; // bottom
     ya = (y0 > y1) ? y0 : y1; // top
     if (fill) {
-        while (yi <= ya) {
-            draw_hline(frame, xi, xa, yi, color, screen_width, screen_height);
-            yi++;
-        }
-    } else {
-        if (ya < line_width || yi > (screen_height - line_width) ||
-            xi > (screen_width - line_width) ||
-            xa > (screen_width - line_width)) {
-            LOGD_print("point is 0, x0=%d, y0=%d, x1=%d, y1=%d,"
-                "screen_width=%d, screen_height=%d, line_width= %d, return\n",
-                x0, y0, x1, y1,
-                screen_width, screen_height, line_width);
-            return;
-        }
-        for (i = 0; i < line_width; i++) {
-            draw_hline(frame, xi, xa, yi + i, color, screen_width, screen_height);
-            draw_hline(frame, xi, xa, ya - i, color, screen_width, screen_height);
-            draw_vline(frame, xi + i, yi, ya, color, screen_width, screen_height);
-            draw_vline(frame, xa + i, yi, ya, color, screen_width, screen_height);
-        }
-    }
-}
-
-static void osd_draw_word_row(uint8_t *addr, uint32_t width,
-    uint32_t line_width, uint32_t color)
-{
-    uint32_t addr_offset;
-    uint32_t m, w, i;
-
-    for (m = 0; m < line_width; m++) {
-        for (w = 0; w < line_width; w++) {
-            addr_offset = ((width * m) + w) * VOT_ARGB_BYTES;
-            for (i = 0; i < VOT_ARGB_BYTES; i++) {
-                addr[addr_offset + i] = (color >> (i * 8)) & 0xff;
-            }
-        }
-    }
-}
-
-// draw chinese word
-static int32_t osd_draw_cn_word(uint8_t *addr, uint32_t width,
-    uint32_t line_width, uint32_t color, uint8_t *cn_word)
-{
-    FILE *file;
-    uint8_t flag;
-    uint64_t offset;
-    uint8_t *addr_word, *addr_src;
-    uint8_t buffer[32];
-    uint8_t key[8] = {FONT_MASK_80, FONT_MASK_40, FONT_MASK_20,
-                      FONT_MASK_10, FONT_MASK_08, FONT_MASK_04,
-                      FONT_MASK_02, FONT_MASK_01};
-    uint32_t row_bytes;
-    uint32_t k, j, i;
-    size_t size;
-
-    file = fopen(FONT_HZK16_FILE, "rb");
-    if (file == NULL) {
-        LOGE_print("open HZK16 file fail %d %s\n", errno, strerror(errno));
-        return -1;
-    }
-
-    offset = ((FONT_INTERVAL_CN_WORD_CNT *
-        ((uint64_t)cn_word[0] - FONT_CN_WORD_START_ENCODE - 1u)) +
-        ((uint64_t)cn_word[1] - FONT_CN_WORD_START_ENCODE) - 1u)
-        * FONT_CN_WORD_BYTES;
-    (void)fseek(file, (int64_t)offset, SEEK_SET);
-    size = fread((void *)buffer, 1, FONT_CN_WORD_BYTES, file);
-    if (size != FONT_CN_WORD_BYTES) {
-        LOGE_print("fread font file:%s error\n", FONT_HZK16_FILE);
-        (void)fclose(file);
-        return -1;
-    }
-
-    row_bytes = FONT_CN_WORD_WIDTH / ONE_BYTE_BIT_CNT;
-    addr_src = addr;
-
-    for (k = 0; k < FONT_WORD_HEIGHT; k++) {
-        addr_word = addr_src;
-        for (j = 0; j < row_bytes; j++) {
-            for (i = 0; i < ONE_BYTE_BIT_CNT; i++) {
-                flag = buffer[(k * row_bytes) + j] & key[i];
-                if (flag != 0u) {
-                    osd_draw_word_row(addr_word, width, line_width, color);
-                }
-                addr_word = &addr_word[line_width * VOT_ARGB_BYTES];
-            }
-        }
-        addr_src = &addr_src[width * line_width * VOT_ARGB_BYTES];
-    }
-
-    (void)fclose(file);
-
-    return 0;
-}
-
-// draw endlish word
-static int32_t osd_draw_en_word(uint8_t *addr, uint32_t width,
-    uint32_t line_width, uint32_t color, uint8_t en_word)
-{
-    FILE *file;
-    uint8_t flag;
-    uint32_t offset;
-    uint8_t *addr_word, *addr_src;
-    uint8_t buffer[16];
-    uint8_t key[8] = {FONT_MASK_80, FONT_MASK_40, FONT_MASK_20,
-                      FONT_MASK_10, FONT_MASK_08, FONT_MASK_04,
-                      FONT_MASK_02, FONT_MASK_01};
-    uint32_t k, i;
-    size_t size;
-
-    file = fopen(FONT_ASC16_FILE, "rb");
-    if (file == NULL) {
-        LOGE_print("open ASC16 file fail\n");
-        return -1;
-    }
-
-    offset = (uint32_t)en_word * FONT_EN_WORD_BYTES;
-    (void)fseek(file, (int32_t)offset, SEEK_SET);
-    size = fread((void *)buffer, 1, FONT_EN_WORD_BYTES, file);
-    if (size != FONT_EN_WORD_BYTES) {
-        LOGE_print("fread font file:%s error\n", FONT_ASC16_FILE);
-        (void)fclose(file);
-        return -1;
+        fill_rect(canvas, xi, yi, xa, ya, color);
+        return;
     }
 
-    addr_src = addr;
-
-    for (k = 0; k < FONT_WORD_HEIGHT; k++) {
-        addr_word = addr_src;
-        for (i = 0; i < ONE_BYTE_BIT_CNT; i++) {
-            flag = buffer[k] & key[i];
-            if (flag != 0u) {
-                osd_draw_word_row(addr_word, width, line_width, color);
-            }
-            addr_word = &addr_word[line_width * VOT_ARGB_BYTES];
-        }
-        addr_src = &addr_src[width * line_width * VOT_ARGB_BYTES];
+    if (ya < line_width || yi > (screen_height - line_width) ||
+        xi > (screen_width - line_width) ||
+        xa > (screen_width - line_width)) {
+        LOGD_print("point is 0, x0=%d, y0=%d, x1=%d, y1=%d,"
+            "screen_width=%d, screen_height=%d, line_width= %d, return\n",
+            x0, y0, x1, y1,
+            screen_width, screen_height, line_width);
+        return;
     }
+    if (line_width <= 0)
+        return;
 
-    (void)fclose(file);
-
-    return 0;
+    fill_rect(canvas, xi, yi, xa, yi + line_width - 1, color);
+    fill_rect(canvas, xi, ya - line_width + 1, xa, ya, color);
+    fill_rect(canvas, xi, yi, xi + line_width - 1, ya, color);
+    fill_rect(canvas, xa, yi, xa + line_width - 1, ya, color);
 }
 
+// 字形从 OsdFont 的缓存中取，绘制只是按行拷贝预先着色好的像素段
 static int32_t draw_word(uint8_t *addr, int x, int y, char *str, int width, int color, int line_width)
 {
     uint32_t str_len, i, word_offs = 1u;
     uint8_t cn_word[2], en_word;
-    int32_t ret;
     uint32_t addr_offset;
+    OsdFont &font = OsdFont::Instance();
+    shared_ptr<const OsdGlyph> glyph;
 
     if (addr == NULL) {
         LOGE_print("draw word addr was NULL\n");
@@ -296,20 +144,22 @@ static int32_t draw_word(uint8_t *addr, int x, int y, char *str, int width, int
                 continue;
             }
 
-            ret = osd_draw_cn_word(addr, width, line_width, color, cn_word);
-            if (ret < 0) {
-                return ret;
+            glyph = font.GetGlyph(cn_word, FONT_CN_ENCODE_NUM, line_width, color);
+            if (!glyph) {
+                return -1;
             }
+            OsdFont::BlitGlyph(*glyph, addr, width);
             word_offs = FONT_CN_ENCODE_NUM;
             addr = &addr[line_width * FONT_CN_WORD_WIDTH * VOT_ARGB_BYTES];
         }
         if (str[i] < (uint8_t)FONT_CN_WORD_START_ENCODE) {
             en_word = str[i];
 
-            ret = osd_draw_en_word(addr, width, line_width, color, en_word);
-            if (ret < 0) {
-                return ret;
+            glyph = font.GetGlyph(&en_word, FONT_EN_ENCODE_NUM, line_width, color);
+            if (!glyph) {
+                return -1;
             }
+            OsdFont::BlitGlyph(*glyph, addr, width);
             word_offs = FONT_EN_ENCODE_NUM;
             addr = &addr[line_width * FONT_EN_WORD_WIDTH * VOT_ARGB_BYTES];
         }
@@ -383,8 +233,6 @@ int VPPDisplay::x3_vot_init(int chn = 0, int width = 1920, int height = 1080,
     VOT_CHN_ATTR_S stChnAttr = {0};
     VOT_CROP_INFO_S cropAttrs = {0};
     struct fb_var_screeninfo vinfo;
-    struct fb_fix_screeninfo finfo;
-    long int screensize = 0;
     VOT_CHN_ATTR_EX_S extern_attr = {0};
     VOT_UPSCALE_ATTR_S upscale_attr = {0};
     int fb0_fd = 0;
@@ -596,26 +444,13 @@ int VPPDisplay::x3_vot_init(int chn = 0, int width = 1920, int height = 1080,
             LOGE_print("Error: cannot open framebuffer device(%s).\n", fb_str);
             goto err2;
         }
-        /* Get fixed screen information */
-        if (ioctl(m_fbfd[chn - VOT_GRAPH_LAYER_NUM], FBIOGET_FSCREENINFO, &finfo)) {
-            LOGE_print("Error reading fixed information.\n");
-            goto err3;
-        }
-
-        /* Get variable screen information */
-        if (ioctl(m_fbfd[chn - VOT_GRAPH_LAYER_NUM], FBIOGET_VSCREENINFO, &vinfo)) {
-            LOGE_print("Error reading variable information.\n");
-            goto err3;
-        }
-
-        screensize = m_chn_width[chn] * m_chn_height[chn] * 4;
-
-        m_fbp[chn - VOT_GRAPH_LAYER_NUM] =
-            (uint8_t *)mmap(0, screensize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fbfd[chn - VOT_GRAPH_LAYER_NUM], 0);
-        if (m_fbp[chn - VOT_GRAPH_LAYER_NUM] == MAP_FAILED) {
-            LOGE_print("Error: failed to map framebuffer device to memory.\n");
+        // 映射 framebuffer 并建立双缓冲画布，图形层只通过画布绘制
+        if (m_osd[chn - VOT_GRAPH_LAYER_NUM].Init(m_fbfd[chn - VOT_GRAPH_LAYER_NUM],
+                m_chn_width[chn], m_chn_height[chn])) {
             goto err3;
         }
+        m_fbp[chn - VOT_GRAPH_LAYER_NUM] = m_osd[chn - VOT_GRAPH_LAYER_NUM].Mapped();
+        m_graph_explicit[chn - VOT_GRAPH_LAYER_NUM] = false;
     }
 
     return ret;
@@ -624,6 +459,7 @@ err3:
         close(m_fbfd[chn - VOT_GRAPH_LAYER_NUM]);
     }
     m_fbfd[chn - VOT_GRAPH_LAYER_NUM] = -1;
+    m_osd[chn - VOT_GRAPH_LAYER_NUM].Deinit();
     m_fbp[chn - VOT_GRAPH_LAYER_NUM] = NULL;
     HB_VOT_DisableChn(0, chn);
 err2:
@@ -686,12 +522,9 @@ int VPPDisplay::reset_iar_crop(void){
 int VPPDisplay::x3_vot_deinit()
 {
     int ret = 0;
-    int screensize;
 
     for (int i = 0; i < VOT_LAYER_NUM; i++) {
         if (m_vot_chn[i] != -1) {
-            screensize = m_chn_width[i] * m_chn_height[i] * 4;
-
             ret = HB_VOT_DisableChn(0, m_vot_chn[i]);
             if (ret) {
                 LOGE_print("HB_VOT_DisableChn failed.\n");
@@ -699,7 +532,7 @@ int VPPDisplay::x3_vot_deinit()
             m_vot_chn[i] = -1;
 
             if ((i >= 2) && (m_fbp[i - VOT_VIDEO_LAYER_NUM] != NULL)) {
-                munmap(m_fbp[i - VOT_VIDEO_LAYER_NUM], screensize);
+                m_osd[i - VOT_VIDEO_LAYER_NUM].Deinit();
                 m_fbp[i - VOT_VIDEO_LAYER_NUM] = NULL;
             }
             if ((i >= 2) && (m_fbfd[i - VOT_VIDEO_LAYER_NUM] >= 0)) {
@@ -748,6 +581,20 @@ int VPPDisplay::set_img(void *addr, int size, int chn = 0)
     return s32Ret;
 }
 
+// 与 set_graph_rect 相同的坐标钳位，fill 为真时画实心矩形
+void VPPDisplay::draw_graph_rect(int chn, int x0, int y0, int x1, int y1,
+    uint32_t color, int line_width, int fill)
+{
+    int width = m_chn_width[chn], height = m_chn_height[chn];
+
+    x0 = (x0 < (width - line_width)) ? ((x0 >= 0) ? x0 : 0) : (width - line_width);
+    y0 = (y0 < (height - line_width)) ? ((y0 >= 0) ? y0 : 0) : (height - line_width);
+    x1 = (x1 < (width - line_width)) ? ((x1 >= 0) ? x1 : 0) : (width - line_width);
+    y1 = (y1 < (height - line_width)) ? ((y1 >= 0) ? y1 : 0) : (height - line_width);
+
+    draw_rect(m_osd[chn - 2], x0, y0, x1, y1, color, fill, line_width);
+}
+
 int VPPDisplay::set_graph_rect(int x0, int y0, int x1, int y1, int chn = 2,
     int flush = 0, uint32_t color = 0xffff0000, int line_width = 4)
 {
@@ -763,20 +610,49 @@ int VPPDisplay::set_graph_rect(int x0, int y0, int x1, int y1, int chn = 2,
         return -1;
     }
 
-    x0 = (x0 < (m_chn_width[chn] - line_width)) ? ((x0 >= 0) ? x0 : 0) : (m_chn_width[chn] - line_width);
-    y0 = (y0 < (m_chn_height[chn] - line_width)) ? ((y0 >= 0) ? y0 : 0) : (m_chn_height[chn] - line_width);
-    x1 = (x1 < (m_chn_width[chn] - line_width)) ? ((x1 >= 0) ? x1 : 0) : (m_chn_width[chn] - line_width);
-    y1 = (y1 < (m_chn_height[chn] - line_width)) ? ((y1 >= 0) ? y1 : 0) : (m_chn_height[chn] - line_width);
-
     if (flush) {
-        memset(m_fbp[chn - 2], 0, m_chn_width[chn] * m_chn_height[chn] * VOT_ARGB_BYTES);
+        m_osd[chn - 2].Clear();
     }
 
-    draw_rect(m_fbp[chn - 2], x0, y0, x1, y1, color, 0, m_chn_width[chn], m_chn_height[chn], line_width);
+    draw_graph_rect(chn, x0, y0, x1, y1, color, line_width, 0);
+    s32Ret = auto_present_graph(chn);
 
     return s32Ret;
 }
 
+int VPPDisplay::set_graph_rects(const x3_disp_rect_t *rects, int num, int chn,
+    int flush)
+{
+    int i = 0;
+
+    if ((chn < 2) || (chn > 3)) {
+        LOGE_print("set_graph_rects only can set chn 2 or 3\n");
+        return -1;
+    }
+
+    if ((m_vot_chn[chn] < 0) || (m_fbp[chn - 2] == NULL)) {
+        LOGE_print("please init chn:%d first\n", chn);
+        return -1;
+    }
+
+    if ((rects == NULL && num > 0) || num < 0) {
+        LOGE_print("rects was NULL or num:%d error\n", num);
+        return -1;
+    }
+
+    if (flush) {
+        m_osd[chn - 2].Clear();
+    }
+
+    for (i = 0; i < num; i++) {
+        const x3_disp_rect_t &r = rects[i];
+        draw_graph_rect(chn, r.x0, r.y0, r.x1, r.y1, r.color,
+            r.line_width, r.line_width <= 0);
+    }
+
+    return auto_present_graph(chn);
+}
+
 int VPPDisplay::set_graph_word(int x, int y, char *str, int chn = 2,
     int flush = 0, uint32_t color = 0xffff0000, int line_width = 1)
 {
@@ -798,8 +674,9 @@ int VPPDisplay::set_graph_word(int x, int y, char *str, int chn = 2,
         return -1;
     }
 
-    if ((x < 0) || (x > m_chn_width[chn]) || (y < 0) || (y > m_chn_height[chn]) ||
-        ((line_width * FONT_ONE_ENCODE_WIDTH + y) > m_chn_height[chn])) {
+    // 字高是 FONT_WORD_HEIGHT * line_width 行，BlitGlyph 不做裁剪，整行字必须在画布内
+    if ((line_width <= 0) || (x < 0) || (x > m_chn_width[chn]) || (y < 0) ||
+        ((line_width * FONT_WORD_HEIGHT + y) > m_chn_height[chn])) {
         LOGE_print("parameter error, coordinate (%d, %d) string:%s line_width:%d\n",
             x, y, str, line_width);
         return -1;
@@ -810,14 +687,44 @@ int VPPDisplay::set_graph_word(int x, int y, char *str, int chn = 2,
     }
 
     if (flush) {
-        memset(m_fbp[chn - 2], 0, m_chn_width[chn] * m_chn_height[chn] * VOT_ARGB_BYTES);
+        m_osd[chn - 2].Clear();
     }
 
-    s32Ret = draw_word(m_fbp[chn - 2], x, y, str, m_chn_width[chn], color, line_width);
+    s32Ret = draw_word(m_osd[chn - 2].Back(), x, y, str, m_chn_width[chn], color, line_width);
+    m_osd[chn - 2].Mark(x, y, x + (int)strlen(str) * line_width * FONT_ONE_ENCODE_WIDTH - 1,
+        y + line_width * FONT_WORD_HEIGHT - 1);
+    if (auto_present_graph(chn) != 0) {
+        s32Ret = -1;
+    }
 
     return s32Ret;
 }
 
+// 没有调用过 present_graph 的通道保持原来每次绘制都送显的行为
+int VPPDisplay::auto_present_graph(int chn)
+{
+    if (m_graph_explicit[chn - 2]) {
+        return 0;
+    }
+    return m_osd[chn - 2].Present();
+}
+
+int VPPDisplay::present_graph(int chn)
+{
+    if ((chn < 2) || (chn > 3)) {
+        LOGE_print("present_graph only can set chn 2 or 3\n");
+        return -1;
+    }
+
+    if ((m_vot_chn[chn] < 0) || (m_fbp[chn - 2] == NULL)) {
+        LOGE_print("please init chn:%d first\n", chn);
+        return -1;
+    }
+
+    m_graph_explicit[chn - 2] = true;
+    return m_osd[chn - 2].Present();
+}
+
 int VPPDisplay::get_video_chn()
 {
     for (int i = 0; i < VOT_VIDEO_LAYER_NUM; i++) {
@@ -0,0 +1,189 @@
+/*
+ * Horizon Robotics
+ *
+ * Copyright (C) 2023 Horizon Robotics Inc.
+ * All rights reserved.
+ * Author:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "utils_log.h"
+#include "x3_common.h"
+#include "x3_sdk_font.h"
+
+using namespace std;
+
+namespace srpy_cam
+{
+
+OsdFont &OsdFont::Instance()
+{
+    static OsdFont font;
+    return font;
+}
+
+OsdFont::~OsdFont()
+{
+    if (m_asc_data)
+        munmap(const_cast<uint8_t *>(m_asc_data), m_asc_size);
+    if (m_hzk_data)
+        munmap(const_cast<uint8_t *>(m_hzk_data), m_hzk_size);
+}
+
+int OsdFont::MapFont(const char *file, const uint8_t **data, size_t *size)
+{
+    struct stat st;
+    void *addr = nullptr;
+    int fd = -1;
+
+    if (*data)
+        return 0;
+
+    fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        LOGE_print("open %s fail %d %s\n", file, errno, strerror(errno));
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        LOGE_print("stat font file:%s error\n", file);
+        close(fd);
+        return -1;
+    }
+    addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        LOGE_print("mmap font file:%s error %s\n", file, strerror(errno));
+        return -1;
+    }
+
+    *data = static_cast<const uint8_t *>(addr);
+    *size = st.st_size;
+    return 0;
+}
+
+shared_ptr<OsdGlyph> OsdFont::BuildGlyph(const uint8_t *bitmap, uint32_t row_bytes,
+                                         uint32_t line_width, uint32_t color)
+{
+    shared_ptr<OsdGlyph> glyph = make_shared<OsdGlyph>();
+    uint32_t bits = row_bytes * ONE_BYTE_BIT_CNT;
+    uint32_t k = 0, b = 0, start = 0, i = 0;
+    uint8_t *pixel = nullptr;
+
+    glyph->m_width = bits * line_width;
+    glyph->m_height = FONT_WORD_HEIGHT * line_width;
+    glyph->m_line_width = line_width;
+
+    // 与原来逐字节写颜色的顺序一致
+    glyph->m_color_row.resize(glyph->m_width * VOT_ARGB_BYTES);
+    pixel = glyph->m_color_row.data();
+    for (k = 0; k < glyph->m_width; k++) {
+        for (i = 0; i < VOT_ARGB_BYTES; i++)
+            *pixel++ = (color >> (i * 8)) & 0xff;
+    }
+
+    for (k = 0; k < FONT_WORD_HEIGHT; k++) {
+        const uint8_t *row = &bitmap[k * row_bytes];
+        b = 0;
+        while (b < bits) {
+            if (!(row[b / ONE_BYTE_BIT_CNT] & (0x80 >> (b % ONE_BYTE_BIT_CNT)))) {
+                b++;
+                continue;
+            }
+            start = b;
+            while (b < bits && (row[b / ONE_BYTE_BIT_CNT] & (0x80 >> (b % ONE_BYTE_BIT_CNT))))
+                b++;
+            glyph->m_runs[k].push_back(static_cast<uint16_t>(start * line_width));
+            glyph->m_runs[k].push_back(static_cast<uint16_t>((b - start) * line_width));
+        }
+    }
+
+    return glyph;
+}
+
+shared_ptr<const OsdGlyph> OsdFont::GetGlyph(const uint8_t *code, int code_len,
+                                             uint32_t line_width, uint32_t color)
+{
+    const uint8_t *bitmap = nullptr;
+    uint64_t offset = 0;
+    uint64_t key = 0;
+    uint32_t codepoint = 0;
+    uint32_t row_bytes = 0;
+    shared_ptr<OsdGlyph> glyph;
+
+    if (line_width == 0 || line_width > 0xFF)
+        return nullptr;
+
+    codepoint = (code_len == FONT_CN_ENCODE_NUM) ? ((code[0] << 8) | code[1]) : code[0];
+    key = (static_cast<uint64_t>(codepoint) << 40) |
+          (static_cast<uint64_t>(line_width) << 32) | color;
+
+    AUTO_UNIQUE_MTX_LOCK(m_mtx);
+    auto it = m_glyphs.find(key);
+    if (it != m_glyphs.end())
+        return it->second;
+
+    if (code_len == FONT_CN_ENCODE_NUM) {
+        if (MapFont(FONT_HZK16_FILE, &m_hzk_data, &m_hzk_size))
+            return nullptr;
+        offset = ((FONT_INTERVAL_CN_WORD_CNT *
+            ((uint64_t)code[0] - FONT_CN_WORD_START_ENCODE - 1u)) +
+            ((uint64_t)code[1] - FONT_CN_WORD_START_ENCODE) - 1u)
+            * FONT_CN_WORD_BYTES;
+        if (offset + FONT_CN_WORD_BYTES > m_hzk_size) {
+            LOGE_print("fread font file:%s error\n", FONT_HZK16_FILE);
+            return nullptr;
+        }
+        bitmap = &m_hzk_data[offset];
+        row_bytes = FONT_CN_WORD_WIDTH / ONE_BYTE_BIT_CNT;
+    } else {
+        if (MapFont(FONT_ASC16_FILE, &m_asc_data, &m_asc_size))
+            return nullptr;
+        offset = (uint64_t)code[0] * FONT_EN_WORD_BYTES;
+        if (offset + FONT_EN_WORD_BYTES > m_asc_size) {
+            LOGE_print("fread font file:%s error\n", FONT_ASC16_FILE);
+            return nullptr;
+        }
+        bitmap = &m_asc_data[offset];
+        row_bytes = FONT_EN_WORD_WIDTH / ONE_BYTE_BIT_CNT;
+    }
+
+    if (m_glyphs.size() >= OSD_GLYPH_CACHE_MAX)
+        m_glyphs.clear();
+
+    glyph = BuildGlyph(bitmap, row_bytes, line_width, color);
+    m_glyphs.emplace(key, glyph);
+
+    return glyph;
+}
+
+void OsdFont::BlitGlyph(const OsdGlyph &glyph, uint8_t *addr, uint32_t width)
+{
+    const uint8_t *color_row = glyph.m_color_row.data();
+    uint32_t stride = width * VOT_ARGB_BYTES;
+    uint32_t k = 0, r = 0, n = 0;
+    uint8_t *dst = addr;
+
+    for (k = 0; k < FONT_WORD_HEIGHT; k++) {
+        const vector<uint16_t> &runs = glyph.m_runs[k];
+        for (r = 0; r < glyph.m_line_width; r++) {
+            for (n = 0; n < runs.size(); n += 2) {
+                memcpy(&dst[runs[n] * VOT_ARGB_BYTES], color_row, runs[n + 1] * VOT_ARGB_BYTES);
+            }
+            dst += stride;
+        }
+    }
+}
+
+}; // namespace srpy_cam
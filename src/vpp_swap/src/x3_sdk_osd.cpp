@@ -0,0 +1,204 @@
+/*
+ * Horizon Robotics
+ *
+ * Copyright (C) 2023 Horizon Robotics Inc.
+ * All rights reserved.
+ * Author:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "utils_log.h"
+#include "x3_sdk_font.h"
+#include "x3_sdk_osd.h"
+
+using namespace std;
+
+namespace srpy_cam
+{
+
+int OsdCanvas::Init(int fd, int width, int height)
+{
+    struct fb_fix_screeninfo finfo;
+    void *addr = nullptr;
+
+    Deinit();
+
+    if (fd < 0 || width <= 0 || height <= 0)
+        return -1;
+
+    if (ioctl(fd, FBIOGET_FSCREENINFO, &finfo)) {
+        LOGE_print("Error reading fixed information.\n");
+        return -1;
+    }
+    if (ioctl(fd, FBIOGET_VSCREENINFO, &m_vinfo)) {
+        LOGE_print("Error reading variable information.\n");
+        return -1;
+    }
+
+    m_fd = fd;
+    m_width = width;
+    m_height = height;
+    m_page_size = (size_t)width * height * VOT_ARGB_BYTES;
+
+    // 虚拟高度能放下两页，并且一行没有填充时才用翻页
+    m_pan = (m_vinfo.yres_virtual >= 2u * height) &&
+            (finfo.smem_len >= 2 * m_page_size) &&
+            (finfo.line_length == (uint32_t)width * VOT_ARGB_BYTES);
+    m_map_size = m_pan ? 2 * m_page_size : m_page_size;
+
+    addr = mmap(0, m_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        LOGE_print("Error: failed to map framebuffer device to memory.\n");
+        m_map = nullptr;
+        return -1;
+    }
+    m_map = static_cast<uint8_t *>(addr);
+    memset(m_map, 0, m_map_size);
+
+    if (m_pan) {
+        m_vinfo.xoffset = 0;
+        m_vinfo.yoffset = 0;
+        if (ioctl(fd, FBIOPAN_DISPLAY, &m_vinfo)) {
+            LOGW_print("FBIOPAN_DISPLAY not supported (%s), copy dirty regions instead\n",
+                strerror(errno));
+            m_pan = 0;
+        }
+    }
+
+    if (m_pan) {
+        m_back_page = 1;
+        m_back = m_map + m_page_size;
+    } else {
+        m_shadow.assign(m_page_size, 0);
+        m_back = m_shadow.data();
+    }
+    m_drawn.clear();
+    m_damage.clear();
+
+    return 0;
+}
+
+void OsdCanvas::Deinit()
+{
+    if (m_map) {
+        munmap(m_map, m_map_size);
+    }
+    m_map = nullptr;
+    m_back = nullptr;
+    m_fd = -1;
+    m_pan = 0;
+    m_back_page = 0;
+    m_map_size = 0;
+    m_shadow.clear();
+    m_shadow.shrink_to_fit();
+    m_drawn.clear();
+    m_damage.clear();
+}
+
+void OsdCanvas::AddRect(vector<Rect> &rects, const Rect &rect)
+{
+    Rect bound = rect;
+
+    if (rects.size() < OSD_DIRTY_RECT_MAX) {
+        rects.push_back(rect);
+        return;
+    }
+
+    for (const Rect &r : rects) {
+        bound.x0 = min(bound.x0, r.x0);
+        bound.y0 = min(bound.y0, r.y0);
+        bound.x1 = max(bound.x1, r.x1);
+        bound.y1 = max(bound.y1, r.y1);
+    }
+    rects.assign(1, bound);
+}
+
+void OsdCanvas::Mark(int x0, int y0, int x1, int y1)
+{
+    Rect rect;
+
+    rect.x0 = max(min(x0, x1), 0);
+    rect.y0 = max(min(y0, y1), 0);
+    rect.x1 = min(max(x0, x1), m_width - 1);
+    rect.y1 = min(max(y0, y1), m_height - 1);
+    if (rect.x0 > rect.x1 || rect.y0 > rect.y1)
+        return;
+
+    AddRect(m_drawn, rect);
+    AddRect(m_damage, rect);
+}
+
+void OsdCanvas::Clear()
+{
+    size_t stride = (size_t)m_width * VOT_ARGB_BYTES;
+    size_t len = 0;
+    uint8_t *row = nullptr;
+    int y = 0;
+
+    if (m_back == nullptr)
+        return;
+
+    for (const Rect &r : m_drawn) {
+        len = (size_t)(r.x1 - r.x0 + 1) * VOT_ARGB_BYTES;
+        row = m_back + r.y0 * stride + (size_t)r.x0 * VOT_ARGB_BYTES;
+        for (y = r.y0; y <= r.y1; y++, row += stride)
+            memset(row, 0, len);
+        AddRect(m_damage, r);
+    }
+    m_drawn.clear();
+}
+
+void OsdCanvas::CopyRect(uint8_t *dst, const uint8_t *src, const Rect &rect)
+{
+    size_t stride = (size_t)m_width * VOT_ARGB_BYTES;
+    size_t offset = rect.y0 * stride + (size_t)rect.x0 * VOT_ARGB_BYTES;
+    size_t len = (size_t)(rect.x1 - rect.x0 + 1) * VOT_ARGB_BYTES;
+    int y = 0;
+
+    for (y = rect.y0; y <= rect.y1; y++, offset += stride)
+        memcpy(dst + offset, src + offset, len);
+}
+
+int OsdCanvas::Present()
+{
+    uint8_t *front = nullptr;
+
+    if (m_back == nullptr)
+        return -1;
+
+    if (!m_pan) {
+        for (const Rect &r : m_damage)
+            CopyRect(m_map, m_back, r);
+        m_damage.clear();
+        return 0;
+    }
+
+    m_vinfo.yoffset = m_back_page * m_height;
+    if (ioctl(m_fd, FBIOPAN_DISPLAY, &m_vinfo)) {
+        LOGE_print("FBIOPAN_DISPLAY failed %s\n", strerror(errno));
+        return -1;
+    }
+
+    // 原来的前台页变成后台页，它比刚送显的一页少了本帧的改动，补上这些区域
+    front = m_back;
+    m_back_page = !m_back_page;
+    m_back = m_map + m_back_page * m_page_size;
+    for (const Rect &r : m_damage)
+        CopyRect(m_back, front, r);
+    m_damage.clear();
+
+    return 0;
+}
+
+}; // namespace srpy_cam
@@ -4,6 +4,7 @@
  * All rights reserved.
  ***************************************************************************/
 #include <stdio.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <unistd.h>
 
@@ -18,13 +19,16 @@
 #include "x3_vio_vdec.h"
 
 static int s_vdec_init_cnt = 0;
+static pthread_mutex_t s_vdec_init_mtx = PTHREAD_MUTEX_INITIALIZER; /* 多路编解码可能在不同线程中初始化 */
 
 int x3_vdec_common_init()
 {
     int s32Ret;
 
+    pthread_mutex_lock(&s_vdec_init_mtx);
     if (s_vdec_init_cnt > 0) {
         s_vdec_init_cnt++;
+        pthread_mutex_unlock(&s_vdec_init_mtx);
         return 0;
     }
 
@@ -37,6 +41,7 @@ int x3_vdec_common_init()
         s_vdec_init_cnt++;
     }
 
+    pthread_mutex_unlock(&s_vdec_init_mtx);
     return s32Ret;
 }
 
@@ -44,8 +49,10 @@ int x3_vdec_common_deinit()
 {
     int s32Ret;
 
+    pthread_mutex_lock(&s_vdec_init_mtx);
     s_vdec_init_cnt--;
     if (s_vdec_init_cnt > 0) {
+        pthread_mutex_unlock(&s_vdec_init_mtx);
         return 0;
     }
 
@@ -54,6 +61,7 @@ int x3_vdec_common_deinit()
         printf("HB_VDEC_Module_Uninit: %d\n", s32Ret);
     }
 
+    pthread_mutex_unlock(&s_vdec_init_mtx);
     return s32Ret;
 }
 
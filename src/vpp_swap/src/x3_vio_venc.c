@@ -21,6 +21,7 @@
 #include "x3_vio_venc.h"
 
 static int s_venc_init_cnt = 0;
+static pthread_mutex_t s_venc_init_mtx = PTHREAD_MUTEX_INITIALIZER; /* 多路编解码可能在不同线程中初始化 */
 
 void print_h264cvb_attr(VENC_RC_ATTR_S *stRcAttr)
 {
@@ -213,8 +214,10 @@ int x3_venc_common_init()
 {
     int s32Ret;
 
+    pthread_mutex_lock(&s_venc_init_mtx);
     if (s_venc_init_cnt > 0) {
         s_venc_init_cnt++;
+        pthread_mutex_unlock(&s_venc_init_mtx);
         return 0;
     }
 
@@ -227,6 +230,7 @@ int x3_venc_common_init()
         s_venc_init_cnt++;
     }
 
+    pthread_mutex_unlock(&s_venc_init_mtx);
     return s32Ret;
 }
 
@@ -234,8 +238,10 @@ int x3_venc_common_deinit()
 {
     int s32Ret;
 
+    pthread_mutex_lock(&s_venc_init_mtx);
     s_venc_init_cnt--;
     if (s_venc_init_cnt > 0) {
+        pthread_mutex_unlock(&s_venc_init_mtx);
         return 0;
     }
 
@@ -244,6 +250,7 @@ int x3_venc_common_deinit()
         printf("HB_VENC_Module_Uninit: %d\n", s32Ret);
     }
 
+    pthread_mutex_unlock(&s_venc_init_mtx);
     return s32Ret;
 }
 
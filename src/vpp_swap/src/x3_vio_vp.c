@@ -5,6 +5,7 @@
  ***************************************************************************/
 #include "stdint.h"
 #include <stdio.h>
+#include <pthread.h>
 #include <unistd.h>
 
 #include "utils_log.h"
@@ -15,13 +16,16 @@
 #include "x3_vio_vp.h"
 
 static int s_vp_init_cnt = 0;
+static pthread_mutex_t s_vp_init_mtx = PTHREAD_MUTEX_INITIALIZER; /* 多路编解码可能在不同线程中初始化 */
 
 int x3_vp_init()
 {
     VP_CONFIG_S struVpConf;
 
+    pthread_mutex_lock(&s_vp_init_mtx);
     if (s_vp_init_cnt > 0) {
         s_vp_init_cnt++;
+        pthread_mutex_unlock(&s_vp_init_mtx);
         return 0;
     }
 
@@ -40,6 +44,7 @@ int x3_vp_init()
         s_vp_init_cnt++;
     }
 
+    pthread_mutex_unlock(&s_vp_init_mtx);
     return ret;
 }
 
@@ -79,8 +84,10 @@ int x3_vp_free(vp_param_t *param)
 
 int x3_vp_deinit()
 {
+    pthread_mutex_lock(&s_vp_init_mtx);
     s_vp_init_cnt--;
     if (s_vp_init_cnt > 0) {
+        pthread_mutex_unlock(&s_vp_init_mtx);
         return 0;
     }
 
@@ -90,5 +97,6 @@ int x3_vp_deinit()
     } else {
         printf("hb_vp_deinit failed, ret: %d\n", ret);
     }
+    pthread_mutex_unlock(&s_vp_init_mtx);
     return ret;
 }
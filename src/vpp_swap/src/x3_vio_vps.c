@@ -175,7 +175,8 @@ int x3_vps_get_output(uint32_t vpsGrpId, int channel, hb_vio_buffer_t *buffer,
 {
     int ret = 0;
     ret = HB_VPS_GetChnFrame(vpsGrpId, channel, buffer, timeout);
-    if (ret != 0) {
+    // timeout 为 0 时是非阻塞轮询，没有帧是正常情况，不打印
+    if (ret != 0 && timeout != 0) {
         printf("HB_VPS_GetChnFrame Failed. ret = %d\n", ret);
     }
 
@@ -204,6 +205,16 @@ int x3_vps_output_release(uint32_t vpsGrpId, int channel, hb_vio_buffer_t *buffe
     return ret;
 }
 
+// 通道的就绪 fd，有帧时可读，可以加入 epoll
+int x3_vps_get_chn_fd(uint32_t vpsGrpId, int channel)
+{
+    int fd = HB_VPS_GetChnFd(vpsGrpId, channel);
+    if (fd < 0) {
+        printf("HB_VPS_GetChnFd Failed. ret = %d\n", fd);
+    }
+    return fd;
+}
+
 void x3_normal_buf_info_print(hb_vio_buffer_t *buf)
 {
     int i = 0;
@@ -0,0 +1,230 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "x3_vps_plan.h"
+
+typedef struct {
+    const char *name;
+    int max_width;
+    int max_height;
+    int down_only; /* 宽高都不能放大 */
+    int up_only;   /* 宽高都不能缩小 */
+} vps_plan_chn_cap_t;
+
+static const vps_plan_chn_cap_t vps_plan_caps[VPS_PLAN_CHN_NUM] = {
+    [VPS_PLAN_DS0] = {"DS0", 1280, 720, 0, 0},
+    [VPS_PLAN_DS1] = {"DS1", 1920, 1080, 0, 0},
+    [VPS_PLAN_DS2] = {"DS2", 4096, 4096, 1, 0},
+    [VPS_PLAN_DS3] = {"DS3", 1920, 1080, 0, 0},
+    [VPS_PLAN_DS4] = {"DS4", 1280, 720, 0, 0},
+    [VPS_PLAN_US]  = {"US",  4096, 4096, 0, 1},
+};
+
+// 搜索时的通道尝试顺序，沿用原来贪心选择的优先级。余量项让大部分分配的代价互不相同，
+// 这个顺序只在总代价完全相同时起作用，比如能力一样的 DS1/DS3、DS0/DS4 之间
+static const int vps_plan_order[VPS_PLAN_CHN_NUM] = {
+    VPS_PLAN_DS2, VPS_PLAN_DS1, VPS_PLAN_DS3, VPS_PLAN_DS0, VPS_PLAN_DS4, VPS_PLAN_US
+};
+
+// 带宽项的权重，大于所有请求余量之和的上界，保证余量只在带宽相同时起作用
+#define VPS_PLAN_BW_SCALE ((uint64_t)VPS_PLAN_MAX_REQ * 4096 * 4096)
+
+typedef struct {
+    const x3_vps_plan_req_t *reqs;
+    int req_num;
+    uint64_t cost[VPS_PLAN_MAX_REQ][VPS_PLAN_CHN_NUM]; /* UINT64_MAX 表示不可行 */
+    int cur[VPS_PLAN_MAX_REQ];
+    int best[VPS_PLAN_MAX_REQ];
+    int best_placed;
+    uint64_t best_cost;
+} vps_plan_ctx_t;
+
+const char *x3_vps_plan_chn_name(int chn)
+{
+    if (chn < 0 || chn >= VPS_PLAN_CHN_NUM)
+        return "NONE";
+    return vps_plan_caps[chn].name;
+}
+
+static void vps_plan_input_size(const x3_vps_plan_req_t *req, int *in_w, int *in_h)
+{
+    int w = req->src_width, h = req->src_height;
+
+    if (req->crop_width > 0 && req->crop_height > 0) {
+        w = req->crop_width;
+        h = req->crop_height;
+    }
+    if (req->rotate % 2) {
+        *in_w = h;
+        *in_h = w;
+    } else {
+        *in_w = w;
+        *in_h = h;
+    }
+}
+
+// 判断请求能否放到通道上，不能时把原因写入 why（可以为 NULL）
+static int vps_plan_fit(const x3_vps_plan_req_t *req, int chn, char *why, int why_len)
+{
+    const vps_plan_chn_cap_t *cap = &vps_plan_caps[chn];
+    int in_w = 0, in_h = 0;
+
+    vps_plan_input_size(req, &in_w, &in_h);
+
+    if (req->dst_width > cap->max_width || req->dst_height > cap->max_height) {
+        if (why)
+            snprintf(why, why_len, "%s>%dx%d", cap->name, cap->max_width, cap->max_height);
+        return 0;
+    }
+    if (cap->down_only && (req->dst_width > in_w || req->dst_height > in_h)) {
+        if (why)
+            snprintf(why, why_len, "%s:upscale", cap->name);
+        return 0;
+    }
+    if (cap->up_only && (req->dst_width < in_w || req->dst_height < in_h)) {
+        if (why)
+            snprintf(why, why_len, "%s:downscale", cap->name);
+        return 0;
+    }
+    if (!cap->down_only && !cap->up_only &&
+        req->dst_width > in_w && req->dst_height > in_h) {
+        if (why)
+            snprintf(why, why_len, "%s:upscale", cap->name);
+        return 0;
+    }
+    return 1;
+}
+
+// 代价分两级：读入 + 写出像素决定放置哪些请求，通道余量只在带宽相同时区分通道。
+// 两项直接相加时写出像素会和余量里的 -out 抵消，输出大小就不再影响结果
+static uint64_t vps_plan_cost(const x3_vps_plan_req_t *req, int chn)
+{
+    const vps_plan_chn_cap_t *cap = &vps_plan_caps[chn];
+    uint64_t out = (uint64_t)req->dst_width * req->dst_height;
+    uint64_t slack = (uint64_t)cap->max_width * cap->max_height - out;
+    int in_w = 0, in_h = 0;
+
+    vps_plan_input_size(req, &in_w, &in_h);
+    return ((uint64_t)in_w * in_h + out) * VPS_PLAN_BW_SCALE + slack;
+}
+
+static void vps_plan_search(vps_plan_ctx_t *ctx, int idx, int used, int placed, uint64_t cost)
+{
+    int i = 0, chn = 0;
+
+    // 剩下的请求全部放上也追不上当前最优，剪枝
+    if (placed + (ctx->req_num - idx) < ctx->best_placed)
+        return;
+    if (placed + (ctx->req_num - idx) == ctx->best_placed && cost >= ctx->best_cost)
+        return;
+
+    if (idx == ctx->req_num) {
+        if (placed > ctx->best_placed || (placed == ctx->best_placed && cost < ctx->best_cost)) {
+            ctx->best_placed = placed;
+            ctx->best_cost = cost;
+            memcpy(ctx->best, ctx->cur, sizeof(ctx->best));
+        }
+        return;
+    }
+
+    for (i = 0; i < VPS_PLAN_CHN_NUM; i++) {
+        chn = vps_plan_order[i];
+        if ((used & (1 << chn)) || ctx->cost[idx][chn] == UINT64_MAX)
+            continue;
+        ctx->cur[idx] = chn;
+        vps_plan_search(ctx, idx + 1, used | (1 << chn), placed + 1, cost + ctx->cost[idx][chn]);
+    }
+
+    ctx->cur[idx] = -1;
+    vps_plan_search(ctx, idx + 1, used, placed, cost);
+}
+
+static void vps_plan_explain(vps_plan_ctx_t *ctx, int idx, x3_vps_plan_t *plan)
+{
+    const x3_vps_plan_req_t *req = &ctx->reqs[idx];
+    char *reason = plan->reason[idx];
+    char why[32];
+    int len = 0, chn = 0, i = 0, candidates = 0;
+    int in_w = 0, in_h = 0;
+
+    vps_plan_input_size(req, &in_w, &in_h);
+    len = snprintf(reason, VPS_PLAN_REASON_LEN, "%dx%d from %dx%d: ",
+                   req->dst_width, req->dst_height, in_w, in_h);
+
+    for (chn = 0; chn < VPS_PLAN_CHN_NUM; chn++) {
+        if (ctx->cost[idx][chn] != UINT64_MAX)
+            candidates |= 1 << chn;
+    }
+
+    if (candidates == 0) {
+        // 没有任何通道能满足，逐个通道给出不满足的约束
+        for (chn = 0; chn < VPS_PLAN_CHN_NUM && len < VPS_PLAN_REASON_LEN; chn++) {
+            vps_plan_fit(req, chn, why, sizeof(why));
+            len += snprintf(reason + len, VPS_PLAN_REASON_LEN - len, "%s%s",
+                            chn ? " " : "", why);
+        }
+        return;
+    }
+
+    // 有可用通道，但都被其他请求占用
+    len += snprintf(reason + len, VPS_PLAN_REASON_LEN - len, "fits");
+    for (chn = 0; chn < VPS_PLAN_CHN_NUM && len < VPS_PLAN_REASON_LEN; chn++) {
+        if (!(candidates & (1 << chn)))
+            continue;
+        len += snprintf(reason + len, VPS_PLAN_REASON_LEN - len, " %s", vps_plan_caps[chn].name);
+        for (i = 0; i < ctx->req_num && len < VPS_PLAN_REASON_LEN; i++) {
+            if (ctx->best[i] == chn) {
+                len += snprintf(reason + len, VPS_PLAN_REASON_LEN - len, "(req%d)", i);
+                break;
+            }
+        }
+    }
+    if (len < VPS_PLAN_REASON_LEN)
+        snprintf(reason + len, VPS_PLAN_REASON_LEN - len, " but all are taken");
+}
+
+int x3_vps_plan_chn(const x3_vps_plan_req_t *reqs, int req_num, x3_vps_plan_t *plan)
+{
+    vps_plan_ctx_t ctx;
+    int i = 0, chn = 0;
+
+    if (plan == NULL || reqs == NULL || req_num < 0)
+        return -1;
+
+    memset(plan, 0, sizeof(x3_vps_plan_t));
+    memset(&ctx, 0, sizeof(ctx));
+    for (i = 0; i < VPS_PLAN_MAX_REQ; i++) {
+        plan->chn[i] = -1;
+        ctx.cur[i] = -1;
+        ctx.best[i] = -1;
+    }
+
+    ctx.reqs = reqs;
+    ctx.req_num = req_num > VPS_PLAN_MAX_REQ ? VPS_PLAN_MAX_REQ : req_num;
+    ctx.best_placed = -1;
+    ctx.best_cost = UINT64_MAX;
+
+    for (i = 0; i < ctx.req_num; i++) {
+        for (chn = 0; chn < VPS_PLAN_CHN_NUM; chn++) {
+            ctx.cost[i][chn] = vps_plan_fit(&reqs[i], chn, NULL, 0) ?
+                vps_plan_cost(&reqs[i], chn) : UINT64_MAX;
+        }
+    }
+
+    vps_plan_search(&ctx, 0, 0, 0, 0);
+
+    plan->placed = ctx.best_placed;
+    plan->cost = ctx.best_cost;
+    for (i = 0; i < ctx.req_num; i++) {
+        plan->chn[i] = ctx.best[i];
+        if (plan->chn[i] < 0)
+            vps_plan_explain(&ctx, i, plan);
+    }
+
+    return (plan->placed == req_num) ? 0 : -1;
+}
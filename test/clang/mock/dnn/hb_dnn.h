@@ -0,0 +1,150 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+// 测试用的 hb_dnn.h，只包含 src/clang 用到的类型和接口，字段名与板端头文件一致，
+// 实现在 test/clang/mock_hb_dnn.cpp
+#ifndef MOCK_HB_DNN_H_
+#define MOCK_HB_DNN_H_
+
+#include <stdint.h>
+
+#include "hb_sys.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HB_DNN_TENSOR_MAX_DIMENSIONS 8
+
+typedef void *hbPackedDNNHandle_t;
+typedef void *hbDNNHandle_t;
+typedef void *hbDNNTaskHandle_t;
+
+typedef struct {
+    int32_t dimensionSize[HB_DNN_TENSOR_MAX_DIMENSIONS];
+    int32_t numDimensions;
+} hbDNNTensorShape;
+
+typedef struct {
+    int32_t shiftLen;
+    uint8_t *shiftData;
+} hbDNNQuantiShift;
+
+typedef struct {
+    int32_t scaleLen;
+    float *scaleData;
+} hbDNNQuantiScale;
+
+typedef enum {
+    NONE = 0,
+    SHIFT,
+    SCALE,
+} hbDNNQuantiType;
+
+enum {
+    HB_DNN_LAYOUT_NHWC = 0,
+    HB_DNN_LAYOUT_NCHW = 2,
+    HB_DNN_LAYOUT_NONE = 255,
+};
+
+enum {
+    HB_DNN_IMG_TYPE_Y = 0,
+    HB_DNN_IMG_TYPE_NV12,
+    HB_DNN_IMG_TYPE_NV12_SEPARATE,
+    HB_DNN_IMG_TYPE_YUV444,
+    HB_DNN_IMG_TYPE_RGB,
+    HB_DNN_IMG_TYPE_BGR,
+    HB_DNN_TENSOR_TYPE_S4,
+    HB_DNN_TENSOR_TYPE_U4,
+    HB_DNN_TENSOR_TYPE_S8,
+    HB_DNN_TENSOR_TYPE_U8,
+    HB_DNN_TENSOR_TYPE_F16,
+    HB_DNN_TENSOR_TYPE_S16,
+    HB_DNN_TENSOR_TYPE_U16,
+    HB_DNN_TENSOR_TYPE_F32,
+    HB_DNN_TENSOR_TYPE_S32,
+    HB_DNN_TENSOR_TYPE_U32,
+};
+
+typedef enum {
+    HB_DNN_INPUT_FROM_DDR = 0,
+    HB_DNN_INPUT_FROM_RESIZER,
+    HB_DNN_INPUT_FROM_PYRAMID,
+} hbDNNInputSource;
+
+typedef struct {
+    hbDNNTensorShape validShape;
+    hbDNNTensorShape alignedShape;
+    int32_t tensorLayout;
+    int32_t tensorType;
+    hbDNNQuantiShift shift;
+    hbDNNQuantiScale scale;
+    int32_t quantiType;
+    int32_t quantizeAxis;
+    int32_t alignedByteSize;
+    int32_t stride[HB_DNN_TENSOR_MAX_DIMENSIONS];
+} hbDNNTensorProperties;
+
+typedef struct {
+    hbSysMem sysMem[4];
+    hbDNNTensorProperties properties;
+} hbDNNTensor;
+
+typedef struct {
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+} hbDNNRoi;
+
+typedef struct {
+    int32_t bpuCoreId;
+    int32_t dspCoreId;
+    int32_t priority;
+    int32_t more;
+    int64_t customId;
+    int32_t reserved1;
+    int32_t reserved2;
+} hbDNNInferCtrlParam;
+
+#define HB_DNN_INITIALIZE_INFER_CTRL_PARAM(param) \
+    do {                                          \
+        (param)->bpuCoreId = 0;                   \
+        (param)->dspCoreId = 0;                   \
+        (param)->priority = 0;                    \
+        (param)->more = 0;                        \
+        (param)->customId = 0;                    \
+        (param)->reserved1 = 0;                   \
+        (param)->reserved2 = 0;                   \
+    } while (0)
+
+int32_t hbDNNInitializeFromFiles(hbPackedDNNHandle_t *packedDNNHandle,
+                                 const char **modelFileNames, int32_t modelFileCount);
+int32_t hbDNNGetModelNameList(const char ***modelNameList, int32_t *modelNameCount,
+                              hbPackedDNNHandle_t packedDNNHandle);
+int32_t hbDNNGetModelHandle(hbDNNHandle_t *dnnHandle, hbPackedDNNHandle_t packedDNNHandle,
+                            const char *modelName);
+int32_t hbDNNGetInputCount(int32_t *inputCount, hbDNNHandle_t dnnHandle);
+int32_t hbDNNGetOutputCount(int32_t *outputCount, hbDNNHandle_t dnnHandle);
+int32_t hbDNNGetInputTensorProperties(hbDNNTensorProperties *properties,
+                                      hbDNNHandle_t dnnHandle, int32_t inputIndex);
+int32_t hbDNNGetOutputTensorProperties(hbDNNTensorProperties *properties,
+                                       hbDNNHandle_t dnnHandle, int32_t outputIndex);
+int32_t hbDNNGetInputSource(int32_t *inputSource, hbDNNHandle_t dnnHandle, int32_t inputIndex);
+int32_t hbDNNInfer(hbDNNTaskHandle_t *taskHandle, hbDNNTensor **output,
+                   const hbDNNTensor *input, hbDNNHandle_t dnnHandle,
+                   hbDNNInferCtrlParam *inferCtrlParam);
+int32_t hbDNNRoiInfer(hbDNNTaskHandle_t *taskHandle, hbDNNTensor **output,
+                      const hbDNNTensor *input, hbDNNRoi *rois, int32_t roiCount,
+                      hbDNNHandle_t dnnHandle, hbDNNInferCtrlParam *inferCtrlParam);
+int32_t hbDNNWaitTaskDone(hbDNNTaskHandle_t taskHandle, int32_t timeout);
+int32_t hbDNNReleaseTask(hbDNNTaskHandle_t taskHandle);
+int32_t hbDNNRelease(hbPackedDNNHandle_t packedDNNHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOCK_HB_DNN_H_
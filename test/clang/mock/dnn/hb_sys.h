@@ -0,0 +1,33 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+// 测试用的 hb_sys.h，只包含 src/clang 用到的部分，实现在 test/clang/mock_hb_dnn.cpp
+#ifndef MOCK_HB_SYS_H_
+#define MOCK_HB_SYS_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint64_t phyAddr;
+    void *virAddr;
+    uint32_t memSize;
+} hbSysMem;
+
+#define HB_SYS_MEM_CACHE_INVALIDATE 1
+#define HB_SYS_MEM_CACHE_CLEAN 2
+
+int32_t hbSysAllocCachedMem(hbSysMem *mem, uint32_t size);
+int32_t hbSysFreeMem(hbSysMem *mem);
+int32_t hbSysFlushMem(hbSysMem *mem, int32_t flag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOCK_HB_SYS_H_
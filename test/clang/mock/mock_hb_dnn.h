@@ -0,0 +1,34 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+// 模拟 DNN 后端的控制接口
+// 模型：一个 MOCK_DNN_WIDTH x MOCK_DNN_HEIGHT 的 NV12 输入，两个 int32 输出；
+// 每次推理在独立线程里等待 latency 毫秒后，output[0] 写 Y 平面第一个字节，
+// output[1] 写 UV 平面第一个字节，用来检查输入是否按帧送到了 BPU
+#ifndef MOCK_HB_DNN_CTRL_H_
+#define MOCK_HB_DNN_CTRL_H_
+
+#include <stdint.h>
+
+#define MOCK_DNN_WIDTH  16
+#define MOCK_DNN_HEIGHT 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 每次推理的耗时
+void mock_dnn_set_latency_ms(int32_t latency_ms);
+// 模型输入类型，HB_DNN_IMG_TYPE_NV12 或 HB_DNN_IMG_TYPE_NV12_SEPARATE
+void mock_dnn_set_input_type(int32_t type);
+// 同时在推理的任务数峰值，以及清零
+int32_t mock_dnn_max_inflight(void);
+void mock_dnn_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOCK_HB_DNN_CTRL_H_
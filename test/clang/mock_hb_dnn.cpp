@@ -0,0 +1,205 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+// 在主机上代替 libdnn/libhbrt 和 VIO 帧租约的模拟实现，见 mock/mock_hb_dnn.h
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "dnn/hb_dnn.h"
+#include "dnn/hb_sys.h"
+#include "mock_hb_dnn.h"
+#include "sp_vio.h"
+
+typedef struct {
+    std::thread worker;
+} mock_dnn_task_t;
+
+static const char *mock_dnn_names[] = {"mock"};
+static std::atomic<int32_t> mock_dnn_latency_ms{5};
+static std::atomic<int32_t> mock_dnn_input_type{HB_DNN_IMG_TYPE_NV12};
+static std::atomic<int32_t> mock_dnn_inflight{0};
+static std::atomic<int32_t> mock_dnn_peak{0};
+
+void mock_dnn_set_latency_ms(int32_t latency_ms)
+{
+    mock_dnn_latency_ms.store(latency_ms);
+}
+
+void mock_dnn_set_input_type(int32_t type)
+{
+    mock_dnn_input_type.store(type);
+}
+
+int32_t mock_dnn_max_inflight(void)
+{
+    return mock_dnn_peak.load();
+}
+
+void mock_dnn_reset(void)
+{
+    mock_dnn_peak.store(0);
+}
+
+int32_t hbDNNInitializeFromFiles(hbPackedDNNHandle_t *packedDNNHandle,
+                                 const char **modelFileNames, int32_t modelFileCount)
+{
+    *packedDNNHandle = (void *)1;
+    return 0;
+}
+
+int32_t hbDNNGetModelNameList(const char ***modelNameList, int32_t *modelNameCount,
+                              hbPackedDNNHandle_t packedDNNHandle)
+{
+    *modelNameList = mock_dnn_names;
+    *modelNameCount = 1;
+    return 0;
+}
+
+int32_t hbDNNGetModelHandle(hbDNNHandle_t *dnnHandle, hbPackedDNNHandle_t packedDNNHandle,
+                            const char *modelName)
+{
+    *dnnHandle = (void *)1;
+    return 0;
+}
+
+int32_t hbDNNGetInputCount(int32_t *inputCount, hbDNNHandle_t dnnHandle)
+{
+    *inputCount = 1;
+    return 0;
+}
+
+int32_t hbDNNGetOutputCount(int32_t *outputCount, hbDNNHandle_t dnnHandle)
+{
+    *outputCount = 2;
+    return 0;
+}
+
+int32_t hbDNNGetInputTensorProperties(hbDNNTensorProperties *properties,
+                                      hbDNNHandle_t dnnHandle, int32_t inputIndex)
+{
+    memset(properties, 0, sizeof(*properties));
+    properties->validShape.numDimensions = 4;
+    properties->validShape.dimensionSize[0] = 1;
+    properties->validShape.dimensionSize[1] = 3;
+    properties->validShape.dimensionSize[2] = MOCK_DNN_HEIGHT;
+    properties->validShape.dimensionSize[3] = MOCK_DNN_WIDTH;
+    properties->alignedShape = properties->validShape;
+    properties->tensorType = mock_dnn_input_type.load();
+    return 0;
+}
+
+int32_t hbDNNGetOutputTensorProperties(hbDNNTensorProperties *properties,
+                                       hbDNNHandle_t dnnHandle, int32_t outputIndex)
+{
+    memset(properties, 0, sizeof(*properties));
+    properties->validShape.numDimensions = 1;
+    properties->validShape.dimensionSize[0] = 1;
+    properties->alignedShape = properties->validShape;
+    properties->tensorType = HB_DNN_TENSOR_TYPE_S32;
+    return 0;
+}
+
+int32_t hbDNNGetInputSource(int32_t *inputSource, hbDNNHandle_t dnnHandle, int32_t inputIndex)
+{
+    *inputSource = HB_DNN_INPUT_FROM_DDR;
+    return 0;
+}
+
+int32_t hbDNNInfer(hbDNNTaskHandle_t *taskHandle, hbDNNTensor **output,
+                   const hbDNNTensor *input, hbDNNHandle_t dnnHandle,
+                   hbDNNInferCtrlParam *inferCtrlParam)
+{
+    hbDNNTensor *out = *output;
+    const uint8_t *y = static_cast<const uint8_t *>(input->sysMem[0].virAddr);
+    const uint8_t *uv = NULL;
+    int32_t stride = input->properties.alignedShape.dimensionSize[3];
+    int32_t height = input->properties.validShape.dimensionSize[2];
+    int32_t latency = mock_dnn_latency_ms.load();
+    int32_t now = 0, peak = 0;
+    mock_dnn_task_t *task = new mock_dnn_task_t;
+
+    if (stride <= 0)
+        stride = input->properties.validShape.dimensionSize[3];
+    if (input->properties.tensorType == HB_DNN_IMG_TYPE_NV12_SEPARATE)
+        uv = static_cast<const uint8_t *>(input->sysMem[1].virAddr);
+    else
+        uv = y + stride * height;
+
+    now = ++mock_dnn_inflight;
+    peak = mock_dnn_peak.load();
+    while (now > peak && !mock_dnn_peak.compare_exchange_weak(peak, now))
+        ;
+
+    // 输入在提交时读取，和硬件一样，提交之后调用者改写输入不影响本次结果
+    task->worker = std::thread([out, latency](int32_t y0, int32_t uv0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+        *static_cast<int32_t *>(out[0].sysMem[0].virAddr) = y0;
+        *static_cast<int32_t *>(out[1].sysMem[0].virAddr) = uv0;
+        --mock_dnn_inflight;
+    }, y[0], uv[0]);
+    *taskHandle = task;
+    return 0;
+}
+
+int32_t hbDNNRoiInfer(hbDNNTaskHandle_t *taskHandle, hbDNNTensor **output,
+                      const hbDNNTensor *input, hbDNNRoi *rois, int32_t roiCount,
+                      hbDNNHandle_t dnnHandle, hbDNNInferCtrlParam *inferCtrlParam)
+{
+    // 模型输入来自 DDR，不会走到 resizer 路径
+    return -1;
+}
+
+int32_t hbDNNWaitTaskDone(hbDNNTaskHandle_t taskHandle, int32_t timeout)
+{
+    static_cast<mock_dnn_task_t *>(taskHandle)->worker.join();
+    return 0;
+}
+
+int32_t hbDNNReleaseTask(hbDNNTaskHandle_t taskHandle)
+{
+    delete static_cast<mock_dnn_task_t *>(taskHandle);
+    return 0;
+}
+
+int32_t hbDNNRelease(hbPackedDNNHandle_t packedDNNHandle)
+{
+    return 0;
+}
+
+int32_t hbSysAllocCachedMem(hbSysMem *mem, uint32_t size)
+{
+    mem->virAddr = calloc(1, size);
+    mem->phyAddr = 0;
+    mem->memSize = size;
+    return mem->virAddr ? 0 : -1;
+}
+
+int32_t hbSysFreeMem(hbSysMem *mem)
+{
+    free(mem->virAddr);
+    mem->virAddr = NULL;
+    return 0;
+}
+
+int32_t hbSysFlushMem(hbSysMem *mem, int32_t flag)
+{
+    return 0;
+}
+
+// sp_vio.cpp 依赖板端 VIO，这里只模拟 bpu_wrapper 用到的帧引用计数
+int32_t sp_vio_retain_frame(sp_frame_lease_t *frame)
+{
+    return 0;
+}
+
+int32_t sp_vio_release_frame(sp_frame_lease_t *frame)
+{
+    frame->lease = NULL;
+    return 0;
+}
@@ -0,0 +1,449 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+// sp_bpu_submit/poll/wait 的调度测试，DNN 后端由 mock_hb_dnn.cpp 模拟
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "mock_hb_dnn.h"
+#include "sp_bpu.h"
+
+#define ASYNC_DEPTH 4
+#define FRAME_SIZE  (MOCK_DNN_WIDTH * MOCK_DNN_HEIGHT * 3 / 2)
+
+#define ROI_FRAME_WIDTH  64
+#define ROI_FRAME_HEIGHT 48
+#define ROI_NUM          4
+
+#define CHECK(cond)                                                  \
+    do {                                                             \
+        if (!(cond)) {                                               \
+            printf("FAIL %s:%d: %s\n", __func__, __LINE__, #cond);   \
+            return -1;                                               \
+        }                                                            \
+    } while (0)
+
+typedef struct {
+    std::atomic<int32_t> done{0};
+    std::atomic<int32_t> bad{0};
+} async_result_t;
+
+// Y 平面第一个字节放帧号，UV 平面第一个字节放帧号 + 1
+static void fill_frame(std::vector<char> &frame, int32_t seq)
+{
+    memset(frame.data(), 0, frame.size());
+    frame[0] = (char)seq;
+    frame[MOCK_DNN_WIDTH * MOCK_DNN_HEIGHT] = (char)(seq + 1);
+}
+
+static int32_t output_value(hbDNNTensor *output, int32_t index)
+{
+    return *static_cast<int32_t *>(output[index].sysMem[0].virAddr);
+}
+
+static void on_done(int64_t task_id, int32_t status, hbDNNTensor *output,
+                    int32_t output_count, void *userdata)
+{
+    async_result_t *result = static_cast<async_result_t *>(userdata);
+    int32_t seq = (int32_t)(task_id % 100);
+
+    if (status != 0 || output_count != 2 ||
+        output_value(output, 0) != seq || output_value(output, 1) != seq + 1)
+        result->bad++;
+    result->done++;
+}
+
+static int wait_done(async_result_t *result, int32_t count)
+{
+    for (int i = 0; i < 2000 && result->done.load() < count; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return result->done.load() == count ? 0 : -1;
+}
+
+// 回调模式：任务号连续，每个回调拿到的是自己那一帧的输出，并且推理确实流水起来了
+static int test_callback_pipeline(void)
+{
+    bpu_module *bpu = NULL;
+    std::vector<char> frame(FRAME_SIZE);
+    async_result_t result;
+    int64_t id = 0;
+
+    mock_dnn_reset();
+    mock_dnn_set_latency_ms(5);
+    bpu = sp_init_bpu_module("mock.bin");
+    CHECK(bpu != NULL);
+    CHECK(sp_bpu_async_init(bpu, ASYNC_DEPTH) == 0);
+
+    for (int32_t i = 0; i < 40; i++) {
+        fill_frame(frame, i);
+        id = sp_bpu_submit(bpu, frame.data(), on_done, &result);
+        CHECK(id == i);
+    }
+    CHECK(wait_done(&result, 40) == 0);
+    CHECK(result.bad.load() == 0);
+    CHECK(mock_dnn_max_inflight() >= 2);
+    CHECK(mock_dnn_max_inflight() <= ASYNC_DEPTH);
+
+    CHECK(sp_release_bpu_module(bpu) == 0);
+    return 0;
+}
+
+// 无回调模式：poll/wait/get_output/release 的完整流程
+static int test_wait_release(void)
+{
+    bpu_module *bpu = NULL;
+    std::vector<char> frame(FRAME_SIZE);
+    hbDNNTensor *output = NULL;
+    int64_t ids[3];
+    int32_t count = 0;
+
+    mock_dnn_set_latency_ms(5);
+    bpu = sp_init_bpu_module("mock.bin");
+    CHECK(bpu != NULL);
+
+    for (int32_t i = 0; i < 3; i++) {
+        fill_frame(frame, 10 + i);
+        ids[i] = sp_bpu_submit(bpu, frame.data(), NULL, NULL);
+        CHECK(ids[i] >= 0);
+    }
+    for (int32_t i = 0; i < 3; i++) {
+        CHECK(sp_bpu_wait(bpu, ids[i], -1) == 0);
+        CHECK(sp_bpu_poll(bpu, ids[i]) == 1);
+        output = sp_bpu_get_output(bpu, ids[i], &count);
+        CHECK(output != NULL && count == 2);
+        CHECK(output_value(output, 0) == 10 + i);
+        CHECK(output_value(output, 1) == 11 + i);
+        CHECK(sp_bpu_release(bpu, ids[i]) == 0);
+        // 释放之后按已完成处理，从没提交过的 id 才是无效
+        CHECK(sp_bpu_poll(bpu, ids[i]) == 1);
+    }
+    CHECK(sp_bpu_poll(bpu, ids[2] + 1) == -1);
+
+    CHECK(sp_release_bpu_module(bpu) == 0);
+    return 0;
+}
+
+// 推理没完成时 poll 返回 0，wait 超时返回 -1，之后仍然可以正常等到结果
+static int test_wait_timeout(void)
+{
+    bpu_module *bpu = NULL;
+    std::vector<char> frame(FRAME_SIZE);
+    int64_t id = 0;
+
+    mock_dnn_set_latency_ms(100);
+    bpu = sp_init_bpu_module("mock.bin");
+    CHECK(bpu != NULL);
+
+    fill_frame(frame, 7);
+    id = sp_bpu_submit(bpu, frame.data(), NULL, NULL);
+    CHECK(id >= 0);
+    CHECK(sp_bpu_poll(bpu, id) == 0);
+    CHECK(sp_bpu_wait(bpu, id, 1) == -1);
+    CHECK(sp_bpu_wait(bpu, id, -1) == 0);
+    CHECK(sp_bpu_release(bpu, id) == 0);
+
+    CHECK(sp_release_bpu_module(bpu) == 0);
+    mock_dnn_set_latency_ms(5);
+    return 0;
+}
+
+// 零拷贝提交：任务自己持有帧，提交后调用者就可以改写帧内容
+static int test_submit_frame(void)
+{
+    bpu_module *bpu = NULL;
+    std::vector<char> frame(FRAME_SIZE);
+    sp_frame_lease_t lease;
+    async_result_t result;
+
+    bpu = sp_init_bpu_module("mock.bin");
+    CHECK(bpu != NULL);
+
+    for (int32_t i = 0; i < 8; i++) {
+        fill_frame(frame, i);
+        memset(&lease, 0, sizeof(lease));
+        lease.width = MOCK_DNN_WIDTH;
+        lease.height = MOCK_DNN_HEIGHT;
+        lease.stride = MOCK_DNN_WIDTH;
+        lease.plane_count = 1;
+        lease.vaddr[0] = reinterpret_cast<uint8_t *>(frame.data());
+        CHECK(sp_bpu_submit_frame(bpu, &lease, on_done, &result) == i);
+        // 同一块 buffer 被下一帧复用之前先等本帧完成，模拟 VIO 归还 buffer 的时机
+        CHECK(wait_done(&result, i + 1) == 0);
+    }
+    CHECK(result.bad.load() == 0);
+
+    CHECK(sp_release_bpu_module(bpu) == 0);
+    return 0;
+}
+
+// NV12_SEPARATE 模型：submit 要把 Y 和 UV 分别拷到池 tensor 的两块内存里
+static int test_submit_separate(void)
+{
+    bpu_module *bpu = NULL;
+    std::vector<char> frame(FRAME_SIZE);
+    async_result_t result;
+
+    mock_dnn_set_input_type(HB_DNN_IMG_TYPE_NV12_SEPARATE);
+    bpu = sp_init_bpu_module("mock.bin");
+    mock_dnn_set_input_type(HB_DNN_IMG_TYPE_NV12);
+    CHECK(bpu != NULL);
+
+    for (int32_t i = 0; i < 8; i++) {
+        fill_frame(frame, i);
+        CHECK(sp_bpu_submit(bpu, frame.data(), on_done, &result) == i);
+    }
+    CHECK(wait_done(&result, 8) == 0);
+    CHECK(result.bad.load() == 0);
+
+    CHECK(sp_release_bpu_module(bpu) == 0);
+    return 0;
+}
+
+// 池里的 tensor 都被借走时 submit 等完成线程归还，不能和完成线程互相等死
+static int test_pool_exhausted(void)
+{
+    bpu_module *bpu = NULL;
+    std::vector<char> frame(FRAME_SIZE);
+    std::vector<bpu_tensor_set_t *> held;
+    bpu_pool_stats_t stats;
+    bpu_tensor_set_t *tensors = NULL;
+    async_result_t result;
+
+    mock_dnn_set_latency_ms(20);
+    bpu = sp_init_bpu_module("mock.bin");
+    CHECK(bpu != NULL);
+    CHECK(sp_bpu_async_init(bpu, ASYNC_DEPTH) == 0);
+
+    // 池上限 64 组，借到只剩一组，后面的 submit 只能轮流用这一组
+    do {
+        tensors = sp_bpu_acquire_tensors(bpu);
+        CHECK(tensors != NULL);
+        held.push_back(tensors);
+        CHECK(sp_bpu_get_pool_stats(bpu, &stats) == 0);
+    } while (stats.in_use < 63);
+
+    for (int32_t i = 0; i < 3; i++) {
+        fill_frame(frame, i);
+        CHECK(sp_bpu_submit(bpu, frame.data(), on_done, &result) == i);
+    }
+    CHECK(wait_done(&result, 3) == 0);
+    CHECK(result.bad.load() == 0);
+
+    for (auto t : held)
+        CHECK(sp_bpu_release_tensors(bpu, t) == 0);
+    CHECK(sp_release_bpu_module(bpu) == 0);
+    mock_dnn_set_latency_ms(5);
+    return 0;
+}
+
+// 还有借出的 tensor 时拒绝释放模型，归还之后才能释放
+static int test_release_busy(void)
+{
+    bpu_module *bpu = NULL;
+    void *models = NULL;
+    bpu_tensor_set_t *tensors = NULL;
+
+    bpu = sp_init_bpu_module("mock.bin");
+    CHECK(bpu != NULL);
+    tensors = sp_bpu_acquire_tensors(bpu);
+    CHECK(tensors != NULL);
+    CHECK(sp_release_bpu_module(bpu) == -1);
+    CHECK(sp_bpu_release_tensors(bpu, tensors) == 0);
+    CHECK(sp_release_bpu_module(bpu) == 0);
+
+    models = sp_bpu_load_models("mock.bin");
+    CHECK(models != NULL);
+    bpu = sp_bpu_get_model(models, NULL);
+    CHECK(bpu != NULL);
+    tensors = sp_bpu_acquire_tensors(bpu);
+    CHECK(tensors != NULL);
+    CHECK(sp_bpu_release_models(models) == -1);
+    CHECK(sp_bpu_release_tensors(bpu, tensors) == 0);
+    CHECK(sp_bpu_release_models(models) == 0);
+    return 0;
+}
+
+// 浮点双线性参考：像素中心对齐，src = (dst + 0.5) * sw / dw - 0.5，越界时取边上的像素
+// channels 为 2 时是交织的 UV 平面，坐标以 UV 对为单位
+static float roi_ref_sample(const uint8_t *plane, int32_t stride, int32_t channels, const hbDNNRoi &roi,
+                            int32_t dw, int32_t dh, int32_t x, int32_t y, int32_t c)
+{
+    int32_t sx = roi.left;
+    int32_t sy = roi.top;
+    int32_t sw = roi.right - roi.left + 1;
+    int32_t sh = roi.bottom - roi.top + 1;
+    float fx = 0, fy = 0, wx = 0, wy = 0;
+    int32_t x0 = 0, x1 = 0, y0 = 0, y1 = 0;
+
+    if (channels == 2) {
+        sx = roi.left / 2;
+        sy = roi.top / 2;
+        sw /= 2;
+        sh /= 2;
+    }
+    fx = std::max((x + 0.5f) * sw / dw - 0.5f, 0.0f);
+    fy = std::max((y + 0.5f) * sh / dh - 0.5f, 0.0f);
+    x0 = std::min((int32_t)fx, sw - 1);
+    y0 = std::min((int32_t)fy, sh - 1);
+    x1 = std::min(x0 + 1, sw - 1);
+    y1 = std::min(y0 + 1, sh - 1);
+    wx = fx - (int32_t)fx;
+    wy = fy - (int32_t)fy;
+
+    auto at = [&](int32_t px, int32_t py) {
+        return (float)plane[(size_t)(sy + py) * stride + (sx + px) * channels + c];
+    };
+    return (at(x0, y0) * (1 - wx) + at(x1, y0) * wx) * (1 - wy) +
+           (at(x0, y1) * (1 - wx) + at(x1, y1) * wx) * wy;
+}
+
+// 一个平面的裁剪缩放结果和参考相差不超过 1
+static int roi_check_plane(const uint8_t *src, int32_t channels, const hbDNNRoi &roi,
+                           const uint8_t *dst, int32_t dst_stride, int32_t dw, int32_t dh)
+{
+    for (int32_t y = 0; y < dh; y++) {
+        for (int32_t x = 0; x < dw; x++) {
+            for (int32_t c = 0; c < channels; c++) {
+                float ref = roi_ref_sample(src, ROI_FRAME_WIDTH, channels, roi, dw, dh, x, y, c);
+                if (fabsf(dst[(size_t)y * dst_stride + x * channels + c] - ref) > 1.0f)
+                    return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// CPU 裁剪缩放：每个框的模型输入和浮点双线性参考一致，results[i] 对应第 i 个框
+// 缩小、放大和非整数倍的框都有，图像是平缓的渐变，定点权重的误差在 1 以内
+static int test_predict_rois(int32_t input_type)
+{
+    const hbDNNRoi rois[ROI_NUM] = {
+        {0, 0, 31, 15},   /* 32x16，缩小一半 */
+        {8, 8, 15, 11},   /* 8x4，放大一倍 */
+        {20, 10, 59, 45}, /* 40x36，非整数倍 */
+        {40, 30, 63, 47}, /* 24x18，贴着右下边界 */
+    };
+    std::vector<uint8_t> frame(ROI_FRAME_WIDTH * ROI_FRAME_HEIGHT * 3 / 2);
+    uint8_t *y_plane = frame.data();
+    uint8_t *uv_plane = y_plane + ROI_FRAME_WIDTH * ROI_FRAME_HEIGHT;
+    bpu_tensor_set_t *results[ROI_NUM];
+    sp_frame_lease_t lease;
+    bpu_module *bpu = NULL;
+
+    for (int32_t y = 0; y < ROI_FRAME_HEIGHT; y++) {
+        for (int32_t x = 0; x < ROI_FRAME_WIDTH; x++)
+            y_plane[y * ROI_FRAME_WIDTH + x] = (uint8_t)(16 + 2 * x + y);
+    }
+    for (int32_t y = 0; y < ROI_FRAME_HEIGHT / 2; y++) {
+        for (int32_t x = 0; x < ROI_FRAME_WIDTH / 2; x++) {
+            uv_plane[y * ROI_FRAME_WIDTH + 2 * x] = (uint8_t)(64 + x + 2 * y);
+            uv_plane[y * ROI_FRAME_WIDTH + 2 * x + 1] = (uint8_t)(192 - x - y);
+        }
+    }
+    memset(&lease, 0, sizeof(lease));
+    lease.width = ROI_FRAME_WIDTH;
+    lease.height = ROI_FRAME_HEIGHT;
+    lease.stride = ROI_FRAME_WIDTH;
+    lease.plane_count = 1;
+    lease.vaddr[0] = y_plane;
+
+    mock_dnn_set_input_type(input_type);
+    bpu = sp_init_bpu_module("mock.bin");
+    mock_dnn_set_input_type(HB_DNN_IMG_TYPE_NV12);
+    CHECK(bpu != NULL);
+
+    CHECK(sp_bpu_predict_rois(bpu, &lease, rois, ROI_NUM, results) == 0);
+    for (int32_t i = 0; i < ROI_NUM; i++) {
+        const uint8_t *dst_y = static_cast<uint8_t *>(results[i]->input->sysMem[0].virAddr);
+        const uint8_t *dst_uv = (input_type == HB_DNN_IMG_TYPE_NV12) ?
+            dst_y + MOCK_DNN_WIDTH * MOCK_DNN_HEIGHT :
+            static_cast<uint8_t *>(results[i]->input->sysMem[1].virAddr);
+
+        CHECK(roi_check_plane(y_plane, 1, rois[i], dst_y, MOCK_DNN_WIDTH,
+                              MOCK_DNN_WIDTH, MOCK_DNN_HEIGHT) == 0);
+        CHECK(roi_check_plane(uv_plane, 2, rois[i], dst_uv, MOCK_DNN_WIDTH,
+                              MOCK_DNN_WIDTH / 2, MOCK_DNN_HEIGHT / 2) == 0);
+        // 各个框左上角的亮度相差很大，输出是第 i 个框的输入推理出来的，批内顺序没有错位
+        CHECK(output_value(results[i]->output, 0) == dst_y[0]);
+        CHECK(output_value(results[i]->output, 1) == dst_uv[0]);
+    }
+
+    for (int32_t i = 0; i < ROI_NUM; i++)
+        CHECK(sp_bpu_release_tensors(bpu, results[i]) == 0);
+    CHECK(sp_release_bpu_module(bpu) == 0);
+    return 0;
+}
+
+// sp_bpu_async_init 按在途深度加一批 ROI 预分配 tensor 池，异步推理和批量 ROI 同时进行时不再分配
+static int test_pool_prealloc(void)
+{
+    hbDNNRoi rois[SP_BPU_ROI_MAX_NUM];
+    bpu_tensor_set_t *results[SP_BPU_ROI_MAX_NUM];
+    std::vector<char> frame(FRAME_SIZE);
+    std::vector<uint8_t> roi_frame(ROI_FRAME_WIDTH * ROI_FRAME_HEIGHT * 3 / 2, 128);
+    bpu_pool_stats_t before, after;
+    sp_frame_lease_t lease;
+    async_result_t result;
+    bpu_module *bpu = NULL;
+
+    bpu = sp_init_bpu_module("mock.bin");
+    CHECK(bpu != NULL);
+    CHECK(sp_bpu_async_init(bpu, ASYNC_DEPTH) == 0);
+    CHECK(sp_bpu_get_pool_stats(bpu, &before) == 0);
+    CHECK(before.capacity == ASYNC_DEPTH + SP_BPU_ROI_MAX_NUM);
+
+    for (int32_t i = 0; i < SP_BPU_ROI_MAX_NUM; i++)
+        rois[i] = {0, 0, 2 * i + 1, 2 * i + 1};
+    memset(&lease, 0, sizeof(lease));
+    lease.width = ROI_FRAME_WIDTH;
+    lease.height = ROI_FRAME_HEIGHT;
+    lease.stride = ROI_FRAME_WIDTH;
+    lease.plane_count = 1;
+    lease.vaddr[0] = roi_frame.data();
+
+    // 异步任务占满在途深度的同时跑一整批 ROI
+    for (int32_t i = 0; i < ASYNC_DEPTH; i++) {
+        fill_frame(frame, i);
+        CHECK(sp_bpu_submit(bpu, frame.data(), on_done, &result) == i);
+    }
+    CHECK(sp_bpu_predict_rois(bpu, &lease, rois, SP_BPU_ROI_MAX_NUM, results) == 0);
+    CHECK(wait_done(&result, ASYNC_DEPTH) == 0);
+    CHECK(result.bad.load() == 0);
+    for (int32_t i = 0; i < SP_BPU_ROI_MAX_NUM; i++)
+        CHECK(sp_bpu_release_tensors(bpu, results[i]) == 0);
+
+    CHECK(sp_bpu_get_pool_stats(bpu, &after) == 0);
+    CHECK(after.alloc_count == before.alloc_count);
+    CHECK(after.wait_count == 0);
+
+    CHECK(sp_release_bpu_module(bpu) == 0);
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+
+    failed += test_callback_pipeline() ? 1 : 0;
+    failed += test_wait_release() ? 1 : 0;
+    failed += test_wait_timeout() ? 1 : 0;
+    failed += test_submit_frame() ? 1 : 0;
+    failed += test_submit_separate() ? 1 : 0;
+    failed += test_pool_exhausted() ? 1 : 0;
+    failed += test_release_busy() ? 1 : 0;
+    failed += test_predict_rois(HB_DNN_IMG_TYPE_NV12) ? 1 : 0;
+    failed += test_predict_rois(HB_DNN_IMG_TYPE_NV12_SEPARATE) ? 1 : 0;
+    failed += test_pool_prealloc() ? 1 : 0;
+
+    printf("%s\n", failed ? "bpu async test failed" : "bpu async test passed");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,267 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+// yolov5/yolov3 后处理的 golden 测试：用固定种子生成三层输出 tensor，检测结果和 golden 表比较。
+// golden 表是换成近似 exp/sigmoid 之前的实现（std::exp）在同样输入上的结果，
+// 近似只会带来很小的误差，所以分数和坐标按容差比较，类别和框的数量必须一致。
+// float、定点 SCALE、NCHW 几种输入反量化后的数值相同，共用一张表。
+// 用法：test_yolo_golden [--record]，--record 按 golden 表的格式打印当前实现的结果
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+
+#include "yolov3_post_process.h"
+#include "yolov5_post_process.h"
+
+#define GOLDEN_INPUT_SIZE 160
+#define GOLDEN_ORI_SIZE   320
+#define GOLDEN_ANCHOR_NUM 3
+#define GOLDEN_NUM_PRED   85
+#define GOLDEN_CHANNELS   (GOLDEN_ANCHOR_NUM * GOLDEN_NUM_PRED)
+#define GOLDEN_MAX_BOXES  128
+
+#define GOLDEN_SCORE_TOL 1e-4f
+#define GOLDEN_COORD_TOL 0.05f
+
+typedef enum {
+    GOLDEN_FLOAT_NHWC = 0,
+    GOLDEN_SCALE_NHWC,
+    GOLDEN_FLOAT_NCHW,
+} golden_mode_t;
+
+static const char *golden_mode_name[] = {"float nhwc", "scale nhwc", "float nchw"};
+
+// 在 std::exp 实现上用 --record 记录
+static const PostProcessBox_t yolov5_golden[] = {
+    {134.909683f, 246.959808f, 182.281723f, 262.887299f, 0.914528f, 28},
+    {58.780220f, 257.980743f, 73.543732f, 288.999786f, 0.880340f, 47},
+    {196.139969f, 4.068160f, 220.527100f, 38.109402f, 0.846988f, 59},
+    {56.403019f, 279.935760f, 95.178169f, 319.000000f, 0.796876f, 18},
+    {207.886368f, 91.662628f, 273.610474f, 162.479706f, 0.792335f, 16},
+    {0.000000f, 233.031097f, 40.594948f, 308.715302f, 0.782316f, 53},
+    {0.000000f, 166.685608f, 87.684181f, 319.000000f, 0.755910f, 68},
+    {12.964419f, 83.841942f, 19.214590f, 140.427902f, 0.722752f, 5},
+    {0.000000f, 0.000000f, 231.370682f, 319.000000f, 0.717094f, 68},
+    {215.608948f, 217.220566f, 236.596024f, 319.000000f, 0.716164f, 42},
+    {55.512783f, 0.000000f, 206.814621f, 127.490440f, 0.706996f, 22},
+    {235.703812f, 234.488190f, 272.931061f, 306.913788f, 0.697268f, 42},
+    {0.000000f, 121.058495f, 9.277802f, 259.287628f, 0.654185f, 52},
+    {199.003723f, 195.398315f, 250.853958f, 255.737106f, 0.650988f, 26},
+    {287.773926f, 16.220537f, 297.124054f, 216.916611f, 0.649419f, 77},
+    {70.423920f, 4.349379f, 194.857498f, 117.366394f, 0.644856f, 42},
+    {87.047485f, 177.011093f, 178.948502f, 203.237900f, 0.626764f, 20},
+    {237.124359f, 252.893661f, 252.898636f, 263.049316f, 0.606203f, 5},
+    {170.196045f, 286.102722f, 202.196045f, 298.873444f, 0.604981f, 37},
+    {199.796997f, 37.469910f, 206.576660f, 45.877800f, 0.586084f, 31},
+    {185.780502f, 59.468048f, 209.784225f, 69.326912f, 0.577018f, 54},
+    {61.057968f, 114.295418f, 319.000000f, 219.721619f, 0.552774f, 77},
+};
+
+static const PostProcessBox_t yolov3_golden[] = {
+    {232.375504f, 283.994629f, 311.624481f, 319.000000f, 0.958373f, 13},
+    {112.724823f, 55.055351f, 232.568069f, 122.010353f, 0.945988f, 18},
+    {92.095245f, 59.056023f, 120.234192f, 78.342255f, 0.936103f, 66},
+    {37.987762f, 0.000000f, 176.242035f, 139.443420f, 0.926591f, 21},
+    {82.159294f, 0.000000f, 319.000000f, 62.507191f, 0.921806f, 10},
+    {85.722458f, 111.802109f, 97.810684f, 121.300255f, 0.920274f, 27},
+    {217.707581f, 189.039551f, 247.350876f, 215.731033f, 0.915743f, 53},
+    {6.034693f, 142.517380f, 50.143291f, 170.452682f, 0.900609f, 26},
+    {0.000000f, 282.679779f, 118.407700f, 319.000000f, 0.894854f, 36},
+    {85.430290f, 276.833313f, 115.589256f, 319.000000f, 0.890833f, 42},
+    {182.691040f, 251.824600f, 248.039627f, 282.373993f, 0.884636f, 36},
+    {52.885719f, 89.040352f, 113.421577f, 189.710037f, 0.857462f, 63},
+    {0.000000f, 0.000000f, 278.593842f, 319.000000f, 0.754242f, 26},
+    {67.434883f, 0.000000f, 86.650742f, 58.172058f, 0.749766f, 52},
+    {174.907394f, 0.000000f, 234.907394f, 319.000000f, 0.722358f, 38},
+    {83.450775f, 25.128380f, 197.969223f, 154.068054f, 0.718125f, 19},
+    {30.464613f, 117.103210f, 153.153870f, 190.721344f, 0.715945f, 38},
+    {0.000000f, 88.072266f, 36.541149f, 319.000000f, 0.703096f, 77},
+    {127.117607f, 62.417122f, 138.656647f, 81.462883f, 0.506268f, 75},
+    {0.000000f, 0.000000f, 88.175125f, 73.421257f, 0.458759f, 4},
+    {117.750931f, 153.890198f, 148.945251f, 319.000000f, 0.456586f, 64},
+    {248.672256f, 76.510162f, 288.245544f, 100.735313f, 0.367238f, 63},
+};
+
+static uint32_t golden_rand(uint32_t *seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return (*seed >> 8) & 0xffffff;
+}
+
+// [lo, hi) 上的定点数
+static int32_t golden_rand_q(uint32_t *seed, int32_t lo, int32_t hi)
+{
+    return lo + (int32_t)(golden_rand(seed) % (uint32_t)(hi - lo));
+}
+
+// 一层输出的定点数据，按 NHWC 排列；大部分 anchor 是背景，少数放一个明确的目标
+static void golden_make_layer(uint32_t *seed, int hw, const std::vector<float> &scale,
+                              std::vector<int32_t> &q)
+{
+    q.resize(hw * hw * GOLDEN_CHANNELS);
+    for (int cell = 0; cell < hw * hw; cell++) {
+        for (int a = 0; a < GOLDEN_ANCHOR_NUM; a++) {
+            int32_t *p = &q[cell * GOLDEN_CHANNELS + a * GOLDEN_NUM_PRED];
+            const float *s = &scale[a * GOLDEN_NUM_PRED];
+            bool object = golden_rand(seed) % 64 == 0;
+
+            for (int k = 0; k < 4; k++)
+                p[k] = (int32_t)(golden_rand_q(seed, -150, 150) / 100.0f / s[k]);
+            p[4] = (int32_t)(golden_rand_q(seed, object ? 50 : -800, object ? 400 : -200) / 100.0f / s[4]);
+            for (int k = 5; k < GOLDEN_NUM_PRED; k++)
+                p[k] = (int32_t)(golden_rand_q(seed, -600, 0) / 100.0f / s[k]);
+            if (object) {
+                int k = 5 + golden_rand(seed) % (GOLDEN_NUM_PRED - 5);
+                p[k] = (int32_t)(golden_rand_q(seed, 0, 500) / 100.0f / s[k]);
+            }
+        }
+    }
+}
+
+// 同一组定点数据按 mode 填成模型输出 tensor，data 持有 tensor 的内存
+static void golden_fill_tensor(golden_mode_t mode, int hw, const std::vector<int32_t> &q,
+                               std::vector<float> &scale, std::vector<float> &data,
+                               hbDNNTensor *tensor)
+{
+    int32_t *shape = NULL;
+    int c = 0, cell = 0;
+
+    memset(tensor, 0, sizeof(hbDNNTensor));
+    data.resize(q.size());
+    if (mode == GOLDEN_SCALE_NHWC) {
+        memcpy(data.data(), q.data(), q.size() * sizeof(int32_t));
+    } else {
+        for (cell = 0; cell < hw * hw; cell++) {
+            for (c = 0; c < GOLDEN_CHANNELS; c++) {
+                float v = q[cell * GOLDEN_CHANNELS + c] * scale[c];
+                if (mode == GOLDEN_FLOAT_NCHW)
+                    data[c * hw * hw + cell] = v;
+                else
+                    data[cell * GOLDEN_CHANNELS + c] = v;
+            }
+        }
+    }
+
+    tensor->properties.quantiType = mode == GOLDEN_SCALE_NHWC ? SCALE : NONE;
+    tensor->properties.scale.scaleData = scale.data();
+    tensor->properties.scale.scaleLen = GOLDEN_CHANNELS;
+    tensor->properties.validShape.numDimensions = 4;
+    shape = tensor->properties.validShape.dimensionSize;
+    shape[0] = 1;
+    if (mode == GOLDEN_FLOAT_NCHW) {
+        tensor->properties.tensorLayout = HB_DNN_LAYOUT_NCHW;
+        tensor->properties.quantizeAxis = 1;
+        shape[1] = GOLDEN_CHANNELS;
+        shape[2] = hw;
+        shape[3] = hw;
+    } else {
+        tensor->properties.tensorLayout = HB_DNN_LAYOUT_NHWC;
+        tensor->properties.quantizeAxis = 3;
+        shape[1] = hw;
+        shape[2] = hw;
+        shape[3] = GOLDEN_CHANNELS;
+    }
+    tensor->properties.alignedShape = tensor->properties.validShape;
+    tensor->sysMem[0].virAddr = data.data();
+}
+
+// 跑一遍模型的三层后处理，返回框的数量
+static int golden_run(int model, golden_mode_t mode, PostProcessBox_t *boxes)
+{
+    // yolov5 的 stride 是 8/16/32，yolov3 是 32/16/8
+    static const int hw_v5[3] = {20, 10, 5};
+    static const int hw_v3[3] = {5, 10, 20};
+    const int *hw = model == 5 ? hw_v5 : hw_v3;
+    Yolov5PostProcessInfo_t v5_info = {GOLDEN_INPUT_SIZE, GOLDEN_INPUT_SIZE,
+        GOLDEN_ORI_SIZE, GOLDEN_ORI_SIZE, 0.3f, 0.45f, GOLDEN_MAX_BOXES, 0};
+    Yolov3PostProcessInfo_t v3_info = {GOLDEN_INPUT_SIZE, GOLDEN_INPUT_SIZE,
+        GOLDEN_ORI_SIZE, GOLDEN_ORI_SIZE, 0.3f, 0.45f, GOLDEN_MAX_BOXES, 0};
+    std::vector<float> scale(GOLDEN_CHANNELS), data;
+    std::vector<int32_t> q;
+    hbDNNTensor tensor;
+    uint32_t seed = model;
+    int layer = 0;
+
+    for (auto &s : scale)
+        s = golden_rand_q(&seed, 20, 120) / 4000.0f;
+    for (layer = 0; layer < 3; layer++) {
+        golden_make_layer(&seed, hw[layer], scale, q);
+        golden_fill_tensor(mode, hw[layer], q, scale, data, &tensor);
+        if (model == 5)
+            Yolov5doProcess(&tensor, &v5_info, layer);
+        else
+            Yolov3doProcess(&tensor, &v3_info, layer);
+    }
+    if (model == 5)
+        return Yolov5PostProcessBoxes(&v5_info, boxes, GOLDEN_MAX_BOXES);
+    return Yolov3PostProcessBoxes(&v3_info, boxes, GOLDEN_MAX_BOXES);
+}
+
+static int golden_near(float a, float b, float tol)
+{
+    return fabsf(a - b) <= tol;
+}
+
+static int golden_check(int model, golden_mode_t mode, const PostProcessBox_t *golden, int golden_num)
+{
+    PostProcessBox_t boxes[GOLDEN_MAX_BOXES];
+    int num = golden_run(model, mode, boxes);
+    int i = 0;
+
+    if (num != golden_num) {
+        printf("FAIL yolov%d %s: %d boxes (expect %d)\n", model, golden_mode_name[mode], num, golden_num);
+        return -1;
+    }
+    for (i = 0; i < num; i++) {
+        const PostProcessBox_t &a = boxes[i], &b = golden[i];
+        if (a.id != b.id || !golden_near(a.score, b.score, GOLDEN_SCORE_TOL) ||
+            !golden_near(a.xmin, b.xmin, GOLDEN_COORD_TOL) || !golden_near(a.ymin, b.ymin, GOLDEN_COORD_TOL) ||
+            !golden_near(a.xmax, b.xmax, GOLDEN_COORD_TOL) || !golden_near(a.ymax, b.ymax, GOLDEN_COORD_TOL)) {
+            printf("FAIL yolov%d %s box %d: {%f, %f, %f, %f, %f, %d} (expect {%f, %f, %f, %f, %f, %d})\n",
+                   model, golden_mode_name[mode], i, a.xmin, a.ymin, a.xmax, a.ymax, a.score, a.id,
+                   b.xmin, b.ymin, b.xmax, b.ymax, b.score, b.id);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void golden_record(int model)
+{
+    PostProcessBox_t boxes[GOLDEN_MAX_BOXES];
+    int num = golden_run(model, GOLDEN_FLOAT_NHWC, boxes);
+    int i = 0;
+
+    printf("static const PostProcessBox_t yolov%d_golden[] = {\n", model);
+    for (i = 0; i < num; i++) {
+        printf("    {%.6ff, %.6ff, %.6ff, %.6ff, %.6ff, %d},\n", boxes[i].xmin, boxes[i].ymin,
+               boxes[i].xmax, boxes[i].ymax, boxes[i].score, boxes[i].id);
+    }
+    printf("};\n");
+}
+
+int main(int argc, char **argv)
+{
+    int v5_num = sizeof(yolov5_golden) / sizeof(yolov5_golden[0]);
+    int v3_num = sizeof(yolov3_golden) / sizeof(yolov3_golden[0]);
+    int failed = 0;
+
+    if (argc > 1 && strcmp(argv[1], "--record") == 0) {
+        golden_record(5);
+        golden_record(3);
+        return 0;
+    }
+
+    failed += golden_check(5, GOLDEN_FLOAT_NHWC, yolov5_golden, v5_num) ? 1 : 0;
+    failed += golden_check(5, GOLDEN_SCALE_NHWC, yolov5_golden, v5_num) ? 1 : 0;
+    failed += golden_check(3, GOLDEN_FLOAT_NHWC, yolov3_golden, v3_num) ? 1 : 0;
+    failed += golden_check(3, GOLDEN_SCALE_NHWC, yolov3_golden, v3_num) ? 1 : 0;
+    failed += golden_check(3, GOLDEN_FLOAT_NCHW, yolov3_golden, v3_num) ? 1 : 0;
+
+    printf("%s\n", failed ? "yolo golden test failed" : "yolo golden test passed");
+    return failed ? 1 : 0;
+}
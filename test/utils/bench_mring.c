@@ -0,0 +1,182 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2020 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+// tsQueue（mutex + condvar）和 tsRingSpsc/tsRingMpmc（eventfd 挂起）的帧传递对比
+// 吞吐：生产者连续入队，统计每秒传递的消息数
+// 延迟：生产者每隔一段时间入队一个，消费者大部分时间处于挂起状态，
+//       统计从入队到出队的时间（包含唤醒），输出 p50/p99
+// 用法：bench_mring [吞吐消息数] [延迟采样数]
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mqueue.h"
+#include "mring.h"
+
+#define BENCH_QUEUE_LENGTH 64
+#define BENCH_PACE_NS      20000 /* 延迟测试的入队间隔 */
+
+typedef enum {
+    E_BENCH_QUEUE,
+    E_BENCH_SPSC,
+    E_BENCH_MPMC,
+} teBenchKind;
+
+typedef struct
+{
+    uint64_t u64PushNs;
+} tsBenchMsg;
+
+typedef struct
+{
+    teBenchKind eKind;
+    tsQueue sQueue;
+    tsRingSpsc sSpsc;
+    tsRingMpmc sMpmc;
+    tsBenchMsg *asMsgs;
+    uint64_t *au64Latency;
+    uint32_t u32Count;
+    int iPaced;
+} tsBench;
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec sNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &sNow);
+    return (uint64_t)sNow.tv_sec * 1000000000ULL + sNow.tv_nsec;
+}
+
+static void bench_push(tsBench *psBench, void *pvData)
+{
+    switch (psBench->eKind) {
+    case E_BENCH_QUEUE:
+        mQueueEnqueue(&psBench->sQueue, pvData);
+        break;
+    case E_BENCH_SPSC:
+        while (mRingSpscPush(&psBench->sSpsc, pvData) == E_QUEUE_ERROR_FULL)
+            sched_yield();
+        break;
+    case E_BENCH_MPMC:
+        while (mRingMpmcPush(&psBench->sMpmc, pvData) == E_QUEUE_ERROR_FULL)
+            sched_yield();
+        break;
+    }
+}
+
+static teQueueStatus bench_pop(tsBench *psBench, void **ppvData)
+{
+    switch (psBench->eKind) {
+    case E_BENCH_QUEUE:
+        return mQueueDequeueTimed(&psBench->sQueue, 1000, ppvData);
+    case E_BENCH_SPSC:
+        return mRingSpscPopTimed(&psBench->sSpsc, 1000, ppvData);
+    default:
+        return mRingMpmcPopTimed(&psBench->sMpmc, 1000, ppvData);
+    }
+}
+
+static void *bench_producer(void *pvArg)
+{
+    tsBench *psBench = (tsBench *)pvArg;
+    struct timespec sPace = {0, BENCH_PACE_NS};
+
+    for (uint32_t i = 0; i < psBench->u32Count; i++) {
+        if (psBench->iPaced)
+            nanosleep(&sPace, NULL);
+        psBench->asMsgs[i].u64PushNs = bench_now_ns();
+        bench_push(psBench, &psBench->asMsgs[i]);
+    }
+    return NULL;
+}
+
+static int bench_cmp_u64(const void *pvA, const void *pvB)
+{
+    uint64_t u64A = *(const uint64_t *)pvA;
+    uint64_t u64B = *(const uint64_t *)pvB;
+
+    return u64A < u64B ? -1 : u64A > u64B;
+}
+
+static int bench_run(teBenchKind eKind, const char *pcName, uint32_t u32Count, int iPaced)
+{
+    tsBench sBench;
+    pthread_t sProducer;
+    uint64_t u64Start, u64Elapsed;
+    void *pvData = NULL;
+
+    memset(&sBench, 0, sizeof(sBench));
+    sBench.eKind = eKind;
+    sBench.u32Count = u32Count;
+    sBench.iPaced = iPaced;
+    sBench.asMsgs = calloc(u32Count, sizeof(tsBenchMsg));
+    sBench.au64Latency = calloc(u32Count, sizeof(uint64_t));
+    if (!sBench.asMsgs || !sBench.au64Latency) {
+        printf("no memory\n");
+        return -1;
+    }
+
+    if (eKind == E_BENCH_QUEUE)
+        mQueueCreate(&sBench.sQueue, BENCH_QUEUE_LENGTH);
+    else if (eKind == E_BENCH_SPSC)
+        mRingSpscCreate(&sBench.sSpsc, BENCH_QUEUE_LENGTH, E_RING_WAIT_EVENTFD);
+    else
+        mRingMpmcCreate(&sBench.sMpmc, BENCH_QUEUE_LENGTH, E_RING_WAIT_EVENTFD);
+
+    u64Start = bench_now_ns();
+    pthread_create(&sProducer, NULL, bench_producer, &sBench);
+    for (uint32_t i = 0; i < u32Count; i++) {
+        if (bench_pop(&sBench, &pvData) != E_QUEUE_OK) {
+            printf("%s: dequeue timeout at %u\n", pcName, i);
+            return -1;
+        }
+        sBench.au64Latency[i] = bench_now_ns() - ((tsBenchMsg *)pvData)->u64PushNs;
+    }
+    u64Elapsed = bench_now_ns() - u64Start;
+    pthread_join(sProducer, NULL);
+
+    qsort(sBench.au64Latency, u32Count, sizeof(uint64_t), bench_cmp_u64);
+    if (iPaced) {
+        printf("%-28s latency p50 %7.2f us  p99 %7.2f us\n", pcName,
+            sBench.au64Latency[u32Count / 2] / 1000.0,
+            sBench.au64Latency[(uint64_t)u32Count * 99 / 100] / 1000.0);
+    } else {
+        printf("%-28s %10.0f ops/s  p99 %9.2f us\n", pcName,
+            u32Count / (u64Elapsed / 1e9),
+            sBench.au64Latency[(uint64_t)u32Count * 99 / 100] / 1000.0);
+    }
+
+    if (eKind == E_BENCH_QUEUE)
+        mQueueDestroy(&sBench.sQueue);
+    else if (eKind == E_BENCH_SPSC)
+        mRingSpscDestroy(&sBench.sSpsc);
+    else
+        mRingMpmcDestroy(&sBench.sMpmc);
+    free(sBench.asMsgs);
+    free(sBench.au64Latency);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t u32Count = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000000;
+    uint32_t u32Paced = argc > 2 ? (uint32_t)atoi(argv[2]) : 20000;
+    int ret = 0;
+
+    printf("throughput, %u messages, queue length %d\n", u32Count, BENCH_QUEUE_LENGTH);
+    ret |= bench_run(E_BENCH_QUEUE, "mQueue (mutex+cond)", u32Count, 0);
+    ret |= bench_run(E_BENCH_SPSC, "mRingSpsc (eventfd)", u32Count, 0);
+    ret |= bench_run(E_BENCH_MPMC, "mRingMpmc (eventfd)", u32Count, 0);
+
+    printf("handoff, %u messages, one every %d us\n", u32Paced, BENCH_PACE_NS / 1000);
+    ret |= bench_run(E_BENCH_QUEUE, "mQueue (mutex+cond)", u32Paced, 1);
+    ret |= bench_run(E_BENCH_SPSC, "mRingSpsc (eventfd)", u32Paced, 1);
+    ret |= bench_run(E_BENCH_MPMC, "mRingMpmc (eventfd)", u32Paced, 1);
+    return ret ? 1 : 0;
+}
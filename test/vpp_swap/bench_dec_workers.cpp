@@ -0,0 +1,90 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+// 多路解码送流的扩展性：1/2/4/8 路同时交给 VPPDecodeWorkers，
+// 每路由 soft_vdec.h 里的软件解码器模拟，各路硬件解码互不影响，
+// 统计所有通道送完的总包率，以及相对 1 路线性扩展的比例。
+// 第二组让第 0 路在送流时阻塞一次，看其他通道是否被拖慢。
+// 用法：bench_dec_workers [每路包数] [每包解码耗时 us]
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "soft_vdec.h"
+
+#define BENCH_STALL_MS 200
+
+static const int bench_streams[] = {1, 2, 4, 8};
+
+// 返回所有通道都 close 时的耗时，单位秒；stall_ms 大于 0 时第 0 路阻塞一次，不计入统计
+static double bench_run(int streams, int packets, int decode_us, int stall_ms)
+{
+    VPPDecodeWorkers &workers = VPPDecodeWorkers::Instance();
+    std::vector<std::unique_ptr<SoftVdec>> decs;
+    std::chrono::steady_clock::time_point start, end;
+    bool done = false;
+    int i = 0;
+
+    for (i = 0; i < streams; i++)
+        decs.emplace_back(new SoftVdec(packets, decode_us));
+    if (stall_ms > 0)
+        decs[0]->SetStall(1, stall_ms);
+
+    start = std::chrono::steady_clock::now();
+    for (auto &dec : decs)
+        workers.Attach(dec.get());
+    while (!done) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        done = true;
+        for (i = (stall_ms > 0) ? 1 : 0; i < streams; i++)
+            done = done && decs[i]->m_closed.load() == 1;
+    }
+    end = std::chrono::steady_clock::now();
+
+    for (auto &dec : decs)
+        workers.Detach(dec.get());
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    int packets = (argc > 1) ? atoi(argv[1]) : 2000;
+    int decode_us = (argc > 2) ? atoi(argv[2]) : 200;
+    int num = sizeof(bench_streams) / sizeof(bench_streams[0]);
+    double base = 0, rate = 0, cost = 0;
+    int i = 0, other = 0;
+
+    if (packets <= 0)
+        packets = 1;
+    if (decode_us < 0)
+        decode_us = 0;
+
+    printf("%d packets per stream, %d us per packet, %d workers\n", packets, decode_us, DEC_WORKER_NUM);
+    printf("%-8s %12s %12s %10s\n", "streams", "pkts/s", "per stream", "scaling");
+    for (i = 0; i < num; i++) {
+        cost = bench_run(bench_streams[i], packets, decode_us, 0);
+        rate = bench_streams[i] * packets / cost;
+        if (i == 0)
+            base = rate;
+        printf("%-8d %12.0f %12.0f %9.2fx\n", bench_streams[i], rate,
+               rate / bench_streams[i], rate / base);
+    }
+
+    // 第 0 路阻塞 BENCH_STALL_MS，其余通道的总包率
+    printf("\nstream 0 stalls %d ms once\n", BENCH_STALL_MS);
+    printf("%-8s %12s %12s\n", "streams", "pkts/s", "per stream");
+    for (i = 1; i < num; i++) {
+        other = bench_streams[i] - 1;
+        cost = bench_run(bench_streams[i], packets, decode_us, BENCH_STALL_MS);
+        rate = other * packets / cost;
+        printf("%-8d %12.0f %12.0f\n", bench_streams[i], rate, rate / other);
+    }
+
+    return 0;
+}
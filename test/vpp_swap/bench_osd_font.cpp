@@ -0,0 +1,297 @@
+/*
+ * Horizon Robotics
+ *
+ * Copyright (C) 2023 Horizon Robotics Inc.
+ * All rights reserved.
+ */
+// set_graph_word 文字绘制的对比：原来每个字 fopen/fseek/fread 字库再逐像素写，
+// 和 OsdFont 的 mmap 字库 + 字形缓存 + 按段 memcpy。
+// 在内存里的 ARGB8888 画布上重复绘制同一组标签，统计每秒绘制的标签数，
+// 并逐字节比较两种实现画出来的结果。
+// 字库路径由编译选项 FONT_ASC16_FILE/FONT_HZK16_FILE 指定，文件不存在时生成伪随机点阵的字库，
+// 只用来测速度和一致性，不是真实字形。
+// 用法：bench_osd_font [每组标签的绘制次数]
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "x3_sdk_font.h"
+
+using namespace srpy_cam;
+
+#define BENCH_FB_WIDTH  1920
+#define BENCH_FB_HEIGHT 1080
+#define BENCH_COLOR     0xffff0000
+
+#define FONT_MASK_80 0x80
+#define FONT_MASK_40 0x40
+#define FONT_MASK_20 0x20
+#define FONT_MASK_10 0x10
+#define FONT_MASK_08 0x08
+#define FONT_MASK_04 0x04
+#define FONT_MASK_02 0x02
+#define FONT_MASK_01 0x01
+
+typedef struct {
+    const char *name;
+    const char *text;
+    int line_width;
+} bench_label_t;
+
+// 中文按 GB2312 编码：人 0xc8cb，车 0xb3b5
+static const bench_label_t bench_labels[] = {
+    {"en 11 chars, lw 1", "person 0.87", 1},
+    {"en 11 chars, lw 2", "person 0.87", 2},
+    {"cn+en, lw 1", "\xc8\xcb 0.87 \xb3\xb5 0.66", 1},
+    {"cn+en, lw 2", "\xc8\xcb 0.87 \xb3\xb5 0.66", 2},
+};
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static int bench_make_font(const char *file, size_t size)
+{
+    FILE *fp = NULL;
+    uint32_t seed = 0x12345678;
+    size_t i = 0;
+
+    if (access(file, R_OK) == 0)
+        return 0;
+
+    fp = fopen(file, "wb");
+    if (fp == NULL) {
+        printf("create %s failed: %s\n", file, strerror(errno));
+        return -1;
+    }
+    for (i = 0; i < size; i++) {
+        seed = seed * 1103515245u + 12345u;
+        fputc((seed >> 16) & 0xff, fp);
+    }
+    fclose(fp);
+    printf("generated synthetic font %s\n", file);
+    return 0;
+}
+
+/******************** 原来的实现，取自 x3_sdk_display.cpp ********************/
+
+static void osd_draw_word_row(uint8_t *addr, uint32_t width,
+    uint32_t line_width, uint32_t color)
+{
+    uint32_t addr_offset;
+    uint32_t m, w, i;
+
+    for (m = 0; m < line_width; m++) {
+        for (w = 0; w < line_width; w++) {
+            addr_offset = ((width * m) + w) * VOT_ARGB_BYTES;
+            for (i = 0; i < VOT_ARGB_BYTES; i++) {
+                addr[addr_offset + i] = (color >> (i * 8)) & 0xff;
+            }
+        }
+    }
+}
+
+static int32_t osd_draw_cn_word(uint8_t *addr, uint32_t width,
+    uint32_t line_width, uint32_t color, uint8_t *cn_word)
+{
+    FILE *file;
+    uint8_t flag;
+    uint64_t offset;
+    uint8_t *addr_word, *addr_src;
+    uint8_t buffer[32];
+    uint8_t key[8] = {FONT_MASK_80, FONT_MASK_40, FONT_MASK_20,
+                      FONT_MASK_10, FONT_MASK_08, FONT_MASK_04,
+                      FONT_MASK_02, FONT_MASK_01};
+    uint32_t row_bytes;
+    uint32_t k, j, i;
+    size_t size;
+
+    file = fopen(FONT_HZK16_FILE, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    offset = ((FONT_INTERVAL_CN_WORD_CNT *
+        ((uint64_t)cn_word[0] - FONT_CN_WORD_START_ENCODE - 1u)) +
+        ((uint64_t)cn_word[1] - FONT_CN_WORD_START_ENCODE) - 1u)
+        * FONT_CN_WORD_BYTES;
+    (void)fseek(file, (int64_t)offset, SEEK_SET);
+    size = fread((void *)buffer, 1, FONT_CN_WORD_BYTES, file);
+    if (size != FONT_CN_WORD_BYTES) {
+        (void)fclose(file);
+        return -1;
+    }
+
+    row_bytes = FONT_CN_WORD_WIDTH / ONE_BYTE_BIT_CNT;
+    addr_src = addr;
+
+    for (k = 0; k < FONT_WORD_HEIGHT; k++) {
+        addr_word = addr_src;
+        for (j = 0; j < row_bytes; j++) {
+            for (i = 0; i < ONE_BYTE_BIT_CNT; i++) {
+                flag = buffer[(k * row_bytes) + j] & key[i];
+                if (flag != 0u) {
+                    osd_draw_word_row(addr_word, width, line_width, color);
+                }
+                addr_word = &addr_word[line_width * VOT_ARGB_BYTES];
+            }
+        }
+        addr_src = &addr_src[width * line_width * VOT_ARGB_BYTES];
+    }
+
+    (void)fclose(file);
+
+    return 0;
+}
+
+static int32_t osd_draw_en_word(uint8_t *addr, uint32_t width,
+    uint32_t line_width, uint32_t color, uint8_t en_word)
+{
+    FILE *file;
+    uint8_t flag;
+    uint32_t offset;
+    uint8_t *addr_word, *addr_src;
+    uint8_t buffer[16];
+    uint8_t key[8] = {FONT_MASK_80, FONT_MASK_40, FONT_MASK_20,
+                      FONT_MASK_10, FONT_MASK_08, FONT_MASK_04,
+                      FONT_MASK_02, FONT_MASK_01};
+    uint32_t k, i;
+    size_t size;
+
+    file = fopen(FONT_ASC16_FILE, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    offset = (uint32_t)en_word * FONT_EN_WORD_BYTES;
+    (void)fseek(file, (int32_t)offset, SEEK_SET);
+    size = fread((void *)buffer, 1, FONT_EN_WORD_BYTES, file);
+    if (size != FONT_EN_WORD_BYTES) {
+        (void)fclose(file);
+        return -1;
+    }
+
+    addr_src = addr;
+
+    for (k = 0; k < FONT_WORD_HEIGHT; k++) {
+        addr_word = addr_src;
+        for (i = 0; i < ONE_BYTE_BIT_CNT; i++) {
+            flag = buffer[k] & key[i];
+            if (flag != 0u) {
+                osd_draw_word_row(addr_word, width, line_width, color);
+            }
+            addr_word = &addr_word[line_width * VOT_ARGB_BYTES];
+        }
+        addr_src = &addr_src[width * line_width * VOT_ARGB_BYTES];
+    }
+
+    (void)fclose(file);
+
+    return 0;
+}
+
+/*********************** 两种实现共用 draw_word 的遍历 ***********************/
+
+static int32_t bench_draw_word(uint8_t *addr, int x, int y, const char *str, int width,
+                               int color, int line_width, int cached)
+{
+    uint32_t str_len, i, word_offs = 1u;
+    uint8_t cn_word[2], en_word;
+    int32_t ret = 0;
+    std::shared_ptr<const OsdGlyph> glyph;
+
+    str_len = (uint32_t)strlen(str);
+    addr = &addr[((y * width) + x) * VOT_ARGB_BYTES];
+
+    for (i = 0; i < str_len; i += word_offs) {
+        if ((uint8_t)str[i] >= FONT_CN_WORD_START_ENCODE) {
+            cn_word[0] = str[i];
+            cn_word[1] = str[i + 1u];
+            if (cn_word[1] == '\0') {
+                word_offs = FONT_CN_ENCODE_NUM;
+                continue;
+            }
+            if (cached) {
+                glyph = OsdFont::Instance().GetGlyph(cn_word, FONT_CN_ENCODE_NUM, line_width, color);
+                if (!glyph)
+                    return -1;
+                OsdFont::BlitGlyph(*glyph, addr, width);
+            } else if ((ret = osd_draw_cn_word(addr, width, line_width, color, cn_word)) < 0) {
+                return ret;
+            }
+            word_offs = FONT_CN_ENCODE_NUM;
+            addr = &addr[line_width * FONT_CN_WORD_WIDTH * VOT_ARGB_BYTES];
+        } else {
+            en_word = str[i];
+            if (cached) {
+                glyph = OsdFont::Instance().GetGlyph(&en_word, FONT_EN_ENCODE_NUM, line_width, color);
+                if (!glyph)
+                    return -1;
+                OsdFont::BlitGlyph(*glyph, addr, width);
+            } else if ((ret = osd_draw_en_word(addr, width, line_width, color, en_word)) < 0) {
+                return ret;
+            }
+            word_offs = FONT_EN_ENCODE_NUM;
+            addr = &addr[line_width * FONT_EN_WORD_WIDTH * VOT_ARGB_BYTES];
+        }
+    }
+    return 0;
+}
+
+static double bench_run(uint8_t *fb, const bench_label_t *label, int iters, int cached)
+{
+    uint64_t start = 0, cost = 0;
+    int i = 0;
+
+    start = bench_now_ns();
+    for (i = 0; i < iters; i++) {
+        if (bench_draw_word(fb, 16, 16, label->text, BENCH_FB_WIDTH, BENCH_COLOR,
+                            label->line_width, cached)) {
+            printf("draw %s failed\n", label->name);
+            return 0;
+        }
+    }
+    cost = bench_now_ns() - start;
+    return iters * 1e9 / (cost ? cost : 1);
+}
+
+int main(int argc, char **argv)
+{
+    int iters = (argc > 1) ? atoi(argv[1]) : 20000;
+    size_t fb_size = (size_t)BENCH_FB_WIDTH * BENCH_FB_HEIGHT * VOT_ARGB_BYTES;
+    std::vector<uint8_t> fb_old(fb_size, 0), fb_new(fb_size, 0);
+    int num = sizeof(bench_labels) / sizeof(bench_labels[0]);
+    int i = 0, mismatch = 0;
+    double old_rate = 0, new_rate = 0;
+
+    if (bench_make_font(FONT_ASC16_FILE, 256 * FONT_EN_WORD_BYTES) ||
+        bench_make_font(FONT_HZK16_FILE,
+                        FONT_INTERVAL_CN_WORD_CNT * FONT_INTERVAL_CN_WORD_CNT * FONT_CN_WORD_BYTES))
+        return 1;
+
+    printf("%-20s %14s %14s %8s\n", "label", "old labels/s", "new labels/s", "speedup");
+    for (i = 0; i < num; i++) {
+        // 每组标签单独比较一次画布，先清零避免前一组的残留掩盖差异
+        memset(fb_old.data(), 0, fb_size);
+        memset(fb_new.data(), 0, fb_size);
+        old_rate = bench_run(fb_old.data(), &bench_labels[i], iters, 0);
+        new_rate = bench_run(fb_new.data(), &bench_labels[i], iters, 1);
+        if (memcmp(fb_old.data(), fb_new.data(), fb_size) != 0) {
+            printf("%s: output differs\n", bench_labels[i].name);
+            mismatch++;
+        }
+        printf("%-20s %14.0f %14.0f %7.1fx\n", bench_labels[i].name,
+               old_rate, new_rate, old_rate > 0 ? new_rate / old_rate : 0);
+    }
+
+    return mismatch ? 1 : 0;
+}
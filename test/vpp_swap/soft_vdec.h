@@ -0,0 +1,104 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+// 软件模拟的解码通道，代替 VPPCodec 交给 VPPDecodeWorkers 推进
+// 每路有固定个数的输入 buffer，硬件按顺序解码，每包耗时 decode_us，解码完归还 buffer；
+// 每次送流拷贝一包数据，相当于 feed_step 里把码流拷到 mmz；
+// 可以让第 stall_at 次送流阻塞 stall_ms 毫秒，模拟 HB_VDEC_SendStream 等待超时或 rtsp 重连
+#ifndef SOFT_VDEC_H_
+#define SOFT_VDEC_H_
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "x3_sdk_dec_workers.h"
+
+using namespace srpy_cam;
+
+class SoftVdec : public DecodeFeeder
+{
+  public:
+    typedef std::chrono::steady_clock clock;
+
+    SoftVdec(int packets, int decode_us, int input_num = 8, int packet_bytes = 64 * 1024)
+        : m_packets(packets), m_decode_us(decode_us), m_input_num(input_num),
+          m_src(packet_bytes, 1), m_dst(packet_bytes, 0)
+    {
+    }
+
+    void SetStall(int stall_at, int stall_ms)
+    {
+        m_stall_at = stall_at;
+        m_stall_ms = stall_ms;
+    }
+
+    int x3_vdec_feed_step() override
+    {
+        clock::time_point now = clock::now();
+        int ret = DEC_FEED_SENT;
+
+        // 同一路同一时间只能在一个线程里推进，Detach 返回之后也不能再被访问
+        if (m_in_call.fetch_add(1) != 0 || m_detached)
+            m_violation++;
+
+        if (m_quit || m_sent == m_packets) {
+            m_eos = true;
+            ret = DEC_FEED_DONE;
+        } else {
+            while (!m_inflight.empty() && m_inflight.front() <= now)
+                m_inflight.pop_front();
+            if ((int)m_inflight.size() >= m_input_num) {
+                ret = DEC_FEED_IDLE;
+            } else {
+                if (m_sent == m_stall_at && m_stall_ms > 0) {
+                    m_stalling = true;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(m_stall_ms));
+                    m_stalling = false;
+                    now = clock::now();
+                }
+                std::copy(m_src.begin(), m_src.end(), m_dst.begin());
+                m_last_done = std::max(now, m_last_done) + std::chrono::microseconds(m_decode_us);
+                m_inflight.push_back(m_last_done);
+                m_sent++;
+            }
+        }
+
+        m_in_call--;
+        return ret;
+    }
+
+    void x3_vdec_feed_close() override
+    {
+        if (m_in_call.load() != 0 || m_detached)
+            m_violation++;
+        m_closed++;
+    }
+
+    // 外部线程读取的状态
+    std::atomic<int> m_sent{0};
+    std::atomic<int> m_closed{0};
+    std::atomic<int> m_violation{0};
+    std::atomic<bool> m_stalling{false};
+    std::atomic<bool> m_quit{false};     /* 相当于 is_quit */
+    std::atomic<bool> m_detached{false}; /* Detach 返回之后由测试设置 */
+    bool m_eos = false;
+
+  private:
+    int m_packets;
+    int m_decode_us;
+    int m_input_num;
+    int m_stall_at = -1;
+    int m_stall_ms = 0;
+    std::atomic<int> m_in_call{0};
+    std::deque<clock::time_point> m_inflight;
+    clock::time_point m_last_done;
+    std::vector<char> m_src;
+    std::vector<char> m_dst;
+};
+
+#endif // SOFT_VDEC_H_
@@ -0,0 +1,229 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+// VPPCaptureReactor 的调度测试，帧源由 FakeCaptureSource 按帧率用 timerfd 模拟
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "x3_sdk_capture.h"
+
+using namespace srpy_cam;
+
+#define CHECK(cond)                                                  \
+    do {                                                             \
+        if (!(cond)) {                                               \
+            printf("FAIL %s:%d: %s\n", __func__, __LINE__, #cond);   \
+            return -1;                                               \
+        }                                                            \
+    } while (0)
+
+typedef std::chrono::steady_clock test_clock;
+
+static int64_t elapsed_ms(test_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(test_clock::now() - start).count();
+}
+
+static void sleep_ms(int ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// 停止之后源的 buffer 应该全部归还：等到每个 buffer 都能再借出一次
+static int source_all_free(FakeCaptureSource *source, int buf_num)
+{
+    ImageFrameLease *leases[8] = {nullptr};
+    int got = 0;
+
+    for (int i = 0; i < 200 && got < buf_num; i++) {
+        leases[got] = source->TryAcquire();
+        if (leases[got] != nullptr)
+            got++;
+        else
+            sleep_ms(1);
+    }
+    for (int i = 0; i < got; i++)
+        source->Release(leases[i]);
+    return got == buf_num ? 0 : -1;
+}
+
+// 就绪事件驱动回调：帧号递增，回调返回后 reactor 释放自己的引用，RetainFrame 可以把帧留到回调之外
+static int test_callback_dispatch(void)
+{
+    FakeCaptureSource source;
+    VPPCaptureReactor reactor;
+    std::atomic<int> frames{0};
+    std::atomic<int> bad{0};
+    std::atomic<ImageFrameLease *> kept{nullptr};
+    int64_t last_id = 0;
+    int chn = -1;
+
+    CHECK(source.Open(64, 32, 200, 3) == 0);
+    chn = reactor.AddChannel(&source, [&](int c, ImageFrameLease *lease) {
+        if (c != chn || lease->m_ref_cnt.load() != 1 || lease->m_frame.image_id <= last_id ||
+            lease->m_frame.width != 64 || lease->m_frame.height != 32)
+            bad++;
+        last_id = lease->m_frame.image_id;
+        if (kept.load() == nullptr) {
+            reactor.RetainFrame(lease);
+            kept = lease;
+        }
+        frames++;
+    });
+    CHECK(chn == 0);
+    CHECK(reactor.Start() == 0);
+    // 已经启动后不能再加通道
+    CHECK(reactor.AddChannel(&source, 4) == -1);
+
+    sleep_ms(200);
+    CHECK(reactor.Stop() == 0);
+    CHECK(frames.load() >= 10);
+    CHECK(bad.load() == 0);
+    CHECK((int)reactor.GetFrameCount(chn) == frames.load());
+
+    // 留下来的那一帧在释放之前一直占着一个 buffer
+    CHECK(kept.load() != nullptr && kept.load()->m_ref_cnt.load() == 1);
+    reactor.ReleaseFrame(chn, kept.load());
+    CHECK(source_all_free(&source, 3) == 0);
+    return 0;
+}
+
+// 多个源：回调和队列两种通道混在一个 reactor 里，每一帧只送到自己的通道
+static int test_multi_source(void)
+{
+    static const int widths[3] = {32, 48, 64};
+    static const int fps[3] = {100, 200, 50};
+    FakeCaptureSource sources[3];
+    VPPCaptureReactor reactor;
+    std::atomic<int> cb_frames[2];
+    std::atomic<int> bad{0};
+    std::atomic<bool> consuming{true};
+    int popped = 0, chns[3] = {-1, -1, -1};
+
+    for (int i = 0; i < 3; i++)
+        CHECK(sources[i].Open(widths[i], 16, fps[i], 4) == 0);
+    for (int i = 0; i < 2; i++) {
+        cb_frames[i] = 0;
+        chns[i] = reactor.AddChannel(&sources[i], [&, i](int c, ImageFrameLease *lease) {
+            if (c != chns[i] || lease->m_frame.width != widths[i])
+                bad++;
+            cb_frames[i]++;
+        });
+        CHECK(chns[i] == i);
+    }
+    chns[2] = reactor.AddChannel(&sources[2], 4);
+    CHECK(chns[2] == 2);
+    CHECK(reactor.GetChannelFd(chns[2]) >= 0);
+    CHECK(reactor.GetChannelFd(chns[0]) == -1);
+
+    CHECK(reactor.Start() == 0);
+    std::thread consumer([&]() {
+        ImageFrameLease *lease = nullptr;
+        while (consuming.load()) {
+            if (reactor.PopFrame(chns[2], &lease, 10) != 0)
+                continue;
+            if (lease->m_frame.width != widths[2])
+                bad++;
+            popped++;
+            reactor.ReleaseFrame(chns[2], lease);
+        }
+    });
+
+    sleep_ms(300);
+    CHECK(reactor.Stop() == 0);
+    consuming = false;
+    consumer.join();
+
+    CHECK(bad.load() == 0);
+    CHECK(cb_frames[0].load() >= 10 && cb_frames[1].load() >= 20);
+    CHECK(popped >= 5);
+    // 帧率高的源分到的帧更多，说明各通道按自己的就绪事件调度
+    CHECK(cb_frames[1].load() > cb_frames[0].load());
+    CHECK(cb_frames[0].load() > popped);
+    CHECK(reactor.GetDropCount(chns[2]) == 0);
+    for (int i = 0; i < 3; i++)
+        CHECK(source_all_free(&sources[i], 4) == 0);
+    return 0;
+}
+
+// 队列满时丢帧并计数，丢掉的帧马上还给源；Stop 把队列里没取走的帧还给源
+static int test_queue_drop(void)
+{
+    FakeCaptureSource source;
+    VPPCaptureReactor reactor;
+    int chn = -1;
+
+    CHECK(source.Open(32, 16, 200, 4) == 0);
+    chn = reactor.AddChannel(&source, 2);
+    CHECK(chn == 0);
+    CHECK(reactor.Start() == 0);
+
+    sleep_ms(100);
+    CHECK(reactor.Stop() == 0);
+    CHECK(reactor.GetFrameCount(chn) >= 10);
+    CHECK(reactor.GetDropCount(chn) >= reactor.GetFrameCount(chn) - 2);
+    CHECK(source_all_free(&source, 4) == 0);
+    return 0;
+}
+
+// 关闭：Stop 不等下一帧就返回，阻塞在 PopFrame 的消费者按自己的超时返回；
+// 可以重复 Stop，也可以再次 Start；没有就绪 fd 的源让 Start 失败
+static int test_shutdown(void)
+{
+    FakeCaptureSource source, closed;
+    VPPCaptureReactor reactor, bad_reactor;
+    ImageFrameLease *lease = nullptr;
+    test_clock::time_point start;
+    std::atomic<int> pop_ret{1};
+    int chn = -1;
+
+    // 1 fps，Stop 的时候 reactor 一定在 epoll_wait 里等
+    CHECK(source.Open(32, 16, 1, 2) == 0);
+    chn = reactor.AddChannel(&source, 2);
+    CHECK(reactor.Start() == 0);
+    CHECK(reactor.Start() == 0);
+
+    std::thread consumer([&]() {
+        ImageFrameLease *l = nullptr;
+        pop_ret = reactor.PopFrame(chn, &l, 300);
+        if (pop_ret.load() == 0)
+            reactor.ReleaseFrame(chn, l);
+    });
+    sleep_ms(20);
+    start = test_clock::now();
+    CHECK(reactor.Stop() == 0);
+    CHECK(elapsed_ms(start) < 100);
+    CHECK(reactor.Stop() == 0);
+    consumer.join();
+    CHECK(pop_ret.load() == -1);
+
+    // 重新启动后继续出帧
+    CHECK(source.Open(32, 16, 200, 2) == 0);
+    CHECK(reactor.Start() == 0);
+    CHECK(reactor.PopFrame(chn, &lease, 500) == 0);
+    reactor.ReleaseFrame(chn, lease);
+    CHECK(reactor.Stop() == 0);
+    CHECK(source_all_free(&source, 2) == 0);
+
+    CHECK(bad_reactor.AddChannel(&closed, 2) == 0);
+    CHECK(bad_reactor.Start() == -1);
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+
+    failed += test_callback_dispatch() ? 1 : 0;
+    failed += test_multi_source() ? 1 : 0;
+    failed += test_queue_drop() ? 1 : 0;
+    failed += test_shutdown() ? 1 : 0;
+
+    printf("%s\n", failed ? "capture reactor test failed" : "capture reactor test passed");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+// VPPDecodeWorkers 的调度测试，解码通道由 soft_vdec.h 里的软件解码器模拟
+#include <stdio.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "soft_vdec.h"
+
+#define CHECK(cond)                                                  \
+    do {                                                             \
+        if (!(cond)) {                                               \
+            printf("FAIL %s:%d: %s\n", __func__, __LINE__, #cond);   \
+            return -1;                                               \
+        }                                                            \
+    } while (0)
+
+typedef std::chrono::steady_clock test_clock;
+
+static int64_t elapsed_ms(test_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(test_clock::now() - start).count();
+}
+
+// 等到 cond 成立，最多 timeout_ms 毫秒
+template <typename Cond>
+static bool wait_for(Cond cond, int timeout_ms)
+{
+    test_clock::time_point start = test_clock::now();
+
+    while (!cond()) {
+        if (elapsed_ms(start) > timeout_ms)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// 8 路同时送流：每一路都送完，并且由工作线程 close 一次
+static int test_all_streams_done(void)
+{
+    VPPDecodeWorkers &workers = VPPDecodeWorkers::Instance();
+    std::vector<std::unique_ptr<SoftVdec>> decs;
+
+    for (int i = 0; i < 8; i++)
+        decs.emplace_back(new SoftVdec(100, 100));
+    for (auto &dec : decs)
+        workers.Attach(dec.get());
+
+    for (auto &dec : decs) {
+        SoftVdec *d = dec.get();
+        CHECK(wait_for([d]() { return d->m_closed.load() == 1; }, 5000));
+    }
+    for (auto &dec : decs) {
+        // 已经结束的通道再 Detach 直接返回
+        workers.Detach(dec.get());
+        dec->m_detached = true;
+        CHECK(dec->m_sent.load() == 100);
+        CHECK(dec->m_closed.load() == 1);
+        CHECK(dec->m_violation.load() == 0);
+    }
+    return 0;
+}
+
+// 一路送流阻塞时，其他通道继续推进，Attach/Detach 也不用等它
+static int test_stall_isolated(void)
+{
+    VPPDecodeWorkers &workers = VPPDecodeWorkers::Instance();
+    SoftVdec stalled(20, 100), a(200, 100), b(200, 100), late(50, 100);
+    test_clock::time_point start;
+
+    stalled.SetStall(5, 500);
+    workers.Attach(&stalled);
+    workers.Attach(&a);
+    workers.Attach(&b);
+    CHECK(wait_for([&stalled]() { return stalled.m_stalling.load(); }, 1000));
+
+    // 阻塞期间其他两路送完
+    CHECK(wait_for([&a, &b]() { return a.m_closed.load() == 1 && b.m_closed.load() == 1; }, 300));
+    CHECK(stalled.m_stalling.load());
+
+    // 阻塞期间新加一路，送完后 Detach
+    start = test_clock::now();
+    workers.Attach(&late);
+    CHECK(wait_for([&late]() { return late.m_closed.load() == 1; }, 300));
+    workers.Detach(&late);
+    late.m_detached = true;
+    CHECK(elapsed_ms(start) < 300);
+    CHECK(stalled.m_stalling.load());
+
+    CHECK(wait_for([&stalled]() { return stalled.m_closed.load() == 1; }, 2000));
+    workers.Detach(&stalled);
+    workers.Detach(&a);
+    workers.Detach(&b);
+    stalled.m_detached = a.m_detached = b.m_detached = true;
+    CHECK(stalled.m_sent.load() == 20);
+    CHECK(a.m_violation.load() == 0 && b.m_violation.load() == 0);
+    CHECK(stalled.m_violation.load() == 0 && late.m_violation.load() == 0);
+    return 0;
+}
+
+// 送流中途 Detach：返回后不再访问，close 只调用一次
+static int test_detach_running(void)
+{
+    VPPDecodeWorkers &workers = VPPDecodeWorkers::Instance();
+    SoftVdec dec(1000000, 100);
+
+    workers.Attach(&dec);
+    CHECK(wait_for([&dec]() { return dec.m_sent.load() >= 20; }, 1000));
+    dec.m_quit = true;
+    workers.Detach(&dec);
+    dec.m_detached = true;
+    CHECK(dec.m_eos);
+    CHECK(dec.m_closed.load() == 1);
+
+    // 给工作线程留出时间，如果还会访问 dec，这里会记录到 m_violation
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(dec.m_violation.load() == 0);
+    return 0;
+}
+
+// 送流阻塞时 Detach：等这一步结束后再返回
+static int test_detach_stalled(void)
+{
+    VPPDecodeWorkers &workers = VPPDecodeWorkers::Instance();
+    SoftVdec dec(1000000, 100);
+    test_clock::time_point start;
+
+    dec.SetStall(3, 200);
+    workers.Attach(&dec);
+    CHECK(wait_for([&dec]() { return dec.m_stalling.load(); }, 1000));
+    start = test_clock::now();
+    dec.m_quit = true;
+    workers.Detach(&dec);
+    dec.m_detached = true;
+    CHECK(!dec.m_stalling.load());
+    CHECK(elapsed_ms(start) >= 100);
+    CHECK(dec.m_closed.load() == 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(dec.m_violation.load() == 0);
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+
+    failed += test_all_streams_done() ? 1 : 0;
+    failed += test_stall_isolated() ? 1 : 0;
+    failed += test_detach_running() ? 1 : 0;
+    failed += test_detach_stalled() ? 1 : 0;
+
+    printf("%s\n", failed ? "decode workers test failed" : "decode workers test passed");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+/***************************************************************************
+ * COPYRIGHT NOTICE
+ * Copyright 2023 Horizon Robotics, Inc.
+ * All rights reserved.
+ ***************************************************************************/
+// x3_vps_plan_chn 的表驱动测试：每一项给出一组输出请求和期望的通道分配
+
+#include <stdio.h>
+#include <string.h>
+
+#include "x3_vps_plan.h"
+
+#define NONE (-1)
+
+typedef struct {
+    const char *name;
+    int req_num;
+    x3_vps_plan_req_t reqs[VPS_PLAN_MAX_REQ];
+    int ret;
+    int chn[VPS_PLAN_MAX_REQ];
+} vps_plan_case_t;
+
+// 请求字段顺序：src_w, src_h, crop_w, crop_h, dst_w, dst_h, rotate
+static const vps_plan_case_t vps_plan_cases[] = {
+    // 原来的贪心选择会放到 DS2，余量项让它落到刚好放得下的 DS1，把 DS2 留给 4K 输出
+    {"same size takes ds1 not ds2 (less slack)", 1,
+     {{1920, 1080, 0, 0, 1920, 1080, 0}},
+     0, {VPS_PLAN_DS1}},
+    {"small output takes the smallest chn", 1,
+     {{1920, 1080, 0, 0, 640, 360, 0}},
+     0, {VPS_PLAN_DS0}},
+    {"4k output only fits ds2", 1,
+     {{3840, 2160, 0, 0, 3840, 2160, 0}},
+     0, {VPS_PLAN_DS2}},
+    {"upscale only fits us", 1,
+     {{1280, 720, 0, 0, 1920, 1080, 0}},
+     0, {VPS_PLAN_US}},
+    {"two small outputs use both small chns", 2,
+     {{1920, 1080, 0, 0, 640, 360, 0}, {1920, 1080, 0, 0, 1280, 720, 0}},
+     0, {VPS_PLAN_DS0, VPS_PLAN_DS4}},
+    {"crop is the scaler input", 1,
+     {{1920, 1080, 640, 360, 1280, 720, 0}},
+     0, {VPS_PLAN_US}},
+    {"rotate swaps the scaler input", 1,
+     {{1920, 1080, 0, 0, 1080, 1920, 1}},
+     0, {VPS_PLAN_DS2}},
+    {"full house", 6,
+     {{3840, 2160, 0, 0, 3840, 2160, 0}, {3840, 2160, 0, 0, 1920, 1080, 0},
+      {3840, 2160, 0, 0, 1920, 1080, 0}, {3840, 2160, 0, 0, 1280, 720, 0},
+      {3840, 2160, 0, 0, 640, 360, 0}, {1920, 1080, 0, 0, 3840, 2160, 0}},
+     0, {VPS_PLAN_DS2, VPS_PLAN_DS1, VPS_PLAN_DS3, VPS_PLAN_DS0, VPS_PLAN_DS4, VPS_PLAN_US}},
+    // 两个请求都只能放 US，输入相同，放输出小的那个（写出像素要进入代价）
+    {"smaller output wins the only chn", 2,
+     {{640, 360, 0, 0, 3840, 2160, 0}, {640, 360, 0, 0, 1920, 1080, 0}},
+     -1, {NONE, VPS_PLAN_US}},
+    {"smaller input wins the only chn", 2,
+     {{1280, 720, 0, 0, 3840, 2160, 0}, {640, 360, 0, 0, 3840, 2160, 0}},
+     -1, {NONE, VPS_PLAN_US}},
+    {"too big for every chn", 1,
+     {{1920, 1080, 0, 0, 8192, 4320, 0}},
+     -1, {NONE}},
+};
+
+static int vps_plan_check(const vps_plan_case_t *c)
+{
+    x3_vps_plan_t plan;
+    int ret = x3_vps_plan_chn(c->reqs, c->req_num, &plan);
+    int i = 0, ok = (ret == c->ret);
+
+    for (i = 0; i < c->req_num; i++) {
+        if (plan.chn[i] != c->chn[i])
+            ok = 0;
+    }
+    if (ok)
+        return 0;
+
+    printf("FAIL %s: ret %d (expect %d)\n", c->name, ret, c->ret);
+    for (i = 0; i < c->req_num; i++) {
+        printf("  req%d: %s (expect %s) %s\n", i,
+               x3_vps_plan_chn_name(plan.chn[i]), x3_vps_plan_chn_name(c->chn[i]),
+               plan.chn[i] < 0 ? plan.reason[i] : "");
+    }
+    return -1;
+}
+
+int main(void)
+{
+    int num = sizeof(vps_plan_cases) / sizeof(vps_plan_cases[0]);
+    int i = 0, failed = 0;
+
+    for (i = 0; i < num; i++) {
+        if (vps_plan_check(&vps_plan_cases[i]))
+            failed++;
+    }
+    printf("%d/%d vps plan cases passed\n", num - failed, num);
+    return failed ? 1 : 0;
+}